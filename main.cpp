@@ -1,51 +1,27 @@
+#include <cstdio>
 #include <iostream>
+#include <memory>
 #include <thread>
-#include <latch>
 #include <chrono>
-#include <mutex>
 
-#include "src/util/spsc_queue.h"
-
-#include <boost/lockfree/spsc_queue.hpp>
 #include <gtest/gtest.h>
 
+#include "src/backtest/backtester.h"
+#include "src/client/ws_execution_client.h"
 #include "src/client/ws_order_book_client.h"
+#include "src/replay/frame_file.h"
+#include "src/replay/replay_driver.h"
+#include "src/store/tick_store.h"
 #include "src/trading/feature_engine.h"
 #include "src/trading/trading_engine.h"
+#include "src/util/latency_probe.h"
+#include "src/util/logger.h"
+#include "src/util/metrics.h"
+#include "src/util/symbol_table.h"
+#include "src/test/bench/bench.h"
 
 using namespace std::literals::chrono_literals;
-
-std::latch latch(2);
-std::mutex cout_mutex;
-
-struct X {
-  int x;
-};
-
-template<typename T>
-using QueueT = util::SpscQueue<T>;
-
-const int F = 10;
-const int N = 100000;
-const int M = F * N;
-
-auto consumeFunction(QueueT<X> &lfq) {
-  latch.arrive_and_wait();
-
-  size_t count{0};
-  auto start = std::chrono::high_resolution_clock::now();
-  while (count < M) {
-    X item{};
-    if (lfq.pop(item)) count++;
-  }
-  auto end = std::chrono::high_resolution_clock::now(); // End time
-  std::chrono::duration<double, std::micro> duration = end - start; // Measure time in microseconds
-
-  cout_mutex.lock();
-  std::cout << "consumed " << count << " items, duration [micros] = " << duration.count() << ", tps="
-      << (double) M / (duration.count() / 1000000) << std::endl;
-  cout_mutex.unlock();
-}
+using namespace util::literals;
 
 int main(int argc, char *argv[]) {
   for (int i = 1; i < argc; ++i) {
@@ -54,35 +30,162 @@ int main(int argc, char *argv[]) {
       return RUN_ALL_TESTS();
     }
   }
+  for (int i = 1; i < argc; ++i) {
+    if (std::string(argv[i]).find("--bench-scale=") == 0) {
+      bench::scale() = std::stod(std::string(argv[i]).substr(std::string("--bench-scale=").size()));
+    }
+  }
+  for (int i = 1; i < argc; ++i) {
+    if (std::string(argv[i]).find("--bench") == 0 && std::string(argv[i]).find("--bench-scale=") != 0) {
+      const auto arg = std::string(argv[i]);
+      return bench::runBenchmarks(arg.find('=') != std::string::npos ? arg.substr(arg.find('=') + 1) : "");
+    }
+  }
 
-  util::SpscQueue<client::WsOrderBookClient::WsBestBidBestAskMsg> incoming_order_book_updates_queue(10000);
-  util::SpscQueue<client::WsOrderEntryClient::WsOrderEntryReqMsg> outgoing_order_entry_req_queue(10000);
-  util::SpscQueue<client::WsOrderEntryClient::WsOrderEntryResMsg> incoming_order_entry_res_queue(10000);
+  // Every instrument we trade with its tick and lot size, interned once. Everything downstream works with the
+  // dense SymbolIds.
+  util::SymbolTable symbols;
+  symbols.add("BTCGUSDPERP", {.tick_size = 0.5_px, .lot_size = 0.0001_qty});
+  symbols.add("ETHGUSDPERP", {.tick_size = 0.01_px, .lot_size = 0.001_qty});
+  symbols.add("SOLGUSDPERP", {.tick_size = 0.001_px, .lot_size = 0.01_qty});
 
-  client::WsOrderBookClient ws_order_book_client("wss://api.gemini.com/v2/marketdata",
-                                                 incoming_order_book_updates_queue);
-  ws_order_book_client.start();
+  // --replay=<capture> [--replay-speed=<x>]: run a capture through the pipeline against a mock gateway, as
+  // fast as possible or, given a speed, paced like it was recorded.
+  for (int i = 1; i < argc; ++i) {
+    if (std::string(argv[i]).find("--replay=") == 0) {
+      replay::ReplayConfig config;
+      for (int j = 1; j < argc; ++j) {
+        if (std::string(argv[j]).find("--replay-speed=") == 0) {
+          config.real_time = true;
+          config.speed = std::stod(std::string(argv[j]).substr(std::string("--replay-speed=").size()));
+        }
+      }
+      replay::FrameReader reader(std::string(argv[i]).substr(std::string("--replay=").size()));
+      replay::ReplayDriver driver(symbols, config);
+      const auto stats = driver.run(reader);
+      std::printf("frames: %lu, book updates: %lu, trades: %lu, new orders: %lu, cancels: %lu, checksum: %016lx\n"
+                  "%.0f frames/s, %.1f ns/frame, %.1f MB/s\n",
+                  stats.frames, stats.book_updates, stats.trades, stats.new_orders, stats.cancels, stats.checksum,
+                  stats.framesPerSecond(), stats.nanosPerFrame(),
+                  static_cast<double>(stats.bytes) * 1e3 / static_cast<double>(std::max<int64_t>(stats.elapsed_ns, 1)));
+      return 0;
+    }
+  }
 
-  client::WsOrderEntryClient ws_order_entry_client("https://api.gemini.com", outgoing_order_entry_req_queue,
-                                                   incoming_order_entry_res_queue,
-                                                   "key", "secret");
-  ws_order_entry_client.start();
+  // --backtest=<tick store> --backtest-date=<YYYYMMDD> [--backtest-symbol=<symbol>]: run the strategy against a
+  // recorded day in simulated time.
+  for (int i = 1; i < argc; ++i) {
+    if (std::string(argv[i]).find("--backtest=") == 0) {
+      uint32_t date = 0;
+      std::string symbol = "BTCGUSDPERP";
+      for (int j = 1; j < argc; ++j) {
+        if (std::string(argv[j]).find("--backtest-date=") == 0) {
+          date = static_cast<uint32_t>(std::stoul(std::string(argv[j]).substr(std::string("--backtest-date=").size())));
+        } else if (std::string(argv[j]).find("--backtest-symbol=") == 0) {
+          symbol = std::string(argv[j]).substr(std::string("--backtest-symbol=").size());
+        }
+      }
+      const auto root = std::string(argv[i]).substr(std::string("--backtest=").size());
+      const auto l2 = store::openStream(root, date, symbol, store::Stream::L2_DELTAS);
+      const auto trades = store::openStream(root, date, symbol, store::Stream::TRADES);
+      backtest::BacktestConfig config;
+      if (const auto id = symbols.find(symbol); id != util::InvalidSymbolId) {
+        config.exchange.book.tick_size = symbols.spec(id).tick_size;
+      }
+      backtest::Backtester backtester(backtest::TickColumns::fromStream(l2), backtest::TickColumns::fromStream(trades),
+                                      config);
+      const auto result = backtester.run();
+      std::printf("book updates: %lu, trades: %lu, new orders: %lu, cancels: %lu, fills: %lu\n"
+                  "position: %.8g, cash: %.2f, pnl: %.2f\n%.0f ticks/s\n",
+                  result.book_updates, result.trades, result.new_orders, result.cancels, result.fills,
+                  result.position, result.cash, result.pnl, result.ticksPerSecond());
+      return 0;
+    }
+  }
+
+  // Counters and gauges of the live pipeline go to shared memory for cmm_metrics, replays and backtests above
+  // keep theirs private.
+  util::MetricsRegistry::configure(util::MetricsConfig{.shm_name = "/crypto_mm.metrics"});
+
+  // Formatting and writing happens on a housekeeping CPU, away from the isolated trading engine CPU.
+  util::Logger::instance().start(util::LoggerConfig{.file = stdout, .cpu_id = 0});
 
-  trading::FeatureEngine feature_engine;
-  trading::OrderManager order_manager(outgoing_order_entry_req_queue);
+  // Top of book is handed over as the latest value per symbol, trades, orders and their responses are queued.
+  util::LatestValueSlots<client::WsOrderBookClient::WsBestBidBestAskMsg> incoming_order_book_updates(symbols.size());
+  util::SpscQueue<client::WsTradesMsg> incoming_trades(10000);
+  util::SpscQueue<client::WsOrderEntryClient::WsOrderEntryReqMsg> outgoing_order_entry_req_queue(10000);
+  util::SpscQueue<client::WsOrderEntryClient::WsOrderEntryResMsg> incoming_order_entry_res_queue(10000);
+  util::SpscQueue<client::WsOrderEntryClient::WsOrderEntryResMsg> incoming_order_events(10000);
+
+  trading::FeatureEngine feature_engine(symbols.size());
+  trading::OrderManager order_manager(outgoing_order_entry_req_queue, symbols.size());
+  for (util::SymbolId id = 0; id < symbols.size(); ++id) {
+    order_manager.setSymbolSpec(id, symbols.spec(id));
+  }
   trading::MarketMaker market_maker(order_manager, feature_engine);
+  // The trading engine owns an isolated CPU (see the README) so it never has to give it up.
   trading::TradingEngine trading_engine(
     feature_engine,
     order_manager,
     market_maker,
-    incoming_order_book_updates_queue,
-    incoming_order_entry_res_queue
+    incoming_order_book_updates,
+    incoming_order_entry_res_queue,
+    trading::TradingEngineConfig{
+      .wait_strategy = util::WaitStrategyType::BUSY_SPIN,
+      .max_batch = 64,
+      .cpu_id = 8,
+      .measure_wire_to_decision = true
+    }
   );
+  trading_engine.setIncomingTrades(&incoming_trades);
+  trading_engine.setIncomingOrderEvents(&incoming_order_events);
+
+  client::WsOrderBookClient ws_order_book_client("wss://api.gemini.com/v2/marketdata", symbols,
+                                                 incoming_order_book_updates,
+                                                 &trading_engine.waitStrategy());
+  ws_order_book_client.set_trade_queue(incoming_trades);
+  // --capture=<file>: record every market data frame for later replay.
+  std::unique_ptr<replay::FrameWriter> capture;
+  for (int i = 1; i < argc; ++i) {
+    if (std::string(argv[i]).find("--capture=") == 0) {
+      capture = std::make_unique<replay::FrameWriter>(std::string(argv[i]).substr(std::string("--capture=").size()));
+      ws_order_book_client.set_capture(capture.get());
+    }
+  }
+  // --tick-store=<dir>: persist l2 changes, top of book and trades for research and backtests.
+  std::unique_ptr<store::TickStoreWriter> tick_store;
+  for (int i = 1; i < argc; ++i) {
+    if (std::string(argv[i]).find("--tick-store=") == 0) {
+      tick_store = std::make_unique<store::TickStoreWriter>(symbols, store::TickStoreConfig{
+                                                              .root = std::string(argv[i]).substr(
+                                                                std::string("--tick-store=").size()),
+                                                              .cpu_id = 0
+                                                            });
+      tick_store->start();
+      ws_order_book_client.set_tick_store(tick_store.get());
+    }
+  }
+  ws_order_book_client.start();
+
+  client::WsOrderEntryClient ws_order_entry_client("https://api.gemini.com", symbols,
+                                                   outgoing_order_entry_req_queue,
+                                                   incoming_order_entry_res_queue,
+                                                   "key", "secret", &trading_engine.waitStrategy());
+  ws_order_entry_client.start();
+
+  // Fills and cancels made by the exchange, on an isolated CPU next to the engine's.
+  client::WsExecutionClient ws_execution_client(
+    "wss://api.gemini.com/v1/order/events?eventTypeFilter=accepted&eventTypeFilter=rejected&eventTypeFilter=fill"
+    "&eventTypeFilter=cancelled&eventTypeFilter=cancel_rejected", symbols, incoming_order_events, "key", "secret",
+    &trading_engine.waitStrategy(), client::WsExecutionClientConfig{.cpu_id = 9});
+  ws_execution_client.start();
 
   trading_engine.start();
 
+  // The main thread is left to monitoring.
   while (true) {
-    std::this_thread::sleep_for(10ms);
+    std::this_thread::sleep_for(10s);
+    util::LatencyProbes::instance().report();
   }
 
   return 0;
@@ -0,0 +1,227 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <limits>
+#include <span>
+#include <thread>
+#include <vector>
+
+#include "sim_exchange.h"
+#include "../client/l2_book_builder.h"
+#include "../store/tick_store.h"
+#include "../trading/feature_engine.h"
+#include "../trading/market_maker.h"
+#include "../trading/order_manager.h"
+#include "../trading/trading_engine.h"
+#include "../util/metrics.h"
+
+namespace backtest {
+  // One day of an l2 deltas or trades stream for one symbol, as columns in timestamp order, prices and
+  // quantities util::FixedPointScale fixed-point. Usually views into a tick store mapping, which any number of
+  // backtests can share read only.
+  struct TickColumns {
+    std::span<const int64_t> timestamps;
+    std::span<const int8_t> sides;
+    std::span<const int64_t> prices;
+    std::span<const int64_t> quantities;
+
+    static TickColumns fromStream(const store::StreamReader &reader) noexcept {
+      return TickColumns{reader.timestamps(), reader.sides(), reader.prices(), reader.quantities()};
+    }
+
+    size_t rows() const noexcept {
+      return timestamps.size();
+    }
+  };
+
+  struct BacktestConfig {
+    trading::OrderManagerConfig order_manager{};
+    SimExchangeConfig exchange{};
+    size_t queue_capacity{4096};
+  };
+
+  struct BacktestResult {
+    uint64_t book_updates{0};
+    uint64_t trades{0};
+    uint64_t new_orders{0};
+    uint64_t cancels{0};
+    uint64_t fills{0};
+    double position{0.0};
+    double cash{0.0};
+    // Cash plus the position marked at the last mid.
+    double pnl{0.0};
+    // Price moves and re-quotes of the order manager, in simulated time.
+    trading::OrderManagerStats quoting{};
+    int64_t elapsed_ns{0};
+
+    double ticksPerSecond() const noexcept {
+      return elapsed_ns ? static_cast<double>(book_updates + trades) * 1e9 / static_cast<double>(elapsed_ns) : 0.0;
+    }
+  };
+
+  // Event driven backtest of the production strategy on recorded ticks: FeatureEngine, MarketMaker and
+  // OrderManager run unchanged behind a TradingEngine driven through processPending(), a SimExchange stands
+  // in for the exchange. Everything runs on the calling thread in simulated time, every tick is processed
+  // until the strategy and the exchange are quiet again, so a result only depends on the ticks and the
+  // configuration.
+  class Backtester {
+  public:
+    using Config = BacktestConfig;
+    using ReqMsg = client::WsOrderEntryClient::WsOrderEntryReqMsg;
+    using ResMsg = client::WsOrderEntryClient::WsOrderEntryResMsg;
+
+    static constexpr util::SymbolId Symbol = 0;
+
+    Backtester(const TickColumns &l2_deltas, const TickColumns &trades, const Config &config = Config{})
+      : l2_deltas_(l2_deltas)
+        , trades_(trades)
+        , book_updates_(1)
+        , order_entry_req_queue_(config.queue_capacity)
+        , order_entry_res_queue_(config.queue_capacity)
+        , feature_engine_(1)
+        , order_manager_(order_entry_req_queue_, 1, withOwnMetrics(config.order_manager))
+        , market_maker_(order_manager_, feature_engine_)
+        , trading_engine_(feature_engine_, order_manager_, market_maker_, book_updates_,
+                          order_entry_res_queue_, withOwnMetrics(trading::TradingEngineConfig{}))
+        , exchange_(order_entry_req_queue_, order_entry_res_queue_, config.exchange) {
+      order_manager_.setSymbolSpec(Symbol, util::SymbolSpec{.tick_size = config.exchange.book.tick_size});
+    }
+
+    Backtester(const Backtester &) = delete;
+
+    Backtester(const Backtester &&) = delete;
+
+    Backtester &operator=(const Backtester &) = delete;
+
+    Backtester &operator=(const Backtester &&) = delete;
+
+    BacktestResult run() {
+      BacktestResult result;
+      const auto start = std::chrono::steady_clock::now();
+      size_t l2_row = 0;
+      size_t trade_row = 0;
+      int64_t now = 0;
+      while (l2_row < l2_deltas_.rows() || trade_row < trades_.rows()) {
+        now = std::min(l2_row < l2_deltas_.rows() ? l2_deltas_.timestamps[l2_row] : MaxTime,
+                       trade_row < trades_.rows() ? trades_.timestamps[trade_row] : MaxTime);
+        // Orders and responses still in flight happen before the ticks they precede.
+        runUntil(now);
+        const auto first_l2_row = l2_row;
+        for (; l2_row < l2_deltas_.rows() && l2_deltas_.timestamps[l2_row] == now; ++l2_row) {
+          exchange_.onL2Delta(static_cast<client::Side>(l2_deltas_.sides[l2_row]),
+                              util::Price::fromFixed(l2_deltas_.prices[l2_row]),
+                              util::Qty::fromFixed(l2_deltas_.quantities[l2_row]));
+        }
+        for (; trade_row < trades_.rows() && trades_.timestamps[trade_row] == now; ++trade_row) {
+          const auto side = static_cast<client::Side>(trades_.sides[trade_row]);
+          const auto price = util::Price::fromFixed(trades_.prices[trade_row]);
+          const auto quantity = util::Qty::fromFixed(trades_.quantities[trade_row]);
+          exchange_.onTrade(now, side, price, quantity);
+          feature_engine_.onTrade(Symbol, side, price, quantity);
+          ++result.trades;
+        }
+        if (l2_row != first_l2_row) {
+          result.book_updates += l2_row - first_l2_row;
+          publishBestBidBestAsk();
+        }
+        settle(now);
+      }
+      runUntil(MaxTime);
+      result.elapsed_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - start).count();
+
+      const auto &book = exchange_.book();
+      result.new_orders = exchange_.newOrders();
+      result.cancels = exchange_.cancels();
+      result.fills = exchange_.fills();
+      result.quoting = order_manager_.stats();
+      result.position = exchange_.position().toDouble();
+      result.cash = exchange_.cash();
+      result.pnl = result.cash;
+      if (book.hasBid() && book.hasAsk()) {
+        const auto mid = (book.toPrice(book.bestBid().price_ticks) + book.toPrice(book.bestAsk().price_ticks)) / 2;
+        result.pnl += result.position * mid.toDouble();
+      }
+      return result;
+    }
+
+    const SimExchange &exchange() const noexcept {
+      return exchange_;
+    }
+
+    const trading::FeatureEngine &featureEngine() const noexcept {
+      return feature_engine_;
+    }
+
+    const trading::OrderManager &orderManager() const noexcept {
+      return order_manager_;
+    }
+
+  private:
+    static constexpr int64_t MaxTime = std::numeric_limits<int64_t>::max();
+
+    // Backtests run side by side, each one's engines write metrics of their own.
+    template<typename EngineConfig>
+    EngineConfig withOwnMetrics(EngineConfig config) noexcept {
+      config.metrics = &metrics_;
+      return config;
+    }
+
+    void publishBestBidBestAsk() {
+      book_updates_.store(Symbol, client::make_best_bid_best_ask_msg(Symbol, exchange_.book()));
+    }
+
+    // Lets the exchange and the strategy react to each other at `now` until neither has anything left to do.
+    void settle(int64_t now) {
+      order_manager_.onTimer(now);
+      while (trading_engine_.processPending() + exchange_.acceptRequests(now) + exchange_.advance(now) != 0) {
+      }
+    }
+
+    // Plays out the exchange events due before `until`, each at its own time.
+    void runUntil(int64_t until) {
+      for (auto next = exchange_.nextEventTime(until); next < until; next = exchange_.nextEventTime(until)) {
+        settle(next);
+      }
+    }
+
+    const TickColumns l2_deltas_;
+    const TickColumns trades_;
+    util::MetricsRegistry metrics_;
+    util::LatestValueSlots<client::WsBestBidBestAskMsg> book_updates_;
+    util::SpscQueue<ReqMsg> order_entry_req_queue_;
+    util::SpscQueue<ResMsg> order_entry_res_queue_;
+    trading::FeatureEngine feature_engine_;
+    trading::OrderManager order_manager_;
+    trading::MarketMaker market_maker_;
+    trading::TradingEngine trading_engine_;
+    SimExchange exchange_;
+  };
+
+  // Runs one backtest per configuration over the same ticks on up to `threads` threads. The results are in
+  // the order of `configs`.
+  inline std::vector<BacktestResult> runBacktests(const TickColumns &l2_deltas, const TickColumns &trades,
+                                                  std::span<const BacktestConfig> configs,
+                                                  unsigned threads = std::thread::hardware_concurrency()) {
+    std::vector<BacktestResult> results(configs.size());
+    std::atomic<size_t> next{0};
+    const auto worker = [&] {
+      for (auto i = next.fetch_add(1); i < configs.size(); i = next.fetch_add(1)) {
+        Backtester backtester(l2_deltas, trades, configs[i]);
+        results[i] = backtester.run();
+      }
+    };
+    std::vector<std::thread> pool;
+    const auto count = std::clamp<size_t>(threads, 1, std::max<size_t>(configs.size(), 1));
+    for (size_t i = 1; i < count; ++i) {
+      pool.emplace_back(worker);
+    }
+    worker();
+    for (auto &thread: pool) {
+      thread.join();
+    }
+    return results;
+  }
+}
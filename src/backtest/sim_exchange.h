@@ -0,0 +1,292 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <deque>
+#include <vector>
+
+#include "../book/order_book.h"
+#include "../client/ws_order_entry_client.h"
+#include "../util/decimal.h"
+#include "../util/spsc_queue.h"
+
+namespace backtest {
+  struct SimExchangeConfig {
+    // From a request leaving the order manager until the exchange acts on it.
+    int64_t request_latency_ns{2'000'000};
+    // From the exchange acting until the response reaches the order manager.
+    int64_t response_latency_ns{2'000'000};
+    book::OrderBookConfig book{};
+  };
+
+  // Matching engine stand-in for backtests. It keeps the historical book and rests our orders in it with a
+  // queue position: an order joins behind everything displayed at its price when it arrives, trades at the
+  // price eat that queue before they fill us, and cancellations of others can only move us up to the size
+  // still displayed. A trade through our price fills us completely. Orders crossing the book on arrival take
+  // the opposite side level by level like a market order would.
+  //
+  // Time is whatever the caller says it is. Requests taken at t act at t + request_latency_ns, and the
+  // responses they cause arrive at that time plus response_latency_ns. Both latencies are constant, so both
+  // event streams are FIFO.
+  class SimExchange {
+  public:
+    using Config = SimExchangeConfig;
+    using ReqMsg = client::WsOrderEntryClient::WsOrderEntryReqMsg;
+    using ResMsg = client::WsOrderEntryClient::WsOrderEntryResMsg;
+
+    SimExchange(util::SpscQueue<ReqMsg> &request_queue, util::SpscQueue<ResMsg> &response_queue,
+                const Config &config = Config{})
+      : config_(config), request_queue_(request_queue), response_queue_(response_queue), book_(config.book) {
+    }
+
+    SimExchange(const SimExchange &) = delete;
+
+    SimExchange(const SimExchange &&) = delete;
+
+    SimExchange &operator=(const SimExchange &) = delete;
+
+    SimExchange &operator=(const SimExchange &&) = delete;
+
+    // Historical market data.
+    void onL2Delta(client::Side side, util::Price price, util::Qty displayed) noexcept {
+      const auto price_ticks = book_.toTicks(price);
+      book_.update(side, price_ticks, displayed);
+      for (auto &order: resting_) {
+        if (order.side == side && order.price_ticks == price_ticks) {
+          order.queue_ahead = std::min(order.queue_ahead, displayed);
+        }
+      }
+    }
+
+    // `aggressor` is the taker side, the trade fills resting orders of the other side.
+    void onTrade(int64_t now, client::Side aggressor, util::Price price, util::Qty quantity) {
+      const auto price_ticks = book_.toTicks(price);
+      auto remaining = quantity;
+      for (size_t i = 0; i < resting_.size();) {
+        auto &order = resting_[i];
+        if (order.side == aggressor) {
+          ++i;
+          continue;
+        }
+        const bool through = order.side == client::Side::BID ? price_ticks < order.price_ticks
+                                                             : price_ticks > order.price_ticks;
+        util::Qty filled;
+        if (through) {
+          filled = order.leaves;
+        } else if (price_ticks == order.price_ticks) {
+          const auto ahead = std::min(order.queue_ahead, remaining);
+          order.queue_ahead -= ahead;
+          remaining -= ahead;
+          filled = std::min(order.leaves, remaining);
+          remaining -= filled;
+        }
+        if (!filled.isZero() && fill(now, order, order.price_ticks, filled)) {
+          resting_.erase(resting_.begin() + static_cast<std::ptrdiff_t>(i));
+        } else {
+          ++i;
+        }
+      }
+    }
+
+    // Takes the requests the order manager has sent by `now`.
+    size_t acceptRequests(int64_t now) {
+      size_t accepted = 0;
+      ReqMsg request;
+      while (request_queue_.pop(request)) {
+        requests_.push_back(PendingRequest{now + config_.request_latency_ns, request});
+        ++accepted;
+      }
+      return accepted;
+    }
+
+    // Runs everything due by `now` in time order, returns how many events that was.
+    size_t advance(int64_t now) {
+      size_t processed = 0;
+      for (;;) {
+        const bool request_due = !requests_.empty() && requests_.front().time <= now;
+        const bool response_due = !responses_.empty() && responses_.front().time <= now;
+        if (request_due && (!response_due || requests_.front().time <= responses_.front().time)) {
+          const auto pending = requests_.front();
+          requests_.pop_front();
+          execute(pending.time, pending.request);
+        } else if (response_due) {
+          if (!response_queue_.push(responses_.front().response)) {
+            // Delivered on the next call once the consumer caught up.
+            return processed;
+          }
+          responses_.pop_front();
+        } else {
+          return processed;
+        }
+        ++processed;
+      }
+    }
+
+    // Time of the next request or response still in flight, or `otherwise` if there is none.
+    int64_t nextEventTime(int64_t otherwise) const noexcept {
+      auto next = otherwise;
+      if (!requests_.empty()) {
+        next = std::min(next, requests_.front().time);
+      }
+      if (!responses_.empty()) {
+        next = std::min(next, responses_.front().time);
+      }
+      return next;
+    }
+
+    const book::OrderBook &book() const noexcept {
+      return book_;
+    }
+
+    size_t restingOrders() const noexcept {
+      return resting_.size();
+    }
+
+    uint64_t newOrders() const noexcept {
+      return new_orders_;
+    }
+
+    uint64_t cancels() const noexcept {
+      return cancels_;
+    }
+
+    uint64_t fills() const noexcept {
+      return fills_;
+    }
+
+    // Our position and the cash it cost, in base and quote units.
+    util::Qty position() const noexcept {
+      return position_;
+    }
+
+    double cash() const noexcept {
+      return cash_;
+    }
+
+  private:
+    struct PendingRequest {
+      int64_t time;
+      ReqMsg request;
+    };
+
+    struct PendingResponse {
+      int64_t time;
+      ResMsg response;
+    };
+
+    struct RestingOrder {
+      uint64_t order_id;
+      uint64_t client_order_id;
+      util::SymbolId symbol_id;
+      client::Side side;
+      int64_t price_ticks;
+      util::Qty leaves;
+      util::Qty queue_ahead;
+    };
+
+    void execute(int64_t now, const ReqMsg &request) {
+      if (request.type == ReqMsg::RequestType::NEW_ORDER) {
+        place(now, request);
+      } else if (request.type == ReqMsg::RequestType::CANCEL_ORDER) {
+        cancel(now, request);
+      }
+    }
+
+    void place(int64_t now, const ReqMsg &request) {
+      ++new_orders_;
+      RestingOrder order{
+        .order_id = ++next_order_id_, .client_order_id = request.client_order_id, .symbol_id = request.symbol_id,
+        .side = request.side, .price_ticks = book_.toTicks(request.price), .leaves = request.quantity,
+        .queue_ahead = util::Qty{}
+      };
+      respond(now, order, ResMsg::OrdStatus::NEW);
+      if (take(now, order)) {
+        return;
+      }
+      order.queue_ahead = book_.quantityAt(order.side, order.price_ticks);
+      resting_.push_back(order);
+    }
+
+    // Fills a crossing order against the opposite side of the book, taking the liquidity it used out of the
+    // book until the next delta for those levels. Returns true if nothing is left to rest.
+    bool take(int64_t now, RestingOrder &order) {
+      const auto opposite = order.side == client::Side::BID ? client::Side::ASK : client::Side::BID;
+      for (;;) {
+        const bool crosses = order.side == client::Side::BID
+                               ? book_.hasAsk() && order.price_ticks >= book_.bestAsk().price_ticks
+                               : book_.hasBid() && order.price_ticks <= book_.bestBid().price_ticks;
+        if (!crosses) {
+          return false;
+        }
+        const auto level = order.side == client::Side::BID ? book_.bestAsk() : book_.bestBid();
+        const auto quantity = std::min(order.leaves, level.quantity);
+        book_.update(opposite, level.price_ticks, level.quantity - quantity);
+        if (fill(now, order, level.price_ticks, quantity)) {
+          return true;
+        }
+      }
+    }
+
+    void cancel(int64_t now, const ReqMsg &request) {
+      const auto it = std::find_if(resting_.begin(), resting_.end(), [&](const RestingOrder &order) {
+        return order.client_order_id == request.client_order_id;
+      });
+      if (it == resting_.end()) {
+        // Filled while the cancel was on its way.
+        RestingOrder order{.order_id = request.order_id, .client_order_id = request.client_order_id,
+                           .symbol_id = request.symbol_id, .side = request.side, .price_ticks = 0, .leaves = {},
+                           .queue_ahead = {}};
+        respond(now, order, ResMsg::OrdStatus::REJECTED);
+        return;
+      }
+      ++cancels_;
+      respond(now, *it, ResMsg::OrdStatus::CANCELED);
+      resting_.erase(it);
+    }
+
+    // Returns true once the order is completely filled.
+    bool fill(int64_t now, RestingOrder &order, int64_t price_ticks, util::Qty quantity) {
+      ++fills_;
+      const auto notional = book_.toPrice(price_ticks).toDouble() * quantity.toDouble();
+      if (order.side == client::Side::BID) {
+        position_ += quantity;
+        cash_ -= notional;
+      } else {
+        position_ -= quantity;
+        cash_ += notional;
+      }
+      order.leaves -= quantity;
+      if (order.leaves.isZero()) {
+        respond(now, order, ResMsg::OrdStatus::FILLED);
+        return true;
+      }
+      respond(now, order, ResMsg::OrdStatus::PARTIALLY_FILLED);
+      return false;
+    }
+
+    void respond(int64_t now, const RestingOrder &order, ResMsg::OrdStatus status) {
+      ResMsg response;
+      response.status = status;
+      response.side = order.side;
+      response.symbol_id = order.symbol_id;
+      response.leaves_qty = order.leaves;
+      response.order_id = order.order_id;
+      response.client_order_id = order.client_order_id;
+      responses_.push_back(PendingResponse{now + config_.response_latency_ns, response});
+    }
+
+    const Config config_;
+    util::SpscQueue<ReqMsg> &request_queue_;
+    util::SpscQueue<ResMsg> &response_queue_;
+    book::OrderBook book_;
+    std::vector<RestingOrder> resting_;
+    std::deque<PendingRequest> requests_;
+    std::deque<PendingResponse> responses_;
+    uint64_t next_order_id_{0};
+    uint64_t new_orders_{0};
+    uint64_t cancels_{0};
+    uint64_t fills_{0};
+    util::Qty position_{};
+    double cash_{0.0};
+  };
+}
@@ -0,0 +1,168 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+#include "../client/types.h"
+#include "../util/decimal.h"
+#include "../util/symbol_table.h"
+
+namespace book {
+  struct OrderBookConfig {
+    // Prices are stored as integer multiples of the tick size, it has to divide every price we see.
+    util::Price tick_size{util::SymbolSpec{}.tick_size};
+    // Levels exposed per side. Up to twice as many are kept so the worst ones can be dropped in bulk.
+    size_t max_depth{1000};
+  };
+
+  struct Level {
+    int64_t price_ticks{};
+    util::Qty quantity{};
+  };
+
+  // L2 book with integer tick prices. Each side is a sorted array reserved up front with the best
+  // level at the back: updates near the top of book (the common case) only move a handful of levels,
+  // best bid / best ask are O(1) and nothing allocates after construction. A full side drops its worst
+  // max_depth levels in one go, which keeps that O(depth) move amortized O(1) per update.
+  class OrderBook {
+  public:
+    explicit OrderBook(const OrderBookConfig &config = OrderBookConfig{})
+      : tick_size_(config.tick_size), max_depth_(std::max<size_t>(config.max_depth, 1)) {
+      bids_.reserve(2 * max_depth_);
+      asks_.reserve(2 * max_depth_);
+    }
+
+    // Exact, the tick size has to divide the price.
+    int64_t toTicks(util::Price price) const noexcept {
+      return price.steps(tick_size_);
+    }
+
+    util::Price toPrice(int64_t price_ticks) const noexcept {
+      return tick_size_ * price_ticks;
+    }
+
+    util::Price tickSize() const noexcept {
+      return tick_size_;
+    }
+
+    // Applies an absolute level update, zero quantity removes the level.
+    void update(client::Side side, int64_t price_ticks, util::Qty quantity) noexcept {
+      if (side == client::Side::BID) {
+        updateSide(bids_, price_ticks, quantity, [](int64_t lhs, int64_t rhs) { return lhs < rhs; });
+      } else if (side == client::Side::ASK) {
+        updateSide(asks_, price_ticks, quantity, [](int64_t lhs, int64_t rhs) { return lhs > rhs; });
+      }
+    }
+
+    void update(client::Side side, util::Price price, util::Qty quantity) noexcept {
+      update(side, toTicks(price), quantity);
+    }
+
+    void clear() noexcept {
+      bids_.clear();
+      asks_.clear();
+    }
+
+    bool hasBid() const noexcept {
+      return !bids_.empty();
+    }
+
+    bool hasAsk() const noexcept {
+      return !asks_.empty();
+    }
+
+    // Only valid if hasBid() / hasAsk().
+    const Level &bestBid() const noexcept {
+      return bids_.back();
+    }
+
+    const Level &bestAsk() const noexcept {
+      return asks_.back();
+    }
+
+    size_t bidDepth() const noexcept {
+      return std::min(bids_.size(), max_depth_);
+    }
+
+    size_t askDepth() const noexcept {
+      return std::min(asks_.size(), max_depth_);
+    }
+
+    // Level i counted from the top of book, 0 is the best one.
+    const Level &bidLevel(size_t i) const noexcept {
+      return bids_[bids_.size() - 1 - i];
+    }
+
+    const Level &askLevel(size_t i) const noexcept {
+      return asks_[asks_.size() - 1 - i];
+    }
+
+    // Quantity resting at a price, 0 if there is no such level.
+    util::Qty quantityAt(client::Side side, int64_t price_ticks) const noexcept {
+      if (side == client::Side::BID) {
+        return quantityAt(bids_, price_ticks, [](int64_t lhs, int64_t rhs) { return lhs < rhs; });
+      }
+      return quantityAt(asks_, price_ticks, [](int64_t lhs, int64_t rhs) { return lhs > rhs; });
+    }
+
+    size_t maxDepth() const noexcept {
+      return max_depth_;
+    }
+
+  private:
+    template<typename Worse>
+    static util::Qty quantityAt(const std::vector<Level> &levels, int64_t price_ticks, Worse worse) noexcept {
+      const auto it = std::lower_bound(levels.begin(), levels.end(), price_ticks,
+                                       [&](const Level &level, int64_t price) {
+                                         return worse(level.price_ticks, price);
+                                       });
+      return it != levels.end() && it->price_ticks == price_ticks ? it->quantity : util::Qty{};
+    }
+
+    // `worse(a, b)` is true when price a is further from the top of book than price b.
+    template<typename Worse>
+    void updateSide(std::vector<Level> &levels, int64_t price_ticks, util::Qty quantity, Worse worse) noexcept {
+      // Most updates land within a few levels of the top, walk those linearly before bisecting the rest.
+      auto it = levels.end();
+      const auto scan_end = levels.size() > LinearScanLevels ? levels.end() - LinearScanLevels : levels.begin();
+      while (it != scan_end && !worse((it - 1)->price_ticks, price_ticks)) {
+        --it;
+      }
+      if (it == scan_end && it != levels.begin()) {
+        it = std::lower_bound(levels.begin(), it, price_ticks, [&](const Level &level, int64_t price) {
+          return worse(level.price_ticks, price);
+        });
+      }
+      if (it != levels.end() && it->price_ticks == price_ticks) {
+        if (quantity > util::Qty{}) {
+          it->quantity = quantity;
+        } else {
+          levels.erase(it);
+        }
+        return;
+      }
+      if (quantity <= util::Qty{}) {
+        return;
+      }
+      // Not capacity(): a copied book starts with an unreserved vector.
+      if (levels.size() >= 2 * max_depth_) [[unlikely]] {
+        const auto position = it - levels.begin();
+        if (position < static_cast<std::ptrdiff_t>(max_depth_)) {
+          // Worse than every level we would keep.
+          return;
+        }
+        levels.erase(levels.begin(), levels.begin() + static_cast<std::ptrdiff_t>(max_depth_));
+        it = levels.begin() + (position - static_cast<std::ptrdiff_t>(max_depth_));
+      }
+      levels.insert(it, Level{price_ticks, quantity});
+    }
+
+    static constexpr size_t LinearScanLevels = 8;
+
+    const util::Price tick_size_;
+    const size_t max_depth_;
+    std::vector<Level> bids_;
+    std::vector<Level> asks_;
+  };
+}
@@ -0,0 +1,286 @@
+#pragma once
+
+#include <cstdint>
+#include <string_view>
+
+#include "types.h"
+#include "../util/decimal.h"
+
+namespace client {
+    struct GeminiTrade {
+        uint64_t event_id{};
+        uint64_t timestamp_ms{};
+        util::Price price{};
+        util::Qty quantity{};
+        Side aggressor_side{Side::NONE};
+    };
+
+    // Forward-only cursor over a JSON text. Strings are returned as views into the frame without
+    // unescaping, which is fine for everything Gemini puts in the fields we read.
+    class JsonCursor {
+    public:
+        explicit JsonCursor(std::string_view text) noexcept : p_(text.data()), end_(text.data() + text.size()) {
+        }
+
+        bool at_end() noexcept {
+            skip_whitespace();
+            return p_ == end_;
+        }
+
+        bool consume(char c) noexcept {
+            skip_whitespace();
+            if (p_ != end_ && *p_ == c) {
+                ++p_;
+                return true;
+            }
+            return false;
+        }
+
+        bool peek(char c) noexcept {
+            skip_whitespace();
+            return p_ != end_ && *p_ == c;
+        }
+
+        bool read_string(std::string_view &out) noexcept {
+            if (!consume('"')) {
+                return false;
+            }
+            const char *const begin = p_;
+            while (p_ != end_ && *p_ != '"') {
+                if (*p_ == '\\' && p_ + 1 != end_) {
+                    ++p_;
+                }
+                ++p_;
+            }
+            if (p_ == end_) {
+                return false;
+            }
+            out = std::string_view(begin, static_cast<size_t>(p_ - begin));
+            ++p_;
+            return true;
+        }
+
+        bool read_unsigned(uint64_t &out) noexcept {
+            skip_whitespace();
+            const char *const begin = p_;
+            uint64_t value = 0;
+            while (p_ != end_ && static_cast<unsigned>(*p_ - '0') < 10) {
+                value = value * 10 + static_cast<unsigned>(*p_ - '0');
+                ++p_;
+            }
+            out = value;
+            return p_ != begin;
+        }
+
+        // Skips one value of any type, returning the raw text it spanned.
+        bool skip_value(std::string_view &raw) noexcept {
+            skip_whitespace();
+            const char *const begin = p_;
+            if (p_ == end_) {
+                return false;
+            }
+            if (*p_ == '"') {
+                std::string_view ignored;
+                if (!read_string(ignored)) return false;
+            } else if (*p_ == '[' || *p_ == '{') {
+                int depth = 0;
+                do {
+                    if (*p_ == '"') {
+                        std::string_view ignored;
+                        if (!read_string(ignored)) return false;
+                        continue;
+                    }
+                    if (*p_ == '[' || *p_ == '{') ++depth;
+                    else if (*p_ == ']' || *p_ == '}') --depth;
+                    ++p_;
+                } while (depth > 0 && p_ != end_);
+                if (depth != 0) return false;
+            } else {
+                while (p_ != end_ && *p_ != ',' && *p_ != '}' && *p_ != ']' && !is_whitespace(*p_)) {
+                    ++p_;
+                }
+            }
+            raw = std::string_view(begin, static_cast<size_t>(p_ - begin));
+            return true;
+        }
+
+        bool skip_value() noexcept {
+            std::string_view ignored;
+            return skip_value(ignored);
+        }
+
+    private:
+        static bool is_whitespace(char c) noexcept {
+            return c == ' ' || c == '\n' || c == '\r' || c == '\t';
+        }
+
+        void skip_whitespace() noexcept {
+            while (p_ != end_ && is_whitespace(*p_)) {
+                ++p_;
+            }
+        }
+
+        const char *p_;
+        const char *end_;
+    };
+
+    // Parser for the Gemini v2 market data messages we trade on, working directly on the frame bytes.
+    // It reads only the fields we need, decodes decimal strings straight into fixed-point and never
+    // allocates. Anything that is not l2_updates / trade / heartbeat is reported as UNKNOWN so the
+    // caller can fall back to a general purpose JSON parser.
+    //
+    // Handler has to provide:
+    //   void on_l2_change(std::string_view symbol, Side side, util::Price price, util::Qty quantity);
+    //   void on_l2_updates_end(std::string_view symbol);
+    //   void on_trade(std::string_view symbol, const GeminiTrade &trade);
+    class GeminiMarketDataParser {
+    public:
+        enum class MessageType {
+            INVALID,
+            UNKNOWN,
+            L2_UPDATES,
+            TRADE,
+            HEARTBEAT
+        };
+
+        template<typename Handler>
+        static MessageType parse(std::string_view frame, Handler &handler) noexcept {
+            Fields fields;
+            if (!scan_object(frame, fields)) [[unlikely]] {
+                return MessageType::INVALID;
+            }
+            if (fields.type == "l2_updates") [[likely]] {
+                if (!parse_changes(fields.symbol, fields.changes, handler) ||
+                        !parse_trades(fields.symbol, fields.trades, handler)) [[unlikely]] {
+                    return MessageType::INVALID;
+                }
+                handler.on_l2_updates_end(fields.symbol);
+                return MessageType::L2_UPDATES;
+            }
+            if (fields.type == "trade") {
+                GeminiTrade trade;
+                if (!to_trade(fields, trade)) [[unlikely]] {
+                    return MessageType::INVALID;
+                }
+                handler.on_trade(fields.symbol, trade);
+                return MessageType::TRADE;
+            }
+            if (fields.type == "heartbeat") {
+                return MessageType::HEARTBEAT;
+            }
+            return MessageType::UNKNOWN;
+        }
+
+    private:
+        // Views into the frame for every field of the messages above, anything else is skipped.
+        struct Fields {
+            std::string_view type;
+            std::string_view symbol;
+            std::string_view changes;
+            std::string_view trades;
+            std::string_view price;
+            std::string_view quantity;
+            std::string_view side;
+            uint64_t event_id{};
+            uint64_t timestamp{};
+        };
+
+        static bool scan_object(std::string_view text, Fields &fields) noexcept {
+            JsonCursor cursor(text);
+            if (!cursor.consume('{')) {
+                return false;
+            }
+            if (cursor.consume('}')) {
+                return true;
+            }
+            do {
+                std::string_view key;
+                if (!cursor.read_string(key) || !cursor.consume(':')) {
+                    return false;
+                }
+                bool ok;
+                if (key == "type") ok = cursor.read_string(fields.type);
+                else if (key == "symbol") ok = cursor.read_string(fields.symbol);
+                else if (key == "changes") ok = cursor.skip_value(fields.changes);
+                else if (key == "trades") ok = cursor.skip_value(fields.trades);
+                else if (key == "price") ok = cursor.read_string(fields.price);
+                else if (key == "quantity") ok = cursor.read_string(fields.quantity);
+                else if (key == "side") ok = cursor.read_string(fields.side);
+                else if (key == "event_id") ok = cursor.read_unsigned(fields.event_id);
+                else if (key == "timestamp") ok = cursor.read_unsigned(fields.timestamp);
+                else ok = cursor.skip_value();
+                if (!ok) {
+                    return false;
+                }
+            } while (cursor.consume(','));
+            return cursor.consume('}');
+        }
+
+        static Side to_side(std::string_view side) noexcept {
+            if (side == "buy") return Side::BID;
+            if (side == "sell") return Side::ASK;
+            return Side::NONE;
+        }
+
+        // [["buy","9122.04","0.00121425"],["sell","9122.07","0.98942515"]]
+        template<typename Handler>
+        static bool parse_changes(std::string_view symbol, std::string_view changes, Handler &handler) noexcept {
+            if (changes.empty()) {
+                return true;
+            }
+            JsonCursor cursor(changes);
+            if (!cursor.consume('[')) {
+                return false;
+            }
+            if (cursor.consume(']')) {
+                return true;
+            }
+            do {
+                std::string_view side, price, quantity;
+                if (!cursor.consume('[') || !cursor.read_string(side) || !cursor.consume(',') ||
+                        !cursor.read_string(price) || !cursor.consume(',') || !cursor.read_string(quantity) ||
+                        !cursor.consume(']')) {
+                    return false;
+                }
+                util::Price price_value;
+                util::Qty quantity_value;
+                if (!util::Price::parse(price, price_value) || !util::Qty::parse(quantity, quantity_value)) {
+                    return false;
+                }
+                handler.on_l2_change(symbol, to_side(side), price_value, quantity_value);
+            } while (cursor.consume(','));
+            return cursor.consume(']');
+        }
+
+        template<typename Handler>
+        static bool parse_trades(std::string_view symbol, std::string_view trades, Handler &handler) noexcept {
+            if (trades.empty()) {
+                return true;
+            }
+            JsonCursor cursor(trades);
+            if (!cursor.consume('[')) {
+                return false;
+            }
+            if (cursor.consume(']')) {
+                return true;
+            }
+            do {
+                std::string_view object;
+                Fields fields;
+                GeminiTrade trade;
+                if (!cursor.peek('{') || !cursor.skip_value(object) || !scan_object(object, fields) || !to_trade(fields, trade)) {
+                    return false;
+                }
+                handler.on_trade(fields.symbol.empty() ? symbol : fields.symbol, trade);
+            } while (cursor.consume(','));
+            return cursor.consume(']');
+        }
+
+        static bool to_trade(const Fields &fields, GeminiTrade &trade) noexcept {
+            trade.event_id = fields.event_id;
+            trade.timestamp_ms = fields.timestamp;
+            trade.aggressor_side = to_side(fields.side);
+            return util::Price::parse(fields.price, trade.price) && util::Qty::parse(fields.quantity, trade.quantity);
+        }
+    };
+}
@@ -0,0 +1,218 @@
+#pragma once
+
+#include <charconv>
+#include <cstdint>
+#include <string_view>
+
+#include "gemini_md_parser.h"
+#include "types.h"
+#include "../util/decimal.h"
+
+namespace client {
+    // One event of the Gemini order events stream, views point into the frame.
+    struct GeminiOrderEvent {
+        enum class Type : uint8_t {
+            UNKNOWN,
+            INITIAL, // an order that was already open when we subscribed
+            ACCEPTED,
+            REJECTED,
+            BOOKED,
+            FILL,
+            CANCELLED,
+            CANCEL_REJECTED,
+            CLOSED
+        };
+
+        Type type{Type::UNKNOWN};
+        Side side{Side::NONE};
+        // Not every event type carries the remaining amount, an accepted order has only the original one.
+        bool has_remaining_amount{false};
+        uint64_t order_id{};
+        // Zero for orders placed without one or with one that is not a number, neither can be ours.
+        uint64_t client_order_id{};
+        uint64_t socket_sequence{};
+        uint64_t timestamp_ms{};
+        util::Price price{};
+        util::Qty original_amount{};
+        util::Qty executed_amount{};
+        util::Qty remaining_amount{};
+        // The trade of a FILL event.
+        util::Price fill_price{};
+        util::Qty fill_amount{};
+        // Lower case, "btcgusdperp".
+        std::string_view symbol;
+        std::string_view reason;
+    };
+
+    // Parser for the private order events stream (/v1/order/events), on the frame bytes like
+    // GeminiMarketDataParser and just as allocation free. Events come as an array of one or more orders' events,
+    // heartbeats and the subscription ack as single objects, every message numbered by socket_sequence.
+    //
+    // Handler has to provide:
+    //   void on_order_event(const GeminiOrderEvent &event);
+    class GeminiOrderEventsParser {
+    public:
+        enum class MessageType {
+            INVALID,
+            UNKNOWN,
+            ORDER_EVENTS,
+            HEARTBEAT,
+            SUBSCRIPTION_ACK
+        };
+
+        // `socket_sequence` is set to the sequence number of the message, left alone if it has none.
+        template<typename Handler>
+        static MessageType parse(std::string_view frame, Handler &handler, uint64_t &socket_sequence) noexcept {
+            JsonCursor cursor(frame);
+            if (cursor.peek('[')) [[likely]] {
+                return parse_events(cursor, handler, socket_sequence) ? MessageType::ORDER_EVENTS
+                                                                     : MessageType::INVALID;
+            }
+            Fields fields;
+            if (!scan_object(frame, fields)) [[unlikely]] {
+                return MessageType::INVALID;
+            }
+            if (fields.type == "heartbeat") {
+                socket_sequence = fields.socket_sequence;
+                return MessageType::HEARTBEAT;
+            }
+            if (fields.type == "subscription_ack") {
+                socket_sequence = fields.socket_sequence;
+                return MessageType::SUBSCRIPTION_ACK;
+            }
+            return MessageType::UNKNOWN;
+        }
+
+    private:
+        struct Fields {
+            std::string_view type;
+            std::string_view order_id;
+            std::string_view client_order_id;
+            std::string_view symbol;
+            std::string_view side;
+            std::string_view price;
+            std::string_view amount; // of the fill object
+            std::string_view original_amount;
+            std::string_view executed_amount;
+            std::string_view remaining_amount;
+            std::string_view fill;
+            std::string_view reason;
+            uint64_t socket_sequence{};
+            uint64_t timestamp_ms{};
+        };
+
+        static bool scan_object(std::string_view text, Fields &fields) noexcept {
+            JsonCursor cursor(text);
+            if (!cursor.consume('{')) {
+                return false;
+            }
+            if (cursor.consume('}')) {
+                return true;
+            }
+            do {
+                std::string_view key;
+                if (!cursor.read_string(key) || !cursor.consume(':')) {
+                    return false;
+                }
+                bool ok;
+                if (key == "type") ok = cursor.read_string(fields.type);
+                else if (key == "order_id") ok = cursor.read_string(fields.order_id);
+                else if (key == "client_order_id") ok = cursor.read_string(fields.client_order_id);
+                else if (key == "symbol") ok = cursor.read_string(fields.symbol);
+                else if (key == "side") ok = cursor.read_string(fields.side);
+                else if (key == "price") ok = cursor.read_string(fields.price);
+                else if (key == "amount") ok = cursor.read_string(fields.amount);
+                else if (key == "original_amount") ok = cursor.read_string(fields.original_amount);
+                else if (key == "executed_amount") ok = cursor.read_string(fields.executed_amount);
+                else if (key == "remaining_amount") ok = cursor.read_string(fields.remaining_amount);
+                else if (key == "fill") ok = cursor.skip_value(fields.fill);
+                else if (key == "reason") ok = cursor.read_string(fields.reason);
+                else if (key == "socket_sequence") ok = cursor.read_unsigned(fields.socket_sequence);
+                else if (key == "timestampms") ok = cursor.read_unsigned(fields.timestamp_ms);
+                else ok = cursor.skip_value();
+                if (!ok) {
+                    return false;
+                }
+            } while (cursor.consume(','));
+            return cursor.consume('}');
+        }
+
+        template<typename Handler>
+        static bool parse_events(JsonCursor &cursor, Handler &handler, uint64_t &socket_sequence) noexcept {
+            if (!cursor.consume('[')) {
+                return false;
+            }
+            if (cursor.consume(']')) {
+                return true;
+            }
+            do {
+                std::string_view object;
+                Fields fields;
+                GeminiOrderEvent event;
+                if (!cursor.peek('{') || !cursor.skip_value(object) || !scan_object(object, fields) ||
+                        !to_event(fields, event)) {
+                    return false;
+                }
+                socket_sequence = event.socket_sequence;
+                handler.on_order_event(event);
+            } while (cursor.consume(','));
+            return cursor.consume(']');
+        }
+
+        static GeminiOrderEvent::Type to_type(std::string_view type) noexcept {
+            if (type == "fill") return GeminiOrderEvent::Type::FILL;
+            if (type == "accepted") return GeminiOrderEvent::Type::ACCEPTED;
+            if (type == "booked") return GeminiOrderEvent::Type::BOOKED;
+            if (type == "cancelled") return GeminiOrderEvent::Type::CANCELLED;
+            if (type == "closed") return GeminiOrderEvent::Type::CLOSED;
+            if (type == "rejected") return GeminiOrderEvent::Type::REJECTED;
+            if (type == "cancel_rejected") return GeminiOrderEvent::Type::CANCEL_REJECTED;
+            if (type == "initial") return GeminiOrderEvent::Type::INITIAL;
+            return GeminiOrderEvent::Type::UNKNOWN;
+        }
+
+        static Side to_side(std::string_view side) noexcept {
+            if (side == "buy") return Side::BID;
+            if (side == "sell") return Side::ASK;
+            return Side::NONE;
+        }
+
+        // Ids come as quoted numbers, "109535951". Anything else reads as zero.
+        static uint64_t to_id(std::string_view id) noexcept {
+            uint64_t value = 0;
+            const auto result = std::from_chars(id.data(), id.data() + id.size(), value);
+            return result.ec == std::errc() && result.ptr == id.data() + id.size() ? value : 0;
+        }
+
+        // An absent amount stays zero, a malformed one fails the whole message.
+        template<typename Tag>
+        static bool parse_optional(std::string_view text, util::Decimal<Tag> &out) noexcept {
+            return text.empty() || util::Decimal<Tag>::parse(text, out);
+        }
+
+        static bool to_event(const Fields &fields, GeminiOrderEvent &event) noexcept {
+            event.type = to_type(fields.type);
+            event.side = to_side(fields.side);
+            event.has_remaining_amount = !fields.remaining_amount.empty();
+            event.order_id = to_id(fields.order_id);
+            event.client_order_id = to_id(fields.client_order_id);
+            event.socket_sequence = fields.socket_sequence;
+            event.timestamp_ms = fields.timestamp_ms;
+            event.symbol = fields.symbol;
+            event.reason = fields.reason;
+            if (!parse_optional(fields.price, event.price) ||
+                    !parse_optional(fields.original_amount, event.original_amount) ||
+                    !parse_optional(fields.executed_amount, event.executed_amount) ||
+                    !parse_optional(fields.remaining_amount, event.remaining_amount)) {
+                return false;
+            }
+            if (fields.fill.empty()) {
+                return true;
+            }
+            // {"trade_id":"109535955","liquidity":"Maker","price":"3592.00","amount":"1","fee":"0", ...}
+            Fields fill;
+            return scan_object(fields.fill, fill) && util::Price::parse(fill.price, event.fill_price) &&
+                   util::Qty::parse(fill.amount, event.fill_amount);
+        }
+    };
+}
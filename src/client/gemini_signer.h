@@ -0,0 +1,217 @@
+#pragma once
+
+#include <openssl/sha.h>
+#include <array>
+#include <charconv>
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+#include <type_traits>
+
+#include "../util/decimal.h"
+
+namespace client {
+    // Fixed capacity text buffer the request payload is written into, nothing allocates.
+    class PayloadWriter {
+    public:
+        static constexpr size_t Capacity = 512;
+
+        void clear() noexcept {
+            size_ = 0;
+            overflow_ = false;
+        }
+
+        PayloadWriter &append(std::string_view str) noexcept {
+            if (str.size() > Capacity - size_) [[unlikely]] {
+                overflow_ = true;
+                return *this;
+            }
+            std::memcpy(data_ + size_, str.data(), str.size());
+            size_ += str.size();
+            return *this;
+        }
+
+        template<typename Integer> requires std::is_integral_v<Integer>
+        PayloadWriter &append(Integer value) noexcept {
+            return append_chars(std::to_chars(data_ + size_, data_ + Capacity, value));
+        }
+
+        // Shortest exact decimal, never in exponent notation: 60000.5, 0.1.
+        template<typename Tag>
+        PayloadWriter &append(util::Decimal<Tag> value) noexcept {
+            if (util::MaxDecimalChars > Capacity - size_) [[unlikely]] {
+                overflow_ = true;
+                return *this;
+            }
+            size_ = static_cast<size_t>(value.format(data_ + size_) - data_);
+            return *this;
+        }
+
+        std::string_view view() const noexcept {
+            return {data_, size_};
+        }
+
+        // Set when something did not fit, the payload must not be signed then.
+        bool overflow() const noexcept {
+            return overflow_;
+        }
+
+    private:
+        PayloadWriter &append_chars(std::to_chars_result result) noexcept {
+            if (result.ec != std::errc()) [[unlikely]] {
+                overflow_ = true;
+            } else {
+                size_ = static_cast<size_t>(result.ptr - data_);
+            }
+            return *this;
+        }
+
+        char data_[Capacity];
+        size_t size_{0};
+        bool overflow_{false};
+    };
+
+    // Base64 and hex encoders working two output characters at a time from precomputed tables.
+    namespace encoding {
+        constexpr std::string_view Base64Alphabet = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+        // Every 12 bit value mapped to its two base64 characters.
+        inline constexpr auto Base64Pairs = [] {
+            std::array<std::array<char, 2>, 4096> table{};
+            for (size_t i = 0; i < table.size(); ++i) {
+                table[i] = {Base64Alphabet[i >> 6], Base64Alphabet[i & 0x3F]};
+            }
+            return table;
+        }();
+
+        inline constexpr auto HexPairs = [] {
+            constexpr std::string_view digits = "0123456789abcdef";
+            std::array<std::array<char, 2>, 256> table{};
+            for (size_t i = 0; i < table.size(); ++i) {
+                table[i] = {digits[i >> 4], digits[i & 0xF]};
+            }
+            return table;
+        }();
+
+        constexpr size_t base64_size(size_t size) noexcept {
+            return (size + 2) / 3 * 4;
+        }
+
+        // `out` must have room for base64_size(size) characters, returns the end of the output.
+        inline char *base64_encode(const unsigned char *in, size_t size, char *out) noexcept {
+            size_t i = 0;
+            for (; i + 3 <= size; i += 3) {
+                const uint32_t value = (uint32_t{in[i]} << 16) | (uint32_t{in[i + 1]} << 8) | in[i + 2];
+                std::memcpy(out, Base64Pairs[value >> 12].data(), 2);
+                std::memcpy(out + 2, Base64Pairs[value & 0xFFF].data(), 2);
+                out += 4;
+            }
+            if (i < size) {
+                const uint32_t value = (uint32_t{in[i]} << 16) | (i + 1 < size ? uint32_t{in[i + 1]} << 8 : 0);
+                std::memcpy(out, Base64Pairs[value >> 12].data(), 2);
+                out[2] = i + 1 < size ? Base64Alphabet[(value >> 6) & 0x3F] : '=';
+                out[3] = '=';
+                out += 4;
+            }
+            return out;
+        }
+
+        inline char *hex_encode(const unsigned char *in, size_t size, char *out) noexcept {
+            for (size_t i = 0; i < size; ++i) {
+                std::memcpy(out + 2 * i, HexPairs[in[i]].data(), 2);
+            }
+            return out + 2 * size;
+        }
+    }
+
+    // Signs Gemini REST payloads: X-GEMINI-PAYLOAD is the base64 of the payload, X-GEMINI-SIGNATURE the
+    // hex HMAC-SHA384 of that base64 keyed with the API secret.
+    //
+    // The secret never changes, so the SHA-384 states after absorbing key^ipad and key^opad are computed
+    // once. Signing copies those two plain structs and hashes the message, nothing is re-keyed and nothing
+    // allocates (OpenSSL 3 EVP_MAC / HMAC_CTX copies would both allocate). Returned views point into the
+    // signer and stay valid until the next sign().
+    class GeminiSigner {
+    public:
+        static constexpr size_t DigestSize = SHA384_DIGEST_LENGTH;
+        static constexpr size_t BlockSize = 128;
+
+        struct Signature {
+            std::string_view payload; // base64 payload
+            std::string_view signature; // hex HMAC
+        };
+
+        explicit GeminiSigner(std::string_view api_secret) noexcept {
+            unsigned char key[BlockSize]{};
+            if (api_secret.size() > BlockSize) {
+                sha384(reinterpret_cast<const unsigned char *>(api_secret.data()), api_secret.size(), key);
+            } else {
+                std::memcpy(key, api_secret.data(), api_secret.size());
+            }
+            unsigned char pad[BlockSize];
+            for (size_t i = 0; i < BlockSize; ++i) {
+                pad[i] = key[i] ^ 0x36;
+            }
+            init(inner_, pad);
+            for (size_t i = 0; i < BlockSize; ++i) {
+                pad[i] = key[i] ^ 0x5c;
+            }
+            init(outer_, pad);
+        }
+
+        Signature sign(std::string_view payload) noexcept {
+            if (payload.size() > PayloadWriter::Capacity) [[unlikely]] {
+                return Signature{};
+            }
+            const auto encoded_end = encoding::base64_encode(reinterpret_cast<const unsigned char *>(payload.data()),
+                                                             payload.size(), encoded_.data());
+            const auto encoded_size = static_cast<size_t>(encoded_end - encoded_.data());
+
+            unsigned char digest[DigestSize];
+            hmac(reinterpret_cast<const unsigned char *>(encoded_.data()), encoded_size, digest);
+            encoding::hex_encode(digest, DigestSize, signature_.data());
+            return Signature{
+                .payload = std::string_view(encoded_.data(), encoded_size),
+                .signature = std::string_view(signature_.data(), signature_.size())
+            };
+        }
+
+        // HMAC-SHA384 of `data` with the secret given at construction.
+        void hmac(const unsigned char *data, size_t size, unsigned char *digest) const noexcept {
+            SHA512_CTX ctx = inner_;
+            unsigned char inner_digest[DigestSize];
+            update(ctx, data, size);
+            final(ctx, inner_digest);
+            ctx = outer_;
+            update(ctx, inner_digest, DigestSize);
+            final(ctx, digest);
+        }
+
+    private:
+// The low level SHA API is deprecated in OpenSSL 3 but is the only one with a copyable, heap free state.
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wdeprecated-declarations"
+        static void init(SHA512_CTX &ctx, const unsigned char *pad) noexcept {
+            SHA384_Init(&ctx);
+            SHA384_Update(&ctx, pad, BlockSize);
+        }
+
+        static void update(SHA512_CTX &ctx, const unsigned char *data, size_t size) noexcept {
+            SHA384_Update(&ctx, data, size);
+        }
+
+        static void final(SHA512_CTX &ctx, unsigned char *digest) noexcept {
+            SHA384_Final(digest, &ctx);
+        }
+
+        static void sha384(const unsigned char *data, size_t size, unsigned char *digest) noexcept {
+            SHA384(data, size, digest);
+        }
+#pragma GCC diagnostic pop
+
+        SHA512_CTX inner_;
+        SHA512_CTX outer_;
+        std::array<char, encoding::base64_size(PayloadWriter::Capacity)> encoded_;
+        std::array<char, 2 * DigestSize> signature_;
+    };
+} // namespace client
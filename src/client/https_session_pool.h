@@ -0,0 +1,368 @@
+#pragma once
+
+#include <boost/asio/connect.hpp>
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/asio/ssl.hpp>
+#include <boost/beast/core.hpp>
+#include <boost/beast/http.hpp>
+#include <boost/beast/ssl.hpp>
+#include <boost/beast/version.hpp>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "socket_options.h"
+#include "../util/latency_probe.h"
+#include "../util/logger.h"
+
+namespace client {
+    namespace beast = boost::beast;
+    namespace http = beast::http;
+    namespace net = boost::asio;
+    using tcp = net::ip::tcp;
+
+    struct HttpsSessionPoolConfig {
+        // Sessions kept open. One carries the traffic, the others are warm spares for when it drops.
+        size_t pool_size{2};
+        std::chrono::milliseconds connect_timeout{5000};
+        std::chrono::milliseconds request_timeout{5000};
+        // A session idle for this long sends heartbeat_target so neither side times it out.
+        std::chrono::milliseconds heartbeat_interval{15000};
+        std::string heartbeat_target{"/v1/symbols"};
+        // Reconnect attempts of a session back off exponentially between these two.
+        std::chrono::milliseconds reconnect_backoff{100};
+        std::chrono::milliseconds max_reconnect_backoff{5000};
+        // PEM certificate to trust instead of the system store, for test servers.
+        std::string ca_certificate_pem{};
+        SocketOptionsConfig socket{};
+    };
+
+    // Keeps a few TLS keep-alive sessions to one host open so a request never pays for DNS, TCP and TLS
+    // handshakes. The host is resolved once in start(). A maintenance thread reconnects dropped sessions
+    // and sends heartbeats on idle ones, callers only ever see ready sessions unless every one of them is
+    // down, in which case one is reconnected inline.
+    //
+    // Each session has its own io_context driven by whichever thread holds the session, the session state
+    // is what hands it over between the caller and the maintenance thread.
+    class HttpsSessionPool {
+    public:
+        using Request = http::request<http::string_body>;
+        using Response = http::response<http::string_body>;
+
+        enum class SessionState : uint8_t {
+            DISCONNECTED,
+            CONNECTING,
+            READY,
+            BUSY
+        };
+
+        HttpsSessionPool(std::string host, std::string port,
+                         const HttpsSessionPoolConfig &config = HttpsSessionPoolConfig{})
+            : host_(std::move(host)), port_(std::move(port)), config_(config),
+              ssl_ctx_(net::ssl::context::tlsv12_client) {
+            if (config_.ca_certificate_pem.empty()) {
+                ssl_ctx_.set_default_verify_paths();
+            } else {
+                ssl_ctx_.add_certificate_authority(net::buffer(config_.ca_certificate_pem));
+            }
+            ssl_ctx_.set_verify_mode(net::ssl::verify_peer);
+            sessions_.reserve(std::max<size_t>(config_.pool_size, 1));
+            for (size_t i = 0; i < std::max<size_t>(config_.pool_size, 1); ++i) {
+                sessions_.push_back(std::make_unique<Session>());
+            }
+        }
+
+        HttpsSessionPool(const HttpsSessionPool &) = delete;
+
+        HttpsSessionPool(const HttpsSessionPool &&) = delete;
+
+        HttpsSessionPool &operator=(const HttpsSessionPool &) = delete;
+
+        HttpsSessionPool &operator=(const HttpsSessionPool &&) = delete;
+
+        ~HttpsSessionPool() {
+            stop();
+        }
+
+        // Throws if the host does not resolve, a session that fails to connect is retried in the background.
+        void start() {
+            net::io_context ioc;
+            tcp::resolver resolver(ioc);
+            beast::error_code ec;
+            endpoints_ = resolver.resolve(host_, port_, ec);
+            if (ec) {
+                throw std::runtime_error("HttpsSessionPool: cannot resolve " + host_ + ": " + ec.message());
+            }
+            for (auto &session: sessions_) {
+                auto expected = SessionState::DISCONNECTED;
+                if (session->state.compare_exchange_strong(expected, SessionState::CONNECTING)) {
+                    release(*session, connect(*session));
+                }
+            }
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                stopping_ = false;
+            }
+            maintenance_thread_ = std::thread(&HttpsSessionPool::maintain, this);
+        }
+
+        // Callers must be done with execute() by now.
+        void stop() {
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                stopping_ = true;
+            }
+            cv_.notify_all();
+            if (maintenance_thread_.joinable()) {
+                maintenance_thread_.join();
+            }
+            for (auto &session: sessions_) {
+                disconnect(*session);
+                session->state.store(SessionState::DISCONNECTED, std::memory_order::release);
+            }
+        }
+
+        // Writes all requests back to back on one session and then reads the responses in order (HTTP/1.1
+        // pipelining). Returns how many responses were read, requests past that got no answer and may or
+        // may not have reached the server.
+        size_t execute(std::span<Request> requests, std::span<Response> responses) {
+            auto *session = acquire();
+            if (!session) [[unlikely]] {
+                LOG_ERROR("HttpsSessionPool: no session to {} available", host_);
+                return 0;
+            }
+            beast::error_code ec;
+            size_t written = 0;
+            for (; written < requests.size(); ++written) {
+                requests[written].keep_alive(true);
+                ec = run(*session, config_.request_timeout, [&](auto handler) {
+                    http::async_write(*session->stream, requests[written], std::move(handler));
+                });
+                if (ec) [[unlikely]] {
+                    break;
+                }
+                CMM_PROBE(WIRE_WRITE);
+            }
+            size_t read = 0;
+            bool keep_alive = true;
+            for (; read < written; ++read) {
+                responses[read] = Response{};
+                ec = run(*session, config_.request_timeout, [&](auto handler) {
+                    http::async_read(*session->stream, session->buffer, responses[read], std::move(handler));
+                });
+                if (ec) [[unlikely]] {
+                    break;
+                }
+                keep_alive = keep_alive && responses[read].keep_alive();
+            }
+            if (ec) [[unlikely]] {
+                LOG_WARN("HttpsSessionPool: session to {} failed: {}", host_, ec.message());
+            }
+            session->touch();
+            release(*session, !ec && keep_alive);
+            return read;
+        }
+
+        bool execute(Request &request, Response &response) {
+            return execute(std::span<Request>(&request, 1), std::span<Response>(&response, 1)) == 1;
+        }
+
+        size_t ready_sessions() const noexcept {
+            size_t ready = 0;
+            for (const auto &session: sessions_) {
+                const auto state = session->state.load(std::memory_order::relaxed);
+                ready += state == SessionState::READY || state == SessionState::BUSY;
+            }
+            return ready;
+        }
+
+        const std::string &host() const noexcept {
+            return host_;
+        }
+
+    private:
+        static constexpr auto MaintenanceInterval = std::chrono::milliseconds(10);
+
+        struct Session {
+            net::io_context ioc;
+            // Recreated on every connect, an SSL stream cannot be reused once it failed.
+            std::optional<beast::ssl_stream<beast::tcp_stream> > stream;
+            beast::flat_buffer buffer;
+            std::atomic<SessionState> state{SessionState::DISCONNECTED};
+            // Read by the maintenance thread without holding the session.
+            std::atomic<std::chrono::steady_clock::rep> last_used{0};
+            // Below are only touched by the thread holding the session.
+            std::chrono::steady_clock::time_point next_attempt{};
+            std::chrono::milliseconds backoff{0};
+
+            void touch() noexcept {
+                last_used.store(std::chrono::steady_clock::now().time_since_epoch().count(),
+                                std::memory_order::relaxed);
+            }
+
+            std::chrono::steady_clock::time_point idle_since() const noexcept {
+                return std::chrono::steady_clock::time_point(
+                    std::chrono::steady_clock::duration(last_used.load(std::memory_order::relaxed)));
+            }
+        };
+
+        // Runs one async operation on the session's io_context with a deadline. The handler passed to
+        // `initiate` records the result.
+        template<typename Initiate>
+        static beast::error_code run(Session &session, std::chrono::milliseconds timeout, Initiate &&initiate) {
+            beast::error_code result = net::error::timed_out;
+            beast::get_lowest_layer(*session.stream).expires_after(timeout);
+            initiate([&result](beast::error_code ec, auto &&...) { result = ec; });
+            session.ioc.restart();
+            session.ioc.run();
+            return result;
+        }
+
+        bool connect(Session &session) {
+            disconnect(session);
+            session.stream.emplace(session.ioc, ssl_ctx_);
+            session.buffer.clear();
+            if (!SSL_set_tlsext_host_name(session.stream->native_handle(), host_.c_str())) {
+                LOG_ERROR("HttpsSessionPool: cannot set SNI host name {}", host_);
+                return false;
+            }
+            session.stream->set_verify_callback(net::ssl::host_name_verification(host_));
+
+            auto ec = run(session, config_.connect_timeout, [&](auto handler) {
+                beast::get_lowest_layer(*session.stream).async_connect(endpoints_, std::move(handler));
+            });
+            if (!ec) {
+                apply_socket_options(beast::get_lowest_layer(*session.stream).socket().native_handle(), config_.socket,
+                                     host_);
+                ec = run(session, config_.connect_timeout, [&](auto handler) {
+                    session.stream->async_handshake(net::ssl::stream_base::client, std::move(handler));
+                });
+            }
+            if (ec) {
+                LOG_WARN("HttpsSessionPool: cannot connect to {}:{}: {}", host_, port_, ec.message());
+                disconnect(session);
+                return false;
+            }
+            session.touch();
+            LOG_INFO("HttpsSessionPool: connected to {}:{}", host_, port_);
+            return true;
+        }
+
+        // No TLS close_notify, the server does not need it and it would cost a round trip.
+        static void disconnect(Session &session) {
+            if (session.stream) {
+                beast::error_code ignored;
+                beast::get_lowest_layer(*session.stream).socket().close(ignored);
+                session.stream.reset();
+            }
+        }
+
+        // Hands the session back as ready, or closes it and leaves it to the maintenance thread.
+        void release(Session &session, bool healthy) {
+            if (healthy) {
+                session.backoff = std::chrono::milliseconds(0);
+                session.state.store(SessionState::READY, std::memory_order::release);
+                return;
+            }
+            disconnect(session);
+            session.backoff = std::clamp(session.backoff * 2, config_.reconnect_backoff, config_.max_reconnect_backoff);
+            session.next_attempt = std::chrono::steady_clock::now() + session.backoff;
+            session.state.store(SessionState::DISCONNECTED, std::memory_order::release);
+        }
+
+        static bool claim(Session &session, SessionState from, SessionState to) noexcept {
+            return session.state.compare_exchange_strong(from, to, std::memory_order::acquire,
+                                                         std::memory_order::relaxed);
+        }
+
+        // Prefers the first ready session so the traffic keeps one connection hot.
+        Session *acquire() {
+            const auto deadline = std::chrono::steady_clock::now() + config_.request_timeout;
+            for (;;) {
+                for (auto &session: sessions_) {
+                    if (claim(*session, SessionState::READY, SessionState::BUSY)) [[likely]] {
+                        return session.get();
+                    }
+                }
+                // Nothing ready, connect one here rather than wait for the maintenance thread.
+                for (auto &session: sessions_) {
+                    if (claim(*session, SessionState::DISCONNECTED, SessionState::CONNECTING)) {
+                        if (connect(*session)) {
+                            session->state.store(SessionState::BUSY, std::memory_order::relaxed);
+                            return session.get();
+                        }
+                        release(*session, false);
+                    }
+                }
+                if (std::chrono::steady_clock::now() >= deadline) {
+                    return nullptr;
+                }
+                std::this_thread::yield();
+            }
+        }
+
+        void heartbeat(Session &session) {
+            Request request{http::verb::get, config_.heartbeat_target, 11};
+            request.set(http::field::host, host_);
+            request.set(http::field::user_agent, BOOST_BEAST_VERSION_STRING);
+            request.keep_alive(true);
+            Response response;
+            auto ec = run(session, config_.request_timeout, [&](auto handler) {
+                http::async_write(*session.stream, request, std::move(handler));
+            });
+            if (!ec) {
+                ec = run(session, config_.request_timeout, [&](auto handler) {
+                    http::async_read(*session.stream, session.buffer, response, std::move(handler));
+                });
+            }
+            if (ec) {
+                LOG_WARN("HttpsSessionPool: heartbeat to {} failed: {}", host_, ec.message());
+            }
+            session.touch();
+            release(session, !ec && response.keep_alive());
+        }
+
+        void maintain() {
+            std::unique_lock<std::mutex> lock(mutex_);
+            while (!cv_.wait_for(lock, MaintenanceInterval, [this] { return stopping_; })) {
+                lock.unlock();
+                const auto now = std::chrono::steady_clock::now();
+                for (auto &session: sessions_) {
+                    if (session->state.load(std::memory_order::relaxed) == SessionState::DISCONNECTED &&
+                        claim(*session, SessionState::DISCONNECTED, SessionState::CONNECTING)) {
+                        if (now >= session->next_attempt) {
+                            release(*session, connect(*session));
+                        } else {
+                            session->state.store(SessionState::DISCONNECTED, std::memory_order::release);
+                        }
+                    } else if (now - session->idle_since() >= config_.heartbeat_interval &&
+                               claim(*session, SessionState::READY, SessionState::BUSY)) {
+                        heartbeat(*session);
+                    }
+                }
+                lock.lock();
+            }
+        }
+
+        const std::string host_;
+        const std::string port_;
+        const HttpsSessionPoolConfig config_;
+        net::ssl::context ssl_ctx_;
+        tcp::resolver::results_type endpoints_;
+        std::vector<std::unique_ptr<Session> > sessions_;
+
+        std::mutex mutex_;
+        std::condition_variable cv_;
+        bool stopping_{false};
+        std::thread maintenance_thread_;
+    };
+} // namespace client
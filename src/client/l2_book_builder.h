@@ -0,0 +1,208 @@
+#pragma once
+
+#include <array>
+#include <optional>
+#include <string_view>
+#include <vector>
+
+#include "gemini_md_parser.h"
+#include "types.h"
+#include "ws_trades_client.h"
+#include "../book/order_book.h"
+#include "../store/tick_store.h"
+#include "../util/latency_probe.h"
+#include "../util/logger.h"
+#include "../util/latest_value.h"
+#include "../util/metrics.h"
+#include "../util/symbol_table.h"
+#include "../util/wait_strategy.h"
+
+namespace client {
+    struct WsBestBidBestAskMsg {
+        util::SymbolId symbol_id{};
+        util::Price best_bid{};
+        util::Qty best_bid_quantity{};
+        util::Price best_ask{};
+        util::Qty best_ask_quantity{};
+        // Latency probe stamp of the update, 0 if it is not followed.
+        uint64_t tsc{};
+        // Wall clock receive time of the frame with the update: the kernel's when the socket timestamps, the
+        // capture time in replays, 0 if unknown.
+        int64_t receive_time_ns{};
+        // Quantities of the levels behind the best ones, nearest first, zero past the end of the book.
+        std::array<util::Qty, BookDepthLevels - 1> bid_depth{};
+        std::array<util::Qty, BookDepthLevels - 1> ask_depth{};
+    };
+
+    // Top of book of `book` with the depth behind it.
+    inline WsBestBidBestAskMsg make_best_bid_best_ask_msg(util::SymbolId symbol_id, const book::OrderBook &book) noexcept {
+        WsBestBidBestAskMsg msg{.symbol_id = symbol_id};
+        if (book.hasBid()) {
+            msg.best_bid = book.toPrice(book.bestBid().price_ticks);
+            msg.best_bid_quantity = book.bestBid().quantity;
+            for (size_t i = 1; i < book.bidDepth() && i < BookDepthLevels; ++i) {
+                msg.bid_depth[i - 1] = book.bidLevel(i).quantity;
+            }
+        }
+        if (book.hasAsk()) {
+            msg.best_ask = book.toPrice(book.bestAsk().price_ticks);
+            msg.best_ask_quantity = book.bestAsk().quantity;
+            for (size_t i = 1; i < book.askDepth() && i < BookDepthLevels; ++i) {
+                msg.ask_depth[i - 1] = book.askLevel(i).quantity;
+            }
+        }
+        return msg;
+    }
+
+    // Applies Gemini l2 frames to one book per symbol and publishes the top of book of every symbol
+    // a frame touched. Books live in a vector indexed by SymbolId, the symbol name of a frame is resolved
+    // once per frame and everything downstream only sees the id. Top of book goes out through a latest value
+    // slot per symbol, so a consumer that fell behind catches up on the latest book instead of working through
+    // stale ones.
+    class L2BookBuilder {
+        friend class GeminiMarketDataParser;
+
+    public:
+        // `ob_updates` needs a slot per symbol. consumer_wait_strategy, if given, is notified after every update
+        // so a parked consumer wakes up.
+        L2BookBuilder(const util::SymbolTable &symbols, util::LatestValueSlots<WsBestBidBestAskMsg> &ob_updates,
+                      util::WaitStrategy *consumer_wait_strategy = nullptr,
+                      const book::OrderBookConfig &book_config = book::OrderBookConfig{})
+            : m_symbols(symbols)
+              , m_ob_updates(ob_updates)
+              , m_consumer_wait_strategy(consumer_wait_strategy)
+              , m_published(util::MetricsRegistry::instance().counter("md.bbo_published"))
+              , m_conflated(util::MetricsRegistry::instance().counter("md.bbo_conflated")) {
+            // Constructed in place so each book reserves its levels up front. The tick size of each book is the
+            // one of its symbol, book_config.tick_size is not used.
+            m_books.reserve(symbols.size());
+            for (size_t i = 0; i < symbols.size(); ++i) {
+                auto config = book_config;
+                config.tick_size = symbols.spec(static_cast<util::SymbolId>(i)).tick_size;
+                m_books.emplace_back(config);
+            }
+        }
+
+        // timestamp_ns is the receive time of the frame, it goes into the tick store and the top of book.
+        GeminiMarketDataParser::MessageType on_message(std::string_view message, int64_t timestamp_ns = 0) noexcept {
+            m_timestamp_ns = timestamp_ns;
+            return GeminiMarketDataParser::parse(message, *this);
+        }
+
+        // Queues every trade of the stream into `trades` for the trading engine, see TradePublisher. Trades are
+        // dropped without it.
+        void set_trade_queue(util::SpscQueue<WsTradesMsg> &trades, const TradePublisherConfig &config = {}) {
+            m_trades.emplace(m_symbols.size(), trades, m_consumer_wait_strategy, config);
+        }
+
+        // Records every l2 change, top of book and trade into `tick_store`, which has to outlive the builder.
+        void set_tick_store(store::TickStoreWriter *tick_store) noexcept {
+            m_tick_store = tick_store;
+        }
+
+        // Forgets every book, for when updates were missed, and publishes an empty top of book for every symbol
+        // so nothing downstream keeps quoting on it. The next snapshot of a symbol rebuilds its book.
+        void reset() noexcept {
+            for (size_t i = 0; i < m_books.size(); ++i) {
+                m_books[i].clear();
+                m_ob_updates.store(i, WsBestBidBestAskMsg{.symbol_id = static_cast<util::SymbolId>(i)});
+            }
+            if (m_consumer_wait_strategy) {
+                m_consumer_wait_strategy->notify();
+            }
+        }
+
+        const book::OrderBook &book(util::SymbolId symbol_id) const noexcept {
+            return m_books[symbol_id];
+        }
+
+        void print_order_book(util::SymbolId symbol_id) const {
+            const auto &book = m_books[symbol_id];
+            LOG_DEBUG("Printing {} bid levels:", m_symbols.name(symbol_id));
+            for (size_t i = 0; i < book.bidDepth(); ++i) {
+                LOG_DEBUG("Price: {}, Quantity: {}", book.toPrice(book.bidLevel(i).price_ticks),
+                          book.bidLevel(i).quantity);
+            }
+            LOG_DEBUG("Printing {} ask levels:", m_symbols.name(symbol_id));
+            for (size_t i = 0; i < book.askDepth(); ++i) {
+                LOG_DEBUG("Price: {}, Quantity: {}", book.toPrice(book.askLevel(i).price_ticks),
+                          book.askLevel(i).quantity);
+            }
+        }
+
+    private:
+        // All changes of a frame carry the same symbol, remember the last one instead of hashing each time.
+        util::SymbolId resolve(std::string_view symbol) noexcept {
+            if (m_last_symbol_id == util::InvalidSymbolId || m_symbols.name(m_last_symbol_id) != symbol) [[unlikely]] {
+                m_last_symbol_id = m_symbols.find(symbol);
+            }
+            return m_last_symbol_id;
+        }
+
+        // GeminiMarketDataParser callbacks.
+
+        void on_l2_change(std::string_view symbol, Side side, util::Price price, util::Qty quantity) noexcept {
+            const auto symbol_id = resolve(symbol);
+            if (symbol_id != util::InvalidSymbolId) [[likely]] {
+                m_books[symbol_id].update(side, price, quantity);
+                if (m_tick_store) {
+                    m_tick_store->appendL2Delta(symbol_id, m_timestamp_ns, side, price, quantity);
+                }
+            }
+        }
+
+        void on_l2_updates_end(std::string_view symbol) noexcept {
+            const auto symbol_id = resolve(symbol);
+            if (symbol_id == util::InvalidSymbolId) [[unlikely]] {
+                return;
+            }
+            CMM_PROBE(PARSED);
+            auto msg = make_best_bid_best_ask_msg(symbol_id, m_books[symbol_id]);
+            LOG_DEBUG("push {} with best bid: {}, best bid quantity: {}, best ask: {}, best ask quantity: {}",
+                      m_symbols.name(symbol_id), msg.best_bid, msg.best_bid_quantity, msg.best_ask,
+                      msg.best_ask_quantity);
+            CMM_PROBE(QUEUE_PUSH);
+            msg.tsc = CMM_PROBE_STAMP();
+            msg.receive_time_ns = m_timestamp_ns;
+            m_published.add();
+            if (m_ob_updates.store(symbol_id, msg)) {
+                m_conflated.add();
+            }
+            if (m_consumer_wait_strategy) {
+                m_consumer_wait_strategy->notify();
+            }
+            if (m_tick_store) {
+                m_tick_store->appendBbo(symbol_id, m_timestamp_ns, msg.best_bid, msg.best_bid_quantity, msg.best_ask,
+                                        msg.best_ask_quantity);
+            }
+        }
+
+        void on_trade(std::string_view symbol, const GeminiTrade &trade) noexcept {
+            if (!m_trades && !m_tick_store) {
+                return;
+            }
+            const auto symbol_id = resolve(symbol);
+            if (symbol_id == util::InvalidSymbolId) [[unlikely]] {
+                return;
+            }
+            if (m_trades) {
+                m_trades->publish(symbol_id, trade, m_timestamp_ns);
+            }
+            if (m_tick_store) {
+                m_tick_store->appendTrade(symbol_id, m_timestamp_ns, trade.aggressor_side, trade.price,
+                                          trade.quantity);
+            }
+        }
+
+        const util::SymbolTable &m_symbols;
+        util::LatestValueSlots<WsBestBidBestAskMsg> &m_ob_updates;
+        util::WaitStrategy *m_consumer_wait_strategy;
+        std::vector<book::OrderBook> m_books;
+        util::SymbolId m_last_symbol_id{util::InvalidSymbolId};
+        std::optional<TradePublisher> m_trades;
+        store::TickStoreWriter *m_tick_store{nullptr};
+        int64_t m_timestamp_ns{0};
+        util::Counter m_published;
+        util::Counter m_conflated;
+    };
+}
@@ -0,0 +1,134 @@
+#pragma once
+
+#include <boost/asio.hpp>
+#include <boost/beast/core.hpp>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <cerrno>
+#include <cstdint>
+
+#include "socket_options.h"
+
+namespace client {
+    namespace beast = boost::beast;
+    namespace net = boost::asio;
+
+    // A beast::tcp_stream whose reads go through recvmsg() to pick up the kernel receive timestamp of the data,
+    // for sockets with SocketOptionsConfig::rx_timestamps. Meant to sit under an SSL stream, writes, connects
+    // and get_lowest_layer() work on the tcp_stream as before. Reads ignore the tcp_stream timeouts, the
+    // layers above have their own.
+    class RxTimestampStream {
+    public:
+        using next_layer_type = beast::tcp_stream;
+        using lowest_layer_type = next_layer_type::socket_type;
+        using executor_type = next_layer_type::executor_type;
+
+        explicit RxTimestampStream(net::io_context &ioc) : next_layer_(ioc) {
+        }
+
+        executor_type get_executor() noexcept {
+            return next_layer_.get_executor();
+        }
+
+        next_layer_type &next_layer() noexcept {
+            return next_layer_;
+        }
+
+        lowest_layer_type &lowest_layer() noexcept {
+            return next_layer_.socket();
+        }
+
+        // Wall clock time the kernel received the data of the latest read (its last segment when a read spans
+        // several), 0 until a read carries a timestamp.
+        int64_t last_receive_time() const noexcept {
+            return last_receive_time_;
+        }
+
+        template<typename MutableBufferSequence, typename ReadHandler>
+        auto async_read_some(const MutableBufferSequence &buffers, ReadHandler &&handler) {
+            return net::async_initiate<ReadHandler, void(beast::error_code, std::size_t)>(
+                [this](auto &&handler, const MutableBufferSequence &buffers) {
+                    ReadOp<MutableBufferSequence, std::decay_t<decltype(handler)> >(std::move(handler), *this, buffers);
+                }, handler, buffers);
+        }
+
+        template<typename ConstBufferSequence, typename WriteHandler>
+        auto async_write_some(const ConstBufferSequence &buffers, WriteHandler &&handler) {
+            return next_layer_.async_write_some(buffers, std::forward<WriteHandler>(handler));
+        }
+
+    private:
+        static constexpr size_t MaxBuffers = 16;
+
+        // Tries a non blocking read first, the data is often there already, and waits for the socket otherwise.
+        template<typename Buffers, typename Handler>
+        class ReadOp : public beast::async_base<Handler, executor_type> {
+        public:
+            ReadOp(Handler &&handler, RxTimestampStream &stream, const Buffers &buffers)
+                : beast::async_base<Handler, executor_type>(std::move(handler), stream.get_executor())
+                  , stream_(stream)
+                  , buffers_(buffers) {
+                (*this)({}, false);
+            }
+
+            void operator()(beast::error_code ec, bool is_continuation = true) {
+                size_t received = 0;
+                if (!ec) {
+                    received = stream_.receive(buffers_, ec);
+                    if (ec == net::error::would_block) {
+                        stream_.next_layer_.socket().async_wait(net::socket_base::wait_read, std::move(*this));
+                        return;
+                    }
+                }
+                this->complete(is_continuation, ec, received);
+            }
+
+        private:
+            RxTimestampStream &stream_;
+            Buffers buffers_;
+        };
+
+        template<typename Buffers>
+        size_t receive(const Buffers &buffers, beast::error_code &ec) noexcept {
+            iovec iov[MaxBuffers];
+            size_t iov_count = 0;
+            size_t capacity = 0;
+            for (auto it = net::buffer_sequence_begin(buffers); it != net::buffer_sequence_end(buffers) &&
+                                                                 iov_count < MaxBuffers; ++it) {
+                const net::mutable_buffer buffer(*it);
+                iov[iov_count++] = iovec{buffer.data(), buffer.size()};
+                capacity += buffer.size();
+            }
+            if (capacity == 0) {
+                return 0;
+            }
+            alignas(cmsghdr) char control[CMSG_SPACE(3 * sizeof(timespec))];
+            msghdr msg{};
+            msg.msg_iov = iov;
+            msg.msg_iovlen = iov_count;
+            msg.msg_control = control;
+            msg.msg_controllen = sizeof(control);
+            ssize_t received;
+            do {
+                received = ::recvmsg(next_layer_.socket().native_handle(), &msg, MSG_DONTWAIT);
+            } while (received < 0 && errno == EINTR);
+            if (received > 0) {
+                if (const auto timestamp = rx_timestamp_nanos(msg)) {
+                    last_receive_time_ = timestamp;
+                }
+                return static_cast<size_t>(received);
+            }
+            if (received == 0) {
+                ec = net::error::eof;
+            } else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                ec = net::error::would_block;
+            } else {
+                ec.assign(errno, net::error::get_system_category());
+            }
+            return 0;
+        }
+
+        next_layer_type next_layer_;
+        int64_t last_receive_time_{0};
+    };
+}
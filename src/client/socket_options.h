@@ -0,0 +1,86 @@
+#pragma once
+
+#include <linux/net_tstamp.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <ctime>
+#include <string_view>
+
+#include "../util/logger.h"
+
+namespace client {
+    // Options applied to every exchange connection right after it connects.
+    struct SocketOptionsConfig {
+        bool no_delay{true};
+        // SO_BUSY_POLL: microseconds a read on an empty socket spins on the device queue before sleeping, 0 leaves
+        // it to the net.core.busy_read sysctl. Raising it needs CAP_NET_ADMIN.
+        uint32_t busy_poll_us{0};
+        // SO_PREFER_BUSY_POLL (Linux 5.11): keep interrupts off while the busy poll keeps up. Needs CAP_NET_ADMIN.
+        bool prefer_busy_poll{false};
+        // SO_RCVBUF / SO_SNDBUF in bytes, 0 keeps the kernel's autotuning which a fixed size turns off.
+        int receive_buffer_size{0};
+        int send_buffer_size{0};
+        // SO_TIMESTAMPING with software receive timestamps, read back through RxTimestampStream.
+        bool rx_timestamps{false};
+    };
+
+    namespace detail {
+        inline bool set_socket_option(int fd, int level, int name, int value, std::string_view option,
+                                      std::string_view peer) noexcept {
+            if (::setsockopt(fd, level, name, &value, sizeof(value)) == 0) {
+                return true;
+            }
+            LOG_WARN("Cannot set {} on the socket to {}: {}", option, peer, std::strerror(errno));
+            return false;
+        }
+    }
+
+    // Applies `config` to the connected socket `fd`. An option the kernel or our privileges refuse is logged and
+    // skipped, the connection works without it. Returns whether everything was applied.
+    inline bool apply_socket_options(int fd, const SocketOptionsConfig &config, std::string_view peer) noexcept {
+        bool applied = true;
+        if (config.no_delay) {
+            applied &= detail::set_socket_option(fd, IPPROTO_TCP, TCP_NODELAY, 1, "TCP_NODELAY", peer);
+        }
+        if (config.busy_poll_us > 0) {
+            applied &= detail::set_socket_option(fd, SOL_SOCKET, SO_BUSY_POLL, static_cast<int>(config.busy_poll_us),
+                                                 "SO_BUSY_POLL", peer);
+        }
+        if (config.prefer_busy_poll) {
+            applied &= detail::set_socket_option(fd, SOL_SOCKET, SO_PREFER_BUSY_POLL, 1, "SO_PREFER_BUSY_POLL", peer);
+        }
+        if (config.receive_buffer_size > 0) {
+            applied &= detail::set_socket_option(fd, SOL_SOCKET, SO_RCVBUF, config.receive_buffer_size, "SO_RCVBUF",
+                                                 peer);
+        }
+        if (config.send_buffer_size > 0) {
+            applied &= detail::set_socket_option(fd, SOL_SOCKET, SO_SNDBUF, config.send_buffer_size, "SO_SNDBUF",
+                                                 peer);
+        }
+        if (config.rx_timestamps) {
+            // Software timestamps are taken when the packet reaches the stack, in CLOCK_REALTIME like the rest of
+            // our receive times. Hardware ones would need SIOCSHWTSTAMP on the interface and a PHC synced to it.
+            applied &= detail::set_socket_option(fd, SOL_SOCKET, SO_TIMESTAMPING,
+                                                 SOF_TIMESTAMPING_RX_SOFTWARE | SOF_TIMESTAMPING_SOFTWARE,
+                                                 "SO_TIMESTAMPING", peer);
+        }
+        return applied;
+    }
+
+    // Receive timestamp in a control message of recvmsg(), 0 if there is none.
+    inline int64_t rx_timestamp_nanos(const msghdr &msg) noexcept {
+        for (auto *cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(const_cast<msghdr *>(&msg), cmsg)) {
+            if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SO_TIMESTAMPING) {
+                // scm_timestamping: software, deprecated, raw hardware.
+                timespec stamps[3];
+                std::memcpy(stamps, CMSG_DATA(cmsg), sizeof(stamps));
+                return static_cast<int64_t>(stamps[0].tv_sec) * 1'000'000'000 + stamps[0].tv_nsec;
+            }
+        }
+        return 0;
+    }
+}
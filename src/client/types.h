@@ -0,0 +1,30 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+namespace client {
+    // Levels per side whose quantities a top of book update carries, the best one included.
+    inline constexpr size_t BookDepthLevels = 5;
+
+    enum class Side : uint8_t {
+        NONE,
+        BID,
+        ASK
+    };
+
+    constexpr std::string_view to_string(Side side) noexcept {
+        switch (side) {
+            case Side::BID: return "bid";
+            case Side::ASK: return "ask";
+            case Side::NONE: break;
+        }
+        return "none";
+    }
+
+    // Gemini's order entry API talks about buy and sell.
+    constexpr std::string_view to_gemini_side(Side side) noexcept {
+        return side == Side::BID ? "buy" : "sell";
+    }
+}
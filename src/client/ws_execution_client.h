@@ -1,14 +1,398 @@
-//
-// Created by Tomasz Kupczyk on 27/9/24.
-//
+#pragma once
 
-#ifndef WS_EXECUTION_CLIENT_H
-#define WS_EXECUTION_CLIENT_H
+#include <boost/asio.hpp>
+#include <boost/beast.hpp>
+#include <boost/beast/ssl.hpp>
+#include <boost/beast/websocket/ssl.hpp>
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <optional>
+#include <string>
+#include <thread>
+
+#include "gemini_order_events_parser.h"
+#include "gemini_signer.h"
+#include "socket_options.h"
+#include "ws_order_entry_client.h"
+#include "../util/logger.h"
+#include "../util/metrics.h"
+#include "../util/queue_producer.h"
+#include "../util/spsc_queue.h"
+#include "../util/symbol_table.h"
+#include "../util/thread_utils.h"
+#include "../util/wait_strategy.h"
 
 namespace client {
-  struct WsExecutionMsg {
+    namespace beast = boost::beast;
+    namespace http = beast::http;
+    namespace websocket = beast::websocket;
+    namespace net = boost::asio;
+    using tcp = boost::asio::ip::tcp;
 
-  };
-}
+    struct WsExecutionClientConfig {
+        // See WsOrderBookClientConfig, the same for this connection's reader thread.
+        bool busy_poll{false};
+        int cpu_id{-1};
+        std::chrono::milliseconds connect_timeout{5000};
+        // Gemini sends a heartbeat every five seconds.
+        std::chrono::milliseconds idle_timeout{10000};
+        std::chrono::milliseconds reconnect_backoff{100};
+        std::chrono::milliseconds max_reconnect_backoff{5000};
+        size_t read_buffer_size{64 << 10};
+        // PEM certificate to trust instead of the system store, for test servers.
+        std::string ca_certificate_pem{};
+        SocketOptionsConfig socket{};
+        // Losing an event could leave an order manager waiting on it forever, like the order entry responses.
+        util::QueueProducerConfig queue{.policy = util::OverflowPolicy::BLOCK, .metrics_name = "oe.events_queue"};
+    };
+
+    // Our orders' events as the exchange sees them, from the private Gemini order events WebSocket
+    // (wss://api.gemini.com/v1/order/events), on a thread of its own. Accepted, fill, cancelled and rejected
+    // events go out as WsOrderEntryResMsg with the leaves quantity, the same messages the order entry responses
+    // are, so fills and cancels made by the exchange reach the order manager without polling.
+    //
+    // The stream overlaps with the order entry responses, the order manager sees an ack or a cancel from both
+    // and has to take the second one as a no-op. The queue is an SpscQueue of its own, the order entry client
+    // already produces into the response queue. Events missed while reconnecting are lost, a gap in
+    // socket_sequence is counted as oe.events_gaps.
+    class WsExecutionClient {
+    public:
+        using WsOrderEntryResMsg = WsOrderEntryClient::WsOrderEntryResMsg;
+        using Config = WsExecutionClientConfig;
+
+        // `uri` may carry the stream's filters, "wss://api.gemini.com/v1/order/events?eventTypeFilter=fill".
+        // consumer_wait_strategy, if given, is notified after every event so a parked consumer wakes up.
+        WsExecutionClient(const std::string &uri, const util::SymbolTable &symbols,
+                          util::SpscQueue<WsOrderEntryResMsg> &events, const std::string &api_key,
+                          const std::string &api_secret, util::WaitStrategy *consumer_wait_strategy = nullptr,
+                          const Config &config = Config{})
+            : m_uri(uri)
+              , m_config(config)
+              , m_symbols(symbols)
+              , m_api_key(api_key)
+              , m_signer(api_secret)
+              , m_consumer_wait_strategy(consumer_wait_strategy)
+              , m_ssl_ctx(net::ssl::context::tlsv12_client)
+              , m_resolver(m_ioc)
+              , m_timer(m_ioc)
+              , m_events(events, config.queue, consumer_wait_strategy)
+              , m_frames(util::MetricsRegistry::instance().counter("oe.events_frames"))
+              , m_order_events(util::MetricsRegistry::instance().counter("oe.order_events"))
+              , m_invalid_frames(util::MetricsRegistry::instance().counter("oe.events_invalid_frames"))
+              , m_gaps(util::MetricsRegistry::instance().counter("oe.events_gaps"))
+              , m_reconnects(util::MetricsRegistry::instance().counter("oe.events_reconnects"))
+              , m_connected_gauge(util::MetricsRegistry::instance().gauge("oe.events_connected")) {
+            LOG_INFO("Initializing order events client with URI: {}", m_uri);
+            m_host = m_uri.substr(m_uri.find("//") + 2);
+            if (m_host.find("/") != std::string::npos) {
+                m_endpoint = m_host.substr(m_host.find("/"));
+                m_host = m_host.substr(0, m_host.find("/"));
+            }
+            if (m_host.find(":") != std::string::npos) {
+                m_port = m_host.substr(m_host.find(":") + 1);
+                m_host = m_host.substr(0, m_host.find(":"));
+            }
+            if (m_config.ca_certificate_pem.empty()) {
+                m_ssl_ctx.set_default_verify_paths();
+            } else {
+                m_ssl_ctx.add_certificate_authority(net::buffer(m_config.ca_certificate_pem));
+            }
+            m_ssl_ctx.set_verify_mode(net::ssl::verify_peer);
+            m_buffer.reserve(m_config.read_buffer_size);
+        }
+
+        WsExecutionClient(const WsExecutionClient &) = delete;
+
+        WsExecutionClient(const WsExecutionClient &&) = delete;
+
+        WsExecutionClient &operator=(const WsExecutionClient &) = delete;
+
+        WsExecutionClient &operator=(const WsExecutionClient &&) = delete;
+
+        ~WsExecutionClient() {
+            stop();
+        }
+
+        // Connects in the background and keeps the connection up until stop().
+        void start() {
+            LOG_INFO("Starting order events client, host: {}", m_host);
+            m_stopping = false;
+            m_ioc.restart();
+            net::post(m_ioc, [this] { connect(); });
+            m_io_thread = std::thread([this] { run(); });
+        }
+
+        void stop() {
+            if (!m_io_thread.joinable()) {
+                return;
+            }
+            LOG_INFO("Stopping order events client");
+            m_stopping = true;
+            net::post(m_ioc, [this] { close(); });
+            m_io_thread.join();
+        }
+
+        bool is_connected() const noexcept {
+            return m_is_connected.load(std::memory_order::relaxed);
+        }
+
+    private:
+        friend class GeminiOrderEventsParser;
+
+        void run() {
+            if (m_config.cpu_id >= 0 && !util::pinCurrentThreadToCpu(m_config.cpu_id)) {
+                LOG_WARN("WsExecutionClient: failed to pin to cpu {}", m_config.cpu_id);
+            }
+            while (!m_stopping.load(std::memory_order::relaxed)) {
+                if (m_config.busy_poll) {
+                    m_ioc.poll();
+                } else {
+                    m_ioc.run_one();
+                }
+            }
+            while (m_ioc.poll() != 0) {
+            }
+        }
 
-#endif //WS_EXECUTION_CLIENT_H
+        void connect() {
+            if (m_stopping) {
+                return;
+            }
+            m_ws.emplace(m_ioc, m_ssl_ctx);
+            if (!SSL_set_tlsext_host_name(m_ws->next_layer().native_handle(), m_host.c_str())) {
+                on_fail("sni", beast::error_code(static_cast<int>(::ERR_get_error()), net::error::get_ssl_category()));
+                return;
+            }
+            m_ws->next_layer().set_verify_callback(net::ssl::host_name_verification(m_host));
+            m_timer.expires_after(m_config.connect_timeout);
+            m_timer.async_wait([this](beast::error_code ec) {
+                if (!ec) {
+                    disconnect();
+                }
+            });
+            m_resolver.async_resolve(m_host, m_port, [this](beast::error_code ec, tcp::resolver::results_type results) {
+                if (ec) {
+                    return on_fail("resolve", ec);
+                }
+                beast::get_lowest_layer(*m_ws).async_connect(results, [this](beast::error_code ec, const auto &) {
+                    on_connect(ec);
+                });
+            });
+        }
+
+        void on_connect(beast::error_code ec) {
+            if (ec) {
+                return on_fail("connect", ec);
+            }
+            apply_socket_options(beast::get_lowest_layer(*m_ws).socket().native_handle(), m_config.socket, m_host);
+            m_ws->next_layer().async_handshake(net::ssl::stream_base::client, [this](beast::error_code ec) {
+                on_tls_handshake(ec);
+            });
+        }
+
+        void on_tls_handshake(beast::error_code ec) {
+            if (ec) {
+                return on_fail("tls handshake", ec);
+            }
+            m_ws->set_option(websocket::stream_base::timeout{m_config.connect_timeout, m_config.idle_timeout, true});
+            // The stream is authenticated like a REST call, with the signed payload in the upgrade request. The
+            // nonce shares the API key's sequence with the order entry requests, Gemini takes it as long as the
+            // key accepts time based nonces.
+            const auto nonce = std::max<int64_t>(std::chrono::duration_cast<std::chrono::milliseconds>(
+                                                     std::chrono::system_clock::now().time_since_epoch()).count(),
+                                                 m_last_nonce + 1);
+            m_last_nonce = nonce;
+            m_payload.clear();
+            m_payload.append(R"({"request":")").append(std::string_view(m_endpoint).substr(0, m_endpoint.find('?')))
+                    .append(R"(","nonce":)").append(nonce).append("}");
+            const auto signed_payload = m_signer.sign(m_payload.view());
+            m_ws->set_option(websocket::stream_base::decorator(
+                [this, signed_payload](websocket::request_type &req) {
+                    req.set(http::field::user_agent,
+                            std::string(BOOST_BEAST_VERSION_STRING) + " websocket-client-async");
+                    req.set("X-GEMINI-APIKEY", m_api_key);
+                    req.set("X-GEMINI-PAYLOAD",
+                            beast::string_view(signed_payload.payload.data(), signed_payload.payload.size()));
+                    req.set("X-GEMINI-SIGNATURE",
+                            beast::string_view(signed_payload.signature.data(), signed_payload.signature.size()));
+                }));
+            m_ws->async_handshake(m_host, m_endpoint, [this](beast::error_code ec) { on_open(ec); });
+        }
+
+        // Nothing to subscribe to, the events start with the upgrade.
+        void on_open(beast::error_code ec) {
+            if (ec) {
+                return on_fail("websocket handshake", ec);
+            }
+            LOG_INFO("Order events connection opened");
+            m_timer.cancel();
+            m_is_connected = true;
+            m_connected_gauge.set(1);
+            m_backoff = std::chrono::milliseconds(0);
+            m_socket_sequence.reset();
+            read();
+        }
+
+        void read() {
+            m_ws->async_read(m_buffer, [this](beast::error_code ec, size_t) { on_read(ec); });
+        }
+
+        void on_read(beast::error_code ec) {
+            if (ec) {
+                return on_fail("read", ec);
+            }
+            const auto data = m_buffer.data();
+            on_message(std::string_view(static_cast<const char *>(data.data()), data.size()));
+            m_buffer.consume(m_buffer.size());
+            read();
+        }
+
+        void on_fail(std::string_view what, beast::error_code ec) {
+            if (m_stopping) {
+                return;
+            }
+            if (m_is_connected) {
+                m_is_connected = false;
+                m_connected_gauge.set(0);
+                LOG_WARN("Order events connection lost ({}: {}), events until the reconnect are missed", what,
+                         ec.message());
+            } else {
+                LOG_WARN("Order events cannot connect to {}:{} ({}: {})", m_host, m_port, what, ec.message());
+            }
+            disconnect();
+            m_backoff = std::clamp(m_backoff * 2, m_config.reconnect_backoff, m_config.max_reconnect_backoff);
+            m_reconnects.add();
+            m_timer.expires_after(m_backoff);
+            m_timer.async_wait([this](beast::error_code ec) {
+                if (!ec) {
+                    connect();
+                }
+            });
+        }
+
+        void disconnect() {
+            m_buffer.clear();
+            if (m_ws) {
+                beast::error_code ignored;
+                beast::get_lowest_layer(*m_ws).socket().close(ignored);
+            }
+        }
+
+        void close() {
+            m_timer.cancel();
+            m_resolver.cancel();
+            disconnect();
+            m_is_connected = false;
+            m_connected_gauge.set(0);
+        }
+
+        void on_message(std::string_view message) {
+            LOG_DEBUG("Processing order events message: {}", message);
+            m_frames.add();
+            uint64_t socket_sequence = m_socket_sequence.value_or(0);
+            const auto type = GeminiOrderEventsParser::parse(message, *this, socket_sequence);
+            if (type == GeminiOrderEventsParser::MessageType::INVALID) [[unlikely]] {
+                m_invalid_frames.add();
+                LOG_ERROR("Malformed order events message: {}", message);
+                return;
+            }
+            if (type == GeminiOrderEventsParser::MessageType::UNKNOWN) [[unlikely]] {
+                LOG_INFO("Unhandled order events message: {}", message);
+                return;
+            }
+            // Every message is numbered from 0 on each connection, events of one message share the number.
+            const auto expected = m_socket_sequence ? *m_socket_sequence + 1 : 0;
+            if (socket_sequence != expected) [[unlikely]] {
+                m_gaps.add();
+                LOG_WARN("Order events socket_sequence {} where {} was expected, events missed", socket_sequence, expected);
+            }
+            m_socket_sequence = socket_sequence;
+        }
+
+        // GeminiOrderEventsParser handler.
+        void on_order_event(const GeminiOrderEvent &event) noexcept {
+            m_order_events.add();
+            WsOrderEntryResMsg msg;
+            if (!to_response(event, msg)) {
+                return;
+            }
+            char symbol[32];
+            const auto length = std::min(event.symbol.size(), sizeof(symbol));
+            std::transform(event.symbol.begin(), event.symbol.begin() + length, symbol,
+                           [](char c) { return static_cast<char>(std::toupper(static_cast<unsigned char>(c))); });
+            msg.symbol_id = m_symbols.find(std::string_view(symbol, length));
+            m_events.push(msg, 0, &m_stopping);
+            if (m_consumer_wait_strategy) {
+                m_consumer_wait_strategy->notify();
+            }
+        }
+
+        // Only events that change what the order manager knows about one of our orders are passed on. A booked
+        // or closed event follows one of those, initial ones are orders we already know.
+        static bool to_response(const GeminiOrderEvent &event, WsOrderEntryResMsg &msg) noexcept {
+            using OrdStatus = WsOrderEntryResMsg::OrdStatus;
+            if (event.client_order_id == 0) {
+                return false;
+            }
+            switch (event.type) {
+                case GeminiOrderEvent::Type::ACCEPTED:
+                    msg.status = OrdStatus::NEW;
+                    msg.leaves_qty = event.has_remaining_amount ? event.remaining_amount : event.original_amount;
+                    break;
+                case GeminiOrderEvent::Type::FILL:
+                    msg.status = event.remaining_amount.isZero() ? OrdStatus::FILLED : OrdStatus::PARTIALLY_FILLED;
+                    msg.leaves_qty = event.remaining_amount;
+                    break;
+                case GeminiOrderEvent::Type::CANCELLED:
+                    msg.status = OrdStatus::CANCELED;
+                    break;
+                case GeminiOrderEvent::Type::REJECTED:
+                case GeminiOrderEvent::Type::CANCEL_REJECTED:
+                    msg.status = OrdStatus::REJECTED;
+                    break;
+                default:
+                    return false;
+            }
+            msg.side = event.side;
+            msg.order_id = event.order_id;
+            msg.client_order_id = event.client_order_id;
+            msg.message = event.reason;
+            return true;
+        }
+
+        std::string m_uri;
+        const Config m_config;
+        std::string m_host;
+        std::string m_port{"443"};
+        std::string m_endpoint{"/"};
+        const util::SymbolTable &m_symbols;
+        std::string m_api_key;
+        GeminiSigner m_signer;
+        PayloadWriter m_payload;
+        int64_t m_last_nonce{0};
+        util::WaitStrategy *m_consumer_wait_strategy;
+        std::atomic<bool> m_is_connected{false};
+        std::atomic<bool> m_stopping{false};
+        // Everything below is only touched on the io thread once started.
+        net::io_context m_ioc;
+        net::ssl::context m_ssl_ctx;
+        tcp::resolver m_resolver;
+        std::optional<websocket::stream<beast::ssl_stream<beast::tcp_stream> > > m_ws;
+        beast::flat_buffer m_buffer;
+        // Deadline of a connection attempt, then the backoff before the next one.
+        net::steady_timer m_timer;
+        std::chrono::milliseconds m_backoff{0};
+        std::thread m_io_thread;
+        // Of the last message on this connection, none yet after connecting.
+        std::optional<uint64_t> m_socket_sequence;
+        util::QueueProducer<WsOrderEntryResMsg> m_events;
+        util::Counter m_frames;
+        util::Counter m_order_events;
+        util::Counter m_invalid_frames;
+        util::Counter m_gaps;
+        util::Counter m_reconnects;
+        util::Gauge m_connected_gauge;
+    };
+}
@@ -7,12 +7,24 @@
 #include <string>
 #include <functional>
 #include <nlohmann/json.hpp> // For parsing JSON, assuming you use this library
-#include <map>
 #include <algorithm>
-#include <mutex>
+#include <atomic>
+#include <optional>
 #include <thread>
 #include <chrono>
 
+#include "l2_book_builder.h"
+#include "rx_timestamp_stream.h"
+#include "socket_options.h"
+#include "../replay/frame_file.h"
+#include "../util/latency_probe.h"
+#include "../util/logger.h"
+#include "../util/metrics.h"
+#include "../util/latest_value.h"
+#include "../util/symbol_table.h"
+#include "../util/thread_utils.h"
+#include "../util/wait_strategy.h"
+
 namespace client {
     using json = nlohmann::json;
     namespace beast = boost::beast; // from <boost/beast.hpp>
@@ -21,241 +33,331 @@ namespace client {
     namespace net = boost::asio; // from <boost/asio.hpp>
     using tcp = boost::asio::ip::tcp; // from <boost/asio/ip/tcp.hpp>
 
+    struct WsOrderBookClientConfig {
+        // Poll the io_context in a loop instead of sleeping in epoll between frames. Saves the wake up on every
+        // frame at the cost of a whole CPU, for a reader thread pinned to an isolated one.
+        bool busy_poll{false};
+        // CPU to pin the reader thread to, negative means no pinning.
+        int cpu_id{-1};
+        std::chrono::milliseconds connect_timeout{5000};
+        // A connection that went this long without a frame or an answer to our ping counts as dead.
+        std::chrono::milliseconds idle_timeout{10000};
+        // Reconnect attempts back off exponentially between these two.
+        std::chrono::milliseconds reconnect_backoff{100};
+        std::chrono::milliseconds max_reconnect_backoff{5000};
+        // Allocated up front and reused for every frame. The snapshot after subscribing is the largest frame,
+        // the buffer only grows if that doesn't fit.
+        size_t read_buffer_size{1 << 20};
+        // PEM certificate to trust instead of the system store, for test servers.
+        std::string ca_certificate_pem{};
+        // Kernel receive timestamps become the receive time of every frame, falling back to the time of the read.
+        SocketOptionsConfig socket{.rx_timestamps = true};
+        book::OrderBookConfig book{};
+    };
+
+    // Gemini v2 market data over one WebSocket connection, driven by asynchronous reads on a thread of its own.
+    // A dropped or silent connection is reconnected with backoff and resubscribed. Updates missed in between
+    // can't be replayed, so the books are cleared (publishing an empty top of book) and rebuilt from the
+    // snapshot the exchange sends after every subscription.
     class WsOrderBookClient {
     public:
-        struct WsBestBidBestAskMsg {
-            double best_bid{};
-            double best_bid_quantity{};
-            double best_ask{};
-            double best_ask_quantity{};
-        };
+        using WsBestBidBestAskMsg = client::WsBestBidBestAskMsg;
+        using Config = WsOrderBookClientConfig;
 
-        WsOrderBookClient(const std::string &uri, util::SpscQueue<WsBestBidBestAskMsg> &ob_updates_queue)
+        // Subscribes to l2 of every symbol in `symbols` on one connection.
+        // Top of book goes to `ob_updates`, one slot per symbol. consumer_wait_strategy, if given, is notified
+        // after every update so a parked consumer wakes up.
+        WsOrderBookClient(const std::string &uri, const util::SymbolTable &symbols,
+                          util::LatestValueSlots<WsBestBidBestAskMsg> &ob_updates,
+                          util::WaitStrategy *consumer_wait_strategy = nullptr, const Config &config = Config{})
             : m_uri(uri)
-              , m_is_connected(false)
-              , m_ioc()
+              , m_config(config)
               , m_ssl_ctx(net::ssl::context::tlsv12_client)
               , m_resolver(m_ioc)
-              , m_ws(beast::ssl_stream<beast::tcp_stream>(m_ioc, m_ssl_ctx))
-              , m_ob_updates_queue(ob_updates_queue) {
-            std::cout << "Initializing WebSocket client with URI: " << m_uri << std::endl;
-        }
-
-        void start() {
-            std::lock_guard<std::mutex> lock(m_mutex);
-            std::cout << "Starting WebSocket client" << std::endl;
-
+              , m_timer(m_ioc)
+              , m_symbols(symbols)
+              , m_book_builder(symbols, ob_updates, consumer_wait_strategy, config.book)
+              , m_frames(util::MetricsRegistry::instance().counter("md.frames"))
+              , m_invalid_frames(util::MetricsRegistry::instance().counter("md.invalid_frames"))
+              , m_reconnects(util::MetricsRegistry::instance().counter("md.reconnects"))
+              , m_connected_gauge(util::MetricsRegistry::instance().gauge("md.connected")) {
+            LOG_INFO("Initializing WebSocket client with URI: {}", m_uri);
             // Parse the URI to extract the host, port, and endpoint
-            std::string host = m_uri.substr(m_uri.find("//") + 2);
-            std::string endpoint = "/";
-            std::string port = "443";
-            if (host.find("/") != std::string::npos) {
-                endpoint = host.substr(host.find("/"));
-                host = host.substr(0, host.find("/"));
+            m_host = m_uri.substr(m_uri.find("//") + 2);
+            if (m_host.find("/") != std::string::npos) {
+                m_endpoint = m_host.substr(m_host.find("/"));
+                m_host = m_host.substr(0, m_host.find("/"));
             }
-            if (host.find(":") != std::string::npos) {
-                port = host.substr(host.find(":") + 1);
-                host = host.substr(0, host.find(":"));
+            if (m_host.find(":") != std::string::npos) {
+                m_port = m_host.substr(m_host.find(":") + 1);
+                m_host = m_host.substr(0, m_host.find(":"));
+            }
+            if (m_config.ca_certificate_pem.empty()) {
+                m_ssl_ctx.set_default_verify_paths();
+            } else {
+                m_ssl_ctx.add_certificate_authority(net::buffer(m_config.ca_certificate_pem));
             }
+            m_ssl_ctx.set_verify_mode(net::ssl::verify_peer);
+            m_subscription = json{
+                {"type", "subscribe"},
+                {"subscriptions", {{{"name", "l2"}, {"symbols", m_symbols.names()}}}}
+            }.dump();
+            m_buffer.reserve(m_config.read_buffer_size);
+        }
 
-            // Resolve the host
-            std::cout << "host: " << host << std::endl;
-            auto const results = m_resolver.resolve(host, port);
+        WsOrderBookClient(const WsOrderBookClient &) = delete;
 
-            // Make the connection on the IP address we get from a lookup
-            beast::get_lowest_layer(m_ws).connect(results);
+        WsOrderBookClient(const WsOrderBookClient &&) = delete;
 
-            // Perform the SSL handshake
-            m_ws.next_layer().handshake(net::ssl::stream_base::client);
+        WsOrderBookClient &operator=(const WsOrderBookClient &) = delete;
 
-            // Set a decorator to change the User-Agent of the handshake
-            m_ws.set_option(websocket::stream_base::decorator(
-                [](websocket::request_type &req) {
-                    req.set(http::field::user_agent,
-                            std::string(BOOST_BEAST_VERSION_STRING) + " websocket-client-coro");
-                }));
+        WsOrderBookClient &operator=(const WsOrderBookClient &&) = delete;
 
-            // Perform the WebSocket handshake with the correct endpoint
-            m_ws.handshake(host, endpoint);
+        ~WsOrderBookClient() {
+            stop();
+        }
 
-            m_is_connected = true;
-            subscribe_order_book();
+        // Connects in the background and keeps the connection up until stop().
+        void start() {
+            LOG_INFO("Starting WebSocket client, host: {}", m_host);
+            m_stopping = false;
+            m_ioc.restart();
+            net::post(m_ioc, [this] { connect(); });
+            m_io_thread = std::thread([this] { run(); });
+        }
 
-            // Read messages in a separate thread
-            m_read_thread = std::thread([this] { read_messages(); });
+        // Records every frame received from now on, the writer has to outlive the client. Set before start().
+        void set_capture(replay::FrameWriter *capture) {
+            m_capture = capture;
+        }
+
+        // Queues the trades of the subscribed symbols into `trades` for the trading engine, they come with the l2
+        // subscription. Set before start().
+        void set_trade_queue(util::SpscQueue<WsTradesMsg> &trades, const TradePublisherConfig &config = {}) {
+            m_book_builder.set_trade_queue(trades, config);
+        }
+
+        // Persists the market data into `tick_store`, which has to outlive the client. Set before start().
+        void set_tick_store(store::TickStoreWriter *tick_store) {
+            m_book_builder.set_tick_store(tick_store);
         }
 
         void stop() {
-            std::lock_guard<std::mutex> lock(m_mutex);
-            std::cout << "Stopping WebSocket client" << std::endl;
-            m_ws.close(websocket::close_code::normal);
-            if (m_read_thread.joinable()) {
-                m_read_thread.join();
+            if (!m_io_thread.joinable()) {
+                return;
             }
-            m_is_connected = false;
+            LOG_INFO("Stopping WebSocket client");
+            m_stopping = true;
+            net::post(m_ioc, [this] { close(); });
+            m_io_thread.join();
+        }
+
+        bool is_connected() const noexcept {
+            return m_is_connected.load(std::memory_order::relaxed);
         }
 
     private:
-        void read_messages() {
-            try {
-                for (;;) {
-                    beast::flat_buffer buffer;
-                    m_ws.read(buffer);
-                    std::lock_guard<std::mutex> lock(m_mutex);
-                    std::string message = beast::buffers_to_string(buffer.data());
-                    auto start_time = std::chrono::high_resolution_clock::now();
-                    on_message(message);
-                    auto end_time = std::chrono::high_resolution_clock::now();
-                    auto duration = std::chrono::duration_cast<std::chrono::microseconds>(end_time - start_time).
-                            count();
-                    std::cout << "Processed message in " << duration << " microseconds" << std::endl;
+        void run() {
+            if (m_config.cpu_id >= 0 && !util::pinCurrentThreadToCpu(m_config.cpu_id)) {
+                LOG_WARN("WsOrderBookClient: failed to pin to cpu {}", m_config.cpu_id);
+            }
+            while (!m_stopping.load(std::memory_order::relaxed)) {
+                if (m_config.busy_poll) {
+                    m_ioc.poll();
+                } else {
+                    m_ioc.run_one();
+                }
+            }
+            // The close posted by stop() and the handlers it aborts. Timers left pending are harmless.
+            while (m_ioc.poll() != 0) {
+            }
+        }
+
+        // Resolves on every attempt, the exchange may have moved.
+        void connect() {
+            if (m_stopping) {
+                return;
+            }
+            // Recreated on every attempt, an SSL stream cannot be reused once it failed.
+            m_ws.emplace(m_ioc, m_ssl_ctx);
+            if (!SSL_set_tlsext_host_name(m_ws->next_layer().native_handle(), m_host.c_str())) {
+                on_fail("sni", beast::error_code(static_cast<int>(::ERR_get_error()), net::error::get_ssl_category()));
+                return;
+            }
+            m_ws->next_layer().set_verify_callback(net::ssl::host_name_verification(m_host));
+            // Covers everything up to the subscription, the TLS reads don't go through the tcp_stream timeouts.
+            m_timer.expires_after(m_config.connect_timeout);
+            m_timer.async_wait([this](beast::error_code ec) {
+                if (!ec) {
+                    // Fails whatever step is pending.
+                    disconnect();
                 }
-            } catch (const std::exception &e) {
-                std::cerr << "Read error: " << e.what() << std::endl;
+            });
+            m_resolver.async_resolve(m_host, m_port, [this](beast::error_code ec, tcp::resolver::results_type results) {
+                if (ec) {
+                    return on_fail("resolve", ec);
+                }
+                beast::get_lowest_layer(*m_ws).async_connect(results, [this](beast::error_code ec, const auto &) {
+                    on_connect(ec);
+                });
+            });
+        }
+
+        void on_connect(beast::error_code ec) {
+            if (ec) {
+                return on_fail("connect", ec);
             }
+            apply_socket_options(beast::get_lowest_layer(*m_ws).socket().native_handle(), m_config.socket, m_host);
+            m_ws->next_layer().async_handshake(net::ssl::stream_base::client, [this](beast::error_code ec) {
+                on_tls_handshake(ec);
+            });
         }
 
-        void print_order_book(const std::map<double, double> &orders, const std::string &side) {
-            std::cout << "Printing " << side << " orders:" << std::endl;
-            for (const auto &order: orders) {
-                std::cout << "Price: " << order.first << ", Quantity: " << order.second << std::endl;
+        void on_tls_handshake(beast::error_code ec) {
+            if (ec) {
+                return on_fail("tls handshake", ec);
             }
+            // The websocket stream has timeouts of its own, with pings on an idle connection.
+            m_ws->set_option(websocket::stream_base::timeout{m_config.connect_timeout, m_config.idle_timeout, true});
+            // Set a decorator to change the User-Agent of the handshake
+            m_ws->set_option(websocket::stream_base::decorator(
+                [](websocket::request_type &req) {
+                    req.set(http::field::user_agent,
+                            std::string(BOOST_BEAST_VERSION_STRING) + " websocket-client-async");
+                }));
+            m_ws->async_handshake(m_host, m_endpoint, [this](beast::error_code ec) { on_open(ec); });
         }
 
-        void on_open() {
-            std::cout << "WebSocket connection opened" << std::endl;
+        void on_open(beast::error_code ec) {
+            if (ec) {
+                return on_fail("websocket handshake", ec);
+            }
+            LOG_INFO("WebSocket connection opened");
+            m_timer.cancel();
             m_is_connected = true;
+            m_connected_gauge.set(1);
+            m_backoff = std::chrono::milliseconds(0);
             subscribe_order_book();
         }
 
-        void on_fail(const std::string &reason) {
-            std::cerr << "Connection failed: " << reason << std::endl;
+        void subscribe_order_book() {
+            LOG_INFO("Subscribing to order book with payload: {}", m_subscription);
+            m_ws->text(true);
+            m_ws->async_write(net::buffer(m_subscription), [this](beast::error_code ec, size_t) {
+                if (ec) {
+                    return on_fail("subscribe", ec);
+                }
+                read();
+            });
         }
 
-        void on_close() {
-            m_is_connected = false;
-            std::cerr << "WebSocket connection closed" << std::endl;
+        void read() {
+            CMM_PROBE_BEGIN();
+            m_ws->async_read(m_buffer, [this](beast::error_code ec, size_t) { on_read(ec); });
         }
 
-        void on_message(const std::string &message) {
-            std::cout << "Processing WebSocket message: " << message << std::endl;
-            try {
-                json data = json::parse(message);
-                std::cout << "Parsed JSON: " << data.dump() << std::endl;
-                if (data.contains("type") && data["type"] == "l2_updates" && data.contains("symbol") && data["symbol"]
-                    == "BTCGUSDPERP") {
-                    if (data.contains("changes")) {
-                        for (const auto &change: data["changes"]) {
-                            if (change.size() == 3) {
-                                std::string side = change[0].get<std::string>();
-                                double price = std::stod(change[1].get<std::string>());
-                                double quantity = std::stod(change[2].get<std::string>());
-
-                                //std::cout << "Processing change - Side: " << side << ", Price: " << price << ", Quantity: " << quantity << std::endl;
-
-                                if (side == "buy") {
-                                    if (quantity > 0.0) {
-                                        //std::cout << "Inserting/updating bid: " << price << " with quantity: " << quantity << std::endl;
-                                        m_bid_orders[price] = quantity;
-                                    } else {
-                                        //std::cout << "Removing bid: " << price << std::endl;
-                                        m_bid_orders.erase(price);
-                                    }
-                                } else if (side == "sell") {
-                                    if (quantity > 0.0) {
-                                        //std::cout << "Inserting/updating ask: " << price << " with quantity: " << quantity << std::endl;
-                                        m_ask_orders[price] = quantity;
-                                    } else {
-                                        //std::cout << "Removing ask: " << price << std::endl;
-                                        m_ask_orders.erase(price);
-                                    }
-                                }
-                            }
-                        }
-                    }
-                    trim_and_update_best_levels();
-                    std::cout << "push with best bid: " << m_best_bid << ", best bid quantity: " << m_best_bid_quantity
-                              << ", best ask: " << m_best_ask << ", best ask quantity: " << m_best_ask_quantity << std::endl;
-                    m_ob_updates_queue.push(WsBestBidBestAskMsg{
-                        .best_bid = m_best_bid,
-                        .best_bid_quantity = m_best_bid_quantity,
-                        .best_ask = m_best_ask,
-                        .best_ask_quantity = m_best_ask_quantity
-                    });
-                }
-            } catch (const std::exception &e) {
-                std::cerr << "Error parsing message: " << e.what() << std::endl;
+        void on_read(beast::error_code ec) {
+            if (ec) {
+                CMM_PROBE_END();
+                return on_fail("read", ec);
             }
-        }
-
-        void trim_and_update_best_levels() {
-            //std::cout << "Trimming order book to top 3 levels and updating best levels" << std::endl;
-            // Keep only the top 3 levels for bids
-            while (m_bid_orders.size() > 3) {
-                //std::cout << "Removing lowest bid level: " << m_bid_orders.begin()->first << std::endl;
-                m_bid_orders.erase(m_bid_orders.begin());
+            CMM_PROBE(SOCKET_READ);
+            // flat_buffer is contiguous, parse the frame where it is.
+            const auto data = m_buffer.data();
+            const std::string_view message(static_cast<const char *>(data.data()), data.size());
+            const auto kernel_receive_time = m_ws->next_layer().next_layer().last_receive_time();
+            const auto receive_time = kernel_receive_time ? kernel_receive_time : replay::wallClockNanos();
+            if (m_capture) {
+                m_capture->write(receive_time, message);
             }
+            on_message(message, receive_time);
+            m_buffer.consume(m_buffer.size());
+            read();
+        }
 
-            // Keep only the top 3 levels for asks
-            while (m_ask_orders.size() > 3) {
-                //std::cout << "Removing highest ask level: " << std::prev(m_ask_orders.end())->first << std::endl;
-                m_ask_orders.erase(std::prev(m_ask_orders.end()));
+        void on_fail(std::string_view what, beast::error_code ec) {
+            if (m_stopping) {
+                return;
             }
-
-            // Update best bid and ask levels
-            if (!m_bid_orders.empty()) {
-                auto best_bid_it = std::prev(m_bid_orders.end());
-                m_best_bid = best_bid_it->first;
-                m_best_bid_quantity = best_bid_it->second;
-                //std::cout << "Updated best bid: " << m_best_bid << " with quantity: " << m_best_bid_quantity << std::endl;
+            if (m_is_connected) {
+                m_is_connected = false;
+                m_connected_gauge.set(0);
+                LOG_WARN("WebSocket connection lost ({}: {}), books are resynced after reconnecting", what, ec.message());
+                m_book_builder.reset();
             } else {
-                m_best_bid = 0.0;
-                m_best_bid_quantity = 0.0;
-                //std::cout << "No bids available, setting best bid to -infinity" << std::endl;
+                LOG_WARN("WebSocket cannot connect to {}:{} ({}: {})", m_host, m_port, what, ec.message());
             }
+            disconnect();
+            m_backoff = std::clamp(m_backoff * 2, m_config.reconnect_backoff, m_config.max_reconnect_backoff);
+            m_reconnects.add();
+            m_timer.expires_after(m_backoff);
+            m_timer.async_wait([this](beast::error_code ec) {
+                if (!ec) {
+                    connect();
+                }
+            });
+        }
 
-            if (!m_ask_orders.empty()) {
-                auto best_ask_it = m_ask_orders.begin();
-                m_best_ask = best_ask_it->first;
-                m_best_ask_quantity = best_ask_it->second;
-                //std::cout << "Updated best ask: " << m_best_ask << " with quantity: " << m_best_ask_quantity << std::endl;
-            } else {
-                m_best_ask = 0.0;
-                m_best_ask_quantity = 0.0;
-                //std::cout << "No asks available, setting best ask to infinity" << std::endl;
+        // Whatever is still pending on the stream completes with an error before the next connect() replaces it.
+        void disconnect() {
+            m_buffer.clear();
+            if (m_ws) {
+                beast::error_code ignored;
+                beast::get_lowest_layer(*m_ws).socket().close(ignored);
             }
         }
 
-        void subscribe_order_book() {
-            if (!m_is_connected) {
-                std::cout << "Not connected, cannot subscribe to order book" << std::endl;
-                return;
-            }
+        // No close handshake, the exchange doesn't need it and stop() shouldn't wait for it.
+        void close() {
+            m_timer.cancel();
+            m_resolver.cancel();
+            disconnect();
+            m_is_connected = false;
+            m_connected_gauge.set(0);
+        }
 
-            json payload = {
-                {"type", "subscribe"},
-                {"subscriptions", {{{"name", "l2"}, {"symbols", {"BTCGUSDPERP"}}}}}
-            };
-            std::cout << "Subscribing to order book with payload: " << payload.dump() << std::endl;
-            m_ws.write(net::buffer(payload.dump()));
+        void on_message(std::string_view message, int64_t receive_time) {
+            LOG_DEBUG("Processing WebSocket message: {}", message);
+            m_frames.add();
+            const auto type = m_book_builder.on_message(message, receive_time);
+            if (type == GeminiMarketDataParser::MessageType::UNKNOWN) [[unlikely]] {
+                // Subscription acks, errors and whatever else the exchange sends, not worth a custom parser.
+                try {
+                    json data = json::parse(message);
+                    LOG_INFO("Unhandled message: {}", data.dump());
+                } catch (const std::exception &e) {
+                    LOG_ERROR("Error parsing message: {}", e.what());
+                }
+            } else if (type == GeminiMarketDataParser::MessageType::INVALID) [[unlikely]] {
+                m_invalid_frames.add();
+                LOG_ERROR("Malformed market data message: {}", message);
+            }
         }
 
         std::string m_uri;
-        bool m_is_connected;
+        const Config m_config;
+        std::string m_host;
+        std::string m_port{"443"};
+        std::string m_endpoint{"/"};
+        std::string m_subscription;
+        std::atomic<bool> m_is_connected{false};
+        std::atomic<bool> m_stopping{false};
+        // Everything below is only touched on the io thread once started.
         net::io_context m_ioc;
         net::ssl::context m_ssl_ctx;
         tcp::resolver m_resolver;
-        websocket::stream<beast::ssl_stream<beast::tcp_stream> > m_ws;
-        std::mutex m_mutex;
-        std::thread m_read_thread;
-        util::SpscQueue<WsBestBidBestAskMsg> &m_ob_updates_queue;
-
-        double m_best_bid;
-        double m_best_bid_quantity;
-        double m_best_ask;
-        double m_best_ask_quantity;
-
-        std::map<double, double> m_bid_orders;
-        std::map<double, double> m_ask_orders;
+        std::optional<websocket::stream<beast::ssl_stream<RxTimestampStream> > > m_ws;
+        beast::flat_buffer m_buffer;
+        // Deadline of a connection attempt, then the backoff before the next one.
+        net::steady_timer m_timer;
+        std::chrono::milliseconds m_backoff{0};
+        std::thread m_io_thread;
+        const util::SymbolTable &m_symbols;
+        L2BookBuilder m_book_builder;
+        replay::FrameWriter *m_capture{nullptr};
+        util::Counter m_frames;
+        util::Counter m_invalid_frames;
+        util::Counter m_reconnects;
+        util::Gauge m_connected_gauge;
     };
 }
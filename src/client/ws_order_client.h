@@ -1,6 +0,0 @@
-#pragma once
-
-namespace client {
-  struct WsOrderMsg {
-  };
-}
\ No newline at end of file
@@ -2,19 +2,26 @@
 
 #include <boost/beast/core.hpp>
 #include <boost/beast/http.hpp>
-#include <boost/asio/connect.hpp>
 #include <boost/beast/version.hpp>
-#include <boost/asio/ip/tcp.hpp>
-#include <openssl/hmac.h>
-#include <openssl/sha.h>
 #include <string>
 #include <iostream>
-#include <sstream>
-#include <iomanip>
 #include <chrono>
 #include <thread>
 #include <atomic>
+#include <charconv>
+#include <type_traits>
+#include <vector>
+#include "gemini_signer.h"
+#include "https_session_pool.h"
+#include "types.h"
+#include "../util/fixed_string.h"
+#include "../util/latency_probe.h"
+#include "../util/logger.h"
+#include "../util/metrics.h"
+#include "../util/queue_producer.h"
 #include "../util/spsc_queue.h"
+#include "../util/symbol_table.h"
+#include "../util/wait_strategy.h"
 
 namespace beast = boost::beast;
 namespace http = beast::http;
@@ -22,10 +29,21 @@ namespace net = boost::asio;
 using tcp = net::ip::tcp;
 
 namespace client {
+    struct WsOrderEntryClientConfig {
+        HttpsSessionPoolConfig pool{};
+        // Requests taken off the queue at once and pipelined on one session.
+        size_t max_pipelined{8};
+        util::WaitStrategyType wait_strategy{util::WaitStrategyType::SPIN_YIELD};
+    };
+
     class WsOrderEntryClient {
     public:
-        struct WsOrderEntryReqMsg {
-            enum class RequestType {
+        using Config = WsOrderEntryClientConfig;
+
+        // Messages crossing the queues are trivially copyable and exactly one cache line so a push or pop
+        // is a plain 64 byte copy. Side and status are enums, ids are numeric, zero meaning "not set".
+        struct alignas(64) WsOrderEntryReqMsg {
+            enum class RequestType : uint8_t {
                 NONE,
                 NEW_ORDER,
                 CANCEL_ORDER
@@ -33,35 +51,43 @@ namespace client {
 
             WsOrderEntryReqMsg() = default;
 
-            std::string to_string() const {
-                std::ostringstream oss;
+            // Order parameters as they follow the request in the payload,
+            // "&symbol=BTCGUSDPERP&amount=0.1&price=60000.5&side=buy...".
+            void write_params(PayloadWriter &writer, std::string_view symbol) const noexcept {
                 if (type == RequestType::NEW_ORDER) {
-                    oss << "amount=" << quantity << "&price=" << price << "&side=" << side << "&type=exchange limit";
-                } else if (type == RequestType::CANCEL_ORDER) {
-                    if (!order_id.empty()) {
-                        oss << "order_id=" << order_id;
-                    }
-                    if (!client_order_id.empty()) {
-                        if (!oss.str().empty()) {
-                            oss << "&";
-                        }
-                        oss << "client_order_id=" << client_order_id;
-                    }
+                    writer.append("&symbol=").append(symbol).append("&amount=").append(quantity).append("&price=").append(price).append("&side=")
+                            .append(to_gemini_side(side)).append("&type=exchange limit");
+                } else if (type == RequestType::CANCEL_ORDER && order_id != 0) {
+                    writer.append("&order_id=").append(order_id);
                 }
-                return oss.str();
+                if (client_order_id != 0) {
+                    writer.append("&client_order_id=").append(client_order_id);
+                }
+            }
+
+            std::string to_string(std::string_view symbol = {}) const {
+                PayloadWriter writer;
+                write_params(writer, symbol);
+                return std::string(writer.view().substr(writer.view().empty() ? 0 : 1));
             }
 
             RequestType type{RequestType::NONE};
-            double price{};
-            double quantity{};
-            std::string side{};
-            std::string order_id{};
-            std::string client_order_id{};
+            Side side{Side::NONE};
+            util::SymbolId symbol_id{};
+            util::Price price{};
+            util::Qty quantity{};
+            uint64_t order_id{};
+            uint64_t client_order_id{};
+            // Latency probe stamp of the request, 0 if it is not followed.
+            uint64_t tsc{};
         };
 
-        struct WsOrderEntryResMsg {
+        static_assert(std::is_trivially_copyable_v<WsOrderEntryReqMsg>);
+        static_assert(sizeof(WsOrderEntryReqMsg) == 64);
+
+        struct alignas(64) WsOrderEntryResMsg {
             // Follows https://btobits.com/fixopaedia/fixdic44/tag_39_OrdStatus_.html loosely.
-            enum class OrdStatus {
+            enum class OrdStatus : uint8_t {
                 NONE,
                 NEW,
                 CANCELED,
@@ -72,36 +98,59 @@ namespace client {
 
             WsOrderEntryResMsg() = default;
 
-            WsOrderEntryResMsg(OrdStatus st, const std::string& msg)
+            WsOrderEntryResMsg(OrdStatus st, std::string_view msg)
                 : status(st), message(msg) {
             }
 
-            WsOrderEntryResMsg(OrdStatus st, const std::string& msg, const std::string& oid)
-                : status(st), message(msg), order_id(oid) {
+            WsOrderEntryResMsg(OrdStatus st, std::string_view msg, uint64_t oid)
+                : status(st), order_id(oid), message(msg) {
             }
 
             OrdStatus status{OrdStatus::NONE};
-            std::string message{};
-            std::string side;
-            std::string order_id{};
-            std::string client_order_id{};
-            double leaves_qty{};
+            Side side{Side::NONE};
+            util::SymbolId symbol_id{};
+            util::Qty leaves_qty{};
+            uint64_t order_id{};
+            uint64_t client_order_id{};
+            // Reason text, truncated; only meant for diagnostics.
+            util::FixedString<32> message{};
         };
 
-        WsOrderEntryClient(const std::string &api_base_url, util::SpscQueue<WsOrderEntryReqMsg> &request_queue,
+        static_assert(std::is_trivially_copyable_v<WsOrderEntryResMsg>);
+        static_assert(sizeof(WsOrderEntryResMsg) == 64);
+
+        WsOrderEntryClient(const std::string &api_base_url, const util::SymbolTable &symbols,
+                           util::SpscQueue<WsOrderEntryReqMsg> &request_queue,
                            util::SpscQueue<WsOrderEntryResMsg> &response_queue, const std::string &api_key,
-                           const std::string &api_secret)
-            : api_base_url_(api_base_url), request_queue_(request_queue), response_queue_(response_queue),
-              api_key_(api_key), api_secret_(api_secret), ioc_(), resolver_(ioc_), stream_(ioc_),
-              stop_flag_(false) {
+                           const std::string &api_secret, util::WaitStrategy *consumer_wait_strategy = nullptr,
+                           const WsOrderEntryClientConfig &config = WsOrderEntryClientConfig{})
+            : api_base_url_(api_base_url), symbols_(symbols), request_queue_(request_queue),
+              api_key_(api_key), api_secret_(api_secret), consumer_wait_strategy_(consumer_wait_strategy),
+              host_(parse_host(api_base_url)), session_pool_(host_, parse_port(api_base_url), config.pool),
+              wait_strategy_(config.wait_strategy), signer_(api_secret), stop_flag_(false),
+              new_orders_sent_(util::MetricsRegistry::instance().counter("oe.new_orders_sent")),
+              cancels_sent_(util::MetricsRegistry::instance().counter("oe.cancels_sent")),
+              acked_(util::MetricsRegistry::instance().counter("oe.acked")),
+              rejected_(util::MetricsRegistry::instance().counter("oe.rejected")),
+              responses_(response_queue, util::QueueProducerConfig{
+                             .policy = util::OverflowPolicy::BLOCK,
+                             .metrics_name = "oe.response_queue"
+                         }, consumer_wait_strategy),
+              request_queue_depth_(util::MetricsRegistry::instance().gauge("oe.request_queue_depth")),
+              round_trip_ns_(util::MetricsRegistry::instance().histogram("oe.round_trip_ns")) {
+            batch_.resize(std::max<size_t>(config.max_pipelined, 1));
+            http_requests_.resize(batch_.size());
+            http_responses_.resize(batch_.size());
         }
 
         ~WsOrderEntryClient() {
             stop();
         }
 
+        // Opens the HTTPS sessions before the first order needs one.
         void start() {
             stop_flag_ = false;
+            session_pool_.start();
             processing_thread_ = std::thread(&WsOrderEntryClient::process_orders, this);
         }
 
@@ -110,146 +159,183 @@ namespace client {
             if (processing_thread_.joinable()) {
                 processing_thread_.join();
             }
+            session_pool_.stop();
         }
 
     private:
+        // "https://api.gemini.com[:port][/...]"
+        static std::string parse_host(std::string_view url) {
+            if (const auto scheme = url.find("://"); scheme != std::string_view::npos) {
+                url.remove_prefix(scheme + 3);
+            }
+            return std::string(url.substr(0, url.find_first_of(":/")));
+        }
+
+        static std::string parse_port(std::string_view url) {
+            if (const auto scheme = url.find("://"); scheme != std::string_view::npos) {
+                url.remove_prefix(scheme + 3);
+            }
+            url = url.substr(0, url.find('/'));
+            const auto colon = url.find(':');
+            return colon == std::string_view::npos ? "443" : std::string(url.substr(colon + 1));
+        }
+
+        // Whatever piled up in the queue goes out pipelined on one session.
         void process_orders() {
-            WsOrderEntryReqMsg order_request;
             while (!stop_flag_) {
-                if (request_queue_.pop(order_request)) {
-                    if (order_request.type == WsOrderEntryReqMsg::RequestType::NEW_ORDER) {
-                        send_order(order_request);
-                    } else if (order_request.type == WsOrderEntryReqMsg::RequestType::CANCEL_ORDER) {
-                        cancel_order(order_request);
-                    }
+                const auto count = request_queue_.pop_n(batch_.data(), batch_.size());
+                if (count == 0) {
+                    wait_strategy_.idle([this] { return !request_queue_.empty(); });
+                    continue;
+                }
+                wait_strategy_.reset();
+                request_queue_depth_.set(static_cast<int64_t>(request_queue_.size()));
+                execute_requests(count);
+            }
+        }
+
+        void execute_requests(size_t count) {
+            size_t n = 0;
+            for (size_t i = 0; i < count; ++i) {
+                if (batch_[i].type == WsOrderEntryReqMsg::RequestType::NONE) [[unlikely]] {
+                    continue;
+                }
+                if (!make_http_request(batch_[i], http_requests_[n])) [[unlikely]] {
+                    push_response(make_response(batch_[i], WsOrderEntryResMsg::OrdStatus::REJECTED,
+                                                "Payload too large"));
+                    continue;
+                }
+                CMM_PROBE_FROM(SIGNED, batch_[i].tsc);
+                (batch_[i].type == WsOrderEntryReqMsg::RequestType::NEW_ORDER ? new_orders_sent_ : cancels_sent_).add();
+                batch_[n++] = batch_[i];
+            }
+            const auto start = std::chrono::steady_clock::now();
+            const auto answered = session_pool_.execute(std::span(http_requests_.data(), n),
+                                                        std::span(http_responses_.data(), n));
+            CMM_PROBE_END();
+            round_trip_ns_.record(static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now() - start).count()));
+            for (size_t i = 0; i < n; ++i) {
+                if (i < answered) [[likely]] {
+                    handle_response(batch_[i], http_responses_[i]);
                 } else {
-                    std::cout << "No orders to process" << std::endl;
+                    push_response(make_response(batch_[i], WsOrderEntryResMsg::OrdStatus::REJECTED,
+                                                "No response from exchange"));
                 }
-                std::this_thread::sleep_for(std::chrono::milliseconds(1000));
             }
         }
 
-        void send_order(const WsOrderEntryReqMsg &order_request) {
-            execute_request(order_request, "/v1/order/new", "Order submitted successfully");
+        static std::string_view target(const WsOrderEntryReqMsg &order_request) noexcept {
+            return order_request.type == WsOrderEntryReqMsg::RequestType::NEW_ORDER
+                       ? "/v1/order/new"
+                       : "/v1/order/cancel";
         }
 
-        void cancel_order(const WsOrderEntryReqMsg &order_request) {
-            execute_request(order_request, "/v1/order/cancel", "Order cancelled successfully");
+        // Signs the request into `req`, false if the payload does not fit the signer's buffer.
+        bool make_http_request(const WsOrderEntryReqMsg &order_request, HttpsSessionPool::Request &req) {
+            const auto target = WsOrderEntryClient::target(order_request);
+
+            // Gemini wants a strictly increasing nonce, requests sent within the same millisecond included.
+            const auto nonce = std::max<int64_t>(std::chrono::duration_cast<std::chrono::milliseconds>(
+                                                     std::chrono::system_clock::now().time_since_epoch()).count(),
+                                                 last_nonce_ + 1);
+            last_nonce_ = nonce;
+
+            payload_.clear();
+            payload_.append("nonce=").append(nonce).append("&request=").append(target);
+            order_request.write_params(payload_, symbols_.name(order_request.symbol_id));
+            if (payload_.overflow()) [[unlikely]] {
+                return false;
+            }
+            const auto signed_payload = signer_.sign(payload_.view());
+
+            req = HttpsSessionPool::Request{http::verb::post, beast::string_view(target.data(), target.size()), 11};
+            req.set(http::field::host, host_);
+            req.set(http::field::user_agent, BOOST_BEAST_VERSION_STRING);
+            req.set("X-GEMINI-APIKEY", api_key_);
+            req.set("X-GEMINI-PAYLOAD", beast::string_view(signed_payload.payload.data(), signed_payload.payload.size()));
+            req.set("X-GEMINI-SIGNATURE",
+                    beast::string_view(signed_payload.signature.data(), signed_payload.signature.size()));
+            req.set(http::field::content_type, "application/x-www-form-urlencoded");
+            req.prepare_payload();
+            return true;
         }
 
-        void execute_request(const WsOrderEntryReqMsg &order_request, const std::string &target,
-                             const std::string &success_message) {
-            try {
-                auto const host = "api.gemini.com";
-                auto const port = "443";
-                int version = 11;
-
-                // Generate nonce
-                auto nonce = std::chrono::duration_cast<std::chrono::milliseconds>(
-                    std::chrono::system_clock::now().time_since_epoch()).count();
-
-                // Create payload
-                std::ostringstream payload_stream;
-                payload_stream << "nonce=" << nonce << "&request=" << target;
-                if (!order_request.to_string().empty()) {
-                    payload_stream << "&" << order_request.to_string();
-                }
-                std::string payload = payload_stream.str();
-                std::string encoded_payload = base64_encode(reinterpret_cast<const unsigned char *>(payload.c_str()),
-                                                            payload.length());
-
-                // Generate signature
-                unsigned char *digest = HMAC(EVP_sha384(), api_secret_.c_str(), api_secret_.length(),
-                                             reinterpret_cast<const unsigned char *>(encoded_payload.c_str()),
-                                             encoded_payload.length(), nullptr, nullptr);
-                std::ostringstream signature_stream;
-                for (int i = 0; i < SHA384_DIGEST_LENGTH; ++i) {
-                    signature_stream << std::hex << std::setw(2) << std::setfill('0') << static_cast<int>(digest[i]);
-                }
-                std::string signature = signature_stream.str();
-
-                // Resolve the host
-                auto const results = resolver_.resolve(host, port);
-
-                // Make the connection on the IP address we get from a lookup
-                beast::get_lowest_layer(stream_).connect(results);
-
-                // Set up an HTTP POST request message
-                http::request<http::string_body> req{http::verb::post, target, version};
-                req.set(http::field::host, host);
-                req.set(http::field::user_agent, BOOST_BEAST_VERSION_STRING);
-                req.set("X-GEMINI-APIKEY", api_key_);
-                req.set("X-GEMINI-PAYLOAD", encoded_payload);
-                req.set("X-GEMINI-SIGNATURE", signature);
-                req.set(http::field::content_type, "application/x-www-form-urlencoded");
-                req.prepare_payload();
-
-                // Send the HTTP request to the remote host
-                http::write(stream_, req);
-
-                // This buffer is used for reading and must be persisted
-                beast::flat_buffer buffer;
-
-                // Declare a container to hold the response
-                http::response<http::string_body> res;
-
-                // Receive the HTTP response
-                http::read(stream_, buffer, res);
-
-                // Handle the response
-                if (res.result() == http::status::ok) {
-                    // Parse order ID from response
-                    std::string order_id;
-                    auto body = res.body();
-                    auto pos = body.find("order_id");
-                    if (pos != std::string::npos) {
-                        auto start = body.find(':', pos) + 1;
-                        auto end = body.find(',', start);
-                        order_id = body.substr(start, end - start);
+        void handle_response(const WsOrderEntryReqMsg &order_request, const HttpsSessionPool::Response &res) {
+            if (res.result() == http::status::ok) {
+                // Parse order ID from response, it comes as a quoted number: "order_id":"106817811"
+                uint64_t order_id{};
+                const std::string_view body = res.body();
+                auto pos = body.find("order_id");
+                if (pos != std::string_view::npos) {
+                    auto start = body.find_first_of("0123456789", body.find(':', pos));
+                    if (start != std::string_view::npos) {
+                        std::from_chars(body.data() + start, body.data() + body.size(), order_id);
                     }
-                    response_queue_.push(WsOrderEntryResMsg(WsOrderEntryResMsg::OrdStatus::NEW, success_message, order_id));
+                }
+                if (order_request.type == WsOrderEntryReqMsg::RequestType::NEW_ORDER) {
+                    push_response(make_response(order_request, WsOrderEntryResMsg::OrdStatus::NEW,
+                                                "Order submitted successfully", order_id));
                 } else {
-                    response_queue_.push(WsOrderEntryResMsg(WsOrderEntryResMsg::OrdStatus::REJECTED, res.reason()));
+                    push_response(make_response(order_request, WsOrderEntryResMsg::OrdStatus::CANCELED,
+                                                "Order cancelled successfully", order_id));
                 }
+            } else {
+                const auto reason = res.reason();
+                LOG_WARN("Order entry request rejected: {} {}", static_cast<unsigned>(res.result_int()),
+                         std::string_view(reason.data(), reason.size()));
+                push_response(make_response(order_request, WsOrderEntryResMsg::OrdStatus::REJECTED,
+                                            std::string_view(reason.data(), reason.size())));
+            }
+        }
 
-                // Gracefully close the stream
-                beast::get_lowest_layer(stream_).socket().shutdown(tcp::socket::shutdown_both);
-            } catch (const std::exception &e) {
-                std::cerr << "Error: " << e.what() << std::endl;
-                response_queue_.push(WsOrderEntryResMsg(WsOrderEntryResMsg::OrdStatus::REJECTED, e.what()));
+        // Echoes side and ids of the request so the order manager can tell which order the response is for.
+        static WsOrderEntryResMsg make_response(const WsOrderEntryReqMsg &order_request,
+                                                WsOrderEntryResMsg::OrdStatus status, std::string_view message,
+                                                uint64_t order_id = 0) {
+            WsOrderEntryResMsg res(status, message, order_id ? order_id : order_request.order_id);
+            res.side = order_request.side;
+            res.symbol_id = order_request.symbol_id;
+            res.client_order_id = order_request.client_order_id;
+            res.leaves_qty = status == WsOrderEntryResMsg::OrdStatus::NEW ? order_request.quantity : util::Qty{};
+            return res;
+        }
+
+        void push_response(const WsOrderEntryResMsg &msg) {
+            (msg.status == WsOrderEntryResMsg::OrdStatus::REJECTED ? rejected_ : acked_).add();
+            // Losing a response would leave the order manager waiting on it forever, so this waits for the
+            // engine instead, unless we are shutting down.
+            responses_.push(msg, 0, &stop_flag_);
+            if (consumer_wait_strategy_) {
+                consumer_wait_strategy_->notify();
             }
         }
 
         std::string api_base_url_;
+        const util::SymbolTable &symbols_;
         util::SpscQueue<WsOrderEntryReqMsg> &request_queue_;
-        util::SpscQueue<WsOrderEntryResMsg> &response_queue_;
         std::string api_key_;
         std::string api_secret_;
-
-        net::io_context ioc_;
-        tcp::resolver resolver_;
-        beast::tcp_stream stream_;
+        util::WaitStrategy *consumer_wait_strategy_;
+
+        std::string host_;
+        HttpsSessionPool session_pool_;
+        util::WaitStrategy wait_strategy_;
+        std::vector<WsOrderEntryReqMsg> batch_;
+        std::vector<HttpsSessionPool::Request> http_requests_;
+        std::vector<HttpsSessionPool::Response> http_responses_;
+        int64_t last_nonce_{0};
+        GeminiSigner signer_;
+        PayloadWriter payload_;
         std::thread processing_thread_;
         std::atomic<bool> stop_flag_;
 
-        std::string base64_encode(const unsigned char *input, size_t length) {
-            static const char encode_table[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
-            std::string encoded;
-            encoded.reserve(((length + 2) / 3) * 4);
-            for (size_t i = 0; i < length; i += 3) {
-                unsigned int value = 0;
-                for (size_t j = i; j < i + 3; ++j) {
-                    value <<= 8;
-                    if (j < length) {
-                        value |= input[j];
-                    }
-                }
-                encoded.push_back(encode_table[(value >> 18) & 0x3F]);
-                encoded.push_back(encode_table[(value >> 12) & 0x3F]);
-                encoded.push_back((i + 1 < length) ? encode_table[(value >> 6) & 0x3F] : '=');
-                encoded.push_back((i + 2 < length) ? encode_table[value & 0x3F] : '=');
-            }
-            return encoded;
-        }
+        util::Counter new_orders_sent_;
+        util::Counter cancels_sent_;
+        util::Counter acked_;
+        util::Counter rejected_;
+        util::QueueProducer<WsOrderEntryResMsg> responses_;
+        util::Gauge request_queue_depth_;
+        util::Histogram round_trip_ns_;
     };
 } // namespace client
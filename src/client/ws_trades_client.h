@@ -1,7 +1,86 @@
 #pragma once
 
+#include <cstdint>
+#include <vector>
+
+#include "gemini_md_parser.h"
+#include "types.h"
+#include "../util/decimal.h"
+#include "../util/queue_producer.h"
+#include "../util/spsc_queue.h"
+#include "../util/symbol_table.h"
+#include "../util/wait_strategy.h"
+
 namespace client {
-  struct WsTradesMsg {
+    // One trade of the public feed. The aggressor side is the taker's, BID for a buy.
+    struct WsTradesMsg {
+        util::Price price{};
+        util::Qty quantity{};
+        uint64_t event_id{};
+        // Wall clock receive time of the frame with the trade, like WsBestBidBestAskMsg::receive_time_ns.
+        int64_t receive_time_ns{};
+        util::SymbolId symbol_id{};
+        Side aggressor_side{Side::NONE};
+    };
+
+    struct TradePublisherConfig {
+        // A full queue means the engine is far behind, the market data thread must not wait for it.
+        util::QueueProducerConfig queue{.policy = util::OverflowPolicy::DROP, .metrics_name = "md.trade_queue"};
+    };
+
+    // Hands the trades of the market data stream to the trading engine through an SpscQueue. Gemini sends them
+    // on the l2 subscription: the latest ones with the snapshot after subscribing, then one trade event each.
+    // A snapshot after a reconnect repeats trades already published, they are skipped by event id, which the
+    // exchange increases per symbol.
+    class TradePublisher {
+    public:
+        using Config = TradePublisherConfig;
+
+        // consumer_wait_strategy, if given, is notified after every trade so a parked consumer wakes up.
+        TradePublisher(size_t num_symbols, util::SpscQueue<WsTradesMsg> &trades,
+                       util::WaitStrategy *consumer_wait_strategy = nullptr, const Config &config = Config{})
+            : m_producer(trades, config.queue, consumer_wait_strategy)
+              , m_consumer_wait_strategy(consumer_wait_strategy)
+              , m_last_event_ids(num_symbols, 0)
+              , m_skipped(util::MetricsRegistry::instance().counter("md.trades_replayed")) {
+        }
+
+        TradePublisher(const TradePublisher &) = delete;
+
+        TradePublisher(const TradePublisher &&) = delete;
+
+        TradePublisher &operator=(const TradePublisher &) = delete;
+
+        TradePublisher &operator=(const TradePublisher &&) = delete;
+
+        // Returns false if the trade was not queued, already published or dropped on a full queue.
+        bool publish(util::SymbolId symbol_id, const GeminiTrade &trade, int64_t receive_time_ns) noexcept {
+            auto &last_event_id = m_last_event_ids[symbol_id];
+            if (trade.event_id != 0 && trade.event_id <= last_event_id) [[unlikely]] {
+                m_skipped.add();
+                return false;
+            }
+            last_event_id = trade.event_id;
+            if (!m_producer.push(WsTradesMsg{
+                .price = trade.price,
+                .quantity = trade.quantity,
+                .event_id = trade.event_id,
+                .receive_time_ns = receive_time_ns,
+                .symbol_id = symbol_id,
+                .aggressor_side = trade.aggressor_side
+            })) [[unlikely]] {
+                return false;
+            }
+            if (m_consumer_wait_strategy) {
+                m_consumer_wait_strategy->notify();
+            }
+            return true;
+        }
 
-  };
-}
\ No newline at end of file
+    private:
+        util::QueueProducer<WsTradesMsg> m_producer;
+        util::WaitStrategy *m_consumer_wait_strategy;
+        std::vector<uint64_t> m_last_event_ids;
+        util::Counter m_skipped;
+    };
+}
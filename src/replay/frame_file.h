@@ -0,0 +1,185 @@
+#pragma once
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace replay {
+  // Capture file of raw market data frames. A FrameFileHeader is followed by the frames back to back, each one
+  // a FrameHeader and then `size` bytes of the frame as received. Integers are host byte order, the files
+  // are meant to be replayed on the kind of machine that recorded them.
+  struct FrameFileHeader {
+    static constexpr char Magic[8] = {'C', 'M', 'M', 'F', 'R', 'A', 'M', 'E'};
+    static constexpr uint32_t CurrentVersion = 1;
+
+    char magic[8];
+    uint32_t version;
+    uint32_t reserved;
+  };
+
+  struct FrameHeader {
+    // Wall clock receive time.
+    int64_t timestamp_ns;
+    uint32_t size;
+    uint32_t reserved;
+  };
+
+  static_assert(sizeof(FrameFileHeader) == 16);
+  static_assert(sizeof(FrameHeader) == 16);
+
+  inline int64_t wallClockNanos() noexcept {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::system_clock::now().time_since_epoch()).count();
+  }
+
+  // Appends frames to a capture file through a large stdio buffer, so recording costs a memcpy per frame
+  // and a write() every `buffer_size` bytes on the thread that receives the frames.
+  class FrameWriter {
+  public:
+    explicit FrameWriter(const std::string &path, size_t buffer_size = 1 << 20) : buffer_(buffer_size) {
+      file_ = std::fopen(path.c_str(), "wb");
+      if (!file_) {
+        throw std::runtime_error("FrameWriter: cannot open " + path + ": " + std::strerror(errno));
+      }
+      std::setvbuf(file_, buffer_.data(), _IOFBF, buffer_.size());
+      FrameFileHeader header{};
+      std::memcpy(header.magic, FrameFileHeader::Magic, sizeof(header.magic));
+      header.version = FrameFileHeader::CurrentVersion;
+      std::fwrite(&header, sizeof(header), 1, file_);
+    }
+
+    ~FrameWriter() {
+      close();
+    }
+
+    FrameWriter(const FrameWriter &) = delete;
+
+    FrameWriter(const FrameWriter &&) = delete;
+
+    FrameWriter &operator=(const FrameWriter &) = delete;
+
+    FrameWriter &operator=(const FrameWriter &&) = delete;
+
+    bool write(int64_t timestamp_ns, std::string_view frame) noexcept {
+      const FrameHeader header{.timestamp_ns = timestamp_ns, .size = static_cast<uint32_t>(frame.size()),
+                               .reserved = 0};
+      if (std::fwrite(&header, sizeof(header), 1, file_) != 1 ||
+          std::fwrite(frame.data(), 1, frame.size(), file_) != frame.size()) [[unlikely]] {
+        return false;
+      }
+      ++frames_;
+      return true;
+    }
+
+    void flush() noexcept {
+      std::fflush(file_);
+    }
+
+    void close() noexcept {
+      if (file_) {
+        std::fclose(file_);
+        file_ = nullptr;
+      }
+    }
+
+    uint64_t frames() const noexcept {
+      return frames_;
+    }
+
+  private:
+    std::vector<char> buffer_;
+    FILE *file_{nullptr};
+    uint64_t frames_{0};
+  };
+
+  struct Frame {
+    int64_t timestamp_ns{};
+    std::string_view data;
+  };
+
+  // Maps a capture file and hands out its frames in order, the views point into the mapping and stay valid
+  // for the reader's lifetime. A frame cut short at the end of the file (recorder killed mid write) is
+  // treated as the end.
+  class FrameReader {
+  public:
+    explicit FrameReader(const std::string &path) {
+      const int fd = ::open(path.c_str(), O_RDONLY);
+      if (fd < 0) {
+        throw std::runtime_error("FrameReader: cannot open " + path + ": " + std::strerror(errno));
+      }
+      struct stat st{};
+      if (::fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < sizeof(FrameFileHeader)) {
+        ::close(fd);
+        throw std::runtime_error("FrameReader: " + path + " is not a frame file");
+      }
+      size_ = static_cast<size_t>(st.st_size);
+      void *data = ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+      ::close(fd);
+      if (data == MAP_FAILED) {
+        throw std::runtime_error("FrameReader: cannot map " + path + ": " + std::strerror(errno));
+      }
+      data_ = static_cast<const char *>(data);
+      ::madvise(data, size_, MADV_SEQUENTIAL);
+
+      FrameFileHeader header;
+      std::memcpy(&header, data_, sizeof(header));
+      if (std::memcmp(header.magic, FrameFileHeader::Magic, sizeof(header.magic)) != 0 ||
+          header.version != FrameFileHeader::CurrentVersion) {
+        ::munmap(const_cast<char *>(data_), size_);
+        throw std::runtime_error("FrameReader: " + path + " is not a frame file");
+      }
+      rewind();
+    }
+
+    ~FrameReader() {
+      ::munmap(const_cast<char *>(data_), size_);
+    }
+
+    FrameReader(const FrameReader &) = delete;
+
+    FrameReader(const FrameReader &&) = delete;
+
+    FrameReader &operator=(const FrameReader &) = delete;
+
+    FrameReader &operator=(const FrameReader &&) = delete;
+
+    bool next(Frame &frame) noexcept {
+      if (size_ - offset_ < sizeof(FrameHeader)) {
+        return false;
+      }
+      FrameHeader header;
+      std::memcpy(&header, data_ + offset_, sizeof(header));
+      if (size_ - offset_ - sizeof(FrameHeader) < header.size) [[unlikely]] {
+        return false;
+      }
+      frame.timestamp_ns = header.timestamp_ns;
+      frame.data = std::string_view(data_ + offset_ + sizeof(FrameHeader), header.size);
+      offset_ += sizeof(FrameHeader) + header.size;
+      return true;
+    }
+
+    void rewind() noexcept {
+      offset_ = sizeof(FrameFileHeader);
+    }
+
+    size_t sizeBytes() const noexcept {
+      return size_;
+    }
+
+  private:
+    const char *data_{nullptr};
+    size_t size_{0};
+    size_t offset_{0};
+  };
+}
@@ -0,0 +1,96 @@
+#pragma once
+
+#include <bit>
+#include <cstdint>
+
+#include "../client/ws_order_entry_client.h"
+#include "../util/spsc_queue.h"
+
+namespace replay {
+  // Stands in for WsOrderEntryClient when nothing may leave the process: every request is answered right
+  // away, news are acknowledged with exchange order ids counting up from 1 and cancels are confirmed.
+  class MockOrderGateway {
+  public:
+    using ReqMsg = client::WsOrderEntryClient::WsOrderEntryReqMsg;
+    using ResMsg = client::WsOrderEntryClient::WsOrderEntryResMsg;
+
+    MockOrderGateway(util::SpscQueue<ReqMsg> &request_queue, util::SpscQueue<ResMsg> &response_queue)
+      : request_queue_(request_queue), response_queue_(response_queue) {
+    }
+
+    MockOrderGateway(const MockOrderGateway &) = delete;
+
+    MockOrderGateway(const MockOrderGateway &&) = delete;
+
+    MockOrderGateway &operator=(const MockOrderGateway &) = delete;
+
+    MockOrderGateway &operator=(const MockOrderGateway &&) = delete;
+
+    // Answers the requests waiting on the queue, as many as the response queue takes, returns how many.
+    size_t process() noexcept {
+      size_t processed = 0;
+      ReqMsg request;
+      // Requests wait in their queue while the engine hasn't made room for more responses, none is lost.
+      while (response_queue_.size() < response_queue_.capacity() && request_queue_.pop(request)) {
+        accumulate(request);
+        ResMsg response;
+        response.side = request.side;
+        response.symbol_id = request.symbol_id;
+        response.client_order_id = request.client_order_id;
+        if (request.type == ReqMsg::RequestType::NEW_ORDER) {
+          response.status = ResMsg::OrdStatus::NEW;
+          response.order_id = ++next_order_id_;
+          response.leaves_qty = request.quantity;
+          ++new_orders_;
+        } else {
+          response.status = ResMsg::OrdStatus::CANCELED;
+          response.order_id = request.order_id;
+          ++cancels_;
+        }
+        response_queue_.push(response);
+        ++processed;
+      }
+      return processed;
+    }
+
+    uint64_t newOrders() const noexcept {
+      return new_orders_;
+    }
+
+    uint64_t cancels() const noexcept {
+      return cancels_;
+    }
+
+    // Digest of every request seen so far. Replaying the same capture with the same code and parameters has
+    // to give the same value, so it makes a cheap regression check.
+    uint64_t checksum() const noexcept {
+      return checksum_;
+    }
+
+  private:
+    void accumulate(const ReqMsg &request) noexcept {
+      mix(static_cast<uint64_t>(request.type));
+      mix(static_cast<uint64_t>(request.side));
+      mix(request.symbol_id);
+      mix(static_cast<uint64_t>(request.price.fixed()));
+      mix(static_cast<uint64_t>(request.quantity.fixed()));
+      mix(request.order_id);
+      mix(request.client_order_id);
+    }
+
+    // FNV-1a over the value's eight bytes.
+    void mix(uint64_t value) noexcept {
+      for (int i = 0; i < 8; ++i) {
+        checksum_ = (checksum_ ^ (value & 0xff)) * 1099511628211ull;
+        value >>= 8;
+      }
+    }
+
+    util::SpscQueue<ReqMsg> &request_queue_;
+    util::SpscQueue<ResMsg> &response_queue_;
+    uint64_t next_order_id_{0};
+    uint64_t new_orders_{0};
+    uint64_t cancels_{0};
+    uint64_t checksum_{14695981039346656037ull};
+  };
+}
@@ -0,0 +1,143 @@
+#pragma once
+
+#include <chrono>
+#include <thread>
+
+#include "frame_file.h"
+#include "mock_order_gateway.h"
+#include "../client/l2_book_builder.h"
+#include "../trading/feature_engine.h"
+#include "../trading/market_maker.h"
+#include "../trading/order_manager.h"
+#include "../trading/trading_engine.h"
+#include "../util/symbol_table.h"
+
+namespace replay {
+  struct ReplayConfig {
+    // Keep the recorded gaps between frames (divided by `speed`) instead of replaying as fast as possible.
+    bool real_time{false};
+    double speed{1.0};
+    book::OrderBookConfig book{};
+    trading::OrderManagerConfig order_manager{};
+    size_t queue_capacity{1024};
+  };
+
+  struct ReplayStats {
+    uint64_t frames{0};
+    uint64_t bytes{0};
+    uint64_t book_updates{0};
+    uint64_t trades{0};
+    uint64_t new_orders{0};
+    uint64_t cancels{0};
+    uint64_t checksum{0};
+    int64_t elapsed_ns{0};
+
+    double nanosPerFrame() const noexcept {
+      return frames ? static_cast<double>(elapsed_ns) / static_cast<double>(frames) : 0.0;
+    }
+
+    double framesPerSecond() const noexcept {
+      return elapsed_ns ? static_cast<double>(frames) * 1e9 / static_cast<double>(elapsed_ns) : 0.0;
+    }
+  };
+
+  // Feeds a capture through the production pipeline on the calling thread: L2BookBuilder, then TradingEngine
+  // with its FeatureEngine, MarketMaker and OrderManager, with a MockOrderGateway answering the orders. Each
+  // frame is processed until the pipeline is quiet again, so the outcome only depends on the capture and
+  // the configuration.
+  class ReplayDriver {
+  public:
+    using Config = ReplayConfig;
+
+    explicit ReplayDriver(const util::SymbolTable &symbols, const Config &config = Config{})
+      : config_(config)
+        , book_updates_(symbols.size())
+        , trades_(config.queue_capacity)
+        , order_entry_req_queue_(config.queue_capacity)
+        , order_entry_res_queue_(config.queue_capacity)
+        , book_builder_(symbols, book_updates_, nullptr, config.book)
+        , feature_engine_(symbols.size())
+        , order_manager_(order_entry_req_queue_, symbols.size(), config.order_manager)
+        , market_maker_(order_manager_, feature_engine_)
+        , trading_engine_(feature_engine_, order_manager_, market_maker_, book_updates_,
+                          order_entry_res_queue_)
+        , gateway_(order_entry_req_queue_, order_entry_res_queue_) {
+      for (util::SymbolId id = 0; id < symbols.size(); ++id) {
+        order_manager_.setSymbolSpec(id, symbols.spec(id));
+      }
+      book_builder_.set_trade_queue(trades_);
+      trading_engine_.setIncomingTrades(&trades_);
+    }
+
+    ReplayDriver(const ReplayDriver &) = delete;
+
+    ReplayDriver(const ReplayDriver &&) = delete;
+
+    ReplayDriver &operator=(const ReplayDriver &) = delete;
+
+    ReplayDriver &operator=(const ReplayDriver &&) = delete;
+
+    ReplayStats run(FrameReader &reader) {
+      ReplayStats stats;
+      Frame frame;
+      int64_t first_timestamp = 0;
+      const auto start = std::chrono::steady_clock::now();
+      while (reader.next(frame)) {
+        if (config_.real_time) {
+          if (stats.frames == 0) {
+            first_timestamp = frame.timestamp_ns;
+          }
+          const auto offset = static_cast<double>(frame.timestamp_ns - first_timestamp) / config_.speed;
+          std::this_thread::sleep_until(start + std::chrono::nanoseconds(static_cast<int64_t>(offset)));
+        }
+        ++stats.frames;
+        stats.bytes += frame.data.size();
+        const auto type = book_builder_.on_message(frame.data, frame.timestamp_ns);
+        if (type == client::GeminiMarketDataParser::MessageType::L2_UPDATES) {
+          ++stats.book_updates;
+        } else if (type == client::GeminiMarketDataParser::MessageType::TRADE) {
+          ++stats.trades;
+        }
+        order_manager_.onTimer(frame.timestamp_ns);
+        while (trading_engine_.processPending() + gateway_.process() != 0) {
+        }
+      }
+      stats.elapsed_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - start).count();
+      stats.new_orders = gateway_.newOrders();
+      stats.cancels = gateway_.cancels();
+      stats.checksum = gateway_.checksum();
+      return stats;
+    }
+
+    // Records the replayed market data, e.g. to backfill a tick store from captures.
+    void setTickStore(store::TickStoreWriter *tick_store) noexcept {
+      book_builder_.set_tick_store(tick_store);
+    }
+
+    const client::L2BookBuilder &bookBuilder() const noexcept {
+      return book_builder_;
+    }
+
+    const trading::FeatureEngine &featureEngine() const noexcept {
+      return feature_engine_;
+    }
+
+    const trading::OrderManager &orderManager() const noexcept {
+      return order_manager_;
+    }
+
+  private:
+    const Config config_;
+    util::LatestValueSlots<client::WsBestBidBestAskMsg> book_updates_;
+    util::SpscQueue<client::WsTradesMsg> trades_;
+    util::SpscQueue<client::WsOrderEntryClient::WsOrderEntryReqMsg> order_entry_req_queue_;
+    util::SpscQueue<client::WsOrderEntryClient::WsOrderEntryResMsg> order_entry_res_queue_;
+    client::L2BookBuilder book_builder_;
+    trading::FeatureEngine feature_engine_;
+    trading::OrderManager order_manager_;
+    trading::MarketMaker market_maker_;
+    trading::TradingEngine trading_engine_;
+    MockOrderGateway gateway_;
+  };
+}
@@ -0,0 +1,209 @@
+#pragma once
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+
+namespace store {
+  // A column file is a ColumnHeader followed by `rows` values of one trivially copyable type. The file is grown
+  // in chunks ahead of the data, `rows` is only bumped after the values it covers are written, so a reader
+  // (or a restart after a crash) never sees more than what was completely appended.
+  struct ColumnHeader {
+    static constexpr char Magic[8] = {'C', 'M', 'M', 'C', 'O', 'L', 'U', 'M'};
+    static constexpr uint32_t CurrentVersion = 1;
+
+    char magic[8];
+    uint32_t version;
+    uint32_t value_size;
+    std::atomic<uint64_t> rows;
+    char reserved[40];
+  };
+
+  static_assert(sizeof(ColumnHeader) == 64);
+  static_assert(std::atomic<uint64_t>::is_always_lock_free);
+
+  namespace detail {
+    inline std::runtime_error columnError(const std::string &what, const std::string &path) {
+      return std::runtime_error("column " + path + ": " + what + (errno ? std::string(": ") + std::strerror(errno)
+                                                                          : std::string()));
+    }
+
+    inline bool validHeader(const ColumnHeader &header, size_t value_size) noexcept {
+      return std::memcmp(header.magic, ColumnHeader::Magic, sizeof(header.magic)) == 0 &&
+             header.version == ColumnHeader::CurrentVersion && header.value_size == value_size;
+    }
+  }
+
+  // Appends values to a memory mapped column file, reopening an existing file continues after its last row.
+  template<typename T>
+  class ColumnWriter {
+    static_assert(std::is_trivially_copyable_v<T>);
+
+  public:
+    ColumnWriter(const std::string &path, size_t grow_rows) : path_(path), grow_rows_(grow_rows) {
+      errno = 0;
+      fd_ = ::open(path.c_str(), O_RDWR | O_CREAT, 0644);
+      if (fd_ < 0) {
+        throw detail::columnError("cannot open", path);
+      }
+      try {
+        struct stat st{};
+        ::fstat(fd_, &st);
+        const bool fresh = st.st_size == 0;
+        if (!fresh && static_cast<size_t>(st.st_size) < sizeof(ColumnHeader)) {
+          throw detail::columnError("truncated header", path);
+        }
+        map(fresh ? grow_rows_ : (static_cast<size_t>(st.st_size) - sizeof(ColumnHeader)) / sizeof(T));
+        if (fresh) {
+          std::memcpy(header_->magic, ColumnHeader::Magic, sizeof(header_->magic));
+          header_->version = ColumnHeader::CurrentVersion;
+          header_->value_size = sizeof(T);
+          header_->rows.store(0, std::memory_order::relaxed);
+        } else if (!detail::validHeader(*header_, sizeof(T))) {
+          throw detail::columnError("not a column of this type", path);
+        }
+      } catch (...) {
+        unmap();
+        ::close(fd_);
+        throw;
+      }
+      rows_ = header_->rows.load(std::memory_order::relaxed);
+    }
+
+    ~ColumnWriter() {
+      commit();
+      unmap();
+      ::close(fd_);
+    }
+
+    ColumnWriter(const ColumnWriter &) = delete;
+
+    ColumnWriter(const ColumnWriter &&) = delete;
+
+    ColumnWriter &operator=(const ColumnWriter &) = delete;
+
+    ColumnWriter &operator=(const ColumnWriter &&) = delete;
+
+    void append(const T &value) {
+      if (rows_ == capacity_) [[unlikely]] {
+        map(capacity_ + grow_rows_);
+      }
+      values_[rows_++] = value;
+    }
+
+    // Publishes everything appended so far.
+    void commit() noexcept {
+      if (header_) {
+        header_->rows.store(rows_, std::memory_order::release);
+      }
+    }
+
+    uint64_t rows() const noexcept {
+      return rows_;
+    }
+
+  private:
+    // Maps the file grown to `capacity` rows. The current mapping is only replaced once the new one is in
+    // place, a failure leaves the writer as it was.
+    void map(size_t capacity) {
+      const auto size = sizeof(ColumnHeader) + capacity * sizeof(T);
+      errno = 0;
+      if (::ftruncate(fd_, static_cast<off_t>(size)) != 0) {
+        throw detail::columnError("cannot grow", path_);
+      }
+      void *data = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0);
+      if (data == MAP_FAILED) {
+        throw detail::columnError("cannot map", path_);
+      }
+      unmap();
+      mapped_size_ = size;
+      capacity_ = capacity;
+      header_ = static_cast<ColumnHeader *>(data);
+      values_ = reinterpret_cast<T *>(static_cast<char *>(data) + sizeof(ColumnHeader));
+    }
+
+    void unmap() noexcept {
+      if (header_) {
+        ::munmap(header_, mapped_size_);
+        header_ = nullptr;
+      }
+    }
+
+    std::string path_;
+    size_t grow_rows_;
+    int fd_{-1};
+    size_t mapped_size_{0};
+    size_t capacity_{0};
+    uint64_t rows_{0};
+    ColumnHeader *header_{nullptr};
+    T *values_{nullptr};
+  };
+
+  // Read only mapping of a column file, values() covers the rows committed when it was opened.
+  template<typename T>
+  class ColumnReader {
+    static_assert(std::is_trivially_copyable_v<T>);
+
+  public:
+    explicit ColumnReader(const std::string &path) {
+      errno = 0;
+      const int fd = ::open(path.c_str(), O_RDONLY);
+      if (fd < 0) {
+        throw detail::columnError("cannot open", path);
+      }
+      struct stat st{};
+      if (::fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < sizeof(ColumnHeader)) {
+        ::close(fd);
+        throw detail::columnError("truncated header", path);
+      }
+      mapped_size_ = static_cast<size_t>(st.st_size);
+      void *data = ::mmap(nullptr, mapped_size_, PROT_READ, MAP_SHARED, fd, 0);
+      ::close(fd);
+      if (data == MAP_FAILED) {
+        throw detail::columnError("cannot map", path);
+      }
+      data_ = data;
+      const auto *header = static_cast<const ColumnHeader *>(data);
+      if (!detail::validHeader(*header, sizeof(T))) {
+        ::munmap(data_, mapped_size_);
+        throw detail::columnError("not a column of this type", path);
+      }
+      const auto rows = std::min<uint64_t>(header->rows.load(std::memory_order::acquire),
+                                           (mapped_size_ - sizeof(ColumnHeader)) / sizeof(T));
+      values_ = std::span<const T>(
+        reinterpret_cast<const T *>(static_cast<const char *>(data) + sizeof(ColumnHeader)), rows);
+    }
+
+    ~ColumnReader() {
+      ::munmap(data_, mapped_size_);
+    }
+
+    ColumnReader(const ColumnReader &) = delete;
+
+    ColumnReader(const ColumnReader &&) = delete;
+
+    ColumnReader &operator=(const ColumnReader &) = delete;
+
+    ColumnReader &operator=(const ColumnReader &&) = delete;
+
+    std::span<const T> values() const noexcept {
+      return values_;
+    }
+
+  private:
+    void *data_{nullptr};
+    size_t mapped_size_{0};
+    std::span<const T> values_;
+  };
+}
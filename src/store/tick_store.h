@@ -0,0 +1,392 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <memory>
+#include <optional>
+#include <span>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "column_file.h"
+#include "../client/types.h"
+#include "../util/logger.h"
+#include "../util/spsc_queue.h"
+#include "../util/symbol_table.h"
+#include "../util/thread_utils.h"
+#include "../util/wait_strategy.h"
+
+namespace store {
+  // Recorded market data lives under <root>/<YYYYMMDD>/<symbol>/ with one directory per UTC day and symbol and
+  // one file per column: <stream>.<column>. Prices and quantities are util::FixedPointScale fixed-point, times
+  // are wall clock nanoseconds, every column of a stream has one value per row.
+  enum class Stream : uint8_t {
+    L2_DELTAS, // timestamp, side, price, quantity of each l2 change, quantity 0 removes the level
+    BBO, // timestamp, bid_price, bid_quantity, ask_price, ask_quantity after each l2 update
+    TRADES // timestamp, side (taker), price, quantity
+  };
+
+  inline constexpr std::array<const char *, 3> StreamNames{"l2", "bbo", "trades"};
+
+  // Every IndexStride-th row of a stream is also written to its <stream>.index column, which is small enough
+  // to binary search first and leaves at most IndexStride timestamps to search in the big column.
+  inline constexpr uint64_t IndexStride = 1024;
+
+  struct IndexEntry {
+    int64_t timestamp_ns;
+    uint64_t row;
+  };
+
+  struct TickRecord {
+    Stream stream{Stream::L2_DELTAS};
+    client::Side side{client::Side::NONE};
+    util::SymbolId symbol_id{};
+    int64_t timestamp_ns{};
+    // L2 change / trade, or the bid for BBO.
+    int64_t price{};
+    int64_t quantity{};
+    // Ask of a BBO.
+    int64_t ask_price{};
+    int64_t ask_quantity{};
+  };
+
+  static_assert(sizeof(TickRecord) == 48);
+
+  // UTC calendar day of a timestamp as YYYYMMDD.
+  inline uint32_t utcDate(int64_t timestamp_ns) noexcept {
+    const auto days = std::chrono::floor<std::chrono::days>(
+      std::chrono::sys_time<std::chrono::nanoseconds>(std::chrono::nanoseconds(timestamp_ns)));
+    const std::chrono::year_month_day date(days);
+    return static_cast<uint32_t>(static_cast<int>(date.year()) * 10000 + static_cast<unsigned>(date.month()) * 100 +
+                                 static_cast<unsigned>(date.day()));
+  }
+
+  inline std::filesystem::path symbolDayPath(const std::filesystem::path &root, uint32_t date,
+                                             std::string_view symbol) {
+    char day[16];
+    std::snprintf(day, sizeof(day), "%08u", date);
+    return root / day / symbol;
+  }
+
+  namespace detail {
+    inline constexpr size_t columnCount(Stream stream) noexcept {
+      return stream == Stream::BBO ? 5 : 3;
+    }
+
+    inline constexpr std::array<const char *, 5> columnNames(Stream stream) noexcept {
+      if (stream == Stream::BBO) {
+        return {"timestamp", "bid_price", "bid_quantity", "ask_price", "ask_quantity"};
+      }
+      return {"timestamp", "price", "quantity", nullptr, nullptr};
+    }
+
+    inline std::string columnPath(const std::filesystem::path &dir, Stream stream, std::string_view column) {
+      return (dir / (std::string(StreamNames[static_cast<size_t>(stream)]) + "." + std::string(column))).string();
+    }
+  }
+
+  // The columns of one stream of one symbol and day.
+  class StreamWriter {
+  public:
+    StreamWriter(const std::filesystem::path &dir, Stream stream, size_t grow_rows) : stream_(stream) {
+      const auto names = detail::columnNames(stream);
+      for (size_t i = 0; i < detail::columnCount(stream); ++i) {
+        values_[i] = std::make_unique<ColumnWriter<int64_t> >(detail::columnPath(dir, stream, names[i]), grow_rows);
+      }
+      if (stream != Stream::BBO) {
+        sides_ = std::make_unique<ColumnWriter<int8_t> >(detail::columnPath(dir, stream, "side"), grow_rows);
+      }
+      index_ = std::make_unique<ColumnWriter<IndexEntry> >(detail::columnPath(dir, stream, "index"),
+                                                           std::max<size_t>(grow_rows / IndexStride, 16));
+      // After a crash columns can disagree, continue from the last row all of them have.
+      rows_ = values_[0]->rows();
+      for (size_t i = 1; i < detail::columnCount(stream); ++i) {
+        rows_ = std::min(rows_, values_[i]->rows());
+      }
+      if (sides_) {
+        rows_ = std::min(rows_, sides_->rows());
+      }
+      if (rows_ != values_[0]->rows()) {
+        LOG_WARN("StreamWriter: {} has columns of different lengths, appending after row {}", dir.string(), rows_);
+      }
+    }
+
+    void append(const TickRecord &record) {
+      if (rows_ % IndexStride == 0 && index_->rows() <= rows_ / IndexStride) {
+        index_->append(IndexEntry{record.timestamp_ns, rows_});
+      }
+      values_[0]->append(record.timestamp_ns);
+      values_[1]->append(record.price);
+      values_[2]->append(record.quantity);
+      if (stream_ == Stream::BBO) {
+        values_[3]->append(record.ask_price);
+        values_[4]->append(record.ask_quantity);
+      } else {
+        sides_->append(static_cast<int8_t>(record.side));
+      }
+      ++rows_;
+    }
+
+    void commit() noexcept {
+      for (size_t i = 0; i < detail::columnCount(stream_); ++i) {
+        values_[i]->commit();
+      }
+      if (sides_) {
+        sides_->commit();
+      }
+      index_->commit();
+    }
+
+  private:
+    Stream stream_;
+    std::array<std::unique_ptr<ColumnWriter<int64_t> >, 5> values_;
+    std::unique_ptr<ColumnWriter<int8_t> > sides_;
+    std::unique_ptr<ColumnWriter<IndexEntry> > index_;
+    uint64_t rows_{0};
+  };
+
+  struct TickStoreConfig {
+    std::filesystem::path root{"ticks"};
+    size_t queue_capacity{1 << 16};
+    // Records written between two commits of the columns.
+    size_t max_batch{4096};
+    // Columns grow by this many rows at a time.
+    size_t grow_rows{1 << 16};
+    util::WaitStrategyType wait_strategy{util::WaitStrategyType::SPIN_PARK};
+    // The writer belongs on a housekeeping CPU, negative means no pinning.
+    int cpu_id{-1};
+  };
+
+  // Persists ticks without slowing their producer down: append() is a push onto an SPSC queue, a writer thread
+  // drains it in batches into the column files and commits once per batch. A full queue drops the record
+  // and counts it, it never blocks. One producer thread only.
+  class TickStoreWriter {
+  public:
+    using Config = TickStoreConfig;
+
+    TickStoreWriter(const util::SymbolTable &symbols, const Config &config = Config{})
+      : symbols_(symbols), config_(config), queue_(config.queue_capacity), wait_strategy_(config.wait_strategy),
+        symbol_days_(symbols.size()), batch_(config.max_batch) {
+    }
+
+    ~TickStoreWriter() {
+      stop();
+    }
+
+    TickStoreWriter(const TickStoreWriter &) = delete;
+
+    TickStoreWriter(const TickStoreWriter &&) = delete;
+
+    TickStoreWriter &operator=(const TickStoreWriter &) = delete;
+
+    TickStoreWriter &operator=(const TickStoreWriter &&) = delete;
+
+    void start() {
+      run_ = true;
+      thread_ = std::thread(&TickStoreWriter::process, this);
+    }
+
+    // Writes out whatever is still queued, then closes the files.
+    void stop() {
+      run_ = false;
+      wait_strategy_.wake();
+      if (thread_.joinable()) {
+        thread_.join();
+      }
+    }
+
+    bool append(const TickRecord &record) noexcept {
+      if (!queue_.push(record)) [[unlikely]] {
+        dropped_.fetch_add(1, std::memory_order::relaxed);
+        return false;
+      }
+      wait_strategy_.notify();
+      return true;
+    }
+
+    bool appendL2Delta(util::SymbolId symbol_id, int64_t timestamp_ns, client::Side side, util::Price price,
+                       util::Qty quantity) noexcept {
+      return append(TickRecord{.stream = Stream::L2_DELTAS, .side = side, .symbol_id = symbol_id,
+                               .timestamp_ns = timestamp_ns, .price = price.fixed(), .quantity = quantity.fixed()});
+    }
+
+    bool appendBbo(util::SymbolId symbol_id, int64_t timestamp_ns, util::Price bid_price, util::Qty bid_quantity,
+                   util::Price ask_price, util::Qty ask_quantity) noexcept {
+      return append(TickRecord{.stream = Stream::BBO, .symbol_id = symbol_id, .timestamp_ns = timestamp_ns,
+                               .price = bid_price.fixed(), .quantity = bid_quantity.fixed(),
+                               .ask_price = ask_price.fixed(), .ask_quantity = ask_quantity.fixed()});
+    }
+
+    bool appendTrade(util::SymbolId symbol_id, int64_t timestamp_ns, client::Side side, util::Price price,
+                     util::Qty quantity) noexcept {
+      return append(TickRecord{.stream = Stream::TRADES, .side = side, .symbol_id = symbol_id,
+                               .timestamp_ns = timestamp_ns, .price = price.fixed(), .quantity = quantity.fixed()});
+    }
+
+    uint64_t dropped() const noexcept {
+      return dropped_.load(std::memory_order::relaxed);
+    }
+
+    uint64_t written() const noexcept {
+      return written_.load(std::memory_order::relaxed);
+    }
+
+  private:
+    struct SymbolDay {
+      uint32_t date{0};
+      std::array<std::unique_ptr<StreamWriter>, 3> streams;
+    };
+
+    void process() {
+      if (config_.cpu_id >= 0 && !util::pinCurrentThreadToCpu(config_.cpu_id)) {
+        LOG_WARN("TickStoreWriter: failed to pin to cpu {}", config_.cpu_id);
+      }
+      for (;;) {
+        const auto count = queue_.pop_n(batch_.data(), batch_.size());
+        if (count == 0) {
+          if (!run_.load(std::memory_order::relaxed)) {
+            break;
+          }
+          wait_strategy_.idle([this] { return !run_.load(std::memory_order::relaxed) || !queue_.empty(); });
+          continue;
+        }
+        wait_strategy_.reset();
+        for (size_t i = 0; i < count; ++i) {
+          write(batch_[i]);
+        }
+        commit();
+        written_.fetch_add(count, std::memory_order::relaxed);
+      }
+      commit();
+      symbol_days_.clear();
+    }
+
+    void write(const TickRecord &record) {
+      if (record.symbol_id >= symbol_days_.size()) [[unlikely]] {
+        return;
+      }
+      auto &symbol_day = symbol_days_[record.symbol_id];
+      const auto date = utcDate(record.timestamp_ns);
+      if (symbol_day.date != date) [[unlikely]] {
+        symbol_day.streams = {};
+        symbol_day.date = date;
+      }
+      auto &stream = symbol_day.streams[static_cast<size_t>(record.stream)];
+      if (!stream) [[unlikely]] {
+        const auto dir = symbolDayPath(config_.root, date, symbols_.name(record.symbol_id));
+        try {
+          std::filesystem::create_directories(dir);
+          stream = std::make_unique<StreamWriter>(dir, record.stream, config_.grow_rows);
+        } catch (const std::exception &e) {
+          LOG_ERROR("TickStoreWriter: {}", e.what());
+          return;
+        }
+      }
+      stream->append(record);
+    }
+
+    void commit() noexcept {
+      for (auto &symbol_day: symbol_days_) {
+        for (auto &stream: symbol_day.streams) {
+          if (stream) {
+            stream->commit();
+          }
+        }
+      }
+    }
+
+    const util::SymbolTable &symbols_;
+    const Config config_;
+    util::SpscQueue<TickRecord> queue_;
+    util::WaitStrategy wait_strategy_;
+    std::atomic<bool> run_{false};
+    std::thread thread_;
+    std::atomic<uint64_t> dropped_{0};
+    std::atomic<uint64_t> written_{0};
+    std::vector<SymbolDay> symbol_days_;
+    std::vector<TickRecord> batch_;
+  };
+
+  // Zero copy view of one stream of one symbol and day, every span has rows() values.
+  class StreamReader {
+  public:
+    StreamReader(const std::filesystem::path &dir, Stream stream) {
+      const auto names = detail::columnNames(stream);
+      for (size_t i = 0; i < detail::columnCount(stream); ++i) {
+        values_[i].emplace(detail::columnPath(dir, stream, names[i]));
+        rows_ = i == 0 ? values_[i]->values().size() : std::min(rows_, values_[i]->values().size());
+      }
+      if (stream != Stream::BBO) {
+        sides_.emplace(detail::columnPath(dir, stream, "side"));
+        rows_ = std::min(rows_, sides_->values().size());
+      }
+      index_.emplace(detail::columnPath(dir, stream, "index"));
+    }
+
+    size_t rows() const noexcept {
+      return rows_;
+    }
+
+    std::span<const int64_t> timestamps() const noexcept {
+      return column(0);
+    }
+
+    // Price / quantity for l2 and trades, bid price / bid quantity for BBO.
+    std::span<const int64_t> prices() const noexcept {
+      return column(1);
+    }
+
+    std::span<const int64_t> quantities() const noexcept {
+      return column(2);
+    }
+
+    // BBO only.
+    std::span<const int64_t> askPrices() const noexcept {
+      return column(3);
+    }
+
+    std::span<const int64_t> askQuantities() const noexcept {
+      return column(4);
+    }
+
+    // L2 and trades only, client::Side values.
+    std::span<const int8_t> sides() const noexcept {
+      return sides_ ? sides_->values().first(rows_) : std::span<const int8_t>();
+    }
+
+    // First row at or after `timestamp_ns`: binary search of the sparse index, then of one IndexStride block.
+    size_t seek(int64_t timestamp_ns) const noexcept {
+      const auto index = index_->values();
+      const auto entry = std::upper_bound(index.begin(), index.end(), timestamp_ns,
+                                          [](int64_t ts, const IndexEntry &e) { return ts <= e.timestamp_ns; });
+      const auto from = entry == index.begin() ? 0 : std::min<size_t>((entry - 1)->row, rows_);
+      const auto to = entry == index.end() ? rows_ : std::min<size_t>(entry->row, rows_);
+      const auto ts = timestamps();
+      return static_cast<size_t>(std::lower_bound(ts.begin() + static_cast<std::ptrdiff_t>(from),
+                                                  ts.begin() + static_cast<std::ptrdiff_t>(to), timestamp_ns) -
+                                 ts.begin());
+    }
+
+  private:
+    std::span<const int64_t> column(size_t i) const noexcept {
+      return values_[i] ? values_[i]->values().first(rows_) : std::span<const int64_t>();
+    }
+
+    std::array<std::optional<ColumnReader<int64_t> >, 5> values_;
+    std::optional<ColumnReader<int8_t> > sides_;
+    std::optional<ColumnReader<IndexEntry> > index_;
+    size_t rows_{0};
+  };
+
+  // Opens a stream written by TickStoreWriter, throws if it does not exist.
+  inline StreamReader openStream(const std::filesystem::path &root, uint32_t date, std::string_view symbol,
+                                 Stream stream) {
+    return StreamReader(symbolDayPath(root, date, symbol), stream);
+  }
+}
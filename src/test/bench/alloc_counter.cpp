@@ -0,0 +1,57 @@
+#include "alloc_counter.h"
+
+#include <cstdlib>
+#include <new>
+
+namespace {
+  thread_local size_t allocations = 0;
+  thread_local int active_counters = 0;
+
+  void *allocate(std::size_t size) {
+    if (active_counters) {
+      ++allocations;
+    }
+    if (auto *ptr = std::malloc(size ? size : 1)) {
+      return ptr;
+    }
+    throw std::bad_alloc();
+  }
+}
+
+void *operator new(std::size_t size) {
+  return allocate(size);
+}
+
+void *operator new[](std::size_t size) {
+  return allocate(size);
+}
+
+void operator delete(void *ptr) noexcept {
+  std::free(ptr);
+}
+
+void operator delete[](void *ptr) noexcept {
+  std::free(ptr);
+}
+
+void operator delete(void *ptr, std::size_t) noexcept {
+  std::free(ptr);
+}
+
+void operator delete[](void *ptr, std::size_t) noexcept {
+  std::free(ptr);
+}
+
+namespace bench {
+  AllocationCounter::AllocationCounter() : start_(allocations) {
+    ++active_counters;
+  }
+
+  AllocationCounter::~AllocationCounter() {
+    --active_counters;
+  }
+
+  size_t AllocationCounter::count() const {
+    return allocations - start_;
+  }
+}
@@ -0,0 +1,22 @@
+#pragma once
+
+#include <cstddef>
+
+namespace bench {
+  // Counts global operator new calls made by the current thread while a scope is active.
+  // The replacement operators live in alloc_counter.cpp.
+  struct AllocationCounter {
+    AllocationCounter();
+
+    ~AllocationCounter();
+
+    size_t count() const;
+
+    AllocationCounter(const AllocationCounter &) = delete;
+
+    AllocationCounter &operator=(const AllocationCounter &) = delete;
+
+  private:
+    size_t start_;
+  };
+}
@@ -0,0 +1,137 @@
+#include <unistd.h>
+
+#include <algorithm>
+#include <array>
+#include <cstdio>
+#include <filesystem>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "bench.h"
+#include "l2_corpus.h"
+#include "../../backtest/backtester.h"
+#include "../../book/order_book.h"
+#include "../../store/tick_store.h"
+#include "../../util/decimal.h"
+
+namespace {
+  using namespace util::literals;
+
+  // 2024-03-01T00:00:00Z
+  constexpr int64_t Day = 1709251200'000'000'000;
+
+  // One day of the corpus into a tick store at root. A top level taken out of the corpus book is recorded as a
+  // trade against it.
+  void writeDay(const std::filesystem::path &root, const std::vector<bench::L2Change> &changes) {
+    const util::SymbolTable symbols{"BTCGUSDPERP"};
+    const auto spacing = 86'400'000'000'000 / static_cast<int64_t>(changes.size());
+    store::TickStoreWriter writer(symbols, store::TickStoreConfig{.root = root, .grow_rows = 1 << 20});
+    writer.start();
+    book::OrderBook book(book::OrderBookConfig{.tick_size = 0.5_px});
+    for (size_t i = 0; i < changes.size(); ++i) {
+      const auto &change = changes[i];
+      const auto timestamp = Day + static_cast<int64_t>(i) * spacing;
+      const auto price = util::Price::fromDouble(change.price);
+      const auto quantity = util::Qty::fromDouble(change.quantity);
+      const auto price_ticks = book.toTicks(price);
+      const bool bid = change.side == client::Side::BID;
+      if (quantity.isZero() && (bid ? book.hasBid() && book.bestBid().price_ticks == price_ticks
+                                         : book.hasAsk() && book.bestAsk().price_ticks == price_ticks)) {
+        const auto taken = bid ? book.bestBid().quantity : book.bestAsk().quantity;
+        while (!writer.appendTrade(0, timestamp, bid ? client::Side::ASK : client::Side::BID,
+                                   price, taken)) {
+          std::this_thread::yield();
+        }
+      }
+      book.update(change.side, price_ticks, quantity);
+      while (!writer.appendL2Delta(0, timestamp, change.side, price, quantity)) {
+        std::this_thread::yield();
+      }
+    }
+    writer.stop();
+  }
+}
+
+BENCHMARK(BacktestDay) {
+  const auto root = std::filesystem::temp_directory_path() / ("backtest_bench." + std::to_string(::getpid()));
+  writeDay(root, bench::makeL2Corpus(bench::scaled(5'000'000)));
+  const auto l2 = store::openStream(root, store::utcDate(Day), "BTCGUSDPERP", store::Stream::L2_DELTAS);
+  const auto trades = store::openStream(root, store::utcDate(Day), "BTCGUSDPERP", store::Stream::TRADES);
+  const auto l2_columns = backtest::TickColumns::fromStream(l2);
+  const auto trade_columns = backtest::TickColumns::fromStream(trades);
+
+  {
+    backtest::Backtester backtester(l2_columns, trade_columns);
+    const auto result = backtester.run();
+    bench::printThroughput("one day, l2 deltas + trades", result.book_updates + result.trades, result.elapsed_ns);
+    std::printf("%-48s %lu new orders, %lu cancels, %lu fills, position %.1f, pnl %.2f\n", "", result.new_orders,
+                result.cancels, result.fills, result.position, result.pnl);
+  }
+  {
+    // A small latency sweep, one backtest per core.
+    std::vector<backtest::BacktestConfig> configs(8);
+    for (size_t i = 0; i < configs.size(); ++i) {
+      configs[i].exchange.request_latency_ns = static_cast<int64_t>(i + 1) * 500'000;
+      configs[i].exchange.response_latency_ns = static_cast<int64_t>(i + 1) * 500'000;
+    }
+    const auto start = bench::nowNanos();
+    const auto results = backtest::runBacktests(l2_columns, trade_columns, configs);
+    const auto elapsed = bench::nowNanos() - start;
+    uint64_t ticks = 0;
+    for (const auto &result: results) {
+      ticks += result.book_updates + result.trades;
+    }
+    bench::printThroughput("8 parameter sets, all cores", ticks, elapsed);
+    for (size_t i = 0; i < results.size(); ++i) {
+      std::printf("%-48s latency %.1f ms: %lu fills, pnl %.2f\n", "",
+                  static_cast<double>(configs[i].exchange.request_latency_ns) / 1e6, results[i].fills,
+                  results[i].pnl);
+    }
+  }
+  std::filesystem::remove_all(root);
+}
+
+// Tick to wire of the re-quotes on a replayed day, per RequoteMode and exchange latency: how many requests a
+// price move costs and how long a moved level waits in simulated time until its new order goes out. Requests
+// include the re-quotes of filled orders, which are no price move.
+BENCHMARK(RequoteTickToWire) {
+  const auto root = std::filesystem::temp_directory_path() / ("requote_bench." + std::to_string(::getpid()));
+  writeDay(root, bench::makeL2Corpus(bench::scaled(2'000'000)));
+  const auto l2 = store::openStream(root, store::utcDate(Day), "BTCGUSDPERP", store::Stream::L2_DELTAS);
+  const auto trades = store::openStream(root, store::utcDate(Day), "BTCGUSDPERP", store::Stream::TRADES);
+  const auto l2_columns = backtest::TickColumns::fromStream(l2);
+  const auto trade_columns = backtest::TickColumns::fromStream(trades);
+
+  constexpr std::array<int64_t, 3> latencies{500'000, 2'000'000, 8'000'000};
+  std::vector<backtest::BacktestConfig> configs;
+  for (const auto mode: {trading::RequoteMode::CANCEL_THEN_NEW, trading::RequoteMode::CANCEL_REPLACE}) {
+    for (const auto latency: latencies) {
+      auto &config = configs.emplace_back();
+      config.order_manager.requote_mode = mode;
+      config.exchange.request_latency_ns = latency;
+      config.exchange.response_latency_ns = latency;
+    }
+  }
+  const auto start = bench::nowNanos();
+  const auto results = backtest::runBacktests(l2_columns, trade_columns, configs);
+  const auto elapsed = bench::nowNanos() - start;
+  uint64_t ticks = 0;
+  for (const auto &result: results) {
+    ticks += result.book_updates + result.trades;
+  }
+  bench::printThroughput("6 backtests, all cores", ticks, elapsed);
+  for (size_t i = 0; i < results.size(); ++i) {
+    const auto &quoting = results[i].quoting;
+    const auto moves = static_cast<double>(std::max<uint64_t>(quoting.price_moves, 1));
+    const auto requotes = static_cast<double>(std::max<uint64_t>(quoting.requotes, 1));
+    std::printf("%-16s latency %.1f ms: %.2f requests/move, requote after %.2f ms mean %.2f ms max, "
+                "%lu fills, pnl %.2f\n",
+                trading::RequoteModeNames[static_cast<size_t>(configs[i].order_manager.requote_mode)],
+                static_cast<double>(configs[i].exchange.request_latency_ns) / 1e6,
+                static_cast<double>(results[i].new_orders + results[i].cancels) / moves,
+                static_cast<double>(quoting.requote_ns) / requotes / 1e6,
+                static_cast<double>(quoting.max_requote_ns) / 1e6, results[i].fills, results[i].pnl);
+  }
+  std::filesystem::remove_all(root);
+}
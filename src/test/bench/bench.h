@@ -0,0 +1,117 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Minimal benchmark harness compiled into the main binary next to the unit tests, run with
+// `crypto_mm --bench[=<name filter>] [--bench-scale=<factor>]`.
+namespace bench {
+  using BenchFunction = void (*)();
+
+  struct Benchmark {
+    std::string_view name;
+    BenchFunction function;
+  };
+
+  inline std::vector<Benchmark> &registry() {
+    static std::vector<Benchmark> benchmarks;
+    return benchmarks;
+  }
+
+  struct Registrar {
+    Registrar(std::string_view name, BenchFunction function) {
+      registry().push_back(Benchmark{name, function});
+    }
+  };
+
+  // Multiplier applied to iteration counts, handy to smoke test benchmarks on a laptop or in CI.
+  inline double &scale() {
+    static double factor = 1.0;
+    return factor;
+  }
+
+  inline size_t scaled(size_t iterations) {
+    return std::max<size_t>(1, static_cast<size_t>(static_cast<double>(iterations) * scale()));
+  }
+
+  inline int64_t nowNanos() noexcept {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now().time_since_epoch()).count();
+  }
+
+  // Keeps the optimizer from throwing away the value we are measuring.
+  template<typename T>
+  inline void doNotOptimize(const T &value) {
+    asm volatile("" : : "r,m"(value) : "memory");
+  }
+
+  // Collects latency samples (preallocated, no allocation while recording) and prints percentiles.
+  class LatencyStats {
+  public:
+    explicit LatencyStats(size_t max_samples) {
+      samples_.reserve(max_samples);
+    }
+
+    void record(int64_t nanos) {
+      if (samples_.size() < samples_.capacity()) [[likely]] {
+        samples_.push_back(nanos);
+      }
+    }
+
+    void print(std::string_view label) {
+      if (samples_.empty()) {
+        std::printf("%-48.*s no samples\n", static_cast<int>(label.size()), label.data());
+        return;
+      }
+      std::sort(samples_.begin(), samples_.end());
+      std::printf("%-48.*s n=%-8zu p50=%-8ld p99=%-8ld p99.9=%-8ld max=%-8ld [ns]\n",
+                  static_cast<int>(label.size()), label.data(), samples_.size(), percentile(0.5),
+                  percentile(0.99), percentile(0.999), samples_.back());
+    }
+
+  private:
+    int64_t percentile(double p) const {
+      const auto idx = static_cast<size_t>(p * static_cast<double>(samples_.size() - 1));
+      return samples_[idx];
+    }
+
+    std::vector<int64_t> samples_;
+  };
+
+  // Prints throughput for `count` operations that took `nanos` in total.
+  inline void printThroughput(std::string_view label, size_t count, int64_t nanos) {
+    const auto secs = static_cast<double>(nanos) / 1e9;
+    std::printf("%-48.*s n=%-10zu %12.0f ops/s %10.2f ns/op\n", static_cast<int>(label.size()), label.data(),
+                count, static_cast<double>(count) / secs, static_cast<double>(nanos) / static_cast<double>(count));
+  }
+
+  inline int runBenchmarks(std::string_view filter) {
+    int ran = 0;
+    for (const auto &benchmark: registry()) {
+      if (!filter.empty() && benchmark.name.find(filter) == std::string_view::npos) {
+        continue;
+      }
+      std::printf("=== %.*s\n", static_cast<int>(benchmark.name.size()), benchmark.name.data());
+      std::fflush(stdout);
+      benchmark.function();
+      ++ran;
+    }
+    if (ran == 0) {
+      std::cerr << "No benchmark matches filter '" << filter << "'" << std::endl;
+      return 1;
+    }
+    return 0;
+  }
+}
+
+#define BENCHMARK(name) \
+  static void name(); \
+  static const bench::Registrar name##_registrar(#name, &name); \
+  static void name()
@@ -0,0 +1,121 @@
+#include <cstdio>
+#include <vector>
+
+#include "bench.h"
+#include "l2_corpus.h"
+#include "../../client/l2_book_builder.h"
+#include "../../trading/feature_engine.h"
+
+namespace {
+  using namespace trading::features;
+  using namespace util::literals;
+
+  constexpr size_t Symbols = 8;
+
+  // Top of book with depth after every change of the corpus, round robin over the symbols.
+  std::vector<client::WsBestBidBestAskMsg> makeBookUpdates(size_t count) {
+    book::OrderBook book(book::OrderBookConfig{.tick_size = util::Price::fromDouble(0.5)});
+    std::vector<client::WsBestBidBestAskMsg> updates;
+    updates.reserve(count);
+    for (const auto &change: bench::makeL2Corpus(count)) {
+      book.update(change.side, util::Price::fromDouble(change.price), util::Qty::fromDouble(change.quantity));
+      updates.push_back(client::make_best_bid_best_ask_msg(static_cast<util::SymbolId>(updates.size() % Symbols),
+                                                           book));
+    }
+    return updates;
+  }
+
+  // A trade after every tenth book update, like in the Gemini feed.
+  template<typename Pipeline>
+  void run(const std::vector<client::WsBestBidBestAskMsg> &updates) {
+    Pipeline pipeline(Symbols);
+    const auto start = bench::nowNanos();
+    for (size_t i = 0; i < updates.size(); ++i) {
+      const auto &update = updates[i];
+      pipeline.onBook(update.symbol_id, BookTick::make(update.best_bid, update.best_bid_quantity, update.best_ask,
+                                                       update.best_ask_quantity, update.bid_depth,
+                                                       update.ask_depth));
+      if (i % 10 == 0) {
+        pipeline.onTrade(update.symbol_id, TradeTick{update.best_bid_quantity > update.best_ask_quantity
+                                                       ? client::Side::BID
+                                                       : client::Side::ASK, update.best_bid, 1.0_qty});
+      }
+    }
+    const auto elapsed = bench::nowNanos() - start;
+    char label[64];
+    std::snprintf(label, sizeof(label), "%zu kernels, book update + trade/10", Pipeline::numKernels());
+    bench::printThroughput(label, updates.size(), elapsed);
+    bench::doNotOptimize(pipeline.template get<WeightedMid>(0).price());
+  }
+
+  using Pipeline16 = FeaturePipeline<
+    WeightedMid, Microprice, BookImbalance<1>, BookImbalance<client::BookDepthLevels>, EwmaVolatility<16>,
+    EwmaVolatility<256>, EwmaVolatility<4096>, SpreadStats<256>, TradeFlowImbalance<32>, EwmaVolatility<32>,
+    EwmaVolatility<64>, EwmaVolatility<1024>, SpreadStats<16>, SpreadStats<4096>, TradeFlowImbalance<8>,
+    TradeFlowImbalance<512>>;
+}
+
+// ns per tick as kernels are added, the engine runs the 9 kernel pipeline. The single WeightedMid kernel is what
+// FeatureEngine computed before the pipeline.
+BENCHMARK(FeatureKernels) {
+  const auto updates = makeBookUpdates(bench::scaled(2'000'000));
+  run<FeaturePipeline<WeightedMid> >(updates);
+  run<FeaturePipeline<WeightedMid, Microprice> >(updates);
+  run<FeaturePipeline<WeightedMid, Microprice, BookImbalance<1>, BookImbalance<client::BookDepthLevels> > >(updates);
+  run<trading::FeatureEngine::Features>(updates);
+  run<Pipeline16>(updates);
+}
+
+namespace {
+  // Tops of book of `symbols` symbols, one of them one sided.
+  TopOfBookBatch makeBatch(size_t symbols) {
+    TopOfBookBatch batch(symbols);
+    for (size_t i = 0; i < symbols; ++i) {
+      const auto bid = util::Price::fromDouble(60000.0 + static_cast<double>(i % 100) * 0.5);
+      batch.push(static_cast<util::SymbolId>(i), bid, util::Qty::fromDouble(1.0 + static_cast<double>(i % 7)),
+                 bid + 0.5_px, i == 3 ? util::Qty{} : util::Qty::fromDouble(2.0 + static_cast<double>(i % 5)));
+    }
+    return batch;
+  }
+}
+
+// ns per symbol of what the kernels share (quantities, mid, spread, microprice, weighted mid) over a pass of
+// dirty symbols, at every SIMD level the machine has, then the whole 9 kernel FeatureEngine on the same batch.
+BENCHMARK(TopOfBookBatchEvaluation) {
+  for (const size_t symbols: {16, 256, 4096}) {
+    auto batch = makeBatch(symbols);
+    const auto passes = bench::scaled(40'000'000) / symbols;
+    for (const auto level: {util::SimdLevel::SCALAR, util::SimdLevel::AVX2, util::SimdLevel::AVX512}) {
+      if (!util::simdLevelSupported(level)) {
+        continue;
+      }
+      const auto start = bench::nowNanos();
+      for (size_t pass = 0; pass < passes; ++pass) {
+        evaluateTopOfBook(batch, level);
+        bench::doNotOptimize(batch.weighted_mids[pass % symbols]);
+      }
+      const auto elapsed = bench::nowNanos() - start;
+      char label[64];
+      std::snprintf(label, sizeof(label), "%zu symbols, %s", symbols, util::SimdLevelNames[static_cast<size_t>(level)]);
+      bench::printThroughput(label, passes * symbols, elapsed);
+    }
+
+    for (const auto level: {util::SimdLevel::SCALAR, util::SimdLevel::AVX512}) {
+      if (!util::simdLevelSupported(level)) {
+        continue;
+      }
+      trading::FeatureEngine feature_engine(symbols, level);
+      const auto engine_passes = passes / 10;
+      const auto start = bench::nowNanos();
+      for (size_t pass = 0; pass < engine_passes; ++pass) {
+        feature_engine.onBestBidBestAskBatch(batch);
+      }
+      const auto elapsed = bench::nowNanos() - start;
+      char label[64];
+      std::snprintf(label, sizeof(label), "%zu symbols, FeatureEngine %s", symbols,
+                    util::SimdLevelNames[static_cast<size_t>(level)]);
+      bench::printThroughput(label, engine_passes * symbols, elapsed);
+      bench::doNotOptimize(feature_engine.getFairPrice(0));
+    }
+  }
+}
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "l2_corpus.h"
+
+namespace bench {
+  // Gemini v2 market data frames built from the l2 corpus: l2_updates with 1-4 changes each,
+  // a trade every tenth frame and a heartbeat every hundredth, formatted like the real feed.
+  // Frames cycle through `symbols` round robin.
+  inline std::vector<std::string> makeGeminiFrames(size_t count, const std::vector<std::string> &symbols) {
+    const auto changes = makeL2Corpus(count * 3);
+    std::vector<std::string> frames;
+    frames.reserve(count);
+    size_t next_change = 0;
+    uint64_t event_id = 169841458;
+    char number[64];
+    for (size_t i = 0; frames.size() < count; ++i) {
+      const auto &symbol = symbols[i % symbols.size()];
+      if (i % 100 == 99) {
+        frames.push_back(R"({"type":"heartbeat","timestamp":1560976400428})");
+        continue;
+      }
+      if (i % 10 == 9) {
+        const auto &change = changes[next_change++ % changes.size()];
+        std::string frame = R"({"type":"trade","symbol":")";
+        frame += symbol;
+        frame += R"(","event_id":)" + std::to_string(event_id++) + R"(,"timestamp":1560976400428,"price":")";
+        std::snprintf(number, sizeof(number), "%.2f", change.price);
+        frame += number;
+        frame += R"(","quantity":")";
+        std::snprintf(number, sizeof(number), "%.8f", change.quantity > 0.0 ? change.quantity : 0.01);
+        frame += number;
+        frame += R"(","side":")";
+        frame += change.side == client::Side::BID ? "buy" : "sell";
+        frame += R"("})";
+        frames.push_back(std::move(frame));
+        continue;
+      }
+      std::string frame = R"({"type":"l2_updates","symbol":")";
+      frame += symbol;
+      frame += R"(","changes":[)";
+      const auto n = 1 + i % 4;
+      for (size_t j = 0; j < n; ++j) {
+        const auto &change = changes[next_change++ % changes.size()];
+        if (j) frame += ',';
+        frame += change.side == client::Side::BID ? R"(["buy",")" : R"(["sell",")";
+        std::snprintf(number, sizeof(number), "%.2f", change.price);
+        frame += number;
+        frame += R"(",")";
+        std::snprintf(number, sizeof(number), "%.8f", change.quantity);
+        frame += number;
+        frame += R"("])";
+      }
+      frame += "]}";
+      frames.push_back(std::move(frame));
+    }
+    return frames;
+  }
+
+  // A burst of Gemini trade frames like a sweep of the book leaves behind: runs of trades with the same
+  // aggressor walking the price away one tick at a time, cycling through `symbols`.
+  inline std::vector<std::string> makeGeminiTradeBurst(size_t count, const std::vector<std::string> &symbols) {
+    std::vector<std::string> frames;
+    frames.reserve(count);
+    uint64_t event_id = 169841458;
+    char number[64];
+    double price = 60000.0;
+    for (size_t i = 0; i < count; ++i) {
+      const bool buy = (i / 16) % 2 == 0;
+      price += buy ? 0.5 : -0.5;
+      std::string frame = R"({"type":"trade","symbol":")";
+      frame += symbols[i % symbols.size()];
+      frame += R"(","event_id":)" + std::to_string(event_id++) + R"(,"timestamp":1560976400428,"price":")";
+      std::snprintf(number, sizeof(number), "%.2f", price);
+      frame += number;
+      frame += R"(","quantity":")";
+      std::snprintf(number, sizeof(number), "%.8f", 0.001 * static_cast<double>(1 + i % 97));
+      frame += number;
+      frame += buy ? R"(","side":"buy"})" : R"(","side":"sell"})";
+      frames.push_back(std::move(frame));
+    }
+    return frames;
+  }
+
+  inline std::vector<std::string> makeGeminiFrames(size_t count, const char *symbol = "BTCGUSDPERP") {
+    return makeGeminiFrames(count, std::vector<std::string>{symbol});
+  }
+}
@@ -0,0 +1,92 @@
+#include <map>
+#include <string>
+
+#include <nlohmann/json.hpp>
+
+#include "alloc_counter.h"
+#include "bench.h"
+#include "gemini_frames.h"
+#include "../../book/order_book.h"
+#include "../../client/gemini_md_parser.h"
+
+namespace {
+  using namespace util::literals;
+
+  // WsOrderBookClient::on_message as it was: copy the frame out, build a DOM, dump it for logging,
+  // std::stod every price and quantity into a std::map book trimmed to 3 levels.
+  struct DomPath {
+    void operator()(const std::string &frame) {
+      const std::string message(frame.data(), frame.size());
+      const auto data = nlohmann::json::parse(message);
+      bench::doNotOptimize(data.dump().size());
+      if (data.contains("type") && data["type"] == "l2_updates" && data.contains("symbol") &&
+          data["symbol"] == "BTCGUSDPERP" && data.contains("changes")) {
+        for (const auto &change: data["changes"]) {
+          if (change.size() == 3) {
+            const auto side = change[0].get<std::string>();
+            const double price = std::stod(change[1].get<std::string>());
+            const double quantity = std::stod(change[2].get<std::string>());
+            auto &orders = side == "buy" ? bid_orders : ask_orders;
+            if (quantity > 0.0) orders[price] = quantity;
+            else orders.erase(price);
+          }
+        }
+        while (bid_orders.size() > 3) bid_orders.erase(bid_orders.begin());
+        while (ask_orders.size() > 3) ask_orders.erase(std::prev(ask_orders.end()));
+        best += bid_orders.empty() ? 0.0 : std::prev(bid_orders.end())->first;
+      }
+    }
+
+    std::map<double, double> bid_orders;
+    std::map<double, double> ask_orders;
+    double best{};
+  };
+
+  // The same work through GeminiMarketDataParser into book::OrderBook.
+  struct StreamingPath {
+    void operator()(const std::string &frame) {
+      client::GeminiMarketDataParser::parse(frame, *this);
+    }
+
+    void on_l2_change(std::string_view symbol, client::Side side, util::Price price, util::Qty quantity) {
+      if (symbol == "BTCGUSDPERP") {
+        book.update(side, price, quantity);
+      }
+    }
+
+    void on_l2_updates_end(std::string_view) {
+      best += book.hasBid() ? book.bestBid().price_ticks : 0;
+    }
+
+    void on_trade(std::string_view, const client::GeminiTrade &trade) {
+      best += trade.price.fixed();
+    }
+
+    book::OrderBook book{book::OrderBookConfig{.tick_size = 0.5_px, .max_depth = 1000}};
+    int64_t best{};
+  };
+
+  template<typename Path>
+  void run(std::string_view label, Path &&path, const std::vector<std::string> &frames) {
+    for (const auto &frame: frames) path(frame);
+
+    bench::AllocationCounter allocations;
+    const auto start = bench::nowNanos();
+    for (const auto &frame: frames) path(frame);
+    const auto elapsed = bench::nowNanos() - start;
+    bench::printThroughput(label, frames.size(), elapsed);
+    std::printf("%-48s %.2f allocations/msg\n", "",
+                static_cast<double>(allocations.count()) / static_cast<double>(frames.size()));
+    bench::doNotOptimize(path.best);
+  }
+}
+
+BENCHMARK(GeminiMarketDataParsing) {
+  const auto frames = bench::makeGeminiFrames(bench::scaled(500'000));
+  size_t bytes = 0;
+  for (const auto &frame: frames) bytes += frame.size();
+  std::printf("corpus: %zu frames, %.1f bytes/frame\n", frames.size(),
+              static_cast<double>(bytes) / static_cast<double>(frames.size()));
+  run("nlohmann DOM + std::stod + std::map", DomPath{}, frames);
+  run("GeminiMarketDataParser + book::OrderBook", StreamingPath{}, frames);
+}
@@ -0,0 +1,104 @@
+#include <openssl/hmac.h>
+#include <iomanip>
+#include <sstream>
+#include <string>
+
+#include "alloc_counter.h"
+#include "bench.h"
+#include "../../client/gemini_signer.h"
+#include "../../client/ws_order_entry_client.h"
+
+namespace {
+  using client::WsOrderEntryClient;
+
+  constexpr std::string_view Secret = "1234abcd5678efgh1234abcd5678efgh";
+
+  WsOrderEntryClient::WsOrderEntryReqMsg makeOrder(size_t i) {
+    WsOrderEntryClient::WsOrderEntryReqMsg msg;
+    msg.type = WsOrderEntryClient::WsOrderEntryReqMsg::RequestType::NEW_ORDER;
+    msg.side = (i & 1) ? client::Side::BID : client::Side::ASK;
+    msg.price = util::Price::fromDouble(60000.0 + static_cast<double>(i % 100) * 0.5);
+    msg.quantity = util::Qty::fromDouble(0.1);
+    msg.client_order_id = 1'000'000 + i;
+    return msg;
+  }
+
+  // How WsOrderEntryClient signed orders before: ostringstreams, a string based base64, one-shot HMAC()
+  // re-keyed per call and a setw/setfill hex dump.
+  std::string legacyParams(const WsOrderEntryClient::WsOrderEntryReqMsg &msg) {
+    std::ostringstream oss;
+    oss << "symbol=btcusd&amount=" << msg.quantity << "&price=" << msg.price << "&side=" << client::to_gemini_side(msg.side)
+        << "&type=exchange limit" << "&client_order_id=" << msg.client_order_id;
+    return oss.str();
+  }
+
+  std::string legacyBase64(const unsigned char *input, size_t length) {
+    static const char encode_table[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    std::string encoded;
+    encoded.reserve(((length + 2) / 3) * 4);
+    for (size_t i = 0; i < length; i += 3) {
+      unsigned int value = 0;
+      for (size_t j = i; j < i + 3; ++j) {
+        value <<= 8;
+        if (j < length) {
+          value |= input[j];
+        }
+      }
+      encoded.push_back(encode_table[(value >> 18) & 0x3F]);
+      encoded.push_back(encode_table[(value >> 12) & 0x3F]);
+      encoded.push_back((i + 1 < length) ? encode_table[(value >> 6) & 0x3F] : '=');
+      encoded.push_back((i + 2 < length) ? encode_table[value & 0x3F] : '=');
+    }
+    return encoded;
+  }
+
+  std::pair<std::string, std::string> legacySign(const WsOrderEntryClient::WsOrderEntryReqMsg &msg, int64_t nonce) {
+    std::ostringstream payload_stream;
+    payload_stream << "nonce=" << nonce << "&request=" << "/v1/order/new";
+    if (!legacyParams(msg).empty()) {
+      payload_stream << "&" << legacyParams(msg);
+    }
+    std::string payload = payload_stream.str();
+    std::string encoded_payload = legacyBase64(reinterpret_cast<const unsigned char *>(payload.c_str()),
+                                               payload.length());
+    unsigned char *digest = HMAC(EVP_sha384(), Secret.data(), static_cast<int>(Secret.size()),
+                                 reinterpret_cast<const unsigned char *>(encoded_payload.c_str()),
+                                 encoded_payload.length(), nullptr, nullptr);
+    std::ostringstream signature_stream;
+    for (int i = 0; i < SHA384_DIGEST_LENGTH; ++i) {
+      signature_stream << std::hex << std::setw(2) << std::setfill('0') << static_cast<int>(digest[i]);
+    }
+    return {std::move(encoded_payload), signature_stream.str()};
+  }
+
+  template<typename Sign>
+  void run(std::string_view label, Sign &&sign) {
+    const auto count = bench::scaled(200'000);
+    bench::AllocationCounter allocations;
+    const auto start = bench::nowNanos();
+    for (size_t i = 0; i < count; ++i) {
+      sign(makeOrder(i), static_cast<int64_t>(1'700'000'000'000 + i));
+    }
+    const auto elapsed = bench::nowNanos() - start;
+    bench::printThroughput(label, count, elapsed);
+    std::printf("%-48s %.2f allocations/order\n", "",
+                static_cast<double>(allocations.count()) / static_cast<double>(count));
+  }
+}
+
+BENCHMARK(GeminiOrderSigning) {
+  run("ostringstream + HMAC() per order", [](const WsOrderEntryClient::WsOrderEntryReqMsg &msg, int64_t nonce) {
+    auto signature = legacySign(msg, nonce);
+    bench::doNotOptimize(signature);
+  });
+
+  client::GeminiSigner signer(Secret);
+  client::PayloadWriter writer;
+  run("GeminiSigner, precomputed HMAC state", [&](const WsOrderEntryClient::WsOrderEntryReqMsg &msg, int64_t nonce) {
+    writer.clear();
+    writer.append("nonce=").append(nonce).append("&request=").append("/v1/order/new");
+    msg.write_params(writer, "btcusd");
+    const auto signature = signer.sign(writer.view());
+    bench::doNotOptimize(signature);
+  });
+}
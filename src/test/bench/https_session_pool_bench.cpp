@@ -0,0 +1,91 @@
+#include <string>
+#include <vector>
+
+#include "bench.h"
+#include "../mock/mock_https_server.h"
+#include "../../client/https_session_pool.h"
+
+namespace {
+  using client::HttpsSessionPool;
+  namespace http = boost::beast::http;
+
+  HttpsSessionPool::Request makeOrderRequest() {
+    HttpsSessionPool::Request request{http::verb::post, "/v1/order/new", 11};
+    request.set(http::field::host, "localhost");
+    request.set("X-GEMINI-PAYLOAD", "eyJyZXF1ZXN0IjoiL3YxL29yZGVyL25ldyIsIm5vbmNlIjoxNzAwMDAwMDAwMDAwfQ==");
+    request.prepare_payload();
+    return request;
+  }
+
+  // What WsOrderEntryClient used to do per order: resolve, connect, (now also) TLS handshake, one request,
+  // shut the socket down.
+  bool connectPerRequest(const std::string &port, boost::asio::ssl::context &ssl_ctx) {
+    namespace net = boost::asio;
+    namespace beast = boost::beast;
+    net::io_context ioc;
+    net::ip::tcp::resolver resolver(ioc);
+    beast::ssl_stream<beast::tcp_stream> stream(ioc, ssl_ctx);
+    beast::error_code ec;
+    SSL_set_tlsext_host_name(stream.native_handle(), "localhost");
+    beast::get_lowest_layer(stream).connect(resolver.resolve("localhost", port));
+    stream.handshake(net::ssl::stream_base::client, ec);
+    auto request = makeOrderRequest();
+    http::write(stream, request, ec);
+    beast::flat_buffer buffer;
+    HttpsSessionPool::Response response;
+    http::read(stream, buffer, response, ec);
+    beast::get_lowest_layer(stream).socket().shutdown(net::ip::tcp::socket::shutdown_both, ec);
+    return !ec && response.result() == http::status::ok;
+  }
+}
+
+BENCHMARK(OrderRoundTripHttps) {
+  mock::MockHttpsServer server;
+  const auto port = std::to_string(server.port());
+  const auto count = bench::scaled(2'000);
+
+  {
+    boost::asio::ssl::context ssl_ctx(boost::asio::ssl::context::tlsv12_client);
+    ssl_ctx.add_certificate_authority(boost::asio::buffer(mock::LocalhostCertificatePem.data(),
+                                                          mock::LocalhostCertificatePem.size()));
+    ssl_ctx.set_verify_mode(boost::asio::ssl::verify_peer);
+    const auto requests = std::max<size_t>(count / 10, 1);
+    bench::LatencyStats stats(requests);
+    for (size_t i = 0; i < requests; ++i) {
+      const auto start = bench::nowNanos();
+      const bool ok = connectPerRequest(port, ssl_ctx);
+      stats.record(bench::nowNanos() - start);
+      bench::doNotOptimize(ok);
+    }
+    stats.print("connect + TLS handshake per request");
+  }
+
+  client::HttpsSessionPoolConfig config;
+  config.ca_certificate_pem = std::string(mock::LocalhostCertificatePem);
+  HttpsSessionPool pool("localhost", port, config);
+  pool.start();
+  {
+    bench::LatencyStats stats(count);
+    auto request = makeOrderRequest();
+    HttpsSessionPool::Response response;
+    for (size_t i = 0; i < count; ++i) {
+      const auto start = bench::nowNanos();
+      pool.execute(request, response);
+      stats.record(bench::nowNanos() - start);
+    }
+    stats.print("session pool, one request");
+  }
+  {
+    constexpr size_t Pipelined = 8;
+    std::vector<HttpsSessionPool::Request> requests(Pipelined, makeOrderRequest());
+    std::vector<HttpsSessionPool::Response> responses(Pipelined);
+    bench::LatencyStats stats(count / Pipelined + 1);
+    for (size_t i = 0; i < count; i += Pipelined) {
+      const auto start = bench::nowNanos();
+      pool.execute(requests, responses);
+      stats.record((bench::nowNanos() - start) / static_cast<int64_t>(Pipelined));
+    }
+    stats.print("session pool, 8 pipelined (per request)");
+  }
+  pool.stop();
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstdint>
+#include <random>
+#include <vector>
+
+#include "../../client/types.h"
+
+namespace bench {
+  struct L2Change {
+    client::Side side;
+    double price;
+    double quantity;
+  };
+
+  // Deterministic stand-in for a recorded BTCGUSDPERP l2_updates stream: a random walking mid with
+  // updates clustered near the top of book, roughly a third of them deleting a level.
+  // The book it describes is never crossed.
+  inline std::vector<L2Change> makeL2Corpus(size_t count, double tick_size = 0.5, uint64_t seed = 42) {
+    std::mt19937_64 rng(seed);
+    std::geometric_distribution<int> distance_from_top(0.15);
+    std::uniform_real_distribution<double> unit(0.0, 1.0);
+    std::vector<L2Change> changes;
+    changes.reserve(count);
+    int64_t mid_ticks = static_cast<int64_t>(60000.0 / tick_size);
+    while (changes.size() < count) {
+      if (unit(rng) < 0.05) {
+        // The level the mid moves onto gets taken out, like the exchange would after a trade through it.
+        const auto up = unit(rng) < 0.5;
+        mid_ticks += up ? 1 : -1;
+        changes.push_back(L2Change{up ? client::Side::ASK : client::Side::BID,
+                                   static_cast<double>(mid_ticks) * tick_size, 0.0});
+        if (changes.size() == count) break;
+      }
+      const auto side = unit(rng) < 0.5 ? client::Side::BID : client::Side::ASK;
+      const auto distance = 1 + distance_from_top(rng);
+      const auto price_ticks = side == client::Side::BID ? mid_ticks - distance : mid_ticks + distance;
+      const auto quantity = unit(rng) < 0.33 ? 0.0 : static_cast<double>(1 + rng() % 500000) / 1e5;
+      changes.push_back(L2Change{side, static_cast<double>(price_ticks) * tick_size, quantity});
+    }
+    return changes;
+  }
+}
@@ -0,0 +1,33 @@
+#include <chrono>
+#include <cstdio>
+
+#include "bench.h"
+#include "../../util/latency_probe.h"
+
+namespace {
+  template<typename Probe>
+  void run(std::string_view label, Probe &&probe) {
+    const auto count = bench::scaled(20'000'000);
+    for (size_t i = 0; i < 1000; ++i) probe();
+
+    const auto start = bench::nowNanos();
+    for (size_t i = 0; i < count; ++i) {
+      probe();
+    }
+    bench::printThroughput(label, count, bench::nowNanos() - start);
+  }
+}
+
+BENCHMARK(LatencyProbeCost) {
+  std::printf("%-48s %.3f ticks/ns\n", "TSC rate", util::tscTicksPerNano());
+  run("readTsc()", [] { bench::doNotOptimize(util::readTsc()); });
+  run("steady_clock::now()", [] { bench::doNotOptimize(std::chrono::steady_clock::now()); });
+  run("CMM_PROBE outside an event", [] { CMM_PROBE(FEATURE_UPDATE); });
+  CMM_PROBE_BEGIN();
+  run("CMM_PROBE recording", [] { CMM_PROBE(FEATURE_UPDATE); });
+  CMM_PROBE_END();
+
+  const auto snapshot = util::LatencyProbes::instance().snapshot(util::ProbeStage::FEATURE_UPDATE);
+  std::printf("%-48s n=%lu p50=%lu p99=%lu max=%lu [ticks]\n", "recorded probe to probe", snapshot.total,
+              snapshot.percentile(0.5), snapshot.percentile(0.99), snapshot.max);
+}
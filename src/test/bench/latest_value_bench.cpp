@@ -0,0 +1,110 @@
+#include <atomic>
+#include <cstdio>
+#include <thread>
+
+#include "bench.h"
+#include "../../client/l2_book_builder.h"
+#include "../../util/latest_value.h"
+#include "../../util/spsc_queue.h"
+
+namespace {
+  using Msg = client::WsBestBidBestAskMsg;
+  using namespace util::literals;
+
+  constexpr size_t Symbols = 4;
+
+  Msg makeMsg(size_t i, int64_t now) {
+    return Msg{.symbol_id = static_cast<util::SymbolId>(i % Symbols), .best_bid = 100_px + 1_px * static_cast<int64_t>(i),
+               .best_bid_quantity = 1_qty, .best_ask = 101_px + 1_px * static_cast<int64_t>(i),
+               .best_ask_quantity = 1_qty, .tsc = static_cast<uint64_t>(now)};
+  }
+
+  void spinFor(int64_t nanos) {
+    const auto until = bench::nowNanos() + nanos;
+    while (bench::nowNanos() < until) {
+      util::cpuRelax();
+    }
+  }
+
+  // A book client publishing `rate` updates per second round robin over the symbols for `duration_ns`, and an
+  // engine spending `work_ns` on every update it gets. Each update carries its publish time, staleness is how
+  // old it is once the engine starts working on it. The writer publishes whatever is due in one go, so the
+  // rate holds on average even when it shares a core with the reader.
+  template<typename Publish, typename Consume>
+  void runStaleness(std::string_view label, int64_t rate, int64_t duration_ns, int64_t work_ns, Publish &&publish,
+                    Consume &&consume) {
+    bench::LatencyStats staleness(static_cast<size_t>(rate * duration_ns / 1'000'000'000));
+    std::atomic<bool> done{false};
+    size_t published = 0;
+    std::thread writer([&] {
+      const auto start = bench::nowNanos();
+      for (auto now = start; now - start < duration_ns; now = bench::nowNanos()) {
+        const auto due = static_cast<size_t>((now - start) * rate / 1'000'000'000);
+        for (; published < due; ++published) {
+          publish(makeMsg(published, now));
+        }
+      }
+      done = true;
+    });
+    size_t processed = 0;
+    const auto on_msg = [&](const Msg &msg) {
+      staleness.record(bench::nowNanos() - static_cast<int64_t>(msg.tsc));
+      spinFor(work_ns);
+      ++processed;
+    };
+    while (true) {
+      const auto finished = done.load();
+      if (consume(on_msg) == 0 && finished) {
+        break;
+      }
+    }
+    writer.join();
+    staleness.print(label);
+    std::printf("%-48s %zu of %zu updates processed\n", "", processed, published);
+  }
+}
+
+BENCHMARK(LatestValueSlots) {
+  util::LatestValueSlots<Msg> slots(Symbols);
+  const auto count = bench::scaled(20'000'000);
+  auto start = bench::nowNanos();
+  for (size_t i = 0; i < count; ++i) {
+    slots.store(i % Symbols, makeMsg(i, 0));
+  }
+  bench::printThroughput("store(), nobody reading", count, bench::nowNanos() - start);
+
+  start = bench::nowNanos();
+  size_t consumed = 0;
+  for (size_t i = 0; i < count; ++i) {
+    slots.store(i % Symbols, makeMsg(i, 0));
+    consumed += slots.consume([](size_t, const Msg &msg) { bench::doNotOptimize(msg); });
+  }
+  bench::printThroughput("store() + consume() of one key", count, bench::nowNanos() - start);
+
+  start = bench::nowNanos();
+  for (size_t i = 0; i < count; ++i) {
+    consumed += slots.consume([](size_t, const Msg &msg) { bench::doNotOptimize(msg); });
+  }
+  bench::printThroughput("consume() of nothing", count, bench::nowNanos() - start);
+  bench::doNotOptimize(consumed);
+
+  // 1M updates/s against an engine that needs 2 us per update, so it can only keep up with half of them.
+  const auto duration = static_cast<int64_t>(bench::scaled(500)) * 1'000'000;
+  util::SpscQueue<Msg> queue(10'000);
+  runStaleness("staleness, queue of 10000", 1'000'000, duration, 2'000,
+               [&](const Msg &msg) { queue.push(msg); },
+               [&](auto &&on_msg) {
+                 Msg msg;
+                 size_t n = 0;
+                 for (; n < 64 && queue.pop(msg); ++n) {
+                   on_msg(msg);
+                 }
+                 return n;
+               });
+  util::LatestValueSlots<Msg> latest(Symbols);
+  runStaleness("staleness, latest value slots", 1'000'000, duration, 2'000,
+               [&](const Msg &msg) { latest.store(msg.symbol_id, msg); },
+               [&](auto &&on_msg) {
+                 return latest.consume([&](size_t, const Msg &msg) { on_msg(msg); });
+               });
+}
@@ -0,0 +1,58 @@
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <thread>
+
+#include "bench.h"
+#include "../../util/logger.h"
+
+namespace {
+  constexpr size_t BurstSize = 1024;
+
+  // Times bursts of log calls on this thread and leaves the logger thread time to drain in between, so
+  // the ring never fills up and every call measured is a real enqueue rather than a drop.
+  template<typename Log>
+  void runBursts(std::string_view label, Log &&log) {
+    const auto bursts = bench::scaled(200);
+    int64_t elapsed = 0;
+    for (size_t burst = 0; burst < bursts; ++burst) {
+      const auto start = bench::nowNanos();
+      for (size_t i = 0; i < BurstSize; ++i) {
+        log(i);
+      }
+      elapsed += bench::nowNanos() - start;
+      std::this_thread::sleep_for(std::chrono::milliseconds(2));
+    }
+    bench::printThroughput(label, bursts * BurstSize, elapsed);
+  }
+}
+
+BENCHMARK(LoggerProducerCost) {
+  FILE *devnull = std::fopen("/dev/null", "w");
+  auto &logger = util::Logger::instance();
+  const auto dropped_before = logger.dropped();
+  logger.start(util::LoggerConfig{.file = devnull, .cpu_id = -1, .ring_size = 4 * BurstSize});
+
+  runBursts("LOG_INFO 3 numeric args", [](size_t i) {
+    LOG_INFO("newOrder: price={} quantity={} client_order_id={}", 60000.0 + static_cast<double>(i & 127), 0.1, i);
+  });
+  runBursts("LOG_INFO string arg", [](size_t) {
+    LOG_INFO("Malformed market data message: {}", std::string_view(R"({"type":"l2_updates","symbol":"BTC)"));
+  });
+  runBursts("LOG_DEBUG, compiled out", [](size_t i) {
+    LOG_DEBUG("best_bid: {}, best_ask: {}", static_cast<double>(i), static_cast<double>(i + 1));
+  });
+
+  logger.stop();
+  std::fclose(devnull);
+  std::printf("%-48s %lu records dropped\n", "", static_cast<unsigned long>(logger.dropped() - dropped_before));
+
+  // What the hot paths did before: an ostream insert and std::endl flush per call.
+  std::ofstream null_stream("/dev/null");
+  auto *const cout_buffer = std::cout.rdbuf(null_stream.rdbuf());
+  runBursts("std::cout << ... << std::endl", [](size_t i) {
+    std::cout << "newOrder: price=" << 60000.0 + static_cast<double>(i & 127) << " quantity=" << 0.1
+        << " client_order_id=" << i << std::endl;
+  });
+  std::cout.rdbuf(cout_buffer);
+}
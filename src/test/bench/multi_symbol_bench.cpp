@@ -0,0 +1,74 @@
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "bench.h"
+#include "gemini_frames.h"
+#include "../../client/l2_book_builder.h"
+#include "../../trading/feature_engine.h"
+#include "../../trading/market_maker.h"
+#include "../../trading/order_manager.h"
+#include "../../util/latest_value.h"
+#include "../../util/symbol_table.h"
+
+namespace {
+  using client::WsOrderEntryClient;
+
+  // Market data frames in, orders out, on one thread: L2BookBuilder -> FeatureEngine -> MarketMaker ->
+  // OrderManager, with every request acknowledged right away so quotes follow each top of book update.
+  void run(size_t num_symbols) {
+    util::SymbolTable symbols;
+    std::vector<std::string> names;
+    char name[32];
+    for (size_t i = 0; i < num_symbols; ++i) {
+      std::snprintf(name, sizeof(name), "SYM%03zuUSD", i);
+      symbols.add(name);
+      names.emplace_back(name);
+    }
+    const auto frames = bench::makeGeminiFrames(bench::scaled(400'000), names);
+
+    util::LatestValueSlots<client::WsBestBidBestAskMsg> book_updates{symbols.size()};
+    util::SpscQueue<WsOrderEntryClient::WsOrderEntryReqMsg> order_entry_req_queue{1024};
+    client::L2BookBuilder book_builder(symbols, book_updates);
+    trading::FeatureEngine feature_engine(symbols.size());
+    trading::OrderManager order_manager(order_entry_req_queue, symbols.size());
+    trading::MarketMaker market_maker(order_manager, feature_engine);
+
+    size_t orders = 0;
+    WsOrderEntryClient::WsOrderEntryReqMsg request;
+    const auto start = bench::nowNanos();
+    for (const auto &frame: frames) {
+      book_builder.on_message(frame);
+      book_updates.consume([&](size_t, const client::WsBestBidBestAskMsg &update) {
+        feature_engine.onBestBidBestAskUpdate(update.symbol_id, update.best_bid, update.best_bid_quantity,
+                                              update.best_ask, update.best_ask_quantity);
+        market_maker.onBestBidBestAskUpdate(update.symbol_id, update.best_bid, update.best_bid_quantity,
+                                            update.best_ask, update.best_ask_quantity);
+      });
+      while (order_entry_req_queue.pop(request)) {
+        WsOrderEntryClient::WsOrderEntryResMsg res;
+        res.status = request.type == WsOrderEntryClient::WsOrderEntryReqMsg::RequestType::NEW_ORDER
+                       ? WsOrderEntryClient::WsOrderEntryResMsg::OrdStatus::NEW
+                       : WsOrderEntryClient::WsOrderEntryResMsg::OrdStatus::CANCELED;
+        res.side = request.side;
+        res.symbol_id = request.symbol_id;
+        res.client_order_id = request.client_order_id;
+        res.order_id = request.client_order_id;
+        market_maker.onOrderUpdate(res);
+        ++orders;
+      }
+    }
+    const auto elapsed = bench::nowNanos() - start;
+
+    char label[64];
+    std::snprintf(label, sizeof(label), "%zu symbols, frame -> order", num_symbols);
+    bench::printThroughput(label, frames.size(), elapsed);
+    std::printf("%-48s %.2f requests/frame\n", "", static_cast<double>(orders) / static_cast<double>(frames.size()));
+  }
+}
+
+BENCHMARK(MultiSymbolThroughput) {
+  for (const size_t num_symbols: {1, 4, 16, 64, 256}) {
+    run(num_symbols);
+  }
+}
@@ -0,0 +1,83 @@
+#include <map>
+
+#include "alloc_counter.h"
+#include "bench.h"
+#include "l2_corpus.h"
+#include "../../book/order_book.h"
+
+namespace {
+  using namespace util::literals;
+
+  // What WsOrderBookClient used to do per update: std::map keyed by double, optionally trimmed to 3 levels.
+  struct MapBook {
+    explicit MapBook(size_t trim_to) : trim_to_(trim_to) {
+    }
+
+    void update(client::Side side, double price, double quantity) {
+      auto &orders = side == client::Side::BID ? bid_orders_ : ask_orders_;
+      if (quantity > 0.0) {
+        orders[price] = quantity;
+      } else {
+        orders.erase(price);
+      }
+      while (bid_orders_.size() > trim_to_) bid_orders_.erase(bid_orders_.begin());
+      while (ask_orders_.size() > trim_to_) ask_orders_.erase(std::prev(ask_orders_.end()));
+      best_bid_ = bid_orders_.empty() ? 0.0 : std::prev(bid_orders_.end())->first;
+      best_ask_ = ask_orders_.empty() ? 0.0 : ask_orders_.begin()->first;
+    }
+
+    double best() const {
+      return best_bid_ + best_ask_;
+    }
+
+    size_t trim_to_;
+    std::map<double, double> bid_orders_;
+    std::map<double, double> ask_orders_;
+    double best_bid_{};
+    double best_ask_{};
+  };
+
+  struct FlatBook {
+    explicit FlatBook(size_t depth) : book_(book::OrderBookConfig{.tick_size = 0.5_px, .max_depth = depth}) {
+    }
+
+    void update(client::Side side, double price, double quantity) {
+      book_.update(side, util::Price::fromDouble(price), util::Qty::fromDouble(quantity));
+      best_bid_ = book_.hasBid() ? book_.bestBid().price_ticks : 0;
+      best_ask_ = book_.hasAsk() ? book_.bestAsk().price_ticks : 0;
+    }
+
+    int64_t best() const {
+      return best_bid_ + best_ask_;
+    }
+
+    book::OrderBook book_;
+    int64_t best_bid_{};
+    int64_t best_ask_{};
+  };
+
+  template<typename Book>
+  void replay(std::string_view label, Book &&book, const std::vector<bench::L2Change> &corpus) {
+    // Warm up so the steady state (levels present, capacity reached) is what we measure.
+    for (const auto &change: corpus) book.update(change.side, change.price, change.quantity);
+
+    bench::AllocationCounter allocations;
+    const auto start = bench::nowNanos();
+    for (const auto &change: corpus) {
+      book.update(change.side, change.price, change.quantity);
+      bench::doNotOptimize(book.best());
+    }
+    const auto elapsed = bench::nowNanos() - start;
+    bench::printThroughput(label, corpus.size(), elapsed);
+    std::printf("%-48s %.3f allocations/update\n", "",
+                static_cast<double>(allocations.count()) / static_cast<double>(corpus.size()));
+  }
+}
+
+BENCHMARK(OrderBookL2Replay) {
+  const auto corpus = bench::makeL2Corpus(bench::scaled(2'000'000));
+  replay("std::map<double,double> trimmed to 3", MapBook(3), corpus);
+  replay("std::map<double,double> full depth", MapBook(SIZE_MAX), corpus);
+  replay("book::OrderBook depth 3", FlatBook(3), corpus);
+  replay("book::OrderBook depth 1000", FlatBook(1000), corpus);
+}
@@ -0,0 +1,98 @@
+#include <string>
+
+#include "alloc_counter.h"
+#include "bench.h"
+#include "../../client/ws_order_entry_client.h"
+#include "../../util/spsc_queue.h"
+
+namespace {
+  using client::WsOrderEntryClient;
+
+  // The order entry messages as they were before they became trivially copyable.
+  struct LegacyReqMsg {
+    int type{};
+    double price{};
+    double quantity{};
+    std::string side{};
+    std::string order_id{};
+    std::string client_order_id{};
+  };
+
+  struct LegacyResMsg {
+    int status{};
+    std::string message{};
+    std::string side;
+    std::string order_id{};
+    std::string client_order_id{};
+    double leaves_qty{};
+  };
+
+  // Sends a request and its response through the queues the way OrderManager and WsOrderEntryClient do,
+  // reporting time and heap allocations per round trip.
+  template<typename Req, typename Res, typename MakeReq, typename MakeRes>
+  void runRoundTrip(std::string_view label, MakeReq &&make_req, MakeRes &&make_res) {
+    util::SpscQueue<Req> req_queue(1024);
+    util::SpscQueue<Res> res_queue(1024);
+    const auto count = bench::scaled(2'000'000);
+    Req req{};
+    Res res{};
+
+    bench::AllocationCounter allocations;
+    const auto start = bench::nowNanos();
+    for (size_t i = 0; i < count; ++i) {
+      req_queue.push(make_req(i));
+      req_queue.pop(req);
+      res_queue.push(make_res(req));
+      res_queue.pop(res);
+      bench::doNotOptimize(res);
+    }
+    const auto elapsed = bench::nowNanos() - start;
+    bench::printThroughput(label, count, elapsed);
+    std::printf("%-48s %.2f allocations/msg\n", "",
+                static_cast<double>(allocations.count()) / static_cast<double>(count));
+  }
+}
+
+BENCHMARK(OrderEntryMessageAllocations) {
+  runRoundTrip<LegacyReqMsg, LegacyResMsg>(
+    "std::string fields",
+    [](size_t i) {
+      LegacyReqMsg msg;
+      msg.type = 1;
+      msg.price = 60000.0 + static_cast<double>(i % 100);
+      msg.quantity = 0.1;
+      msg.side = (i & 1) ? "bid" : "ask";
+      msg.client_order_id = std::to_string(1'000'000'000'000 + i);
+      return msg;
+    },
+    [](const LegacyReqMsg &req) {
+      LegacyResMsg msg;
+      msg.status = 1;
+      msg.message = "Order submitted successfully";
+      msg.side = req.side;
+      msg.order_id = "106817811000";
+      msg.client_order_id = req.client_order_id;
+      msg.leaves_qty = req.quantity;
+      return msg;
+    });
+
+  runRoundTrip<WsOrderEntryClient::WsOrderEntryReqMsg, WsOrderEntryClient::WsOrderEntryResMsg>(
+    "trivially copyable 64 byte structs",
+    [](size_t i) {
+      WsOrderEntryClient::WsOrderEntryReqMsg msg;
+      msg.type = WsOrderEntryClient::WsOrderEntryReqMsg::RequestType::NEW_ORDER;
+      msg.price = util::Price::fromDouble(60000.0 + static_cast<double>(i % 100));
+      msg.quantity = util::Qty::fromDouble(0.1);
+      msg.side = (i & 1) ? client::Side::BID : client::Side::ASK;
+      msg.client_order_id = 1'000'000'000'000 + i;
+      return msg;
+    },
+    [](const WsOrderEntryClient::WsOrderEntryReqMsg &req) {
+      WsOrderEntryClient::WsOrderEntryResMsg msg(WsOrderEntryClient::WsOrderEntryResMsg::OrdStatus::NEW,
+                                                 "Order submitted successfully", 106817811000);
+      msg.side = req.side;
+      msg.client_order_id = req.client_order_id;
+      msg.leaves_qty = req.quantity;
+      return msg;
+    });
+}
@@ -0,0 +1,95 @@
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include <nlohmann/json.hpp>
+
+#include "alloc_counter.h"
+#include "bench.h"
+#include "../../client/gemini_order_events_parser.h"
+
+namespace {
+  // An order's life on the order events stream: accepted, booked, two fills and closed, or cancelled and closed.
+  std::vector<std::string> makeOrderEventFrames(size_t count) {
+    std::vector<std::string> frames;
+    frames.reserve(count);
+    for (uint64_t order = 0; frames.size() < count; ++order) {
+      const auto ids = R"("order_id":")" + std::to_string(109535951 + order) + R"(","client_order_id":")" +
+                       std::to_string((1ull << 32) + order) + R"(","symbol":"btcgusdperp","side":")" +
+                       (order % 2 ? "sell" : "buy") + R"(","order_type":"exchange limit","timestamp":"1547242032",)"
+                       R"("timestampms":1547242032000,"is_live":true,"is_cancelled":false,"is_hidden":false,)"
+                       R"("original_amount":"0.5","price":"60000.5",)";
+      frames.push_back(R"([{"type":"accepted",)" + ids + R"("socket_sequence":1}])");
+      frames.push_back(R"([{"type":"booked",)" + ids + R"("remaining_amount":"0.5","socket_sequence":2}])");
+      if (order % 4 == 0) {
+        frames.push_back(R"([{"type":"cancelled",)" + ids + R"("reason":"Requested","remaining_amount":"0.5",)"
+                         R"("socket_sequence":3},{"type":"closed",)" + ids + R"("remaining_amount":"0.5",)"
+                         R"("socket_sequence":3}])");
+        continue;
+      }
+      frames.push_back(R"([{"type":"fill",)" + ids + R"("executed_amount":"0.2","remaining_amount":"0.3",)"
+                       R"("avg_execution_price":"60000.5","fill":{"trade_id":"109535955","liquidity":"Maker",)"
+                       R"("price":"60000.5","amount":"0.2","fee":"0.024","fee_currency":"GUSD"},)"
+                       R"("socket_sequence":3}])");
+      frames.push_back(R"([{"type":"fill",)" + ids + R"("executed_amount":"0.5","remaining_amount":"0",)"
+                       R"("avg_execution_price":"60000.5","fill":{"trade_id":"109535956","liquidity":"Maker",)"
+                       R"("price":"60000.5","amount":"0.3","fee":"0.036","fee_currency":"GUSD"},)"
+                       R"("socket_sequence":4},{"type":"closed",)" + ids + R"("remaining_amount":"0",)"
+                       R"("socket_sequence":4}])");
+    }
+    frames.resize(count);
+    return frames;
+  }
+
+  // What a client built on a JSON DOM would do: parse, then read the few fields of every event.
+  struct DomPath {
+    void operator()(const std::string &frame) {
+      for (const auto &event: nlohmann::json::parse(frame)) {
+        total += std::stoull(event["client_order_id"].get<std::string>());
+        if (event.contains("remaining_amount")) {
+          total += static_cast<uint64_t>(std::stod(event["remaining_amount"].get<std::string>()) * 1e8);
+        }
+      }
+    }
+
+    uint64_t total{};
+  };
+
+  struct StreamingPath {
+    void operator()(const std::string &frame) {
+      uint64_t socket_sequence = 0;
+      client::GeminiOrderEventsParser::parse(frame, *this, socket_sequence);
+    }
+
+    void on_order_event(const client::GeminiOrderEvent &event) {
+      total += event.client_order_id + static_cast<uint64_t>(event.remaining_amount.fixed());
+    }
+
+    uint64_t total{};
+  };
+
+  template<typename Path>
+  void run(std::string_view label, Path &&path, const std::vector<std::string> &frames) {
+    for (const auto &frame: frames) path(frame);
+
+    bench::AllocationCounter allocations;
+    const auto start = bench::nowNanos();
+    for (const auto &frame: frames) path(frame);
+    const auto elapsed = bench::nowNanos() - start;
+    bench::printThroughput(label, frames.size(), elapsed);
+    std::printf("%-48s %.2f allocations/msg\n", "",
+                static_cast<double>(allocations.count()) / static_cast<double>(frames.size()));
+    bench::doNotOptimize(path.total);
+  }
+}
+
+// ns per order events frame on the execution client's thread, before the event is queued.
+BENCHMARK(GeminiOrderEventsParsing) {
+  const auto frames = makeOrderEventFrames(bench::scaled(200'000));
+  size_t bytes = 0;
+  for (const auto &frame: frames) bytes += frame.size();
+  std::printf("corpus: %zu frames, %.1f bytes/frame\n", frames.size(),
+              static_cast<double>(bytes) / static_cast<double>(frames.size()));
+  run("nlohmann DOM + std::stod", DomPath{}, frames);
+  run("GeminiOrderEventsParser", StreamingPath{}, frames);
+}
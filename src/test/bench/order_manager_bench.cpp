@@ -0,0 +1,71 @@
+#include <cstdio>
+
+#include "bench.h"
+#include "../../trading/order_manager.h"
+
+namespace {
+  using namespace util::literals;
+  using ReqMsg = client::WsOrderEntryClient::WsOrderEntryReqMsg;
+  using ResMsg = client::WsOrderEntryClient::WsOrderEntryResMsg;
+
+  // Acknowledges everything on the queue the way the exchange would, until the order manager goes quiet.
+  void ackAll(trading::OrderManager &order_manager, util::SpscQueue<ReqMsg> &requests) {
+    ReqMsg request;
+    while (requests.pop(request)) {
+      ResMsg res;
+      res.status = request.type == ReqMsg::RequestType::NEW_ORDER ? ResMsg::OrdStatus::NEW
+                                                                  : ResMsg::OrdStatus::CANCELED;
+      res.side = request.side;
+      res.client_order_id = request.client_order_id;
+      res.order_id = request.client_order_id;
+      order_manager.onOrderUpdate(res);
+    }
+  }
+
+  // Re-quote of a K level ladder whose prices all move: moveOrders() batching 2K cancels, then the cancel
+  // confirmations re-quoting every level and the acks of those news.
+  void run(size_t levels) {
+    util::SpscQueue<ReqMsg> requests{4 * levels + 16};
+    trading::OrderManager order_manager{
+      requests, 1, trading::OrderManagerConfig{.level_quantities = std::vector<util::Qty>(levels, 0.1_qty)}
+    };
+    order_manager.moveOrders(0, 100_px, 101_px);
+    ackAll(order_manager, requests);
+
+    const auto count = bench::scaled(100'000) / levels;
+    bench::LatencyStats move_stats(count);
+    bench::LatencyStats cycle_stats(count);
+    for (size_t i = 0; i < count; ++i) {
+      const auto shift = (i & 1) ? 0_px : 0.5_px;
+      const auto start = bench::nowNanos();
+      order_manager.moveOrders(0, 100_px - shift, 101_px + shift);
+      const auto moved = bench::nowNanos();
+      ackAll(order_manager, requests);
+      const auto end = bench::nowNanos();
+      move_stats.record(moved - start);
+      cycle_stats.record(end - start);
+    }
+
+    char label[64];
+    std::snprintf(label, sizeof(label), "%zu levels, moveOrders", levels);
+    move_stats.print(label);
+    std::snprintf(label, sizeof(label), "%zu levels, cancel + new + acks", levels);
+    cycle_stats.print(label);
+
+    // A re-quote at unchanged prices only compares.
+    order_manager.moveOrders(0, 100_px, 101_px);
+    ackAll(order_manager, requests);
+    const auto start = bench::nowNanos();
+    for (size_t i = 0; i < count; ++i) {
+      order_manager.moveOrders(0, 100_px, 101_px);
+    }
+    std::snprintf(label, sizeof(label), "%zu levels, unchanged prices", levels);
+    bench::printThroughput(label, count, bench::nowNanos() - start);
+  }
+}
+
+BENCHMARK(OrderManagerRequote) {
+  for (const size_t levels: {1, 10, 50}) {
+    run(levels);
+  }
+}
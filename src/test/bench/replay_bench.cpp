@@ -0,0 +1,40 @@
+#include <unistd.h>
+
+#include <cstdio>
+#include <filesystem>
+#include <string>
+
+#include "bench.h"
+#include "gemini_frames.h"
+#include "../../replay/frame_file.h"
+#include "../../replay/replay_driver.h"
+
+BENCHMARK(ReplayEndToEnd) {
+  const std::vector<std::string> names{"BTCGUSDPERP", "ETHGUSDPERP", "SOLGUSDPERP", "XRPGUSDPERP"};
+  const auto frames = bench::makeGeminiFrames(bench::scaled(500'000), names);
+  const auto path = (std::filesystem::temp_directory_path() /
+                     ("replay_bench." + std::to_string(::getpid()) + ".frames")).string();
+
+  {
+    replay::FrameWriter writer(path);
+    const auto start = bench::nowNanos();
+    for (const auto &frame: frames) {
+      writer.write(replay::wallClockNanos(), frame);
+    }
+    writer.flush();
+    bench::printThroughput("capture (FrameWriter::write)", frames.size(), bench::nowNanos() - start);
+  }
+
+  util::SymbolTable symbols;
+  for (const auto &name: names) {
+    symbols.add(name);
+  }
+  replay::FrameReader reader(path);
+  replay::ReplayDriver driver(symbols);
+  const auto stats = driver.run(reader);
+  bench::printThroughput("replay, frame -> book -> engine -> gateway", stats.frames, stats.elapsed_ns);
+  std::printf("%-48s %.1f MB/s, %lu new orders, %lu cancels\n", "",
+              static_cast<double>(stats.bytes) * 1e3 / static_cast<double>(stats.elapsed_ns), stats.new_orders,
+              stats.cancels);
+  std::filesystem::remove(path);
+}
@@ -0,0 +1,177 @@
+#include <atomic>
+#include <latch>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <boost/lockfree/spsc_queue.hpp>
+
+#include "bench.h"
+#include "../../util/padded_value.h"
+#include "../../util/spsc_queue.h"
+
+namespace {
+  // The queue as it was before the in-place API and power-of-two masking, kept as the baseline.
+  template<typename T>
+  class LegacySpscQueue final {
+  public:
+    explicit LegacySpscQueue(std::size_t maxElems) : store_(maxElems, T()) {
+    }
+
+    bool push(const T &elem) noexcept {
+      const auto idx = nextWriteIdx_.value.load(std::memory_order::relaxed);
+      const auto next_idx = increment(idx);
+      if (next_idx != nextReadIdx_.value.load(std::memory_order::acquire)) {
+        store_[idx] = elem;
+        nextWriteIdx_.value.store(next_idx, std::memory_order::release);
+        return true;
+      }
+      return false;
+    }
+
+    bool pop(T &elem) noexcept {
+      const auto idx = nextReadIdx_.value.load(std::memory_order::relaxed);
+      if (idx == nextWriteIdx_.value.load(std::memory_order::acquire)) {
+        return false;
+      }
+      elem = store_[idx];
+      nextReadIdx_.value.store(increment(idx), std::memory_order::release);
+      return true;
+    }
+
+  private:
+    size_t increment(size_t idx) const {
+      if (idx == store_.capacity() - 1) [[unlikely]] {
+        return 0;
+      }
+      return idx + 1;
+    }
+
+    std::vector<T> store_;
+    util::PaddedValue<std::atomic<size_t> > nextWriteIdx_{0};
+    util::PaddedValue<std::atomic<size_t> > nextReadIdx_{0};
+  };
+
+  struct Small {
+    int64_t x;
+  };
+
+  // Roughly what an order message with a few strings looked like on the queues.
+  struct WithStrings {
+    double price{};
+    double quantity{};
+    std::string side;
+    std::string order_id;
+    std::string client_order_id;
+  };
+
+  constexpr size_t QueueSize = 4096;
+
+  inline void produce(Small &item, size_t i) {
+    item.x = static_cast<int64_t>(i);
+  }
+
+  inline void produce(WithStrings &item, size_t i) {
+    item.price = static_cast<double>(i);
+    item.quantity = 0.1;
+    item.side = (i & 1) ? "bid" : "ask";
+    item.order_id = "order-id-that-does-not-fit-sso";
+    item.client_order_id = "client-order-id-that-does-not-fit-sso";
+  }
+
+  // Runs a producer thread and a consumer thread through `count` items and prints throughput.
+  template<typename Push, typename Pop>
+  void runThroughput(std::string_view label, size_t count, Push &&push, Pop &&pop) {
+    std::latch start_latch(2);
+    std::thread producer([&] {
+      start_latch.arrive_and_wait();
+      for (size_t i = 0; i < count;) {
+        if (push(i)) ++i;
+      }
+    });
+    start_latch.arrive_and_wait();
+    const auto start = bench::nowNanos();
+    for (size_t i = 0; i < count;) {
+      if (pop()) ++i;
+    }
+    const auto elapsed = bench::nowNanos() - start;
+    producer.join();
+    bench::printThroughput(label, count, elapsed);
+  }
+
+  template<typename T>
+  void runAll(std::string_view type_name, size_t count) {
+    const auto label = [&](std::string_view queue) {
+      return std::string(queue) + " <" + std::string(type_name) + ">";
+    };
+    {
+      LegacySpscQueue<T> queue(QueueSize);
+      T in{}, out{};
+      runThroughput(label("legacy SpscQueue push/pop"), count,
+                    [&](size_t i) { produce(in, i); return queue.push(in); },
+                    [&] { return queue.pop(out); });
+    }
+    {
+      util::SpscQueue<T> queue(QueueSize);
+      T in{}, out{};
+      runThroughput(label("SpscQueue push/pop"), count,
+                    [&](size_t i) { produce(in, i); return queue.push(in); },
+                    [&] { return queue.pop(out); });
+    }
+    {
+      util::SpscQueue<T> queue(QueueSize);
+      runThroughput(label("SpscQueue try_claim/commit + front/pop"), count,
+                    [&](size_t i) {
+                      auto *slot = queue.try_claim();
+                      if (!slot) return false;
+                      produce(*slot, i);
+                      queue.commit();
+                      return true;
+                    },
+                    [&] {
+                      auto *head = queue.front();
+                      if (!head) return false;
+                      bench::doNotOptimize(*head);
+                      queue.pop();
+                      return true;
+                    });
+    }
+    {
+      constexpr size_t Batch = 32;
+      util::SpscQueue<T> queue(QueueSize);
+      std::vector<T> in(Batch), out(Batch);
+      size_t pushed_total = 0, popped_total = 0;
+      std::latch start_latch(2);
+      std::thread producer([&] {
+        start_latch.arrive_and_wait();
+        while (pushed_total < count) {
+          const auto n = std::min(Batch, count - pushed_total);
+          for (size_t i = 0; i < n; ++i) produce(in[i], pushed_total + i);
+          size_t done = 0;
+          while (done < n) done += queue.push_n(in.data() + done, n - done);
+          pushed_total += n;
+        }
+      });
+      start_latch.arrive_and_wait();
+      const auto start = bench::nowNanos();
+      while (popped_total < count) {
+        popped_total += queue.pop_n(out.data(), Batch);
+      }
+      const auto elapsed = bench::nowNanos() - start;
+      producer.join();
+      bench::printThroughput(label("SpscQueue push_n/pop_n (32)"), count, elapsed);
+    }
+    {
+      boost::lockfree::spsc_queue<T> queue(QueueSize);
+      T in{}, out{};
+      runThroughput(label("boost::lockfree::spsc_queue"), count,
+                    [&](size_t i) { produce(in, i); return queue.push(in); },
+                    [&] { return queue.pop(out); });
+    }
+  }
+}
+
+BENCHMARK(SpscQueueThroughput) {
+  runAll<Small>("int64", bench::scaled(10'000'000));
+  runAll<WithStrings>("3 strings", bench::scaled(2'000'000));
+}
@@ -0,0 +1,68 @@
+#include <unistd.h>
+
+#include <cstdio>
+#include <filesystem>
+#include <string>
+
+#include "bench.h"
+#include "l2_corpus.h"
+#include "../../store/tick_store.h"
+#include "../../util/decimal.h"
+
+namespace {
+  // 2024-03-01T00:00:00Z
+  constexpr int64_t Day = 1709251200'000'000'000;
+}
+
+BENCHMARK(TickStoreAppendAndScan) {
+  const auto root = std::filesystem::temp_directory_path() / ("tick_store_bench." + std::to_string(::getpid()));
+  const util::SymbolTable symbols{"BTCGUSDPERP"};
+  const auto changes = bench::makeL2Corpus(bench::scaled(5'000'000));
+  // Spread over a day, about what a busy perp produces in l2 changes.
+  const auto spacing = 86'400'000'000'000 / static_cast<int64_t>(changes.size());
+
+  {
+    store::TickStoreWriter writer(symbols, store::TickStoreConfig{.root = root, .grow_rows = 1 << 20});
+    writer.start();
+    const auto start = bench::nowNanos();
+    for (size_t i = 0; i < changes.size(); ++i) {
+      const auto timestamp = Day + static_cast<int64_t>(i) * spacing;
+      while (!writer.appendL2Delta(0, timestamp, changes[i].side, util::Price::fromDouble(changes[i].price),
+                                   util::Qty::fromDouble(changes[i].quantity))) {
+        std::this_thread::yield();
+      }
+    }
+    const auto pushed = bench::nowNanos();
+    writer.stop();
+    const auto end = bench::nowNanos();
+    bench::printThroughput("append (producer side)", changes.size(), pushed - start);
+    bench::printThroughput("append until written and committed", changes.size(), end - start);
+  }
+
+  const auto l2 = store::openStream(root, store::utcDate(Day), "BTCGUSDPERP", store::Stream::L2_DELTAS);
+  {
+    const auto start = bench::nowNanos();
+    const auto prices = l2.prices();
+    const auto quantities = l2.quantities();
+    int64_t notional = 0;
+    for (size_t i = 0; i < l2.rows(); ++i) {
+      notional += prices[i] / 100000000 * (quantities[i] / 1000000);
+    }
+    bench::doNotOptimize(notional);
+    const auto elapsed = bench::nowNanos() - start;
+    bench::printThroughput("scan a day, price x quantity", l2.rows(), elapsed);
+    std::printf("%-48s %.0f MB/s\n", "", static_cast<double>(l2.rows() * 2 * sizeof(int64_t)) * 1e3 /
+                                         static_cast<double>(elapsed));
+  }
+  {
+    const auto seeks = bench::scaled(100'000);
+    size_t rows = 0;
+    const auto start = bench::nowNanos();
+    for (size_t i = 0; i < seeks; ++i) {
+      rows += l2.seek(Day + static_cast<int64_t>((i * 7919) % l2.rows()) * spacing);
+    }
+    bench::doNotOptimize(rows);
+    bench::printThroughput("seek by time", seeks, bench::nowNanos() - start);
+  }
+  std::filesystem::remove_all(root);
+}
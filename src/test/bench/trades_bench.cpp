@@ -0,0 +1,89 @@
+#include <unistd.h>
+
+#include <cstdio>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include "alloc_counter.h"
+#include "bench.h"
+#include "gemini_frames.h"
+#include "../../client/l2_book_builder.h"
+#include "../../replay/frame_file.h"
+#include "../../trading/feature_engine.h"
+#include "../../trading/market_maker.h"
+#include "../../trading/order_manager.h"
+#include "../../trading/trading_engine.h"
+
+namespace {
+  using client::WsOrderEntryClient;
+
+  template<typename OnFrame>
+  void run(std::string_view label, const std::vector<replay::Frame> &frames, OnFrame &&on_frame) {
+    for (const auto &frame: frames) on_frame(frame);
+
+    bench::AllocationCounter allocations;
+    const auto start = bench::nowNanos();
+    for (const auto &frame: frames) on_frame(frame);
+    const auto elapsed = bench::nowNanos() - start;
+    bench::printThroughput(label, frames.size(), elapsed);
+    std::printf("%-48s %.2f allocations/trade\n", "",
+                static_cast<double>(allocations.count()) / static_cast<double>(frames.size()));
+  }
+}
+
+// A recorded burst of trade frames replayed through the trades feed: parsed by the L2BookBuilder into
+// WsTradesMsg on the trade queue, then drained by the TradingEngine into the trade features. One thread, the
+// queue is drained after every frame.
+BENCHMARK(TradeBurst) {
+  const std::vector<std::string> names{"BTCGUSDPERP", "ETHGUSDPERP", "SOLGUSDPERP", "XRPGUSDPERP"};
+  const auto path = (std::filesystem::temp_directory_path() /
+                     ("trades_bench." + std::to_string(::getpid()) + ".frames")).string();
+  {
+    replay::FrameWriter writer(path);
+    for (const auto &frame: bench::makeGeminiTradeBurst(bench::scaled(1'000'000), names)) {
+      writer.write(replay::wallClockNanos(), frame);
+    }
+    writer.flush();
+  }
+  replay::FrameReader reader(path);
+  std::vector<replay::Frame> frames;
+  for (replay::Frame frame; reader.next(frame);) {
+    frames.push_back(frame);
+  }
+
+  util::SymbolTable symbols;
+  for (const auto &name: names) {
+    symbols.add(name);
+  }
+  util::LatestValueSlots<client::WsBestBidBestAskMsg> book_updates(symbols.size());
+  util::SpscQueue<client::WsTradesMsg> trades(1024);
+  client::L2BookBuilder builder(symbols, book_updates);
+  builder.set_trade_queue(trades);
+
+  {
+    client::WsTradesMsg trade;
+    int64_t checksum = 0;
+    run("frame -> WsTradesMsg on the queue", frames, [&](const replay::Frame &frame) {
+      builder.on_message(frame.data, frame.timestamp_ns);
+      trades.pop(trade);
+      checksum += trade.price.fixed();
+    });
+    bench::doNotOptimize(checksum);
+  }
+
+  util::SpscQueue<WsOrderEntryClient::WsOrderEntryReqMsg> order_entry_req_queue(1024);
+  util::SpscQueue<WsOrderEntryClient::WsOrderEntryResMsg> order_entry_res_queue(1024);
+  trading::FeatureEngine feature_engine(symbols.size());
+  trading::OrderManager order_manager(order_entry_req_queue, symbols.size());
+  trading::MarketMaker market_maker(order_manager, feature_engine);
+  trading::TradingEngine trading_engine(feature_engine, order_manager, market_maker, book_updates,
+                                        order_entry_res_queue);
+  trading_engine.setIncomingTrades(&trades);
+  run("frame -> queue -> engine trade features", frames, [&](const replay::Frame &frame) {
+    builder.on_message(frame.data, frame.timestamp_ns);
+    trading_engine.processPending();
+  });
+  bench::doNotOptimize(feature_engine.feature<trading::features::TradeFlowImbalance<32> >(0).value());
+  std::filesystem::remove(path);
+}
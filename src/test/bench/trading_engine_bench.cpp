@@ -0,0 +1,88 @@
+#include <array>
+#include <sstream>
+
+#include "bench.h"
+#include "../../trading/feature_engine.h"
+#include "../../trading/order_manager.h"
+#include "../../trading/market_maker.h"
+#include "../../trading/trading_engine.h"
+#include "../../util/latest_value.h"
+#include "../../util/spsc_queue.h"
+
+namespace {
+  using client::WsOrderBookClient;
+  using client::WsOrderEntryClient;
+  using namespace util::literals;
+
+  // Measures tick-to-order: from pushing a best bid / best ask update until both quotes
+  // show up on the outgoing order entry queue.
+  void runTickToOrder(util::WaitStrategyType wait_strategy, std::string_view label) {
+    util::LatestValueSlots<WsOrderBookClient::WsBestBidBestAskMsg> book_updates{1};
+    util::SpscQueue<WsOrderEntryClient::WsOrderEntryReqMsg> order_entry_req_queue{1024};
+    util::SpscQueue<WsOrderEntryClient::WsOrderEntryResMsg> order_entry_res_queue{1024};
+
+    trading::FeatureEngine feature_engine;
+    trading::OrderManager order_manager{order_entry_req_queue};
+    trading::MarketMaker market_maker{order_manager, feature_engine};
+    trading::TradingEngine trading_engine{
+      feature_engine, order_manager, market_maker, book_updates, order_entry_res_queue,
+      trading::TradingEngineConfig{.wait_strategy = wait_strategy}
+    };
+
+    const auto samples = bench::scaled(20000);
+    bench::LatencyStats stats(samples);
+
+    auto spin_until = [](auto &&done) {
+      for (uint32_t spins = 0; !done(); ++spins) {
+        // Yield every now and then so the engine can run when both threads share a core.
+        if ((spins & 0xff) == 0xff) std::this_thread::yield();
+        else util::cpuRelax();
+      }
+    };
+
+    trading_engine.start();
+    std::array<WsOrderEntryClient::WsOrderEntryReqMsg, 2> orders;
+    for (size_t i = 0; i < samples; ++i) {
+      WsOrderBookClient::WsBestBidBestAskMsg tick{
+        .best_bid = 100_px + 1_px * static_cast<int64_t>(i % 16),
+        .best_bid_quantity = 10_qty,
+        .best_ask = 102_px + 1_px * static_cast<int64_t>(i % 16),
+        .best_ask_quantity = 15_qty
+      };
+
+      const auto start = bench::nowNanos();
+      book_updates.store(0, tick);
+      trading_engine.notify();
+      spin_until([&] { return order_entry_req_queue.pop(orders[0]); });
+      spin_until([&] { return order_entry_req_queue.pop(orders[1]); });
+      stats.record(bench::nowNanos() - start);
+
+      // Reject both quotes so their levels are free and the next tick sends fresh orders.
+      for (auto &order: orders) {
+        WsOrderEntryClient::WsOrderEntryResMsg res;
+        res.status = WsOrderEntryClient::WsOrderEntryResMsg::OrdStatus::REJECTED;
+        res.side = order.side;
+        res.client_order_id = order.client_order_id;
+        order_entry_res_queue.push(res);
+      }
+      trading_engine.notify();
+      spin_until([&] { return order_entry_res_queue.empty(); });
+    }
+    trading_engine.stop();
+    stats.print(label);
+  }
+}
+
+BENCHMARK(TradingEngineTickToOrder) {
+  // The engine still logs through std::cout on every tick, keep that out of the numbers.
+  std::ostringstream sink;
+  auto *const cout_buf = std::cout.rdbuf(sink.rdbuf());
+  std::cout.setstate(std::ios::badbit);
+
+  runTickToOrder(util::WaitStrategyType::BUSY_SPIN, "tick-to-order busy-spin");
+  runTickToOrder(util::WaitStrategyType::SPIN_YIELD, "tick-to-order spin-yield");
+  runTickToOrder(util::WaitStrategyType::SPIN_PARK, "tick-to-order spin-park");
+
+  std::cout.clear();
+  std::cout.rdbuf(cout_buf);
+}
@@ -0,0 +1,132 @@
+#include <atomic>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "bench.h"
+#include "gemini_frames.h"
+#include "../mock/mock_ws_server.h"
+#include "../../client/ws_order_book_client.h"
+
+namespace {
+  namespace net = boost::asio;
+  namespace beast = boost::beast;
+  namespace websocket = beast::websocket;
+  using Msg = client::WsBestBidBestAskMsg;
+
+  // What WsOrderBookClient used to do: a blocking read into a fresh flat_buffer and a mutex per frame.
+  class BlockingReader {
+  public:
+    BlockingReader(uint16_t port, const util::SymbolTable &symbols, util::LatestValueSlots<Msg> &updates)
+      : ssl_ctx_(net::ssl::context::tlsv12_client), ws_(ioc_, ssl_ctx_), builder_(symbols, updates) {
+      ssl_ctx_.add_certificate_authority(net::buffer(mock::LocalhostCertificatePem.data(),
+                                                     mock::LocalhostCertificatePem.size()));
+      ssl_ctx_.set_verify_mode(net::ssl::verify_peer);
+      SSL_set_tlsext_host_name(ws_.next_layer().native_handle(), "localhost");
+      net::ip::tcp::resolver resolver(ioc_);
+      beast::get_lowest_layer(ws_).connect(resolver.resolve("localhost", std::to_string(port)));
+      beast::get_lowest_layer(ws_).socket().set_option(net::ip::tcp::no_delay(true));
+      ws_.next_layer().handshake(net::ssl::stream_base::client);
+      ws_.handshake("localhost", "/v2/marketdata");
+      ws_.write(net::buffer(std::string(R"({"type":"subscribe"})")));
+      thread_ = std::thread([this] { read(); });
+    }
+
+    ~BlockingReader() {
+      beast::error_code ignored;
+      beast::get_lowest_layer(ws_).socket().shutdown(net::ip::tcp::socket::shutdown_both, ignored);
+      thread_.join();
+    }
+
+    size_t frames() const noexcept {
+      return frames_.load(std::memory_order::relaxed);
+    }
+
+  private:
+    void read() {
+      beast::error_code ec;
+      while (!ec) {
+        beast::flat_buffer buffer;
+        ws_.read(buffer, ec);
+        if (ec) {
+          break;
+        }
+        std::lock_guard<std::mutex> lock(mutex_);
+        const auto data = buffer.data();
+        builder_.on_message(std::string_view(static_cast<const char *>(data.data()), data.size()),
+                            replay::wallClockNanos());
+        frames_.store(frames_.load(std::memory_order::relaxed) + 1, std::memory_order::relaxed);
+      }
+    }
+
+    net::io_context ioc_;
+    net::ssl::context ssl_ctx_;
+    websocket::stream<beast::ssl_stream<beast::tcp_stream> > ws_;
+    client::L2BookBuilder builder_;
+    std::mutex mutex_;
+    std::atomic<size_t> frames_{0};
+    std::thread thread_;
+  };
+
+  template<typename Frames>
+  void waitForFrames(Frames &&frames, size_t count) {
+    while (frames() < count) {
+      std::this_thread::yield();
+    }
+  }
+
+  // A burst of `frames` written back to back (throughput), then one frame at a time, each sent once the previous
+  // one is through the book builder (latency of a lone frame, wake up included).
+  template<typename Frames>
+  void measure(std::string_view label, mock::MockWsServer &server, const std::vector<std::string> &frames,
+               Frames &&processed) {
+    const auto base = processed();
+    auto start = bench::nowNanos();
+    server.send(frames);
+    waitForFrames(processed, base + frames.size());
+    bench::printThroughput(std::string(label) + ", burst", frames.size(), bench::nowNanos() - start);
+
+    const auto lone = std::min<size_t>(frames.size(), bench::scaled(5'000));
+    bench::LatencyStats stats(lone);
+    for (size_t i = 0; i < lone; ++i) {
+      start = bench::nowNanos();
+      server.send(frames[i]);
+      waitForFrames(processed, base + frames.size() + i + 1);
+      stats.record(bench::nowNanos() - start);
+    }
+    stats.print(std::string(label) + ", one frame at a time");
+  }
+}
+
+BENCHMARK(WsOrderBookClientFrames) {
+  const util::SymbolTable symbols{"BTCGUSDPERP"};
+  const auto frames = bench::makeGeminiFrames(bench::scaled(200'000));
+  util::LatestValueSlots<Msg> updates(symbols.size());
+  {
+    mock::MockWsServer server;
+    BlockingReader reader(server.port(), symbols, updates);
+    while (server.subscriptions().empty()) {
+      std::this_thread::yield();
+    }
+    measure("blocking read, buffer + mutex per frame", server, frames, [&] { return reader.frames(); });
+  }
+  // md.frames is shared by every client in the process, each measurement counts from where it starts.
+  const auto frame_counter = util::MetricsRegistry::instance().counter("md.frames");
+  for (const bool busy_poll: {false, true}) {
+    mock::MockWsServer server;
+    client::WsOrderBookClientConfig config;
+    config.busy_poll = busy_poll;
+    config.ca_certificate_pem = std::string(mock::LocalhostCertificatePem);
+    client::WsOrderBookClient client("wss://localhost:" + std::to_string(server.port()) + "/v2/marketdata",
+                                     symbols, updates, nullptr, config);
+    client.start();
+    while (server.subscriptions().empty()) {
+      std::this_thread::yield();
+    }
+    measure(busy_poll ? "async client, busy poll" : "async client, run_one", server, frames,
+            [&] { return static_cast<size_t>(frame_counter.value()); });
+    client.stop();
+  }
+}
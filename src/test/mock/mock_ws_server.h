@@ -0,0 +1,193 @@
+#pragma once
+
+#include <boost/beast/websocket.hpp>
+#include <boost/beast/websocket/ssl.hpp>
+#include <condition_variable>
+#include <deque>
+#include <vector>
+
+#include "mock_https_server.h"
+
+namespace mock {
+  namespace websocket = beast::websocket;
+
+  // Minimal secure WebSocket server on 127.0.0.1 for tests and benchmarks, one thread per connection, with the
+  // same certificate as MockHttpsServer. A connection counts as subscribed once its first message arrived,
+  // from then on it gets every frame passed to send(). Streams without a subscription message, like the order
+  // events, are served from the upgrade on when constructed with `wait_for_subscription` false.
+  class MockWsServer {
+  public:
+    explicit MockWsServer(bool wait_for_subscription = true)
+      : wait_for_subscription_(wait_for_subscription), ssl_ctx_(net::ssl::context::tlsv12_server), acceptor_(ioc_, tcp::endpoint(net::ip::make_address("127.0.0.1"), 0)) {
+      ssl_ctx_.use_certificate_chain(net::buffer(LocalhostCertificatePem.data(), LocalhostCertificatePem.size()));
+      ssl_ctx_.use_private_key(net::buffer(LocalhostPrivateKeyPem.data(), LocalhostPrivateKeyPem.size()),
+                               net::ssl::context::pem);
+      accept_thread_ = std::thread(&MockWsServer::accept, this);
+    }
+
+    MockWsServer(const MockWsServer &) = delete;
+
+    MockWsServer(const MockWsServer &&) = delete;
+
+    MockWsServer &operator=(const MockWsServer &) = delete;
+
+    MockWsServer &operator=(const MockWsServer &&) = delete;
+
+    ~MockWsServer() {
+      stop_ = true;
+      // Unblocks accept().
+      beast::error_code ignored;
+      tcp::socket waker(ioc_);
+      waker.connect(acceptor_.local_endpoint(), ignored);
+      accept_thread_.join();
+      dropConnections();
+      std::list<Connection> connections;
+      {
+        std::lock_guard<std::mutex> lock(mutex_);
+        connections.splice(connections.begin(), connections_);
+      }
+      for (auto &connection: connections) {
+        connection.thread.join();
+      }
+    }
+
+    uint16_t port() const {
+      return acceptor_.local_endpoint().port();
+    }
+
+    size_t connectionsAccepted() const noexcept {
+      return connections_accepted_.load();
+    }
+
+    // First message of every connection so far, in order.
+    std::vector<std::string> subscriptions() const {
+      std::lock_guard<std::mutex> lock(mutex_);
+      return subscriptions_;
+    }
+
+    // Upgrade request of every connection so far, in order, for the headers. Without waiting for a
+    // subscription a connection gets the frames passed to send() once its request is here.
+    std::vector<http::request<http::string_body> > handshakes() const {
+      std::lock_guard<std::mutex> lock(mutex_);
+      return handshakes_;
+    }
+
+    // Queues `frames` on every subscribed connection.
+    void send(const std::vector<std::string> &frames) {
+      {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (auto &connection: connections_) {
+          if (connection.subscribed && connection.fd >= 0) {
+            connection.outbox.insert(connection.outbox.end(), frames.begin(), frames.end());
+          }
+        }
+      }
+      cv_.notify_all();
+    }
+
+    void send(const std::string &frame) {
+      send(std::vector<std::string>{frame});
+    }
+
+    // Closes every open connection under the clients' feet, without a close handshake.
+    void dropConnections() {
+      {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (auto &connection: connections_) {
+          if (connection.fd >= 0) {
+            ::shutdown(connection.fd, SHUT_RDWR);
+            connection.dropped = true;
+          }
+        }
+      }
+      cv_.notify_all();
+    }
+
+  private:
+    struct Connection {
+      int fd; // -1 once closed, so dropConnections() never hits a reused descriptor
+      std::thread thread;
+      bool subscribed{false};
+      bool dropped{false};
+      std::deque<std::string> outbox;
+    };
+
+    void accept() {
+      while (!stop_) {
+        beast::error_code ec;
+        tcp::socket socket(ioc_);
+        acceptor_.accept(socket, ec);
+        if (ec || stop_) {
+          continue;
+        }
+        ++connections_accepted_;
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto &connection = connections_.emplace_back();
+        connection.fd = socket.native_handle();
+        connection.thread = std::thread(&MockWsServer::serve, this, &connection, std::move(socket));
+      }
+    }
+
+    void serve(Connection *connection, tcp::socket socket) {
+      beast::error_code ec;
+      socket.set_option(tcp::no_delay(true), ec);
+      websocket::stream<beast::ssl_stream<tcp::socket> > ws(std::move(socket), ssl_ctx_);
+      ws.next_layer().handshake(net::ssl::stream_base::server, ec);
+      beast::flat_buffer buffer;
+      http::request<http::string_body> request;
+      if (!ec) {
+        http::read(ws.next_layer(), buffer, request, ec);
+      }
+      if (!ec) {
+        ws.accept(request, ec);
+      }
+      if (!ec) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        handshakes_.push_back(request);
+        connection->subscribed = !wait_for_subscription_;
+      }
+      if (!ec && wait_for_subscription_) {
+        buffer.clear();
+        ws.read(buffer, ec);
+        if (!ec) {
+          std::lock_guard<std::mutex> lock(mutex_);
+          subscriptions_.push_back(beast::buffers_to_string(buffer.data()));
+          connection->subscribed = true;
+        }
+      }
+      ws.text(true);
+      std::deque<std::string> frames;
+      while (!ec) {
+        {
+          std::unique_lock<std::mutex> lock(mutex_);
+          cv_.wait(lock, [&] { return connection->dropped || stop_ || !connection->outbox.empty(); });
+          if (connection->dropped || stop_) {
+            break;
+          }
+          frames.swap(connection->outbox);
+        }
+        for (; !frames.empty() && !ec; frames.pop_front()) {
+          ws.write(net::buffer(frames.front()), ec);
+        }
+        frames.clear();
+      }
+      std::lock_guard<std::mutex> lock(mutex_);
+      connection->fd = -1;
+      connection->subscribed = false;
+      beast::get_lowest_layer(ws).close(ec);
+    }
+
+    const bool wait_for_subscription_;
+    net::io_context ioc_;
+    net::ssl::context ssl_ctx_;
+    tcp::acceptor acceptor_;
+    std::thread accept_thread_;
+    std::atomic<bool> stop_{false};
+    std::atomic<size_t> connections_accepted_{0};
+    mutable std::mutex mutex_;
+    std::condition_variable cv_;
+    std::list<Connection> connections_;
+    std::vector<std::string> subscriptions_;
+    std::vector<http::request<http::string_body> > handshakes_;
+  };
+}
@@ -0,0 +1,241 @@
+#include <random>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "../../backtest/backtester.h"
+#include "../../backtest/sim_exchange.h"
+
+namespace backtest {
+    using namespace util::literals;
+
+    namespace {
+        using ReqMsg = SimExchange::ReqMsg;
+        using ResMsg = SimExchange::ResMsg;
+
+        struct SimExchangeHarness {
+            explicit SimExchangeHarness(const SimExchangeConfig &config = {.request_latency_ns = 0,
+                                                                            .response_latency_ns = 0})
+                : requests(64), responses(64), exchange(requests, responses, config) {
+            }
+
+            void send(ReqMsg::RequestType type, client::Side side, util::Price price, util::Qty quantity,
+                      uint64_t client_order_id) {
+                ReqMsg msg;
+                msg.type = type;
+                msg.side = side;
+                msg.price = price;
+                msg.quantity = quantity;
+                msg.client_order_id = client_order_id;
+                requests.push(msg);
+            }
+
+            void delta(client::Side side, util::Price price, util::Qty quantity) {
+                exchange.onL2Delta(side, price, quantity);
+            }
+
+            void trade(client::Side aggressor, util::Price price, util::Qty quantity) {
+                exchange.onTrade(0, aggressor, price, quantity);
+            }
+
+            std::vector<ResMsg> drain(int64_t now = 0) {
+                exchange.acceptRequests(now);
+                exchange.advance(now);
+                std::vector<ResMsg> out;
+                ResMsg msg;
+                while (responses.pop(msg)) {
+                    out.push_back(msg);
+                }
+                return out;
+            }
+
+            util::SpscQueue<ReqMsg> requests;
+            util::SpscQueue<ResMsg> responses;
+            SimExchange exchange;
+        };
+
+        // A wandering two sided book with trades hitting the top levels, timestamps in milliseconds.
+        struct Ticks {
+            std::vector<int64_t> timestamps, prices, quantities;
+            std::vector<int8_t> sides;
+
+            void add(int64_t ts, client::Side side, double price, double quantity) {
+                timestamps.push_back(ts);
+                sides.push_back(static_cast<int8_t>(side));
+                prices.push_back(util::doubleToFixed(price));
+                quantities.push_back(util::doubleToFixed(quantity));
+            }
+
+            TickColumns columns() const {
+                return TickColumns{timestamps, sides, prices, quantities};
+            }
+        };
+
+        void makeTicks(Ticks &l2, Ticks &trades) {
+            std::mt19937_64 rng(7);
+            int64_t mid = 60000;
+            for (int64_t ts = 1'000'000; ts < 2'000'000'000; ts += 1'000'000) {
+                if (rng() % 4 == 0) {
+                    const bool up = rng() % 2 == 0;
+                    trades.add(ts, up ? client::Side::BID : client::Side::ASK, static_cast<double>(up ? mid + 1 : mid - 1),
+                               0.5);
+                    mid += up ? 1 : -1;
+                }
+                for (int64_t d = 1; d <= 3; ++d) {
+                    l2.add(ts, client::Side::BID, static_cast<double>(mid - d), 0.1 * static_cast<double>(1 + rng() % 5));
+                    l2.add(ts, client::Side::ASK, static_cast<double>(mid + d), 0.1 * static_cast<double>(1 + rng() % 5));
+                }
+                l2.add(ts, client::Side::BID, static_cast<double>(mid), 0.0);
+                l2.add(ts, client::Side::ASK, static_cast<double>(mid), 0.0);
+            }
+        }
+
+        void expectSameResult(const BacktestResult &a, const BacktestResult &b) {
+            EXPECT_EQ(a.book_updates, b.book_updates);
+            EXPECT_EQ(a.trades, b.trades);
+            EXPECT_EQ(a.new_orders, b.new_orders);
+            EXPECT_EQ(a.cancels, b.cancels);
+            EXPECT_EQ(a.fills, b.fills);
+            EXPECT_DOUBLE_EQ(a.position, b.position);
+            EXPECT_DOUBLE_EQ(a.cash, b.cash);
+        }
+    }
+
+    TEST(SimExchangeTest, TradesFillAfterTheQueueAhead) {
+        SimExchangeHarness h;
+        h.delta(client::Side::BID, 100.0_px, 2.0_qty);
+        h.send(ReqMsg::RequestType::NEW_ORDER, client::Side::BID, 100.0_px, 1.0_qty, 7);
+        auto responses = h.drain();
+        ASSERT_EQ(responses.size(), 1u);
+        ASSERT_EQ(responses[0].status, ResMsg::OrdStatus::NEW);
+        ASSERT_EQ(responses[0].client_order_id, 7u);
+
+        // Buys don't touch our bid, sells at our price eat the 2.0 ahead of us first.
+        h.trade(client::Side::BID, 100.0_px, 5.0_qty);
+        h.trade(client::Side::ASK, 100.0_px, 1.5_qty);
+        ASSERT_TRUE(h.drain().empty());
+        h.trade(client::Side::ASK, 100.0_px, 1.0_qty);
+        responses = h.drain();
+        ASSERT_EQ(responses.size(), 1u);
+        ASSERT_EQ(responses[0].status, ResMsg::OrdStatus::PARTIALLY_FILLED);
+        ASSERT_EQ(responses[0].leaves_qty, 0.5_qty);
+
+        // A trade through our price fills the rest whatever its size.
+        h.trade(client::Side::ASK, 99.0_px, 0.01_qty);
+        responses = h.drain();
+        ASSERT_EQ(responses.size(), 1u);
+        ASSERT_EQ(responses[0].status, ResMsg::OrdStatus::FILLED);
+        ASSERT_EQ(responses[0].leaves_qty, 0_qty);
+        ASSERT_EQ(h.exchange.restingOrders(), 0u);
+        ASSERT_EQ(h.exchange.position(), 1_qty);
+        ASSERT_DOUBLE_EQ(h.exchange.cash(), -100.0);
+        ASSERT_EQ(h.exchange.fills(), 2u);
+    }
+
+    TEST(SimExchangeTest, CancellationsAheadMoveUsUp) {
+        SimExchangeHarness h;
+        h.delta(client::Side::ASK, 101.0_px, 2.0_qty);
+        h.send(ReqMsg::RequestType::NEW_ORDER, client::Side::ASK, 101.0_px, 1.0_qty, 1);
+        h.drain();
+        // Only 0.5 of the 2.0 ahead is left, growing the level again puts others behind us.
+        h.delta(client::Side::ASK, 101.0_px, 0.5_qty);
+        h.delta(client::Side::ASK, 101.0_px, 3.0_qty);
+        h.trade(client::Side::BID, 101.0_px, 0.7_qty);
+        const auto responses = h.drain();
+        ASSERT_EQ(responses.size(), 1u);
+        ASSERT_EQ(responses[0].status, ResMsg::OrdStatus::PARTIALLY_FILLED);
+        ASSERT_EQ(responses[0].leaves_qty, 0.8_qty);
+        ASSERT_EQ(h.exchange.position(), -0.2_qty);
+    }
+
+    TEST(SimExchangeTest, CrossingOrdersTakeLiquidity) {
+        SimExchangeHarness h;
+        h.delta(client::Side::ASK, 101.0_px, 0.3_qty);
+        h.delta(client::Side::ASK, 102.0_px, 1.0_qty);
+        h.send(ReqMsg::RequestType::NEW_ORDER, client::Side::BID, 102.0_px, 0.5_qty, 1);
+        const auto responses = h.drain();
+        ASSERT_EQ(responses.size(), 3u);
+        ASSERT_EQ(responses[0].status, ResMsg::OrdStatus::NEW);
+        ASSERT_EQ(responses[1].status, ResMsg::OrdStatus::PARTIALLY_FILLED);
+        ASSERT_EQ(responses[2].status, ResMsg::OrdStatus::FILLED);
+        ASSERT_EQ(h.exchange.position(), 0.5_qty);
+        ASSERT_DOUBLE_EQ(h.exchange.cash(), -(101.0 * 0.3 + 102.0 * 0.2));
+        ASSERT_EQ(h.exchange.restingOrders(), 0u);
+        ASSERT_EQ(h.exchange.book().bestAsk().price_ticks, h.exchange.book().toTicks(102_px));
+        ASSERT_EQ(h.exchange.book().bestAsk().quantity, 0.8_qty);
+    }
+
+    TEST(SimExchangeTest, CancelsAndLateCancels) {
+        SimExchangeHarness h;
+        h.delta(client::Side::BID, 100.0_px, 1.0_qty);
+        h.send(ReqMsg::RequestType::NEW_ORDER, client::Side::BID, 100.0_px, 1.0_qty, 1);
+        h.send(ReqMsg::RequestType::NEW_ORDER, client::Side::BID, 99.0_px, 1.0_qty, 2);
+        h.drain();
+        h.send(ReqMsg::RequestType::CANCEL_ORDER, client::Side::BID, 0.0_px, 0.0_qty, 1);
+        auto responses = h.drain();
+        ASSERT_EQ(responses.size(), 1u);
+        ASSERT_EQ(responses[0].status, ResMsg::OrdStatus::CANCELED);
+        ASSERT_EQ(h.exchange.restingOrders(), 1u);
+
+        h.trade(client::Side::ASK, 98.0_px, 1.0_qty);
+        h.send(ReqMsg::RequestType::CANCEL_ORDER, client::Side::BID, 0.0_px, 0.0_qty, 2);
+        responses = h.drain();
+        ASSERT_EQ(responses.size(), 2u);
+        ASSERT_EQ(responses[0].status, ResMsg::OrdStatus::FILLED);
+        ASSERT_EQ(responses[1].status, ResMsg::OrdStatus::REJECTED);
+        ASSERT_EQ(h.exchange.cancels(), 1u);
+    }
+
+    TEST(SimExchangeTest, LatencyDelaysRequestsAndResponses) {
+        SimExchangeHarness h({.request_latency_ns = 1'000, .response_latency_ns = 500});
+        h.send(ReqMsg::RequestType::NEW_ORDER, client::Side::BID, 100.0_px, 1.0_qty, 1);
+        ASSERT_EQ(h.exchange.acceptRequests(0), 1u);
+        ASSERT_EQ(h.exchange.nextEventTime(10'000), 1'000);
+        ASSERT_EQ(h.exchange.advance(999), 0u);
+        ASSERT_EQ(h.exchange.advance(1'000), 1u);
+        ASSERT_EQ(h.exchange.restingOrders(), 1u);
+        ASSERT_TRUE(h.responses.empty());
+        ASSERT_EQ(h.exchange.nextEventTime(10'000), 1'500);
+        ASSERT_EQ(h.exchange.advance(1'500), 1u);
+        ASSERT_FALSE(h.responses.empty());
+        ASSERT_EQ(h.exchange.nextEventTime(10'000), 10'000);
+    }
+
+    TEST(BacktesterTest, QuotesTradesAndIsDeterministic) {
+        Ticks l2, trades;
+        makeTicks(l2, trades);
+        BacktestConfig config;
+        config.order_manager.level_quantities = {0.1_qty, 0.2_qty};
+        config.exchange.book.tick_size = 1_px;
+
+        // Backtests run side by side, their engines keep out of the process wide metrics.
+        const auto book_updates = util::MetricsRegistry::instance().counter("engine.book_updates").value();
+        Backtester first(l2.columns(), trades.columns(), config);
+        const auto result = first.run();
+        ASSERT_EQ(util::MetricsRegistry::instance().counter("engine.book_updates").value(), book_updates);
+        ASSERT_EQ(result.book_updates, l2.timestamps.size());
+        ASSERT_EQ(result.trades, trades.timestamps.size());
+        ASSERT_GT(result.new_orders, 0u);
+        ASSERT_GT(result.cancels, 0u);
+        ASSERT_GT(result.fills, 0u);
+
+        Backtester second(l2.columns(), trades.columns(), config);
+        expectSameResult(second.run(), result);
+    }
+
+    TEST(BacktesterTest, ParallelRunsMatchSingleRuns) {
+        Ticks l2, trades;
+        makeTicks(l2, trades);
+        std::vector<BacktestConfig> configs(4);
+        for (size_t i = 0; i < configs.size(); ++i) {
+            configs[i].exchange.book.tick_size = 1_px;
+            configs[i].exchange.request_latency_ns = static_cast<int64_t>(i) * 1'000'000;
+        }
+
+        const auto results = runBacktests(l2.columns(), trades.columns(), configs, 3);
+        ASSERT_EQ(results.size(), configs.size());
+        for (size_t i = 0; i < configs.size(); ++i) {
+            Backtester backtester(l2.columns(), trades.columns(), configs[i]);
+            expectSameResult(results[i], backtester.run());
+        }
+    }
+}
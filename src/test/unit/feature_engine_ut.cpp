@@ -1,57 +1,251 @@
+#include <array>
+#include <bit>
+#include <cmath>
+#include <random>
+#include <string>
+
 #include "gtest/gtest.h"
 #include "../../trading/feature_engine.h"
 
 namespace trading {
+    using namespace util::literals;
+
     class FeatureEngineTest : public ::testing::Test {
     protected:
         FeatureEngine featureEngine;
     };
 
     TEST_F(FeatureEngineTest, FairPriceCalculationWithValidData) {
-        double best_bid = 100.0;
-        double best_bid_quantity = 10.0;
-        double best_ask = 102.0;
-        double best_ask_quantity = 15.0;
+        util::Price best_bid = 100.0_px;
+        util::Qty best_bid_quantity = 10.0_qty;
+        util::Price best_ask = 102.0_px;
+        util::Qty best_ask_quantity = 15.0_qty;
 
-        featureEngine.onBestBidBestAskUpdate(best_bid, best_bid_quantity, best_ask, best_ask_quantity);
-        double fair_price = featureEngine.getFairPrice();
+        featureEngine.onBestBidBestAskUpdate(0, best_bid, best_bid_quantity, best_ask, best_ask_quantity);
+        const auto fair_price = featureEngine.getFairPrice();
 
-        ASSERT_DOUBLE_EQ(fair_price, 101.2);
+        ASSERT_EQ(fair_price, 101.2_px);
     }
 
     TEST_F(FeatureEngineTest, FairPriceCalculationWithZeroBidAndAsk) {
-        double best_bid = 0.0;
-        double best_bid_quantity = 0.0;
-        double best_ask = 0.0;
-        double best_ask_quantity = 0.0;
+        util::Price best_bid = 0.0_px;
+        util::Qty best_bid_quantity = 0.0_qty;
+        util::Price best_ask = 0.0_px;
+        util::Qty best_ask_quantity = 0.0_qty;
 
-        featureEngine.onBestBidBestAskUpdate(best_bid, best_bid_quantity, best_ask, best_ask_quantity);
-        double fair_price = featureEngine.getFairPrice();
+        featureEngine.onBestBidBestAskUpdate(0, best_bid, best_bid_quantity, best_ask, best_ask_quantity);
+        const auto fair_price = featureEngine.getFairPrice();
 
-        ASSERT_DOUBLE_EQ(fair_price, 0.0);
+        ASSERT_EQ(fair_price, 0.0_px);
     }
 
     TEST_F(FeatureEngineTest, FairPriceCalculationWithOnlyValidBid) {
-        double best_bid = 100.0;
-        double best_bid_quantity = 10.0;
-        double best_ask = 0.0;
-        double best_ask_quantity = 0.0;
+        util::Price best_bid = 100.0_px;
+        util::Qty best_bid_quantity = 10.0_qty;
+        util::Price best_ask = 0.0_px;
+        util::Qty best_ask_quantity = 0.0_qty;
 
-        featureEngine.onBestBidBestAskUpdate(best_bid, best_bid_quantity, best_ask, best_ask_quantity);
-        double fair_price = featureEngine.getFairPrice();
+        featureEngine.onBestBidBestAskUpdate(0, best_bid, best_bid_quantity, best_ask, best_ask_quantity);
+        const auto fair_price = featureEngine.getFairPrice();
 
-        ASSERT_DOUBLE_EQ(fair_price, 0.0);
+        ASSERT_EQ(fair_price, 0.0_px);
     }
 
     TEST_F(FeatureEngineTest, FairPriceCalculationWithOnlyValidAsk) {
-        double best_bid = 0.0;
-        double best_bid_quantity = 0.0;
-        double best_ask = 102.0;
-        double best_ask_quantity = 15.0;
+        util::Price best_bid = 0.0_px;
+        util::Qty best_bid_quantity = 0.0_qty;
+        util::Price best_ask = 102.0_px;
+        util::Qty best_ask_quantity = 15.0_qty;
+
+        featureEngine.onBestBidBestAskUpdate(0, best_bid, best_bid_quantity, best_ask, best_ask_quantity);
+        const auto fair_price = featureEngine.getFairPrice();
+
+        ASSERT_EQ(fair_price, 0.0_px);
+    }
+
+    TEST(FeatureEngineMultiSymbolTest, FairPricesAreKeptPerSymbol) {
+        FeatureEngine featureEngine(3);
+        featureEngine.onBestBidBestAskUpdate(2, 100.0_px, 10.0_qty, 102.0_px, 15.0_qty);
+        featureEngine.onBestBidBestAskUpdate(0, 50.0_px, 1.0_qty, 52.0_px, 1.0_qty);
+
+        ASSERT_EQ(featureEngine.getFairPrice(0), 51.0_px);
+        ASSERT_EQ(featureEngine.getFairPrice(1), 0.0_px);
+        ASSERT_EQ(featureEngine.getFairPrice(2), 101.2_px);
+    }
+
+    TEST(FeatureEngineFeaturesTest, BookFeatures) {
+        FeatureEngine featureEngine;
+        const std::array<util::Qty, 4> bid_depth{1.0_qty, 2.0_qty, 0.0_qty, 0.0_qty};
+        const std::array<util::Qty, 4> ask_depth{4.0_qty, 0.0_qty, 0.0_qty, 0.0_qty};
+        featureEngine.onBestBidBestAskUpdate(0, 100.0_px, 3.0_qty, 102.0_px, 1.0_qty, bid_depth, ask_depth);
+
+        // Leans towards the ask, there is less of it.
+        ASSERT_DOUBLE_EQ(featureEngine.feature<features::Microprice>().value(), 101.5);
+        ASSERT_DOUBLE_EQ(featureEngine.feature<features::BookImbalance<1>>().value(), 0.5);
+        ASSERT_DOUBLE_EQ(featureEngine.feature<features::BookImbalance<client::BookDepthLevels>>().value(), 1.0 / 11);
+        ASSERT_DOUBLE_EQ(featureEngine.feature<features::SpreadStats<256>>().last(), 2.0);
+        ASSERT_DOUBLE_EQ(featureEngine.feature<features::SpreadStats<256>>().mean(), 2.0);
 
-        featureEngine.onBestBidBestAskUpdate(best_bid, best_bid_quantity, best_ask, best_ask_quantity);
-        double fair_price = featureEngine.getFairPrice();
+        // A one sided book keeps the spread and breaks the volatility series.
+        featureEngine.onBestBidBestAskUpdate(0, 100.0_px, 3.0_qty, 0.0_px, 0.0_qty);
+        ASSERT_DOUBLE_EQ(featureEngine.feature<features::Microprice>().value(), 0.0);
+        ASSERT_DOUBLE_EQ(featureEngine.feature<features::SpreadStats<256>>().last(), 2.0);
+        featureEngine.onBestBidBestAskUpdate(0, 110.0_px, 1.0_qty, 112.0_px, 1.0_qty);
+        ASSERT_DOUBLE_EQ(featureEngine.feature<features::EwmaVolatility<16>>().value(), 0.0);
+    }
 
-        ASSERT_DOUBLE_EQ(fair_price, 0.0);
+    TEST(FeatureEngineFeaturesTest, EwmaHalfLives) {
+        ASSERT_NEAR(std::pow(features::EwmaVolatility<16>::Decay, 16), 0.5, 1e-12);
+        ASSERT_NEAR(std::pow(features::EwmaVolatility<4096>::Decay, 4096), 0.5, 1e-12);
+
+        // The mid moves 1% every update: every volatility converges to 1%, the shortest half-life first.
+        FeatureEngine featureEngine;
+        double mid = 100.0;
+        for (int i = 0; i < 64; ++i) {
+            featureEngine.onBestBidBestAskUpdate(0, util::Price::fromDouble(mid - 0.5), 1.0_qty,
+                                                 util::Price::fromDouble(mid + 0.5), 1.0_qty);
+            mid *= i % 2 ? 1.01 : 1.0 / 1.01;
+        }
+        const auto fast = featureEngine.feature<features::EwmaVolatility<16>>().value();
+        const auto slow = featureEngine.feature<features::EwmaVolatility<4096>>().value();
+        ASSERT_NEAR(fast, 0.01, 0.002);
+        ASSERT_GT(fast, slow);
+        ASSERT_GT(slow, 0.0);
     }
+
+    TEST(FeatureEngineFeaturesTest, TradeFlowImbalance) {
+        FeatureEngine featureEngine(2);
+        ASSERT_DOUBLE_EQ(featureEngine.feature<features::TradeFlowImbalance<32>>().value(), 0.0);
+        featureEngine.onTrade(1, client::Side::BID, 100.0_px, 3.0_qty);
+        featureEngine.onTrade(1, client::Side::ASK, 100.0_px, 1.0_qty);
+        // Bought 3 then sold 1, the older trade has decayed by one step.
+        const auto decay = features::TradeFlowImbalance<32>::Decay;
+        ASSERT_DOUBLE_EQ(featureEngine.feature<features::TradeFlowImbalance<32>>(1).value(),
+                         (3.0 * decay - 1.0) / (3.0 * decay + 1.0));
+        ASSERT_DOUBLE_EQ(featureEngine.feature<features::TradeFlowImbalance<32>>(0).value(), 0.0);
+    }
+
+    namespace {
+        struct CountBooks {
+            size_t books{};
+
+            void onBook(const features::BookTick &) noexcept {
+                ++books;
+            }
+        };
+
+        struct CountTrades {
+            size_t trades{};
+
+            void onTrade(const features::TradeTick &) noexcept {
+                ++trades;
+            }
+        };
+    }
+
+    TEST(FeaturePipelineTest, KernelsOnlySeeTheirEvents) {
+        features::FeaturePipeline<CountBooks, CountTrades, features::WeightedMid> pipeline(2);
+        static_assert(decltype(pipeline)::numKernels() == 3);
+        pipeline.onBook(1, features::BookTick::make(100.0_px, 10.0_qty, 102.0_px, 15.0_qty));
+        pipeline.onBook(1, features::BookTick::make(100.0_px, 10.0_qty, 102.0_px, 15.0_qty));
+        pipeline.onTrade(1, features::TradeTick{client::Side::BID, 101.0_px, 1.0_qty});
+
+        ASSERT_EQ(pipeline.get<CountBooks>(1).books, 2u);
+        ASSERT_EQ(pipeline.get<CountTrades>(1).trades, 1u);
+        ASSERT_EQ(pipeline.get<features::WeightedMid>(1).price(), 101.2_px);
+        ASSERT_EQ(pipeline.get<CountBooks>(0).books, 0u);
+    }
+
+    namespace {
+        // Tops of book around 60000 with a zero somewhere in one row out of five, and now and then a value too
+        // large for the AVX2 conversion.
+        features::TopOfBookBatch makeBatch(size_t rows, std::mt19937_64 &random) {
+            features::TopOfBookBatch batch(rows);
+            std::uniform_int_distribution<int64_t> price(5'999'000'000'000, 6'001'000'000'000);
+            std::uniform_int_distribution<int64_t> quantity(1, 5'000'000'000);
+            std::uniform_int_distribution<int> pick(0, 19);
+            for (size_t row = 0; row < rows; ++row) {
+                std::array<int64_t, 4> values{price(random), quantity(random), price(random), quantity(random)};
+                if (const auto p = pick(random); p < 4) {
+                    values[p] = 0;
+                } else if (p == 4) {
+                    values[1] = int64_t{1} << 53;
+                }
+                batch.push(static_cast<util::SymbolId>(row), util::Price::fromFixed(values[0]),
+                           util::Qty::fromFixed(values[1]), util::Price::fromFixed(values[2]),
+                           util::Qty::fromFixed(values[3]));
+            }
+            return batch;
+        }
+
+        bool sameBits(double a, double b) {
+            return std::bit_cast<uint64_t>(a) == std::bit_cast<uint64_t>(b);
+        }
+    }
+
+    class TopOfBookBatchTest : public ::testing::TestWithParam<util::SimdLevel> {
+    protected:
+        void SetUp() override {
+            if (!util::simdLevelSupported(GetParam())) {
+                GTEST_SKIP() << util::SimdLevelNames[static_cast<size_t>(GetParam())] << " not supported here";
+            }
+        }
+    };
+
+    TEST_P(TopOfBookBatchTest, MatchesTheScalarPathBitForBit) {
+        std::mt19937_64 random(42);
+        // Every tail length of both vector widths.
+        for (size_t rows = 0; rows < 40; ++rows) {
+            auto batch = makeBatch(rows, random);
+            features::evaluateTopOfBook(batch, GetParam());
+            for (size_t row = 0; row < rows; ++row) {
+                SCOPED_TRACE(testing::Message() << "rows " << rows << ", row " << row);
+                const auto expected = features::TopOfBookValues::derive(
+                    batch.best_bids[row], batch.best_bid_quantities[row], batch.best_asks[row],
+                    batch.best_ask_quantities[row]);
+                ASSERT_EQ(batch.two_sided[row] != 0, expected.two_sided);
+                ASSERT_TRUE(sameBits(batch.bid_quantities[row], expected.bid_quantity));
+                ASSERT_TRUE(sameBits(batch.ask_quantities[row], expected.ask_quantity));
+                ASSERT_TRUE(sameBits(batch.mids[row], expected.mid));
+                ASSERT_TRUE(sameBits(batch.spreads[row], expected.spread));
+                ASSERT_TRUE(sameBits(batch.microprices[row], expected.microprice));
+                ASSERT_EQ(batch.weighted_mids[row], expected.weighted_mid.fixed());
+            }
+        }
+    }
+
+    TEST_P(TopOfBookBatchTest, FeatureEngineBatchesLikeSingleUpdates) {
+        constexpr size_t Symbols = 13;
+        FeatureEngine batched(Symbols, GetParam());
+        FeatureEngine single(Symbols);
+        std::mt19937_64 random(7);
+        for (int pass = 0; pass < 50; ++pass) {
+            auto batch = makeBatch(Symbols, random);
+            batched.onBestBidBestAskBatch(batch);
+            for (size_t row = 0; row < Symbols; ++row) {
+                single.onBestBidBestAskUpdate(batch.symbol_ids[row], util::Price::fromFixed(batch.best_bids[row]),
+                                              util::Qty::fromFixed(batch.best_bid_quantities[row]),
+                                              util::Price::fromFixed(batch.best_asks[row]),
+                                              util::Qty::fromFixed(batch.best_ask_quantities[row]));
+            }
+        }
+        for (util::SymbolId id = 0; id < Symbols; ++id) {
+            ASSERT_EQ(batched.getFairPrice(id), single.getFairPrice(id));
+            ASSERT_TRUE(sameBits(batched.feature<features::Microprice>(id).value(),
+                                 single.feature<features::Microprice>(id).value()));
+            ASSERT_TRUE(sameBits(batched.feature<features::EwmaVolatility<16>>(id).value(),
+                                 single.feature<features::EwmaVolatility<16>>(id).value()));
+            ASSERT_TRUE(sameBits(batched.feature<features::SpreadStats<256>>(id).mean(),
+                                 single.feature<features::SpreadStats<256>>(id).mean()));
+            ASSERT_TRUE(sameBits(batched.feature<features::BookImbalance<1>>(id).value(),
+                                 single.feature<features::BookImbalance<1>>(id).value()));
+        }
+    }
+
+    INSTANTIATE_TEST_SUITE_P(SimdLevels, TopOfBookBatchTest,
+                             ::testing::Values(util::SimdLevel::SCALAR, util::SimdLevel::AVX2,
+                                               util::SimdLevel::AVX512),
+                             [](const auto &info) {
+                                 return std::string(util::SimdLevelNames[static_cast<size_t>(info.param)]);
+                             });
 } // namespace trading
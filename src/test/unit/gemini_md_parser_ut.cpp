@@ -0,0 +1,155 @@
+#include <limits>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "../../client/gemini_md_parser.h"
+#include "../../util/symbol_table.h"
+
+namespace client {
+    using namespace util::literals;
+
+    struct RecordingHandler {
+        struct Change {
+            std::string symbol;
+            Side side;
+            util::Price price;
+            util::Qty quantity;
+        };
+
+        void on_l2_change(std::string_view symbol, Side side, util::Price price, util::Qty quantity) {
+            changes.push_back(Change{std::string(symbol), side, price, quantity});
+        }
+
+        void on_l2_updates_end(std::string_view symbol) {
+            ends.emplace_back(symbol);
+        }
+
+        void on_trade(std::string_view symbol, const GeminiTrade &trade) {
+            trade_symbols.emplace_back(symbol);
+            trades.push_back(trade);
+        }
+
+        std::vector<Change> changes;
+        std::vector<std::string> ends;
+        std::vector<std::string> trade_symbols;
+        std::vector<GeminiTrade> trades;
+    };
+
+    TEST(DecimalTest, ParsesIntoFixedPoint) {
+        int64_t value{};
+        ASSERT_TRUE(util::parseDecimal("9122.04", value));
+        ASSERT_EQ(value, 912204000000);
+        ASSERT_TRUE(util::parseDecimal("0.00121425", value));
+        ASSERT_EQ(value, 121425);
+        ASSERT_TRUE(util::parseDecimal("42", value));
+        ASSERT_EQ(value, 4200000000);
+        ASSERT_TRUE(util::parseDecimal("-1.5", value));
+        ASSERT_EQ(value, -150000000);
+        ASSERT_TRUE(util::parseDecimal("0.123456789", value)); // truncated past 8 decimals
+        ASSERT_EQ(value, 12345678);
+
+        ASSERT_FALSE(util::parseDecimal("", value));
+        ASSERT_FALSE(util::parseDecimal(".", value));
+        ASSERT_FALSE(util::parseDecimal("1e5", value));
+        ASSERT_FALSE(util::parseDecimal("12a", value));
+
+        // The fixed-point range ends at 92233720368.54775807.
+        ASSERT_TRUE(util::parseDecimal("92233720368.54775807", value));
+        ASSERT_EQ(value, std::numeric_limits<int64_t>::max());
+        ASSERT_TRUE(util::parseDecimal("-92233720368.54775807", value));
+        ASSERT_EQ(value, -std::numeric_limits<int64_t>::max());
+        ASSERT_FALSE(util::parseDecimal("92233720368.54775808", value));
+        ASSERT_FALSE(util::parseDecimal("92233720369", value));
+        ASSERT_FALSE(util::parseDecimal("100000000000", value));
+        ASSERT_FALSE(util::parseDecimal("18446744073709551617", value));
+        util::Qty qty;
+        ASSERT_FALSE(util::Qty::parse("123456789012.5", qty));
+    }
+
+    TEST(DecimalTest, FormatsShortestExactDecimal) {
+        const auto format = [](auto decimal) {
+            char buffer[util::MaxDecimalChars];
+            return std::string(buffer, decimal.format(buffer));
+        };
+        ASSERT_EQ(format(60000.5_px), "60000.5");
+        ASSERT_EQ(format(0.1_qty), "0.1");
+        ASSERT_EQ(format(0.00000001_qty), "0.00000001");
+        ASSERT_EQ(format(42_px), "42");
+        ASSERT_EQ(format(util::Price{}), "0");
+        ASSERT_EQ(format(-1.25_px), "-1.25");
+        ASSERT_EQ(format(util::Price::fromFixed(INT64_MIN + 1)).size(), util::MaxDecimalChars);
+
+        util::Qty parsed;
+        ASSERT_TRUE(util::Qty::parse(format(1234.56789_qty), parsed));
+        ASSERT_EQ(parsed, 1234.56789_qty);
+    }
+
+    TEST(DecimalTest, ComparesHashesAndRoundsExactly) {
+        // 0.1 + 0.2 != 0.3 in binary floating point.
+        ASSERT_EQ(0.1_px + 0.2_px, 0.3_px);
+        ASSERT_LT(60000_px, 60000.00000001_px);
+        ASSERT_EQ(util::Price::fromDouble(60000.3), 60000.3_px);
+
+        std::unordered_map<util::Price, int> levels{{100.5_px, 1}};
+        ASSERT_EQ(levels.count(100.0_px + 0.5_px), 1u);
+
+        const util::SymbolSpec spec{.tick_size = 0.5_px, .lot_size = 0.0001_qty};
+        ASSERT_EQ(spec.roundToTick(60000.74_px), 60000.5_px);
+        ASSERT_EQ(spec.roundToLot(0.12345_qty), 0.1234_qty);
+        ASSERT_EQ((60000.5_px).steps(spec.tick_size), 120001);
+    }
+
+    TEST(GeminiMarketDataParserTest, ParsesL2UpdatesWithTrades) {
+        const std::string frame =
+            R"({"type":"l2_updates","symbol":"BTCGUSDPERP","changes":[["buy","9122.04","0.00121425"],)"
+            R"(["sell","9122.07","0"]],"trades":[{"type":"trade","symbol":"BTCGUSDPERP","event_id":169841458,)"
+            R"("timestamp":1560976400428,"price":"9122.04","quantity":"0.0073173","side":"sell"}],)"
+            R"("auction_events":[]})";
+        RecordingHandler handler;
+
+        ASSERT_EQ(GeminiMarketDataParser::parse(frame, handler), GeminiMarketDataParser::MessageType::L2_UPDATES);
+
+        ASSERT_EQ(handler.changes.size(), 2u);
+        ASSERT_EQ(handler.changes[0].symbol, "BTCGUSDPERP");
+        ASSERT_EQ(handler.changes[0].side, Side::BID);
+        ASSERT_EQ(handler.changes[0].price, 9122.04_px);
+        ASSERT_EQ(handler.changes[0].quantity, 0.00121425_qty);
+        ASSERT_EQ(handler.changes[1].side, Side::ASK);
+        ASSERT_EQ(handler.changes[1].quantity, 0_qty);
+        ASSERT_EQ(handler.ends.size(), 1u);
+
+        ASSERT_EQ(handler.trades.size(), 1u);
+        ASSERT_EQ(handler.trades[0].event_id, 169841458u);
+        ASSERT_EQ(handler.trades[0].timestamp_ms, 1560976400428u);
+        ASSERT_EQ(handler.trades[0].quantity, 0.0073173_qty);
+        ASSERT_EQ(handler.trades[0].aggressor_side, Side::ASK);
+    }
+
+    TEST(GeminiMarketDataParserTest, ParsesTrade) {
+        const std::string frame =
+            R"({ "type": "trade", "symbol": "BTCUSD", "event_id": 3575573053, "timestamp": 1560976400428,)"
+            R"( "price": "9004.21000000", "quantity": "0.09110000", "side": "buy" })";
+        RecordingHandler handler;
+
+        ASSERT_EQ(GeminiMarketDataParser::parse(frame, handler), GeminiMarketDataParser::MessageType::TRADE);
+        ASSERT_EQ(handler.trade_symbols.at(0), "BTCUSD");
+        ASSERT_EQ(handler.trades.at(0).price, 9004.21_px);
+        ASSERT_EQ(handler.trades.at(0).quantity, 0.0911_qty);
+        ASSERT_EQ(handler.trades.at(0).aggressor_side, Side::BID);
+    }
+
+    TEST(GeminiMarketDataParserTest, ReportsUnknownAndInvalidMessages) {
+        RecordingHandler handler;
+        ASSERT_EQ(GeminiMarketDataParser::parse(R"({"type":"heartbeat","timestamp":1})", handler),
+                  GeminiMarketDataParser::MessageType::HEARTBEAT);
+        ASSERT_EQ(GeminiMarketDataParser::parse(R"({"type":"subscription_ack","nested":{"a":["]"]}})", handler),
+                  GeminiMarketDataParser::MessageType::UNKNOWN);
+        ASSERT_EQ(GeminiMarketDataParser::parse(R"({"type":"l2_updates","changes":[["buy","x","1"]]})", handler),
+                  GeminiMarketDataParser::MessageType::INVALID);
+        ASSERT_EQ(GeminiMarketDataParser::parse(R"({"type":"l2_updates")", handler),
+                  GeminiMarketDataParser::MessageType::INVALID);
+        ASSERT_TRUE(handler.changes.empty());
+    }
+} // namespace client
@@ -0,0 +1,95 @@
+#include <openssl/hmac.h>
+#include <string>
+
+#include "gtest/gtest.h"
+#include "../../client/gemini_signer.h"
+#include "../../client/ws_order_entry_client.h"
+
+namespace client {
+    using namespace util::literals;
+
+    namespace {
+        std::string base64(std::string_view in) {
+            std::string out(encoding::base64_size(in.size()), '\0');
+            encoding::base64_encode(reinterpret_cast<const unsigned char *>(in.data()), in.size(), out.data());
+            return out;
+        }
+
+        std::string referenceHmacHex(std::string_view key, std::string_view data) {
+            unsigned char digest[SHA384_DIGEST_LENGTH];
+            unsigned int size = 0;
+            HMAC(EVP_sha384(), key.data(), static_cast<int>(key.size()),
+                 reinterpret_cast<const unsigned char *>(data.data()), data.size(), digest, &size);
+            std::string hex(2 * size, '\0');
+            encoding::hex_encode(digest, size, hex.data());
+            return hex;
+        }
+    }
+
+    TEST(GeminiSignerTest, Base64MatchesRfc4648Vectors) {
+        ASSERT_EQ(base64(""), "");
+        ASSERT_EQ(base64("f"), "Zg==");
+        ASSERT_EQ(base64("fo"), "Zm8=");
+        ASSERT_EQ(base64("foo"), "Zm9v");
+        ASSERT_EQ(base64("foob"), "Zm9vYg==");
+        ASSERT_EQ(base64("fooba"), "Zm9vYmE=");
+        ASSERT_EQ(base64("foobar"), "Zm9vYmFy");
+        ASSERT_EQ(base64("\xff\xfe\xfd"), "//79");
+    }
+
+    TEST(GeminiSignerTest, HmacMatchesRfc4231Vector) {
+        GeminiSigner signer("Jefe");
+        const std::string_view data = "what do ya want for nothing?";
+        unsigned char digest[GeminiSigner::DigestSize];
+        signer.hmac(reinterpret_cast<const unsigned char *>(data.data()), data.size(), digest);
+        std::string hex(2 * GeminiSigner::DigestSize, '\0');
+        encoding::hex_encode(digest, GeminiSigner::DigestSize, hex.data());
+        ASSERT_EQ(hex, "af45d2e376484031617f78d2b58a6b1b9c7ef464f5a01b47e42ec3736322445e"
+                       "8e2240ca5e69e2c78b3239ecfab21649");
+    }
+
+    TEST(GeminiSignerTest, SignatureIsHmacOfBase64Payload) {
+        const std::string long_secret(200, 's');
+        for (const std::string_view secret: {std::string_view("secret"), std::string_view(long_secret)}) {
+            GeminiSigner signer(secret);
+            std::string payload;
+            for (int size = 0; size < 300; size += 7) {
+                payload.resize(static_cast<size_t>(size), 'x');
+                const auto signature = signer.sign(payload);
+                ASSERT_EQ(signature.payload, base64(payload));
+                ASSERT_EQ(signature.signature, referenceHmacHex(secret, base64(payload)));
+            }
+        }
+    }
+
+    TEST(GeminiSignerTest, OrderParamsAreWrittenWithoutExponents) {
+        WsOrderEntryClient::WsOrderEntryReqMsg request;
+        request.type = WsOrderEntryClient::WsOrderEntryReqMsg::RequestType::NEW_ORDER;
+        request.side = Side::ASK;
+        request.price = 1234567.5_px;
+        request.quantity = 0.00001_qty;
+        request.client_order_id = 42;
+
+        PayloadWriter writer;
+        writer.append("nonce=").append(int64_t{1700000000000}).append("&request=/v1/order/new");
+        request.write_params(writer, "btcusd");
+        ASSERT_FALSE(writer.overflow());
+        ASSERT_EQ(writer.view(), "nonce=1700000000000&request=/v1/order/new&symbol=btcusd&amount=0.00001&price=1234567.5"
+                                 "&side=sell&type=exchange limit&client_order_id=42");
+
+        request.type = WsOrderEntryClient::WsOrderEntryReqMsg::RequestType::CANCEL_ORDER;
+        request.order_id = 106817811;
+        ASSERT_EQ(request.to_string(), "order_id=106817811&client_order_id=42");
+    }
+
+    TEST(GeminiSignerTest, PayloadWriterFlagsOverflow) {
+        PayloadWriter writer;
+        writer.append(std::string(PayloadWriter::Capacity, 'a'));
+        ASSERT_FALSE(writer.overflow());
+        writer.append(uint64_t{1});
+        ASSERT_TRUE(writer.overflow());
+        writer.clear();
+        ASSERT_FALSE(writer.overflow());
+        ASSERT_TRUE(writer.view().empty());
+    }
+} // namespace client
@@ -0,0 +1,136 @@
+#include <chrono>
+#include <string>
+#include <thread>
+
+#include "gtest/gtest.h"
+#include "../mock/mock_https_server.h"
+#include "../../client/https_session_pool.h"
+#include "../../client/ws_order_entry_client.h"
+
+namespace client {
+    using namespace util::literals;
+
+    namespace {
+        HttpsSessionPoolConfig testPoolConfig() {
+            HttpsSessionPoolConfig config;
+            config.pool_size = 2;
+            config.ca_certificate_pem = std::string(mock::LocalhostCertificatePem);
+            return config;
+        }
+
+        HttpsSessionPool::Request makeRequest(std::string_view target) {
+            HttpsSessionPool::Request request{http::verb::post, beast::string_view(target.data(), target.size()), 11};
+            request.set(http::field::host, "localhost");
+            request.prepare_payload();
+            return request;
+        }
+
+        template<typename Predicate>
+        bool waitFor(Predicate &&predicate) {
+            const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+            while (!predicate()) {
+                if (std::chrono::steady_clock::now() > deadline) {
+                    return false;
+                }
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+            return true;
+        }
+    }
+
+    class HttpsSessionPoolTest : public ::testing::Test {
+    protected:
+        mock::MockHttpsServer server{[](const mock::MockHttpsServer::Request &request) {
+            mock::MockHttpsServer::Response response{http::status::ok, request.version()};
+            response.body() = std::string(request.target());
+            return response;
+        }};
+    };
+
+    TEST_F(HttpsSessionPoolTest, RequestsReuseWarmSessions) {
+        HttpsSessionPool pool("localhost", std::to_string(server.port()), testPoolConfig());
+        pool.start();
+        ASSERT_EQ(pool.ready_sessions(), 2u);
+        ASSERT_EQ(server.connectionsAccepted(), 2u);
+
+        for (int i = 0; i < 10; ++i) {
+            auto request = makeRequest("/v1/order/" + std::to_string(i));
+            HttpsSessionPool::Response response;
+            ASSERT_TRUE(pool.execute(request, response));
+            ASSERT_EQ(response.body(), "/v1/order/" + std::to_string(i));
+        }
+        ASSERT_EQ(server.connectionsAccepted(), 2u);
+        ASSERT_EQ(server.requestsServed(), 10u);
+    }
+
+    TEST_F(HttpsSessionPoolTest, PipelinedResponsesComeBackInOrder) {
+        HttpsSessionPool pool("localhost", std::to_string(server.port()), testPoolConfig());
+        pool.start();
+
+        std::vector<HttpsSessionPool::Request> requests;
+        for (int i = 0; i < 5; ++i) {
+            requests.push_back(makeRequest("/" + std::to_string(i)));
+        }
+        std::vector<HttpsSessionPool::Response> responses(requests.size());
+        ASSERT_EQ(pool.execute(requests, responses), 5u);
+        for (int i = 0; i < 5; ++i) {
+            ASSERT_EQ(responses[i].body(), "/" + std::to_string(i));
+        }
+    }
+
+    TEST_F(HttpsSessionPoolTest, ReconnectsAfterServerDropsSessions) {
+        HttpsSessionPool pool("localhost", std::to_string(server.port()), testPoolConfig());
+        pool.start();
+        server.dropConnections();
+
+        // Each dead session fails at most one request, then a fresh one is connected.
+        auto request = makeRequest("/after-drop");
+        HttpsSessionPool::Response response;
+        int failures = 0;
+        while (!pool.execute(request, response)) {
+            ASSERT_LT(++failures, 3);
+            request = makeRequest("/after-drop");
+        }
+        ASSERT_EQ(response.body(), "/after-drop");
+        ASSERT_GT(server.connectionsAccepted(), 2u);
+        ASSERT_TRUE(waitFor([&] { return pool.ready_sessions() == 2; }));
+    }
+
+    TEST_F(HttpsSessionPoolTest, IdleSessionsSendHeartbeats) {
+        auto config = testPoolConfig();
+        config.heartbeat_interval = std::chrono::milliseconds(20);
+        HttpsSessionPool pool("localhost", std::to_string(server.port()), config);
+        pool.start();
+        ASSERT_TRUE(waitFor([&] { return server.requestsServed() >= 4; }));
+        ASSERT_EQ(server.connectionsAccepted(), 2u);
+    }
+
+    TEST(WsOrderEntryClientTest, OrdersGoThroughTheSessionPool) {
+        mock::MockHttpsServer server;
+        const util::SymbolTable symbols{"btcusd"};
+        util::SpscQueue<WsOrderEntryClient::WsOrderEntryReqMsg> requests(16);
+        util::SpscQueue<WsOrderEntryClient::WsOrderEntryResMsg> responses(16);
+        WsOrderEntryClientConfig config;
+        config.pool = testPoolConfig();
+        WsOrderEntryClient order_entry_client("https://localhost:" + std::to_string(server.port()), symbols,
+                                              requests, responses, "key", "secret", nullptr, config);
+        order_entry_client.start();
+
+        WsOrderEntryClient::WsOrderEntryReqMsg request;
+        request.type = WsOrderEntryClient::WsOrderEntryReqMsg::RequestType::NEW_ORDER;
+        request.side = Side::BID;
+        request.price = 60000.0_px;
+        request.quantity = 0.1_qty;
+        request.client_order_id = 7;
+        ASSERT_TRUE(requests.push(request));
+
+        WsOrderEntryClient::WsOrderEntryResMsg response;
+        ASSERT_TRUE(waitFor([&] { return responses.pop(response); }));
+        ASSERT_EQ(response.status, WsOrderEntryClient::WsOrderEntryResMsg::OrdStatus::NEW);
+        ASSERT_EQ(response.side, Side::BID);
+        ASSERT_EQ(response.client_order_id, 7u);
+        ASSERT_NE(response.order_id, 0u);
+        ASSERT_EQ(server.connectionsAccepted(), 2u);
+        order_entry_client.stop();
+    }
+} // namespace client
@@ -0,0 +1,76 @@
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "../../client/l2_book_builder.h"
+
+namespace client {
+    using namespace util::literals;
+
+    TEST(L2BookBuilderTest, KeepsOneBookPerSymbol) {
+        const util::SymbolTable symbols{"BTCGUSDPERP", "ETHGUSDPERP"};
+        util::LatestValueSlots<WsBestBidBestAskMsg> updates(symbols.size());
+        L2BookBuilder builder(symbols, updates);
+
+        builder.on_message(R"({"type":"l2_updates","symbol":"ETHGUSDPERP","changes":[["buy","3000.5","2"],)"
+                           R"(["sell","3001","1"]]})");
+        builder.on_message(R"({"type":"l2_updates","symbol":"BTCGUSDPERP","changes":[["buy","60000","0.5"]]})");
+        // Unknown symbols are ignored and publish nothing.
+        builder.on_message(R"({"type":"l2_updates","symbol":"DOGEUSD","changes":[["buy","0.1","100"]]})");
+
+        std::vector<WsBestBidBestAskMsg> published;
+        ASSERT_EQ(updates.consume([&](size_t, const WsBestBidBestAskMsg &msg) { published.push_back(msg); }), 2u);
+        ASSERT_EQ(published[0].symbol_id, 0);
+        ASSERT_EQ(published[0].best_bid, 60000.0_px);
+        ASSERT_EQ(published[0].best_ask, 0.0_px);
+        ASSERT_EQ(published[1].symbol_id, 1);
+        ASSERT_EQ(published[1].best_bid, 3000.5_px);
+        ASSERT_EQ(published[1].best_bid_quantity, 2.0_qty);
+        ASSERT_EQ(published[1].best_ask, 3001.0_px);
+        ASSERT_FALSE(updates.hasDirty());
+
+        ASSERT_EQ(builder.book(0).bidDepth(), 1u);
+        ASSERT_EQ(builder.book(0).askDepth(), 0u);
+        ASSERT_EQ(builder.book(1).askDepth(), 1u);
+    }
+
+    TEST(L2BookBuilderTest, QueuesEveryTradeOnce) {
+        const util::SymbolTable symbols{"BTCGUSDPERP", "ETHGUSDPERP"};
+        util::LatestValueSlots<WsBestBidBestAskMsg> updates(symbols.size());
+        util::SpscQueue<WsTradesMsg> trades(16);
+        L2BookBuilder builder(symbols, updates);
+        builder.set_trade_queue(trades);
+
+        // The snapshot after subscribing comes with the latest trades.
+        const std::string snapshot =
+            R"({"type":"l2_updates","symbol":"BTCGUSDPERP","changes":[["buy","60000","1"]],"trades":[)"
+            R"({"type":"trade","symbol":"BTCGUSDPERP","event_id":10,"timestamp":1,"price":"60000",)"
+            R"("quantity":"0.5","side":"sell"},)"
+            R"({"type":"trade","symbol":"BTCGUSDPERP","event_id":11,"timestamp":2,"price":"60001",)"
+            R"("quantity":"0.25","side":"buy"}]})";
+        builder.on_message(snapshot, 1000);
+        builder.on_message(R"({"type":"trade","symbol":"ETHGUSDPERP","event_id":5,"timestamp":3,"price":"3000",)"
+                           R"("quantity":"2","side":"buy"})", 2000);
+        builder.on_message(R"({"type":"trade","symbol":"DOGEUSD","event_id":6,"timestamp":3,"price":"0.1",)"
+                           R"("quantity":"2","side":"buy"})", 2000);
+        // After a reconnect the snapshot repeats them.
+        builder.on_message(snapshot, 3000);
+
+        std::vector<WsTradesMsg> queued;
+        for (WsTradesMsg trade; trades.pop(trade);) {
+            queued.push_back(trade);
+        }
+        ASSERT_EQ(queued.size(), 3u);
+        ASSERT_EQ(queued[0].symbol_id, 0);
+        ASSERT_EQ(queued[0].event_id, 10u);
+        ASSERT_EQ(queued[0].aggressor_side, Side::ASK);
+        ASSERT_EQ(queued[0].price, 60000.0_px);
+        ASSERT_EQ(queued[0].quantity, 0.5_qty);
+        ASSERT_EQ(queued[0].receive_time_ns, 1000);
+        ASSERT_EQ(queued[1].event_id, 11u);
+        ASSERT_EQ(queued[1].aggressor_side, Side::BID);
+        ASSERT_EQ(queued[2].symbol_id, 1);
+        ASSERT_EQ(queued[2].quantity, 2.0_qty);
+        ASSERT_EQ(queued[2].receive_time_ns, 2000);
+    }
+}
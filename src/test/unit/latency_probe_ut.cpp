@@ -0,0 +1,106 @@
+#include <thread>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "../../trading/order_manager.h"
+#include "../../util/latency_probe.h"
+
+namespace util {
+    namespace {
+        uint64_t recorded(ProbeStage stage) {
+            return LatencyProbes::instance().snapshot(stage).total;
+        }
+
+        // Probes run on a thread of their own so whatever this thread did before doesn't matter.
+        template<typename Function>
+        void onNewThread(Function &&function) {
+            std::thread thread(std::forward<Function>(function));
+            thread.join();
+        }
+    }
+
+    TEST(LatencyHistogramTest, BucketsKeepValuesWithinThreePercent) {
+        for (uint64_t value = 0; value < 4096; ++value) {
+            ASSERT_EQ(LatencyHistogram::bucketOf(value) < 64, value < 64);
+        }
+        size_t previous = 0;
+        for (uint64_t value = 1; value <= LatencyHistogram::MaxValue; value += value / 7 + 1) {
+            const auto bucket = LatencyHistogram::bucketOf(value);
+            ASSERT_LT(bucket, LatencyHistogram::Buckets);
+            ASSERT_GE(bucket, previous);
+            ASSERT_LE(LatencyHistogram::lowestValue(bucket), value);
+            ASSERT_GE(LatencyHistogram::highestValue(bucket), value);
+            ASSERT_LE(LatencyHistogram::highestValue(bucket) - LatencyHistogram::lowestValue(bucket), value / 32);
+            previous = bucket;
+        }
+        ASSERT_EQ(LatencyHistogram::bucketOf(LatencyHistogram::MaxValue), LatencyHistogram::Buckets - 1);
+    }
+
+    TEST(LatencyHistogramTest, SnapshotPercentiles) {
+        auto histogram = std::make_unique<LatencyHistogram>();
+        for (uint64_t value = 1; value <= 10'000; ++value) {
+            histogram->record(value);
+        }
+        histogram->record(uint64_t{1} << 40);
+
+        LatencySnapshot snapshot;
+        snapshot.add(*histogram);
+        ASSERT_EQ(snapshot.total, 10'001u);
+        ASSERT_EQ(snapshot.max, LatencyHistogram::MaxValue);
+        ASSERT_NEAR(static_cast<double>(snapshot.percentile(0.5)), 5'000.0, 5'000.0 / 32);
+        ASSERT_NEAR(static_cast<double>(snapshot.percentile(0.99)), 9'900.0, 9'900.0 / 32);
+        ASSERT_EQ(snapshot.percentile(1.0), LatencyHistogram::MaxValue);
+        ASSERT_EQ(LatencySnapshot{}.percentile(0.5), 0u);
+    }
+
+#if CMM_LATENCY_PROBES
+    TEST(LatencyProbesTest, OnlyEventsInFlightAreRecorded) {
+        const auto parsed = recorded(ProbeStage::PARSED);
+        const auto pushed = recorded(ProbeStage::QUEUE_PUSH);
+        const auto popped = recorded(ProbeStage::ENGINE_POP);
+        uint64_t stamp = 0;
+        onNewThread([&] {
+            CMM_PROBE(PARSED);
+            ASSERT_EQ(CMM_PROBE_STAMP(), 0u);
+            CMM_PROBE_BEGIN();
+            CMM_PROBE(PARSED);
+            CMM_PROBE(QUEUE_PUSH);
+            stamp = CMM_PROBE_STAMP();
+            CMM_PROBE_END();
+            CMM_PROBE(QUEUE_PUSH);
+        });
+        ASSERT_NE(stamp, 0u);
+        ASSERT_EQ(recorded(ProbeStage::PARSED), parsed + 1);
+        ASSERT_EQ(recorded(ProbeStage::QUEUE_PUSH), pushed + 1);
+
+        // The consumer continues the event from the stamp it carried, messages without one are skipped.
+        onNewThread([&] {
+            CMM_PROBE_FROM(ENGINE_POP, 0);
+            CMM_PROBE_FROM(ENGINE_POP, stamp);
+        });
+        ASSERT_EQ(recorded(ProbeStage::ENGINE_POP), popped + 1);
+    }
+
+    TEST(LatencyProbesTest, OrderRequestsCarryTheEventStamp) {
+        using ReqMsg = client::WsOrderEntryClient::WsOrderEntryReqMsg;
+        using namespace util::literals;
+        onNewThread([] {
+            SpscQueue<ReqMsg> requests{16};
+            trading::OrderManager orderManager{requests, 2};
+            ReqMsg request;
+
+            orderManager.moveOrders(0, 100_px, 101_px);
+            ASSERT_TRUE(requests.pop(request));
+            ASSERT_EQ(request.tsc, 0u);
+
+            CMM_PROBE_BEGIN();
+            orderManager.moveOrders(1, 100_px, 101_px);
+            const auto stamp = CMM_PROBE_STAMP();
+            CMM_PROBE_END();
+            ASSERT_TRUE(requests.pop(request)); // the ask of symbol 0
+            ASSERT_TRUE(requests.pop(request));
+            ASSERT_EQ(request.tsc, stamp);
+        });
+    }
+#endif
+}
@@ -0,0 +1,79 @@
+#include <array>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "../../util/latest_value.h"
+
+namespace util {
+    namespace {
+        // Every word the same, so a torn read shows up as words that differ.
+        struct Wide {
+            std::array<uint64_t, 7> words{};
+        };
+
+        Wide wide(uint64_t value) {
+            Wide w;
+            w.words.fill(value);
+            return w;
+        }
+    }
+
+    TEST(LatestValueSlotsTest, ReaderGetsTheLatestValueOfEachDirtyKey) {
+        LatestValueSlots<int> slots(130);
+        ASSERT_FALSE(slots.hasDirty());
+        ASSERT_FALSE(slots.store(129, 1));
+        ASSERT_FALSE(slots.store(3, 1));
+        ASSERT_TRUE(slots.store(3, 2));
+        ASSERT_TRUE(slots.store(3, 3));
+        ASSERT_TRUE(slots.hasDirty());
+
+        std::vector<std::pair<size_t, int>> seen;
+        ASSERT_EQ(slots.consume([&](size_t key, int value) { seen.emplace_back(key, value); }), 2u);
+        ASSERT_EQ(seen, (std::vector<std::pair<size_t, int>>{{3, 3}, {129, 1}}));
+        ASSERT_FALSE(slots.hasDirty());
+        ASSERT_EQ(slots.consume([](size_t, int) { FAIL(); }), 0u);
+
+        ASSERT_FALSE(slots.store(64, 7));
+        ASSERT_EQ(slots.consume([&](size_t key, int value) { seen.emplace_back(key, value); }), 1u);
+        ASSERT_EQ(seen.back(), (std::pair<size_t, int>{64, 7}));
+        ASSERT_EQ(slots.latest(3), 3);
+        ASSERT_EQ(slots.latest(5), 0);
+    }
+
+    TEST(LatestValueSlotsTest, ConcurrentReaderNeverSeesTornOrOlderValues) {
+        constexpr size_t Keys = 3;
+        constexpr uint64_t Updates = 200'000;
+        LatestValueSlots<Wide> slots(Keys);
+        std::atomic<bool> done{false};
+        std::thread writer([&] {
+            for (uint64_t i = 1; i <= Updates; ++i) {
+                slots.store(i % Keys, wide(i));
+            }
+            done = true;
+        });
+
+        std::array<uint64_t, Keys> last{};
+        bool torn = false;
+        bool backwards = false;
+        const auto check = [&](size_t key, const Wide &value) {
+            for (const auto word: value.words) {
+                torn |= word != value.words[0];
+            }
+            backwards |= value.words[0] <= last[key];
+            last[key] = value.words[0];
+        };
+        while (!done.load()) {
+            slots.consume(check);
+        }
+        writer.join();
+        slots.consume(check);
+        ASSERT_FALSE(torn);
+        ASSERT_FALSE(backwards);
+        // Whatever the reader skipped, it ends up with the last value of every key.
+        for (size_t key = 0; key < Keys; ++key) {
+            ASSERT_EQ(last[key], Updates - (Updates - key) % Keys);
+        }
+    }
+}
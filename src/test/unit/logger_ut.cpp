@@ -0,0 +1,89 @@
+#include <cstdio>
+#include <string>
+
+#include "gtest/gtest.h"
+#include "../../util/logger.h"
+
+namespace util {
+    // Logs through the process wide logger into a temporary file and returns what got written.
+    template<typename Log>
+    std::string capture(Log &&log) {
+        auto &logger = Logger::instance();
+        // Other tests log without a running logger, flush what they left in this thread's ring first.
+        FILE *stale = std::tmpfile();
+        logger.start(LoggerConfig{.file = stale});
+        logger.stop();
+        std::fclose(stale);
+
+        FILE *file = std::tmpfile();
+        logger.start(LoggerConfig{.file = file});
+        log();
+        logger.stop();
+
+        std::string output(static_cast<size_t>(std::ftell(file)), '\0');
+        std::rewind(file);
+        output.resize(std::fread(output.data(), 1, output.size(), file));
+        std::fclose(file);
+        return output;
+    }
+
+    TEST(LoggerTest, FormatsArgumentsOnTheLoggerThread) {
+        const auto output = capture([] {
+            LOG_INFO("newOrder: side={} price={} quantity={} client_order_id={} ok={} {}", std::string_view("bid"),
+                     60000.5, 0.1, uint64_t{42}, true, -7);
+        });
+        ASSERT_NE(output.find(" INFO  newOrder: side=bid price=60000.5 quantity=0.1 client_order_id=42 ok=true -7\n"),
+                  std::string::npos) << output;
+    }
+
+    TEST(LoggerTest, KeepsOrderOfRecords) {
+        const auto output = capture([] {
+            for (int i = 0; i < 100; ++i) {
+                LOG_WARN("record {}", i);
+            }
+        });
+        size_t position = 0;
+        for (int i = 0; i < 100; ++i) {
+            position = output.find("record " + std::to_string(i) + "\n", position);
+            ASSERT_NE(position, std::string::npos) << i;
+        }
+    }
+
+    TEST(LoggerTest, TruncatesLongStrings) {
+        const std::string long_string(1000, 'x');
+        const auto output = capture([&] {
+            LOG_ERROR("{}|{}", 1, long_string);
+        });
+        const auto begin = output.find("1|");
+        ASSERT_NE(begin, std::string::npos);
+        const auto end = output.find('\n', begin);
+        ASSERT_EQ(end - begin - 2, LogRecord::PayloadSize - sizeof(int64_t) - 1);
+    }
+
+    TEST(LoggerTest, StringsLeaveRoomForTheArgumentsAfterThem) {
+        const std::string long_string(1000, 'x');
+        const auto output = capture([&] {
+            LOG_ERROR("{}|{}", long_string, uint64_t{7});
+        });
+        const auto expected = std::string(LogRecord::PayloadSize - 1 - sizeof(uint64_t), 'x') + "|7\n";
+        ASSERT_NE(output.find(" ERROR " + expected), std::string::npos) << output;
+    }
+
+    TEST(LoggerTest, SecondStringGetsWhatTheFirstLeaves) {
+        const std::string first(1000, 'x');
+        const std::string second(1000, 'y');
+        const auto output = capture([&] {
+            LOG_ERROR("{}|{}|{}", first, second, 'z');
+        });
+        const auto expected = std::string(LogRecord::PayloadSize - 1 - 1 - 1, 'x') + "||z\n";
+        ASSERT_NE(output.find(" ERROR " + expected), std::string::npos) << output;
+    }
+
+    TEST(LoggerTest, DisabledLevelsAreCompiledOut) {
+        static_assert(static_cast<int>(LogLevel::DEBUG) < CMM_LOG_LEVEL);
+        const auto output = capture([] {
+            LOG_DEBUG("not logged {}", 1);
+        });
+        ASSERT_EQ(output.find("not logged"), std::string::npos);
+    }
+} // namespace util
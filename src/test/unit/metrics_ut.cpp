@@ -0,0 +1,106 @@
+#include <unistd.h>
+
+#include <string>
+
+#include "gtest/gtest.h"
+#include "../../util/metrics.h"
+
+namespace util {
+    using namespace util::literals;
+
+    namespace {
+        std::string segmentName(const char *test) {
+            return "/cmm_metrics_ut." + std::string(test) + "." + std::to_string(::getpid());
+        }
+    }
+
+    TEST(MetricsTest, ReaderSeesWhatTheRegistryPublishes) {
+        const auto name = segmentName("publish");
+        MetricsRegistry registry({.shm_name = name});
+        auto sent = registry.counter("oe.sent");
+        auto depth = registry.gauge("engine.queue_depth");
+        auto fair_price = registry.decimalGauge("engine.fair_price.0");
+        auto round_trip = registry.histogram("oe.round_trip_ns");
+
+        MetricsReader reader(name);
+        ASSERT_EQ(reader.pid(), ::getpid());
+        sent.add();
+        sent.add(2);
+        depth.set(17);
+        fair_price.set(60000.5_px);
+        for (uint64_t value = 1; value <= 100; ++value) {
+            round_trip.record(value * 1000);
+        }
+
+        const auto metrics = reader.metrics();
+        ASSERT_EQ(metrics.size(), 3u);
+        ASSERT_EQ(metrics[0].name, "oe.sent");
+        ASSERT_EQ(metrics[0].type, MetricType::COUNTER);
+        ASSERT_EQ(metrics[0].value, 3);
+        ASSERT_EQ(metrics[1].type, MetricType::GAUGE);
+        ASSERT_EQ(metrics[1].value, 17);
+        ASSERT_EQ(metrics[2].type, MetricType::DECIMAL_GAUGE);
+        ASSERT_EQ(Price::fromFixed(metrics[2].value), 60000.5_px);
+
+        const auto histograms = reader.histograms();
+        ASSERT_EQ(histograms.size(), 1u);
+        ASSERT_EQ(histograms[0].name, "oe.round_trip_ns");
+        ASSERT_EQ(histograms[0].count, 100u);
+        ASSERT_EQ(histograms[0].sum, 5'050'000u);
+        // 50'000 is 16 bits wide, the bucket holds up to 65'535.
+        ASSERT_EQ(histograms[0].percentile(0.5), 65'535u);
+        ASSERT_EQ(histograms[0].percentile(1.0), 131'071u);
+
+        // Metrics registered after the reader attached show up as well.
+        registry.counter("md.frames").add(5);
+        ASSERT_EQ(reader.metrics().size(), 4u);
+        ASSERT_EQ(reader.metrics()[3].value, 5);
+    }
+
+    TEST(MetricsTest, NamesAreRegisteredOnce) {
+        MetricsRegistry registry;
+        auto first = registry.counter("om.requests_not_sent");
+        auto second = registry.counter("om.requests_not_sent");
+        first.add(2);
+        second.add(3);
+        ASSERT_EQ(first.value(), 5);
+        ASSERT_EQ(second.value(), 5);
+    }
+
+    TEST(MetricsTest, MetricsBeyondTheSegmentStillWork) {
+        const auto name = segmentName("full");
+        MetricsRegistry registry({.shm_name = name, .max_metrics = 2, .max_histograms = 1});
+        registry.counter("a").add();
+        registry.counter("b").add();
+        auto unpublished = registry.counter("c");
+        unpublished.add(4);
+        ASSERT_EQ(unpublished.value(), 4);
+        registry.histogram("h");
+        registry.histogram("h2").record(1);
+
+        MetricsReader reader(name);
+        ASSERT_EQ(reader.metrics().size(), 2u);
+        ASSERT_EQ(reader.histograms().size(), 1u);
+    }
+
+    TEST(MetricsTest, ReaderRejectsMissingAndForeignSegments) {
+        const auto name = segmentName("foreign");
+        ASSERT_THROW(MetricsReader{name}, std::runtime_error);
+
+        const int fd = ::shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+        ASSERT_GE(fd, 0);
+        ASSERT_EQ(::ftruncate(fd, 4096), 0);
+        ::close(fd);
+        ASSERT_THROW(MetricsReader{name}, std::runtime_error);
+        ::shm_unlink(name.c_str());
+    }
+
+    TEST(MetricsTest, SegmentIsRemovedWithTheRegistry) {
+        const auto name = segmentName("removed");
+        {
+            MetricsRegistry registry({.shm_name = name});
+            MetricsReader reader(name);
+        }
+        ASSERT_THROW(MetricsReader{name}, std::runtime_error);
+    }
+}
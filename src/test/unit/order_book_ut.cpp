@@ -0,0 +1,80 @@
+#include "gtest/gtest.h"
+#include "../../book/order_book.h"
+
+namespace book {
+    using client::Side;
+    using namespace util::literals;
+
+    class OrderBookTest : public ::testing::Test {
+    protected:
+        OrderBook orderBook{OrderBookConfig{.tick_size = 0.5_px, .max_depth = 3}};
+    };
+
+    TEST_F(OrderBookTest, BestLevelsFollowUpdates) {
+        orderBook.update(Side::BID, 100.0_px, 1.0_qty);
+        orderBook.update(Side::BID, 100.5_px, 2.0_qty);
+        orderBook.update(Side::ASK, 101.5_px, 3.0_qty);
+        orderBook.update(Side::ASK, 101.0_px, 4.0_qty);
+
+        ASSERT_EQ(orderBook.bestBid().price_ticks, orderBook.toTicks(100.5_px));
+        ASSERT_EQ(orderBook.bestBid().quantity, 2.0_qty);
+        ASSERT_EQ(orderBook.toPrice(orderBook.bestAsk().price_ticks), 101.0_px);
+        ASSERT_EQ(orderBook.bestAsk().quantity, 4.0_qty);
+
+        orderBook.update(Side::BID, 100.5_px, 0.0_qty);
+        ASSERT_EQ(orderBook.toPrice(orderBook.bestBid().price_ticks), 100.0_px);
+        orderBook.update(Side::ASK, 101.0_px, 5.0_qty);
+        ASSERT_EQ(orderBook.bestAsk().quantity, 5.0_qty);
+        ASSERT_EQ(orderBook.askDepth(), 2u);
+    }
+
+    TEST_F(OrderBookTest, LevelsAreOrderedFromTheTop) {
+        orderBook.update(Side::ASK, 103.0_px, 1.0_qty);
+        orderBook.update(Side::ASK, 101.0_px, 1.0_qty);
+        orderBook.update(Side::ASK, 102.0_px, 1.0_qty);
+
+        ASSERT_EQ(orderBook.toPrice(orderBook.askLevel(0).price_ticks), 101.0_px);
+        ASSERT_EQ(orderBook.toPrice(orderBook.askLevel(1).price_ticks), 102.0_px);
+        ASSERT_EQ(orderBook.toPrice(orderBook.askLevel(2).price_ticks), 103.0_px);
+    }
+
+    TEST_F(OrderBookTest, OnlyMaxDepthLevelsAreExposed) {
+        for (int i = 0; i < 6; ++i) {
+            orderBook.update(Side::BID, 100.0_px - 1.0_px * i, 1.0_qty);
+        }
+        ASSERT_EQ(orderBook.bidDepth(), 3u);
+        ASSERT_EQ(orderBook.toPrice(orderBook.bidLevel(2).price_ticks), 98.0_px);
+
+        // A full side drops its worst levels, a better level still gets in.
+        orderBook.update(Side::BID, 90.0_px, 1.0_qty);
+        orderBook.update(Side::BID, 99.5_px, 2.0_qty);
+        ASSERT_EQ(orderBook.bidDepth(), 3u);
+        ASSERT_EQ(orderBook.toPrice(orderBook.bidLevel(0).price_ticks), 100.0_px);
+        ASSERT_EQ(orderBook.toPrice(orderBook.bidLevel(1).price_ticks), 99.5_px);
+        ASSERT_EQ(orderBook.toPrice(orderBook.bidLevel(2).price_ticks), 99.0_px);
+
+        // Levels kept beyond max_depth move up when the top is removed.
+        orderBook.update(Side::BID, 100.0_px, 0.0_qty);
+        ASSERT_EQ(orderBook.toPrice(orderBook.bidLevel(2).price_ticks), 98.0_px);
+    }
+
+    TEST_F(OrderBookTest, RemovingUnknownLevelIsNoop) {
+        orderBook.update(Side::BID, 100.0_px, 0.0_qty);
+        ASSERT_FALSE(orderBook.hasBid());
+        orderBook.update(Side::ASK, 100.0_px, 1.0_qty);
+        orderBook.update(Side::ASK, 100.5_px, 0.0_qty);
+        ASSERT_EQ(orderBook.askDepth(), 1u);
+    }
+
+    TEST_F(OrderBookTest, QuantityAtPrice) {
+        orderBook.update(Side::BID, 100.0_px, 1.0_qty);
+        orderBook.update(Side::BID, 99.0_px, 2.0_qty);
+        orderBook.update(Side::ASK, 101.0_px, 3.0_qty);
+        orderBook.update(Side::ASK, 102.0_px, 4.0_qty);
+
+        ASSERT_EQ(orderBook.quantityAt(Side::BID, orderBook.toTicks(99.0_px)), 2.0_qty);
+        ASSERT_EQ(orderBook.quantityAt(Side::BID, orderBook.toTicks(99.5_px)), 0.0_qty);
+        ASSERT_EQ(orderBook.quantityAt(Side::ASK, orderBook.toTicks(102.0_px)), 4.0_qty);
+        ASSERT_EQ(orderBook.quantityAt(Side::ASK, orderBook.toTicks(100.0_px)), 0.0_qty);
+    }
+} // namespace book
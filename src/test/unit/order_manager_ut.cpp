@@ -0,0 +1,361 @@
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "../../trading/order_manager.h"
+#include "../../trading/order_pool.h"
+
+namespace trading {
+    using namespace util::literals;
+
+    namespace {
+        using ReqMsg = client::WsOrderEntryClient::WsOrderEntryReqMsg;
+        using ResMsg = client::WsOrderEntryClient::WsOrderEntryResMsg;
+
+        std::vector<ReqMsg> drain(util::SpscQueue<ReqMsg> &queue) {
+            std::vector<ReqMsg> requests;
+            ReqMsg request;
+            while (queue.pop(request)) {
+                requests.push_back(request);
+            }
+            return requests;
+        }
+
+        // Answers requests like the exchange would, news are acked and cancels confirmed.
+        void ack(OrderManager &orderManager, const std::vector<ReqMsg> &requests) {
+            for (const auto &request: requests) {
+                ResMsg res;
+                res.status = request.type == ReqMsg::RequestType::NEW_ORDER ? ResMsg::OrdStatus::NEW
+                                                                            : ResMsg::OrdStatus::CANCELED;
+                res.side = request.side;
+                res.symbol_id = request.symbol_id;
+                res.client_order_id = request.client_order_id;
+                res.order_id = 1000 + request.client_order_id;
+                orderManager.onOrderUpdate(res);
+            }
+        }
+    }
+
+    TEST(OrderPoolTest, StaleClientOrderIdsDoNotResolve) {
+        OrderPool<int> pool(2);
+        const auto first = pool.acquire();
+        const auto id = pool.clientOrderId(first);
+        ASSERT_NE(id, 0u);
+        ASSERT_EQ(pool.find(id), first);
+        pool.release(first);
+        ASSERT_EQ(pool.find(id), OrderPool<int>::InvalidSlot);
+
+        const auto second = pool.acquire();
+        const auto third = pool.acquire();
+        ASSERT_NE(second, OrderPool<int>::InvalidSlot);
+        ASSERT_NE(third, OrderPool<int>::InvalidSlot);
+        ASSERT_EQ(pool.acquire(), OrderPool<int>::InvalidSlot);
+        ASSERT_EQ(pool.find(id), OrderPool<int>::InvalidSlot); // slot reused under a new generation
+        ASSERT_EQ(pool.available(), 0u);
+    }
+
+    TEST(OrderManagerTest, QuotesAreRoundedToTheSymbolTickAndLot) {
+        util::SpscQueue<ReqMsg> requests{16};
+        OrderManager orderManager{requests, 1, OrderManagerConfig{.level_quantities = {0.12345_qty}}};
+        orderManager.setSymbolSpec(0, util::SymbolSpec{.tick_size = 0.5_px, .lot_size = 0.001_qty});
+
+        orderManager.moveOrders(0, 100.3_px, 100.7_px);
+        auto sent = drain(requests);
+        ASSERT_EQ(sent.size(), 2u);
+        ASSERT_EQ(sent[0].price, 100.0_px);
+        ASSERT_EQ(sent[0].quantity, 0.123_qty);
+        ASSERT_EQ(sent[1].price, 101.0_px);
+        ack(orderManager, sent);
+
+        // Moves within the same tick leave the quotes alone.
+        orderManager.moveOrders(0, 100.4_px, 100.6_px);
+        ASSERT_TRUE(drain(requests).empty());
+    }
+
+    TEST(OrderManagerTest, OrdersAreTrackedPerSymbol) {
+        util::SpscQueue<ReqMsg> requests{16};
+        OrderManager orderManager{requests, 2};
+
+        orderManager.moveOrders(1, 100.0_px, 101.0_px);
+        const auto sent = drain(requests);
+        ASSERT_EQ(sent.size(), 2u);
+        ASSERT_EQ(sent[0].symbol_id, 1);
+        ASSERT_EQ(sent[1].symbol_id, 1);
+        ASSERT_EQ(orderManager.bidOrder(1)->state, OrderManager::OMOrder::PENDING_OPEN);
+        ASSERT_EQ(orderManager.bidOrder(0), nullptr);
+
+        ack(orderManager, sent);
+        ASSERT_EQ(orderManager.askOrder(1)->state, OrderManager::OMOrder::OPEN);
+        ASSERT_EQ(orderManager.askOrder(1)->order_id, 1000 + sent[1].client_order_id);
+        ASSERT_EQ(orderManager.askOrder(0), nullptr);
+    }
+
+    TEST(OrderManagerTest, QuotesALadderWithPerLevelQuantities) {
+        util::SpscQueue<ReqMsg> requests{64};
+        OrderManager orderManager{requests, 1, OrderManagerConfig{.level_quantities = {0.1_qty, 0.2_qty, 0.3_qty},
+                                                                  .level_spacing = 0.5_px}};
+        orderManager.moveOrders(0, 100.0_px, 101.0_px);
+        const auto sent = drain(requests);
+        ASSERT_EQ(sent.size(), 6u);
+        for (size_t level = 0; level < 3; ++level) {
+            const auto *bid = orderManager.order(0, client::Side::BID, level);
+            const auto *ask = orderManager.order(0, client::Side::ASK, level);
+            ASSERT_NE(bid, nullptr);
+            ASSERT_NE(ask, nullptr);
+            ASSERT_EQ(bid->price, 100.0_px - 0.5_px * static_cast<int64_t>(level));
+            ASSERT_EQ(ask->price, 101.0_px + 0.5_px * static_cast<int64_t>(level));
+            ASSERT_EQ(bid->quantity, 0.1_qty * static_cast<int64_t>(level + 1));
+            ASSERT_EQ(ask->quantity, 0.1_qty * static_cast<int64_t>(level + 1));
+        }
+    }
+
+    TEST(OrderManagerTest, RequoteOnlyTouchesLevelsWhosePriceChanged) {
+        util::SpscQueue<ReqMsg> requests{64};
+        OrderManager orderManager{requests, 1, OrderManagerConfig{.level_quantities = {0.1_qty, 0.1_qty}}};
+        orderManager.moveOrders(0, 100.0_px, 101.0_px);
+        ack(orderManager, drain(requests));
+
+        // Same prices, nothing to do.
+        orderManager.moveOrders(0, 100.0_px, 101.0_px);
+        ASSERT_TRUE(requests.empty());
+
+        // Only the bids move: both bid levels are cancelled, the asks stay.
+        orderManager.moveOrders(0, 99.0_px, 101.0_px);
+        const auto cancels = drain(requests);
+        ASSERT_EQ(cancels.size(), 2u);
+        for (const auto &cancel: cancels) {
+            ASSERT_EQ(cancel.type, ReqMsg::RequestType::CANCEL_ORDER);
+            ASSERT_EQ(cancel.side, client::Side::BID);
+            ASSERT_NE(cancel.order_id, 0u);
+        }
+
+        // Confirmed cancels re-quote their levels at the new prices.
+        ack(orderManager, cancels);
+        const auto news = drain(requests);
+        ASSERT_EQ(news.size(), 2u);
+        ASSERT_EQ(news[0].type, ReqMsg::RequestType::NEW_ORDER);
+        ASSERT_EQ(news[0].price, 99.0_px);
+        ASSERT_EQ(news[1].price, 98.0_px);
+        ack(orderManager, news);
+        ASSERT_TRUE(requests.empty());
+        ASSERT_EQ(orderManager.order(0, client::Side::BID, 1)->state, OrderManager::OMOrder::OPEN);
+    }
+
+    TEST(OrderManagerTest, StaleResponsesAreIgnored) {
+        util::SpscQueue<ReqMsg> requests{16};
+        OrderManager orderManager{requests};
+        orderManager.moveOrders(0, 100.0_px, 101.0_px);
+        const auto sent = drain(requests);
+
+        ResMsg rejected;
+        rejected.status = ResMsg::OrdStatus::REJECTED;
+        rejected.client_order_id = sent[0].client_order_id;
+        orderManager.onOrderUpdate(rejected);
+        ASSERT_EQ(orderManager.bidOrder(0), nullptr);
+
+        // The bid's slot is recycled by the next quote, a late ack for the old id must not touch it.
+        orderManager.moveOrders(0, 100.0_px, 101.0_px);
+        ASSERT_EQ(drain(requests).size(), 1u);
+        ack(orderManager, {sent[0]});
+        ASSERT_EQ(orderManager.bidOrder(0)->state, OrderManager::OMOrder::PENDING_OPEN);
+    }
+
+    // Acks, cancels and rejected cancels come from both the order events and the order entry responses.
+    TEST(OrderManagerTest, SecondReportsOfTheSameUpdateAreNoOps) {
+        util::SpscQueue<ReqMsg> requests{16};
+        OrderManager orderManager{requests};
+        orderManager.moveOrders(0, 100.0_px, 101.0_px);
+        const auto sent = drain(requests);
+        ack(orderManager, sent);
+        ASSERT_EQ(orderManager.bidOrder(0)->state, OrderManager::OMOrder::OPEN);
+
+        // A fill, then a cancel that the second ack must not turn back into an open order.
+        ResMsg fill;
+        fill.status = ResMsg::OrdStatus::PARTIALLY_FILLED;
+        fill.client_order_id = sent[0].client_order_id;
+        fill.leaves_qty = 0.04_qty;
+        orderManager.onOrderUpdate(fill);
+        ASSERT_EQ(orderManager.bidOrder(0)->quantity, 0.04_qty);
+        orderManager.moveOrders(0, 99.0_px, 101.0_px);
+        ASSERT_EQ(drain(requests).size(), 1u);
+        ASSERT_EQ(orderManager.bidOrder(0)->state, OrderManager::OMOrder::PENDING_CLOSE);
+        ack(orderManager, {sent[0]});
+        ASSERT_EQ(orderManager.bidOrder(0)->state, OrderManager::OMOrder::PENDING_CLOSE);
+        ASSERT_TRUE(requests.empty());
+
+        // The cancel is confirmed twice, the level is re-quoted once.
+        ResMsg cancelled;
+        cancelled.status = ResMsg::OrdStatus::CANCELED;
+        cancelled.client_order_id = sent[0].client_order_id;
+        orderManager.onOrderUpdate(cancelled);
+        ASSERT_EQ(drain(requests).size(), 1u);
+        const auto unknown = util::MetricsRegistry::instance().counter("om.unknown_updates").value();
+        orderManager.onOrderUpdate(cancelled);
+        ASSERT_TRUE(requests.empty());
+        ASSERT_EQ(util::MetricsRegistry::instance().counter("om.unknown_updates").value(), unknown + 1);
+
+        // The ask's cancel is rejected twice, the order stays open.
+        orderManager.moveOrders(0, 99.0_px, 102.0_px);
+        ASSERT_EQ(drain(requests).size(), 1u);
+        ResMsg rejected;
+        rejected.status = ResMsg::OrdStatus::REJECTED;
+        rejected.client_order_id = sent[1].client_order_id;
+        orderManager.onOrderUpdate(rejected);
+        orderManager.onOrderUpdate(rejected);
+        ASSERT_NE(orderManager.askOrder(0), nullptr);
+        ASSERT_EQ(orderManager.askOrder(0)->state, OrderManager::OMOrder::OPEN);
+    }
+
+    TEST(OrderManagerTest, CancelReplaceRequotesWithoutWaitingForTheCancel) {
+        util::SpscQueue<ReqMsg> requests{16};
+        OrderManager orderManager{requests, 1, OrderManagerConfig{.requote_mode = RequoteMode::CANCEL_REPLACE}};
+        orderManager.moveOrders(0, 100.0_px, 101.0_px);
+        const auto sent = drain(requests);
+        ack(orderManager, sent);
+
+        // The cancel and the new at the new price go out together, the new order takes the level.
+        orderManager.onTimer(1'000);
+        orderManager.moveOrders(0, 99.0_px, 101.0_px);
+        const auto replace = drain(requests);
+        ASSERT_EQ(replace.size(), 2u);
+        ASSERT_EQ(replace[0].type, ReqMsg::RequestType::CANCEL_ORDER);
+        ASSERT_EQ(replace[0].client_order_id, sent[0].client_order_id);
+        ASSERT_EQ(replace[1].type, ReqMsg::RequestType::NEW_ORDER);
+        ASSERT_EQ(replace[1].price, 99.0_px);
+        ASSERT_EQ(orderManager.bidOrder(0)->client_order_id, replace[1].client_order_id);
+        ASSERT_EQ(orderManager.stats().price_moves, 1u);
+        ASSERT_EQ(orderManager.stats().requotes, 1u);
+        ASSERT_EQ(orderManager.stats().requote_ns, 0);
+
+        // The old order's cancel only releases it.
+        ack(orderManager, replace);
+        ASSERT_TRUE(requests.empty());
+        ASSERT_EQ(orderManager.bidOrder(0)->state, OrderManager::OMOrder::OPEN);
+        ASSERT_EQ(orderManager.bidOrder(0)->price, 99.0_px);
+    }
+
+    TEST(OrderManagerTest, RequotesAreTimedWhenTheyReachTheQueue) {
+        util::SpscQueue<ReqMsg> requests{2};
+        OrderManager orderManager{requests, 1, OrderManagerConfig{.requote_mode = RequoteMode::CANCEL_REPLACE}};
+        orderManager.moveOrders(0, 100.0_px, util::Price{});
+        ack(orderManager, drain(requests));
+
+        // Only the cancel fits the queue, the new order is rolled back and not counted.
+        orderManager.onTimer(1'000);
+        ASSERT_TRUE(requests.push(ReqMsg{}));
+        orderManager.moveOrders(0, 99.0_px, util::Price{});
+        ASSERT_EQ(drain(requests).size(), 2u);
+        ASSERT_EQ(orderManager.bidOrder(0), nullptr);
+        ASSERT_EQ(orderManager.stats().requotes, 0u);
+
+        // The re-quote that goes out is timed from the move.
+        orderManager.onTimer(3'000);
+        orderManager.moveOrders(0, 99.0_px, util::Price{});
+        const auto news = drain(requests);
+        ASSERT_EQ(news.size(), 1u);
+        ASSERT_EQ(news[0].price, 99.0_px);
+        ASSERT_EQ(orderManager.stats().requotes, 1u);
+        ASSERT_EQ(orderManager.stats().requote_ns, 2'000);
+    }
+
+    TEST(OrderManagerTest, MovesWhileARequestIsInFlightOnlySendTheLatestPrice) {
+        util::SpscQueue<ReqMsg> requests{16};
+        OrderManager orderManager{requests};
+        orderManager.moveOrders(0, 100.0_px, 101.0_px);
+        ack(orderManager, drain(requests));
+
+        orderManager.onTimer(1'000);
+        orderManager.moveOrders(0, 99.0_px, 101.0_px);
+        const auto cancel = drain(requests);
+        ASSERT_EQ(cancel.size(), 1u);
+        orderManager.onTimer(2'000);
+        orderManager.moveOrders(0, 98.0_px, 101.0_px);
+        orderManager.moveOrders(0, 97.0_px, 101.0_px);
+        ASSERT_TRUE(requests.empty());
+
+        orderManager.onTimer(5'000);
+        ack(orderManager, cancel);
+        const auto news = drain(requests);
+        ASSERT_EQ(news.size(), 1u);
+        ASSERT_EQ(news[0].price, 97.0_px);
+        ASSERT_EQ(orderManager.stats().price_moves, 3u);
+        ASSERT_EQ(orderManager.stats().requotes, 1u);
+        ASSERT_EQ(orderManager.stats().requote_ns, 4'000);
+    }
+
+    TEST(OrderManagerTest, LostResponsesTimeOut) {
+        util::SpscQueue<ReqMsg> requests{16};
+        OrderManager orderManager{requests, 1, OrderManagerConfig{.ack_timeout_ns = 1'000}};
+        orderManager.onTimer(0);
+        orderManager.moveOrders(0, 100.0_px, 101.0_px);
+        const auto sent = drain(requests);
+        ack(orderManager, {sent[1]});
+        orderManager.moveOrders(0, 100.0_px, 102.0_px);
+        const auto cancel = drain(requests);
+        ASSERT_EQ(cancel.size(), 1u);
+
+        // Not yet due.
+        orderManager.onTimer(999);
+        ASSERT_TRUE(requests.empty());
+
+        // The bid's new gives up its level, which is quoted again. The ask's cancel is sent again.
+        orderManager.onTimer(1'000);
+        const auto retries = drain(requests);
+        ASSERT_EQ(retries.size(), 2u);
+        ASSERT_EQ(retries[0].type, ReqMsg::RequestType::NEW_ORDER);
+        ASSERT_EQ(retries[0].price, 100.0_px);
+        ASSERT_NE(retries[0].client_order_id, sent[0].client_order_id);
+        ASSERT_EQ(retries[1].type, ReqMsg::RequestType::CANCEL_ORDER);
+        ASSERT_EQ(retries[1].client_order_id, cancel[0].client_order_id);
+        ASSERT_EQ(orderManager.stats().ack_timeouts, 2u);
+
+        // The first bid's ack still comes, it is cancelled right away.
+        ack(orderManager, {sent[0]});
+        const auto late = drain(requests);
+        ASSERT_EQ(late.size(), 1u);
+        ASSERT_EQ(late[0].type, ReqMsg::RequestType::CANCEL_ORDER);
+        ASSERT_EQ(late[0].client_order_id, sent[0].client_order_id);
+        ASSERT_EQ(orderManager.bidOrder(0)->client_order_id, retries[0].client_order_id);
+
+        // Everything answered, nothing times out any more.
+        ack(orderManager, retries);
+        ack(orderManager, late);
+        ack(orderManager, drain(requests));
+        orderManager.onTimer(10'000);
+        ASSERT_TRUE(requests.empty());
+        ASSERT_EQ(orderManager.askOrder(0)->price, 102.0_px);
+    }
+
+    TEST(OrderManagerTest, ReplacedOrderWhoseCancelIsRejectedIsCancelledAgain) {
+        util::SpscQueue<ReqMsg> requests{16};
+        OrderManager orderManager{requests, 1, OrderManagerConfig{.requote_mode = RequoteMode::CANCEL_REPLACE,
+                                                                  .ack_timeout_ns = 1'000}};
+        orderManager.onTimer(0);
+        orderManager.moveOrders(0, 100.0_px, 101.0_px);
+        ack(orderManager, drain(requests));
+        orderManager.moveOrders(0, 99.0_px, 101.0_px);
+        const auto replace = drain(requests);
+        ASSERT_EQ(replace.size(), 2u);
+        ack(orderManager, {replace[1]});
+
+        ResMsg rejected;
+        rejected.status = ResMsg::OrdStatus::REJECTED;
+        rejected.client_order_id = replace[0].client_order_id;
+        orderManager.onOrderUpdate(rejected);
+        ASSERT_TRUE(requests.empty());
+
+        orderManager.onTimer(1'000);
+        const auto again = drain(requests);
+        ASSERT_EQ(again.size(), 1u);
+        ASSERT_EQ(again[0].type, ReqMsg::RequestType::CANCEL_ORDER);
+        ASSERT_EQ(again[0].client_order_id, replace[0].client_order_id);
+
+        // Its fill closes it instead, nothing is left to retry.
+        ResMsg filled;
+        filled.status = ResMsg::OrdStatus::FILLED;
+        filled.client_order_id = replace[0].client_order_id;
+        orderManager.onOrderUpdate(filled);
+        orderManager.onTimer(10'000);
+        ASSERT_TRUE(requests.empty());
+        ASSERT_EQ(orderManager.bidOrder(0)->client_order_id, replace[1].client_order_id);
+    }
+}
@@ -0,0 +1,100 @@
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "../../util/queue_producer.h"
+
+namespace util {
+    namespace {
+        // (key, sequence number) so tests can tell which message of a key made it.
+        using Msg = std::pair<int, int>;
+
+        std::vector<Msg> drain(SpscQueue<Msg> &queue) {
+            std::vector<Msg> out;
+            Msg msg;
+            while (queue.pop(msg)) {
+                out.push_back(msg);
+            }
+            return out;
+        }
+
+        int64_t metric(const std::string &name) {
+            return MetricsRegistry::instance().counter(name).value();
+        }
+    }
+
+    TEST(QueueProducerTest, DropCountsWhatDoesNotFit) {
+        SpscQueue<Msg> queue(2);
+        QueueProducer<Msg> producer(queue, {.policy = OverflowPolicy::DROP, .metrics_name = "ut.drop"});
+        const auto dropped = metric("ut.drop.dropped");
+        ASSERT_TRUE(producer.push({0, 1}));
+        ASSERT_TRUE(producer.push({0, 2}));
+        ASSERT_FALSE(producer.push({0, 3}));
+        ASSERT_EQ(metric("ut.drop.dropped"), dropped + 1);
+        ASSERT_EQ(MetricsRegistry::instance().gauge("ut.drop.high_water").value(), 2);
+        ASSERT_EQ(drain(queue), (std::vector<Msg>{{0, 1}, {0, 2}}));
+    }
+
+    TEST(QueueProducerTest, ConflateKeepsTheLatestPerKey) {
+        SpscQueue<Msg> queue(2);
+        QueueProducer<Msg> producer(queue, {.policy = OverflowPolicy::CONFLATE, .metrics_name = "ut.conflate",
+                                            .keys = 3});
+        const auto conflated = metric("ut.conflate.conflated");
+        producer.push({0, 1}, 0);
+        producer.push({1, 1}, 1);
+        // Full: kept aside, later ones of the same key replace earlier ones.
+        producer.push({2, 1}, 2);
+        producer.push({0, 2}, 0);
+        producer.push({0, 3}, 0);
+        producer.push({2, 2}, 2);
+        ASSERT_EQ(producer.pending(), 2u);
+        ASSERT_EQ(metric("ut.conflate.conflated"), conflated + 2);
+
+        ASSERT_EQ(drain(queue), (std::vector<Msg>{{0, 1}, {1, 1}}));
+        ASSERT_FALSE(producer.flush());
+        ASSERT_EQ(drain(queue), (std::vector<Msg>{{2, 2}, {0, 3}}));
+
+        // Kept messages go before a new one, per key the order never changes.
+        producer.push({1, 2}, 1);
+        producer.push({1, 3}, 1);
+        producer.push({1, 4}, 1);
+        ASSERT_EQ(drain(queue), (std::vector<Msg>{{1, 2}, {1, 3}}));
+        producer.push({0, 4}, 0);
+        ASSERT_EQ(drain(queue), (std::vector<Msg>{{1, 4}, {0, 4}}));
+        ASSERT_EQ(producer.pending(), 0u);
+    }
+
+    TEST(QueueProducerTest, BlockWaitsForTheConsumer) {
+        SpscQueue<Msg> queue(4);
+        QueueProducer<Msg> producer(queue, {.policy = OverflowPolicy::BLOCK, .metrics_name = "ut.block"});
+        const auto blocked = metric("ut.block.blocked");
+        std::atomic<bool> stop{false};
+        std::vector<Msg> received;
+        std::thread consumer([&] {
+            Msg msg;
+            while (received.size() < 1000) {
+                if (queue.pop(msg)) {
+                    received.push_back(msg);
+                } else {
+                    std::this_thread::yield();
+                }
+            }
+        });
+        for (int i = 0; i < 1000; ++i) {
+            ASSERT_TRUE(producer.push({0, i}, 0, &stop));
+        }
+        consumer.join();
+        for (int i = 0; i < 1000; ++i) {
+            ASSERT_EQ(received[static_cast<size_t>(i)].second, i);
+        }
+        ASSERT_GT(metric("ut.block.blocked"), blocked);
+
+        // Nobody consumes: gives up once cancelled.
+        for (int i = 0; i < 4; ++i) {
+            producer.push({0, i}, 0, &stop);
+        }
+        stop = true;
+        ASSERT_FALSE(producer.push({0, 4}, 0, &stop));
+    }
+}
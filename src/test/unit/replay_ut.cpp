@@ -0,0 +1,94 @@
+#include <unistd.h>
+
+#include <filesystem>
+#include <fstream>
+#include <string>
+
+#include "gtest/gtest.h"
+#include "../../replay/frame_file.h"
+#include "../../replay/replay_driver.h"
+
+namespace replay {
+    namespace {
+        std::string tempPath(std::string_view name) {
+            return (std::filesystem::temp_directory_path() /
+                    (std::string(name) + "." + std::to_string(::getpid()) + ".frames")).string();
+        }
+
+        // A few ticks of two symbols, the second BTC update moves the market so the quotes get replaced.
+        void writeCapture(const std::string &path) {
+            FrameWriter writer(path);
+            writer.write(1'000, R"({"type":"l2_updates","symbol":"BTCGUSDPERP","changes":[["buy","60000","1"],)"
+                                R"(["sell","60010","2"]]})");
+            writer.write(2'000, R"({"type":"l2_updates","symbol":"ETHGUSDPERP","changes":[["buy","3000","5"],)"
+                                R"(["sell","3001","5"]]})");
+            writer.write(3'000, R"({"type":"heartbeat","timestamp":1560976400428})");
+            writer.write(4'000, R"({"type":"l2_updates","symbol":"BTCGUSDPERP","changes":[["buy","60005","1"]]})");
+        }
+    }
+
+    TEST(FrameFileTest, FramesRoundTrip) {
+        const auto path = tempPath("round_trip");
+        writeCapture(path);
+
+        FrameReader reader(path);
+        Frame frame;
+        ASSERT_TRUE(reader.next(frame));
+        ASSERT_EQ(frame.timestamp_ns, 1'000);
+        ASSERT_EQ(frame.data.substr(0, 21), R"({"type":"l2_updates",)");
+        size_t frames = 1;
+        while (reader.next(frame)) {
+            ++frames;
+        }
+        ASSERT_EQ(frames, 4u);
+        ASSERT_EQ(frame.timestamp_ns, 4'000);
+        reader.rewind();
+        ASSERT_TRUE(reader.next(frame));
+        ASSERT_EQ(frame.timestamp_ns, 1'000);
+        std::filesystem::remove(path);
+    }
+
+    TEST(FrameFileTest, TruncatedLastFrameEndsTheCapture) {
+        const auto path = tempPath("truncated");
+        writeCapture(path);
+        std::filesystem::resize_file(path, std::filesystem::file_size(path) - 3);
+
+        FrameReader reader(path);
+        Frame frame;
+        size_t frames = 0;
+        while (reader.next(frame)) {
+            ++frames;
+        }
+        ASSERT_EQ(frames, 3u);
+        std::filesystem::remove(path);
+    }
+
+    TEST(FrameFileTest, RejectsOtherFiles) {
+        const auto path = tempPath("garbage");
+        std::ofstream(path) << "definitely not a capture";
+        ASSERT_THROW(FrameReader reader(path), std::runtime_error);
+        std::filesystem::remove(path);
+    }
+
+    TEST(ReplayDriverTest, ReplayIsDeterministic) {
+        const auto path = tempPath("replay");
+        writeCapture(path);
+        const util::SymbolTable symbols{"BTCGUSDPERP", "ETHGUSDPERP"};
+
+        FrameReader reader(path);
+        ReplayDriver first(symbols);
+        const auto stats = first.run(reader);
+        ASSERT_EQ(stats.frames, 4u);
+        ASSERT_EQ(stats.book_updates, 3u);
+        // Both symbols quoted on both sides, then the BTC bid re-quoted after the market moved.
+        ASSERT_EQ(stats.cancels, 1u);
+        ASSERT_EQ(stats.new_orders, 5u);
+        ASSERT_EQ(first.orderManager().bidOrder(0)->state, trading::OrderManager::OMOrder::OPEN);
+        ASSERT_EQ(first.orderManager().askOrder(1)->state, trading::OrderManager::OMOrder::OPEN);
+
+        reader.rewind();
+        ReplayDriver second(symbols);
+        ASSERT_EQ(second.run(reader).checksum, stats.checksum);
+        std::filesystem::remove(path);
+    }
+}
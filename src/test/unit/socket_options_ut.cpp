@@ -0,0 +1,115 @@
+#include <array>
+#include <chrono>
+#include <string>
+#include <thread>
+
+#include "gtest/gtest.h"
+#include "../../client/rx_timestamp_stream.h"
+#include "../../replay/frame_file.h"
+
+namespace client {
+    namespace {
+        using tcp = net::ip::tcp;
+
+        int get_socket_option(int fd, int level, int name) {
+            int value = 0;
+            socklen_t size = sizeof(value);
+            EXPECT_EQ(::getsockopt(fd, level, name, &value, &size), 0);
+            return value;
+        }
+    }
+
+    // A loopback connection standing in for the exchange: `stream` is our end, `peer` the server's.
+    class SocketOptionsTest : public ::testing::Test {
+    protected:
+        SocketOptionsTest() : acceptor(ioc, tcp::endpoint(net::ip::make_address("127.0.0.1"), 0)), stream(ioc),
+                              peer(ioc) {
+            stream.next_layer().connect(acceptor.local_endpoint());
+            acceptor.accept(peer);
+        }
+
+        int fd() {
+            return stream.lowest_layer().native_handle();
+        }
+
+        net::io_context ioc;
+        tcp::acceptor acceptor;
+        RxTimestampStream stream;
+        tcp::socket peer;
+    };
+
+    TEST_F(SocketOptionsTest, AppliesTheConfiguredOptions) {
+        ASSERT_EQ(get_socket_option(fd(), IPPROTO_TCP, TCP_NODELAY), 0);
+        ASSERT_TRUE(apply_socket_options(fd(), SocketOptionsConfig{.receive_buffer_size = 1 << 20,
+                                                                   .send_buffer_size = 256 << 10,
+                                                                   .rx_timestamps = true}, "loopback"));
+        ASSERT_NE(get_socket_option(fd(), IPPROTO_TCP, TCP_NODELAY), 0);
+        // The kernel doubles what it is asked for, for its own bookkeeping.
+        ASSERT_GE(get_socket_option(fd(), SOL_SOCKET, SO_RCVBUF), 1 << 20);
+        ASSERT_GE(get_socket_option(fd(), SOL_SOCKET, SO_SNDBUF), 256 << 10);
+        ASSERT_EQ(get_socket_option(fd(), SOL_SOCKET, SO_TIMESTAMPING) & SOF_TIMESTAMPING_RX_SOFTWARE,
+                  SOF_TIMESTAMPING_RX_SOFTWARE);
+
+        // Busy polling needs CAP_NET_ADMIN, without it the socket is left as it was.
+        if (apply_socket_options(fd(), SocketOptionsConfig{.busy_poll_us = 50}, "loopback")) {
+            ASSERT_EQ(get_socket_option(fd(), SOL_SOCKET, SO_BUSY_POLL), 50);
+        } else {
+            ASSERT_EQ(get_socket_option(fd(), SOL_SOCKET, SO_BUSY_POLL), 0);
+        }
+    }
+
+    TEST_F(SocketOptionsTest, ReadsCarryTheKernelReceiveTime) {
+        ASSERT_TRUE(apply_socket_options(fd(), SocketOptionsConfig{.rx_timestamps = true}, "loopback"));
+        std::array<char, 64> buffer{};
+        size_t received = 0;
+        beast::error_code result;
+        const auto read = [&] {
+            received = 0;
+            stream.async_read_some(net::buffer(buffer), [&](beast::error_code ec, size_t n) {
+                result = ec;
+                received = n;
+            });
+            ioc.restart();
+            ioc.run();
+        };
+
+        // The kernel turns timestamping on for the whole stack a moment after the first socket asks for it, packets
+        // before that come without one.
+        for (int attempt = 0; attempt < 1000 && stream.last_receive_time() == 0; ++attempt) {
+            net::write(peer, net::buffer(std::string("warm up")));
+            read();
+            ASSERT_FALSE(result);
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        ASSERT_NE(stream.last_receive_time(), 0);
+
+        // Nothing there yet, the read waits for the socket.
+        const auto before_first = replay::wallClockNanos();
+        stream.async_read_some(net::buffer(buffer), [&](beast::error_code ec, size_t n) {
+            result = ec;
+            received = n;
+        });
+        ASSERT_EQ(ioc.poll(), 0u);
+        net::write(peer, net::buffer(std::string("hello")));
+        ioc.restart();
+        ioc.run();
+        const auto after_first = replay::wallClockNanos();
+        ASSERT_FALSE(result);
+        ASSERT_EQ(std::string(buffer.data(), received), "hello");
+        ASSERT_GE(stream.last_receive_time(), before_first);
+        ASSERT_LE(stream.last_receive_time(), after_first);
+
+        // Data waiting already, read right away.
+        net::write(peer, net::buffer(std::string("world")));
+        const auto after_second = replay::wallClockNanos();
+        read();
+        ASSERT_FALSE(result);
+        ASSERT_EQ(std::string(buffer.data(), received), "world");
+        ASSERT_GE(stream.last_receive_time(), after_first);
+        ASSERT_LE(stream.last_receive_time(), after_second);
+
+        peer.close();
+        read();
+        ASSERT_EQ(result, net::error::eof);
+    }
+}
@@ -0,0 +1,109 @@
+#include <string>
+#include <thread>
+
+#include "gtest/gtest.h"
+#include "../../util/spsc_queue.h"
+
+namespace util {
+    TEST(SpscQueueTest, CapacityRoundsUpToPowerOfTwo) {
+        SpscQueue<int> queue(1000);
+        ASSERT_EQ(queue.capacity(), 1024u);
+
+        SpscQueue<int> exact(64);
+        ASSERT_EQ(exact.capacity(), 64u);
+    }
+
+    TEST(SpscQueueTest, PushPopUsesEverySlot) {
+        SpscQueue<int> queue(4);
+        for (int i = 0; i < 4; ++i) {
+            ASSERT_TRUE(queue.push(i));
+        }
+        ASSERT_FALSE(queue.push(4));
+        ASSERT_EQ(queue.size(), 4u);
+
+        int value{};
+        for (int i = 0; i < 4; ++i) {
+            ASSERT_TRUE(queue.pop(value));
+            ASSERT_EQ(value, i);
+        }
+        ASSERT_FALSE(queue.pop(value));
+        ASSERT_TRUE(queue.empty());
+    }
+
+    TEST(SpscQueueTest, WrapsAroundManyTimes) {
+        SpscQueue<int> queue(8);
+        int value{};
+        for (int i = 0; i < 1000; ++i) {
+            ASSERT_TRUE(queue.push(i));
+            ASSERT_TRUE(queue.push(i + 1));
+            ASSERT_TRUE(queue.pop(value));
+            ASSERT_EQ(value, i);
+            ASSERT_TRUE(queue.pop(value));
+            ASSERT_EQ(value, i + 1);
+        }
+    }
+
+    TEST(SpscQueueTest, ClaimCommitAndFrontWorkInPlace) {
+        SpscQueue<std::string> queue(2);
+
+        auto *slot = queue.try_claim();
+        ASSERT_NE(slot, nullptr);
+        slot->assign("hello");
+        ASSERT_TRUE(queue.empty()); // not visible before commit
+        queue.commit();
+
+        ASSERT_TRUE(queue.emplace(3, 'x'));
+        ASSERT_EQ(queue.try_claim(), nullptr);
+
+        auto *head = queue.front();
+        ASSERT_NE(head, nullptr);
+        ASSERT_EQ(*head, "hello");
+        queue.pop();
+        head = queue.front();
+        ASSERT_NE(head, nullptr);
+        ASSERT_EQ(*head, "xxx");
+        queue.pop();
+        ASSERT_EQ(queue.front(), nullptr);
+    }
+
+    TEST(SpscQueueTest, BatchPushAndPop) {
+        SpscQueue<int> queue(8);
+        const int in[10] = {0, 1, 2, 3, 4, 5, 6, 7, 8, 9};
+        ASSERT_EQ(queue.push_n(in, 10), 8u);
+
+        int out[10] = {};
+        ASSERT_EQ(queue.pop_n(out, 3), 3u);
+        ASSERT_EQ(queue.push_n(in + 8, 2), 2u);
+        ASSERT_EQ(queue.pop_n(out + 3, 10), 7u);
+        for (int i = 0; i < 10; ++i) {
+            ASSERT_EQ(out[i], i);
+        }
+    }
+
+    TEST(SpscQueueTest, ProducerConsumerThreadsSeeEveryElementInOrder) {
+        constexpr int count = 200000;
+        SpscQueue<int> queue(64);
+        std::thread producer([&] {
+            for (int i = 0; i < count;) {
+                if (queue.push(i)) {
+                    ++i;
+                } else {
+                    std::this_thread::yield();
+                }
+            }
+        });
+
+        int expected = 0;
+        int value{};
+        while (expected < count) {
+            if (queue.pop(value)) {
+                ASSERT_EQ(value, expected);
+                ++expected;
+            } else {
+                std::this_thread::yield();
+            }
+        }
+        producer.join();
+        ASSERT_TRUE(queue.empty());
+    }
+} // namespace util
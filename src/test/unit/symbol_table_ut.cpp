@@ -0,0 +1,28 @@
+#include <string>
+
+#include "gtest/gtest.h"
+#include "../../util/symbol_table.h"
+
+namespace util {
+    TEST(SymbolTableTest, InternsSymbolsIntoDenseIds) {
+        SymbolTable symbols{"BTCGUSDPERP", "ETHGUSDPERP"};
+        ASSERT_EQ(symbols.size(), 2u);
+        ASSERT_EQ(symbols.find("BTCGUSDPERP"), 0);
+        ASSERT_EQ(symbols.find("ETHGUSDPERP"), 1);
+        ASSERT_EQ(symbols.find("SOLGUSDPERP"), InvalidSymbolId);
+        ASSERT_EQ(symbols.add("ETHGUSDPERP"), 1); // already interned
+        ASSERT_EQ(symbols.add("SOLGUSDPERP"), 2);
+        ASSERT_EQ(symbols.name(2), "SOLGUSDPERP");
+    }
+
+    TEST(SymbolTableTest, FindsEverySymbolAfterGrowing) {
+        SymbolTable symbols;
+        for (int i = 0; i < 1000; ++i) {
+            ASSERT_EQ(symbols.add("SYM" + std::to_string(i)), i);
+        }
+        for (int i = 0; i < 1000; ++i) {
+            ASSERT_EQ(symbols.find("SYM" + std::to_string(i)), i);
+        }
+        ASSERT_EQ(symbols.find("SYM1000"), InvalidSymbolId);
+    }
+}
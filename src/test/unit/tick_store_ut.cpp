@@ -0,0 +1,170 @@
+#include <sys/resource.h>
+#include <unistd.h>
+
+#include <csignal>
+#include <filesystem>
+#include <string>
+
+#include "gtest/gtest.h"
+#include "../../client/l2_book_builder.h"
+#include "../../store/column_file.h"
+#include "../../store/tick_store.h"
+
+namespace store {
+    using namespace util::literals;
+
+    namespace {
+        // 2024-03-01T00:00:00Z
+        constexpr int64_t Day = 1709251200'000'000'000;
+        constexpr int64_t NanosPerDay = 86'400'000'000'000;
+
+        class TickStoreTest : public ::testing::Test {
+        protected:
+            void TearDown() override {
+                std::filesystem::remove_all(root);
+            }
+
+            const std::filesystem::path root = std::filesystem::temp_directory_path() /
+                                               ("tick_store_ut." + std::to_string(::getpid()));
+            const util::SymbolTable symbols{"BTCGUSDPERP", "ETHGUSDPERP"};
+        };
+    }
+
+    TEST(TickStoreDateTest, UtcDate) {
+        ASSERT_EQ(utcDate(0), 19700101u);
+        ASSERT_EQ(utcDate(Day), 20240301u);
+        ASSERT_EQ(utcDate(Day - 1), 20240229u);
+    }
+
+    TEST_F(TickStoreTest, AppendsArePartitionedByDayAndSymbol) {
+        {
+            TickStoreWriter writer(symbols, TickStoreConfig{.root = root, .grow_rows = 16});
+            writer.start();
+            for (int64_t i = 0; i < 100; ++i) {
+                ASSERT_TRUE(writer.appendL2Delta(0, Day + i, i % 2 ? client::Side::ASK : client::Side::BID,
+                                                 util::Price::fromFixed(6000000000000 + i),
+                                                 util::Qty::fromFixed(100000000)));
+            }
+            ASSERT_TRUE(writer.appendBbo(1, Day + 5, 3000_px, util::Qty::fromFixed(1), 3001_px,
+                                         util::Qty::fromFixed(2)));
+            ASSERT_TRUE(writer.appendTrade(0, Day + NanosPerDay, client::Side::BID, 60001_px, 0.05_qty));
+            writer.stop();
+            ASSERT_EQ(writer.written(), 102u);
+            ASSERT_EQ(writer.dropped(), 0u);
+        }
+
+        const auto l2 = openStream(root, 20240301, "BTCGUSDPERP", Stream::L2_DELTAS);
+        ASSERT_EQ(l2.rows(), 100u);
+        ASSERT_EQ(l2.timestamps()[42], Day + 42);
+        ASSERT_EQ(l2.prices()[42], 6000000000042);
+        ASSERT_EQ(l2.quantities()[42], 100000000);
+        ASSERT_EQ(l2.sides()[1], static_cast<int8_t>(client::Side::ASK));
+
+        const auto bbo = openStream(root, 20240301, "ETHGUSDPERP", Stream::BBO);
+        ASSERT_EQ(bbo.rows(), 1u);
+        ASSERT_EQ(bbo.askPrices()[0], 300100000000);
+        ASSERT_EQ(bbo.askQuantities()[0], 2);
+
+        // The trade falls on the next day.
+        const auto trades = openStream(root, 20240302, "BTCGUSDPERP", Stream::TRADES);
+        ASSERT_EQ(trades.rows(), 1u);
+        ASSERT_EQ(trades.quantities()[0], 5000000);
+        ASSERT_THROW(openStream(root, 20240301, "BTCGUSDPERP", Stream::TRADES), std::runtime_error);
+    }
+
+    TEST_F(TickStoreTest, SeekFindsTheFirstRowAtOrAfter) {
+        {
+            TickStoreWriter writer(symbols, TickStoreConfig{.root = root, .grow_rows = 1000});
+            writer.start();
+            // Three rows per timestamp, spread over several index blocks.
+            for (int64_t i = 0; i < 3 * 5000; ++i) {
+                while (!writer.appendTrade(0, Day + 10 * (i / 3), client::Side::BID, util::Price::fromFixed(i),
+                                           util::Qty::fromFixed(1))) {
+                    std::this_thread::yield();
+                }
+            }
+        }
+        const auto trades = openStream(root, 20240301, "BTCGUSDPERP", Stream::TRADES);
+        ASSERT_EQ(trades.rows(), 15000u);
+        ASSERT_EQ(trades.seek(0), 0u);
+        ASSERT_EQ(trades.seek(Day), 0u);
+        ASSERT_EQ(trades.seek(Day + 1), 3u);
+        ASSERT_EQ(trades.seek(Day + 10 * 1234), 3u * 1234);
+        ASSERT_EQ(trades.seek(Day + 10 * 1234 - 5), 3u * 1234);
+        ASSERT_EQ(trades.seek(Day + 10 * 4999), 3u * 4999);
+        ASSERT_EQ(trades.seek(Day + 10 * 5000), 15000u);
+    }
+
+    TEST_F(TickStoreTest, ReopeningADayAppendsAfterItsLastRow) {
+        for (int run = 0; run < 2; ++run) {
+            TickStoreWriter writer(symbols, TickStoreConfig{.root = root, .grow_rows = 8});
+            writer.start();
+            for (int64_t i = 0; i < 10; ++i) {
+                writer.appendTrade(1, Day + 10 * run + i, client::Side::ASK, util::Price::fromFixed(i), util::Qty::fromFixed(1));
+            }
+        }
+        const auto trades = openStream(root, 20240301, "ETHGUSDPERP", Stream::TRADES);
+        ASSERT_EQ(trades.rows(), 20u);
+        ASSERT_EQ(trades.timestamps()[10], Day + 10);
+    }
+
+    TEST_F(TickStoreTest, ColumnWriterSurvivesFailedOpensAndGrows) {
+        std::filesystem::create_directories(root);
+        const auto path = (root / "column").string();
+        const auto open_files = [] {
+            return std::distance(std::filesystem::directory_iterator("/proc/self/fd"),
+                                 std::filesystem::directory_iterator{});
+        };
+        {
+            ColumnWriter<int64_t> writer(path, 4);
+            for (int64_t i = 0; i < 4; ++i) {
+                writer.append(i);
+            }
+
+            // The file may not grow past its first chunk: the append fails, the writer keeps its rows and still
+            // commits them when it goes.
+            rlimit limit{};
+            ::getrlimit(RLIMIT_FSIZE, &limit);
+            const auto previous = limit;
+            const auto handler = std::signal(SIGXFSZ, SIG_IGN);
+            limit.rlim_cur = sizeof(ColumnHeader) + 4 * sizeof(int64_t);
+            ::setrlimit(RLIMIT_FSIZE, &limit);
+            EXPECT_THROW(writer.append(4), std::runtime_error);
+            ::setrlimit(RLIMIT_FSIZE, &previous);
+            std::signal(SIGXFSZ, handler);
+            ASSERT_EQ(writer.rows(), 4u);
+        }
+        const ColumnReader<int64_t> reader(path);
+        ASSERT_EQ(reader.values().size(), 4u);
+        ASSERT_EQ(reader.values()[3], 3);
+
+        const auto before = open_files();
+        ASSERT_THROW(ColumnWriter<int32_t>(path, 4), std::runtime_error);
+        ASSERT_EQ(open_files(), before);
+    }
+
+    TEST_F(TickStoreTest, BookBuilderRecordsWhatItSees) {
+        {
+            TickStoreWriter writer(symbols, TickStoreConfig{.root = root});
+            util::LatestValueSlots<client::WsBestBidBestAskMsg> updates(symbols.size());
+            client::L2BookBuilder builder(symbols, updates);
+            builder.set_tick_store(&writer);
+            writer.start();
+            builder.on_message(R"({"type":"l2_updates","symbol":"BTCGUSDPERP","changes":[["buy","60000.5","1.5"]],)"
+                               R"("trades":[{"type":"trade","symbol":"BTCGUSDPERP","event_id":1,"timestamp":1,)"
+                               R"("price":"60001","quantity":"0.25","side":"sell"}]})", Day + 7);
+        }
+        const auto l2 = openStream(root, 20240301, "BTCGUSDPERP", Stream::L2_DELTAS);
+        ASSERT_EQ(l2.rows(), 1u);
+        ASSERT_EQ(l2.timestamps()[0], Day + 7);
+        ASSERT_EQ(l2.prices()[0], 6000050000000);
+        ASSERT_EQ(l2.quantities()[0], 150000000);
+        const auto bbo = openStream(root, 20240301, "BTCGUSDPERP", Stream::BBO);
+        ASSERT_EQ(bbo.rows(), 1u);
+        ASSERT_EQ(bbo.prices()[0], 6000050000000);
+        ASSERT_EQ(bbo.askPrices()[0], 0);
+        const auto trades = openStream(root, 20240301, "BTCGUSDPERP", Stream::TRADES);
+        ASSERT_EQ(trades.rows(), 1u);
+        ASSERT_EQ(trades.sides()[0], static_cast<int8_t>(client::Side::ASK));
+    }
+}
@@ -6,12 +6,15 @@
 #include "../../trading/market_maker.h"
 #include "../../trading/trading_engine.h"
 #include "../../client/ws_order_entry_client.h"
+#include "../../util/latest_value.h"
 #include "../../util/spsc_queue.h"
 
 namespace trading {
+    using namespace util::literals;
+
     class TradingEngineTest : public ::testing::Test {
     protected:
-        util::SpscQueue<client::WsOrderBookClient::WsBestBidBestAskMsg> incoming_order_book_updates_queue{1000};
+        util::LatestValueSlots<client::WsOrderBookClient::WsBestBidBestAskMsg> incoming_order_book_updates{1};
         util::SpscQueue<client::WsOrderEntryClient::WsOrderEntryReqMsg> outgoing_order_entry_req_queue{1000};
         util::SpscQueue<client::WsOrderEntryClient::WsOrderEntryResMsg> incoming_order_entry_res_queue{1000};
 
@@ -19,59 +22,71 @@ namespace trading {
         OrderManager orderManager{outgoing_order_entry_req_queue};
         MarketMaker marketMaker{orderManager, featureEngine};
         TradingEngine tradingEngine{
-            featureEngine, orderManager, marketMaker, incoming_order_book_updates_queue,
+            featureEngine, orderManager, marketMaker, incoming_order_book_updates,
             incoming_order_entry_res_queue
         };
 
-        void SetUp() override {
-            tradingEngine.start();
-        }
-
-        void TearDown() override {
-            tradingEngine.stop();
-        }
     };
 
     TEST_F(TradingEngineTest, ProcessOrderBookUpdate) {
         client::WsOrderBookClient::WsBestBidBestAskMsg best_bid_best_ask_msg;
-        best_bid_best_ask_msg.best_bid = 100.0;
-        best_bid_best_ask_msg.best_bid_quantity = 10.0;
-        best_bid_best_ask_msg.best_ask = 102.0;
-        best_bid_best_ask_msg.best_ask_quantity = 15.0;
+        best_bid_best_ask_msg.best_bid = 100.0_px;
+        best_bid_best_ask_msg.best_bid_quantity = 10.0_qty;
+        best_bid_best_ask_msg.best_ask = 102.0_px;
+        best_bid_best_ask_msg.best_ask_quantity = 15.0_qty;
 
-        incoming_order_book_updates_queue.push(best_bid_best_ask_msg);
-        std::this_thread::sleep_for(std::chrono::milliseconds(10)); // Allow some time for processing
+        incoming_order_book_updates.store(0, best_bid_best_ask_msg);
+        ASSERT_EQ(tradingEngine.processPending(), 1u);
 
-        double fair_price = featureEngine.getFairPrice();
-        ASSERT_DOUBLE_EQ(fair_price, 101.2);
+        const auto fair_price = featureEngine.getFairPrice();
+        ASSERT_EQ(fair_price, 101.2_px);
+    }
+
+    TEST_F(TradingEngineTest, OnlyTheLatestBookIsProcessed) {
+        for (int64_t i = 0; i < 100; ++i) {
+            incoming_order_book_updates.store(0, client::WsOrderBookClient::WsBestBidBestAskMsg{
+                .best_bid = 100.0_px + 1_px * i, .best_bid_quantity = 10.0_qty,
+                .best_ask = 102.0_px + 1_px * i, .best_ask_quantity = 15.0_qty
+            });
+        }
+        ASSERT_EQ(tradingEngine.processPending(), 1u);
+        ASSERT_EQ(featureEngine.getFairPrice(), 200.2_px);
+        ASSERT_EQ(tradingEngine.processPending(), 0u);
     }
 
     TEST_F(TradingEngineTest, ProcessOrderEntryResponse) {
-        // Arrange
-        client::WsOrderEntryClient::WsOrderEntryResMsg order_entry_res_msg{
-            client::WsOrderEntryClient::WsOrderEntryResMsg::OrdStatus::NEW, "Order executed", "order123"
+        client::WsOrderBookClient::WsBestBidBestAskMsg best_bid_best_ask_msg{
+            .best_bid = 100.0_px, .best_bid_quantity = 10.0_qty, .best_ask = 102.0_px, .best_ask_quantity = 15.0_qty
         };
+        incoming_order_book_updates.store(0, best_bid_best_ask_msg);
+        ASSERT_EQ(tradingEngine.processPending(), 1u);
+
+        client::WsOrderEntryClient::WsOrderEntryReqMsg bid_order;
+        ASSERT_TRUE(outgoing_order_entry_req_queue.pop(bid_order));
+        ASSERT_EQ(bid_order.side, client::Side::BID);
 
-        // Act
+        client::WsOrderEntryClient::WsOrderEntryResMsg order_entry_res_msg{
+            client::WsOrderEntryClient::WsOrderEntryResMsg::OrdStatus::NEW, "Order executed", 123
+        };
+        order_entry_res_msg.side = client::Side::BID;
+        order_entry_res_msg.client_order_id = bid_order.client_order_id;
         incoming_order_entry_res_queue.push(order_entry_res_msg);
-        std::this_thread::sleep_for(std::chrono::milliseconds(10)); // Allow some time for processing
+        ASSERT_EQ(tradingEngine.processPending(), 1u);
 
-        // Assert
-        // Here we would ideally verify that the order manager has processed the order update correctly.
-        // This would involve adding methods to OrderManager to query the state of orders for verification.
-        // For now, we just check that no exceptions occurred.
-        SUCCEED();
+        ASSERT_EQ(orderManager.bidOrder(0)->state, OrderManager::OMOrder::OPEN);
+        ASSERT_EQ(orderManager.bidOrder(0)->order_id, 123u);
+        ASSERT_EQ(orderManager.askOrder(0)->state, OrderManager::OMOrder::PENDING_OPEN);
     }
 
     TEST_F(TradingEngineTest, SubmitOrderOnBestBidBestAskUpdate) {
         client::WsOrderBookClient::WsBestBidBestAskMsg best_bid_best_ask_msg;
-        best_bid_best_ask_msg.best_bid = 100.0;
-        best_bid_best_ask_msg.best_bid_quantity = 10.0;
-        best_bid_best_ask_msg.best_ask = 102.0;
-        best_bid_best_ask_msg.best_ask_quantity = 15.0;
+        best_bid_best_ask_msg.best_bid = 100.0_px;
+        best_bid_best_ask_msg.best_bid_quantity = 10.0_qty;
+        best_bid_best_ask_msg.best_ask = 102.0_px;
+        best_bid_best_ask_msg.best_ask_quantity = 15.0_qty;
 
-        incoming_order_book_updates_queue.push(best_bid_best_ask_msg);
-        std::this_thread::sleep_for(std::chrono::milliseconds(10)); // Allow some time for processing
+        incoming_order_book_updates.store(0, best_bid_best_ask_msg);
+        ASSERT_EQ(tradingEngine.processPending(), 1u);
 
         std::array<client::WsOrderEntryClient::WsOrderEntryReqMsg, 2> orders;
         ASSERT_TRUE(outgoing_order_entry_req_queue.pop(orders[0]));
@@ -81,9 +96,9 @@ namespace trading {
         client::WsOrderEntryClient::WsOrderEntryReqMsg *ask_order = nullptr;
 
         for (auto &order : orders) {
-            if (order.side == "bid") {
+            if (order.side == client::Side::BID) {
                 bid_order = &order;
-            } else if (order.side == "ask") {
+            } else if (order.side == client::Side::ASK) {
                 ask_order = &order;
             }
         }
@@ -92,16 +107,49 @@ namespace trading {
         ASSERT_NE(ask_order, nullptr);
 
         // Assertions for bid order
-        ASSERT_EQ(bid_order->side, "bid");
-        ASSERT_EQ(bid_order->price, 100.0);
-        ASSERT_EQ(bid_order->quantity, 0.1);
+        ASSERT_EQ(bid_order->side, client::Side::BID);
+        ASSERT_EQ(bid_order->price, 100.0_px);
+        ASSERT_EQ(bid_order->quantity, 0.1_qty);
 
         // Assertions for ask order
-        ASSERT_EQ(ask_order->side, "ask");
-        ASSERT_EQ(ask_order->price, 101.0);
-        ASSERT_EQ(ask_order->quantity, 0.1);
+        ASSERT_EQ(ask_order->side, client::Side::ASK);
+        ASSERT_EQ(ask_order->price, 101.0_px);
+        ASSERT_EQ(ask_order->quantity, 0.1_qty);
 
         std::cout << "Bid Order: " << bid_order->to_string() << std::endl;
         std::cout << "Ask Order: " << ask_order->to_string() << std::endl;
     }
+
+    TEST_F(TradingEngineTest, TradesFeedTheTradeFeatures) {
+        util::SpscQueue<client::WsTradesMsg> incoming_trades(16);
+        tradingEngine.setIncomingTrades(&incoming_trades);
+        incoming_trades.push(client::WsTradesMsg{.price = 100.0_px, .quantity = 3.0_qty,
+                                                 .aggressor_side = client::Side::BID});
+        incoming_trades.push(client::WsTradesMsg{.price = 100.0_px, .quantity = 1.0_qty,
+                                                 .aggressor_side = client::Side::ASK});
+        ASSERT_EQ(tradingEngine.processPending(), 2u);
+        ASSERT_TRUE(incoming_trades.empty());
+        const auto decay = features::TradeFlowImbalance<32>::Decay;
+        ASSERT_DOUBLE_EQ(featureEngine.feature<features::TradeFlowImbalance<32>>().value(),
+                         (3.0 * decay - 1.0) / (3.0 * decay + 1.0));
+        ASSERT_EQ(tradingEngine.processPending(), 0u);
+    }
+
+    TEST_F(TradingEngineTest, ProcessesOnItsOwnThreadOnceStarted) {
+        client::WsOrderBookClient::WsBestBidBestAskMsg best_bid_best_ask_msg{
+            .best_bid = 100.0_px, .best_bid_quantity = 10.0_qty, .best_ask = 102.0_px, .best_ask_quantity = 15.0_qty
+        };
+        tradingEngine.start();
+        incoming_order_book_updates.store(0, best_bid_best_ask_msg);
+        tradingEngine.notify();
+
+        client::WsOrderEntryClient::WsOrderEntryReqMsg order;
+        const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+        while (!outgoing_order_entry_req_queue.pop(order) && std::chrono::steady_clock::now() < deadline) {
+            std::this_thread::yield();
+        }
+        tradingEngine.stop();
+        ASSERT_EQ(order.type, client::WsOrderEntryClient::WsOrderEntryReqMsg::RequestType::NEW_ORDER);
+        ASSERT_EQ(featureEngine.getFairPrice(), 101.2_px);
+    }
 } // namespace trading
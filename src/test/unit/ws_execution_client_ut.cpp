@@ -0,0 +1,248 @@
+#include <openssl/evp.h>
+#include <openssl/hmac.h>
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "../mock/mock_ws_server.h"
+#include "../../client/ws_execution_client.h"
+
+namespace client {
+    using namespace util::literals;
+
+    namespace {
+        using ResMsg = WsOrderEntryClient::WsOrderEntryResMsg;
+
+        template<typename Predicate>
+        bool waitFor(Predicate &&predicate) {
+            const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+            while (!predicate()) {
+                if (std::chrono::steady_clock::now() > deadline) {
+                    return false;
+                }
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+            return true;
+        }
+
+        struct RecordingHandler {
+            void on_order_event(const GeminiOrderEvent &event) {
+                events.push_back(event);
+            }
+
+            std::vector<GeminiOrderEvent> events;
+        };
+
+        std::string header(const http::request<http::string_body> &request, std::string_view name) {
+            const auto value = request[beast::string_view(name.data(), name.size())];
+            return std::string(value.data(), value.size());
+        }
+
+        std::string base64Decode(const std::string &in) {
+            std::string out(in.size(), '\0');
+            const auto size = EVP_DecodeBlock(reinterpret_cast<unsigned char *>(out.data()),
+                                              reinterpret_cast<const unsigned char *>(in.data()),
+                                              static_cast<int>(in.size()));
+            out.resize(static_cast<size_t>(size) - std::count(in.begin(), in.end(), '='));
+            return out;
+        }
+
+        std::string hmacSha384Hex(std::string_view key, std::string_view data) {
+            unsigned char digest[EVP_MAX_MD_SIZE];
+            unsigned int size = 0;
+            HMAC(EVP_sha384(), key.data(), static_cast<int>(key.size()),
+                 reinterpret_cast<const unsigned char *>(data.data()), data.size(), digest, &size);
+            std::string hex(2 * size, '\0');
+            encoding::hex_encode(digest, size, hex.data());
+            return hex;
+        }
+    }
+
+    TEST(GeminiOrderEventsParserTest, ParsesEveryEventOfAMessage) {
+        RecordingHandler handler;
+        uint64_t socket_sequence = 0;
+        const auto type = GeminiOrderEventsParser::parse(
+            R"([{"type":"fill","order_id":"109535951","api_session":"UI","client_order_id":"4294967297",)"
+            R"("symbol":"btcgusdperp","side":"buy","order_type":"exchange limit","timestamp":"1547242032",)"
+            R"("timestampms":1547242032000,"is_live":true,"is_cancelled":false,"is_hidden":false,)"
+            R"("avg_execution_price":"3592.00","executed_amount":"0.4","remaining_amount":"0.6",)"
+            R"("original_amount":"1","price":"3592.00","fill":{"trade_id":"109535955","liquidity":"Maker",)"
+            R"("price":"3592.00","amount":"0.4","fee":"0.0359","fee_currency":"USD"},"socket_sequence":7},)"
+            R"({"type":"cancelled","order_id":"109535952","client_order_id":"my-order","symbol":"btcgusdperp",)"
+            R"("side":"sell","reason":"Requested","remaining_amount":"2","socket_sequence":7}])",
+            handler, socket_sequence);
+        ASSERT_EQ(type, GeminiOrderEventsParser::MessageType::ORDER_EVENTS);
+        ASSERT_EQ(socket_sequence, 7u);
+        ASSERT_EQ(handler.events.size(), 2u);
+
+        const auto &fill = handler.events[0];
+        ASSERT_EQ(fill.type, GeminiOrderEvent::Type::FILL);
+        ASSERT_EQ(fill.order_id, 109535951u);
+        ASSERT_EQ(fill.client_order_id, 4294967297u);
+        ASSERT_EQ(fill.symbol, "btcgusdperp");
+        ASSERT_EQ(fill.side, Side::BID);
+        ASSERT_EQ(fill.timestamp_ms, 1547242032000u);
+        ASSERT_EQ(fill.price, 3592_px);
+        ASSERT_EQ(fill.original_amount, 1_qty);
+        ASSERT_EQ(fill.executed_amount, 0.4_qty);
+        ASSERT_TRUE(fill.has_remaining_amount);
+        ASSERT_EQ(fill.remaining_amount, 0.6_qty);
+        ASSERT_EQ(fill.fill_price, 3592_px);
+        ASSERT_EQ(fill.fill_amount, 0.4_qty);
+
+        // Not an id we would have sent.
+        const auto &cancelled = handler.events[1];
+        ASSERT_EQ(cancelled.type, GeminiOrderEvent::Type::CANCELLED);
+        ASSERT_EQ(cancelled.client_order_id, 0u);
+        ASSERT_EQ(cancelled.side, Side::ASK);
+        ASSERT_EQ(cancelled.reason, "Requested");
+    }
+
+    TEST(GeminiOrderEventsParserTest, ClassifiesControlMessages) {
+        RecordingHandler handler;
+        uint64_t socket_sequence = 0;
+        ASSERT_EQ(GeminiOrderEventsParser::parse(
+                      R"({"type":"subscription_ack","accountId":5365,"subscriptionId":"ws-order-events-5365",)"
+                      R"("symbolFilter":[],"apiSessionFilter":[],"eventTypeFilter":[],"socket_sequence":0})",
+                      handler, socket_sequence), GeminiOrderEventsParser::MessageType::SUBSCRIPTION_ACK);
+        ASSERT_EQ(GeminiOrderEventsParser::parse(
+                      R"({"type":"heartbeat","timestampms":1547742998508,"sequence":31,"trace_id":"b8biknoqppr32kc7gfgg",)"
+                      R"("socket_sequence":37})", handler, socket_sequence),
+                  GeminiOrderEventsParser::MessageType::HEARTBEAT);
+        ASSERT_EQ(socket_sequence, 37u);
+        ASSERT_EQ(GeminiOrderEventsParser::parse(R"([])", handler, socket_sequence),
+                  GeminiOrderEventsParser::MessageType::ORDER_EVENTS);
+        ASSERT_EQ(GeminiOrderEventsParser::parse(R"({"type":"error"})", handler, socket_sequence),
+                  GeminiOrderEventsParser::MessageType::UNKNOWN);
+        ASSERT_EQ(GeminiOrderEventsParser::parse(R"([{"type":"fill","remaining_amount":"x"}])", handler,
+                                                 socket_sequence), GeminiOrderEventsParser::MessageType::INVALID);
+        ASSERT_EQ(GeminiOrderEventsParser::parse(R"([{"type":"fill")", handler, socket_sequence),
+                  GeminiOrderEventsParser::MessageType::INVALID);
+        ASSERT_TRUE(handler.events.empty());
+    }
+
+    class WsExecutionClientTest : public ::testing::Test {
+    protected:
+        static WsExecutionClientConfig testConfig() {
+            WsExecutionClientConfig config;
+            config.reconnect_backoff = std::chrono::milliseconds(10);
+            config.ca_certificate_pem = std::string(mock::LocalhostCertificatePem);
+            return config;
+        }
+
+        // Waits for the next event on the queue.
+        bool nextEvent(ResMsg &msg) {
+            return waitFor([&] { return events.pop(msg); });
+        }
+
+        mock::MockWsServer server{false};
+        const util::SymbolTable symbols{"BTCGUSDPERP", "ETHGUSDPERP"};
+        util::SpscQueue<ResMsg> events{64};
+        WsExecutionClient client{"wss://localhost:" + std::to_string(server.port()) +
+                                 "/v1/order/events?eventTypeFilter=fill", symbols, events, "account-key",
+                                 "account-secret", nullptr, testConfig()};
+    };
+
+    TEST_F(WsExecutionClientTest, AuthenticatesTheUpgradeRequest) {
+        client.start();
+        ASSERT_TRUE(waitFor([&] { return server.handshakes().size() == 1; }));
+        const auto handshakes = server.handshakes();
+        ASSERT_EQ(handshakes.size(), 1u);
+        const auto &request = handshakes[0];
+        ASSERT_EQ(request.target(), "/v1/order/events?eventTypeFilter=fill");
+        ASSERT_EQ(header(request, "X-GEMINI-APIKEY"), "account-key");
+        const auto payload = header(request, "X-GEMINI-PAYLOAD");
+        // The request is the path alone, without the filters.
+        const auto json = base64Decode(payload);
+        ASSERT_EQ(json.find(R"({"request":"/v1/order/events","nonce":)"), 0u) << json;
+        ASSERT_EQ(json.back(), '}');
+        ASSERT_EQ(header(request, "X-GEMINI-SIGNATURE"), hmacSha384Hex("account-secret", payload));
+    }
+
+    TEST_F(WsExecutionClientTest, StreamsOrderEventsAsResponses) {
+        const auto gaps = util::MetricsRegistry::instance().counter("oe.events_gaps").value();
+        client.start();
+        ASSERT_TRUE(waitFor([&] { return server.handshakes().size() == 1; }));
+        server.send({
+            R"({"type":"subscription_ack","accountId":1,"subscriptionId":"ws-order-events-1","socket_sequence":0})",
+            R"([{"type":"initial","order_id":"5","client_order_id":"4294967296","symbol":"btcgusdperp",)"
+            R"("side":"buy","original_amount":"1","remaining_amount":"1","socket_sequence":1}])",
+            R"([{"type":"accepted","order_id":"10","client_order_id":"4294967297","symbol":"ethgusdperp",)"
+            R"("side":"sell","original_amount":"2","price":"3000","socket_sequence":2},)"
+            R"({"type":"booked","order_id":"10","client_order_id":"4294967297","symbol":"ethgusdperp",)"
+            R"("side":"sell","original_amount":"2","remaining_amount":"2","socket_sequence":2}])",
+            R"([{"type":"fill","order_id":"10","client_order_id":"4294967297","symbol":"ethgusdperp","side":"sell",)"
+            R"("executed_amount":"0.5","remaining_amount":"1.5","fill":{"price":"3000","amount":"0.5"},)"
+            R"("socket_sequence":3}])",
+            R"({"type":"heartbeat","timestampms":1,"sequence":1,"socket_sequence":4})",
+            R"([{"type":"fill","order_id":"10","client_order_id":"4294967297","symbol":"ethgusdperp","side":"sell",)"
+            R"("executed_amount":"2","remaining_amount":"0","fill":{"price":"3000","amount":"1.5"},)"
+            R"("socket_sequence":5},{"type":"closed","order_id":"10","client_order_id":"4294967297",)"
+            R"("symbol":"ethgusdperp","side":"sell","remaining_amount":"0","socket_sequence":5}])",
+            R"([{"type":"cancelled","order_id":"11","client_order_id":"4294967298","symbol":"btcgusdperp",)"
+            R"("side":"buy","reason":"Requested","remaining_amount":"1","socket_sequence":6}])",
+            R"([{"type":"rejected","order_id":"12","client_order_id":"4294967299","symbol":"btcgusdperp",)"
+            R"("side":"buy","reason":"InvalidPrice","socket_sequence":7}])",
+            R"([{"type":"fill","order_id":"13","symbol":"btcgusdperp","side":"buy","remaining_amount":"0",)"
+            R"("fill":{"price":"60000","amount":"1"},"socket_sequence":8}])",
+            R"([{"type":"accepted","order_id":"14","client_order_id":"4294967301","symbol":"btcgusdperp",)"
+            R"("side":"buy","original_amount":"1","socket_sequence":9}])"
+        });
+
+        ResMsg msg;
+        ASSERT_TRUE(nextEvent(msg));
+        ASSERT_EQ(msg.status, ResMsg::OrdStatus::NEW);
+        ASSERT_EQ(msg.order_id, 10u);
+        ASSERT_EQ(msg.client_order_id, 4294967297u);
+        ASSERT_EQ(msg.symbol_id, 1);
+        ASSERT_EQ(msg.side, Side::ASK);
+        ASSERT_EQ(msg.leaves_qty, 2_qty);
+
+        ASSERT_TRUE(nextEvent(msg));
+        ASSERT_EQ(msg.status, ResMsg::OrdStatus::PARTIALLY_FILLED);
+        ASSERT_EQ(msg.leaves_qty, 1.5_qty);
+
+        ASSERT_TRUE(nextEvent(msg));
+        ASSERT_EQ(msg.status, ResMsg::OrdStatus::FILLED);
+        ASSERT_TRUE(msg.leaves_qty.isZero());
+
+        ASSERT_TRUE(nextEvent(msg));
+        ASSERT_EQ(msg.status, ResMsg::OrdStatus::CANCELED);
+        ASSERT_EQ(msg.client_order_id, 4294967298u);
+        ASSERT_EQ(msg.symbol_id, 0);
+        ASSERT_TRUE(msg.leaves_qty.isZero());
+
+        ASSERT_TRUE(nextEvent(msg));
+        ASSERT_EQ(msg.status, ResMsg::OrdStatus::REJECTED);
+        ASSERT_EQ(msg.order_id, 12u);
+        ASSERT_EQ(msg.message.view(), "InvalidPrice");
+
+        // Initial, booked and closed events and orders without a client order id of ours are not passed on.
+        ASSERT_TRUE(nextEvent(msg));
+        ASSERT_EQ(msg.order_id, 14u);
+        ASSERT_EQ(util::MetricsRegistry::instance().counter("oe.events_gaps").value(), gaps);
+        client.stop();
+        ASSERT_FALSE(client.is_connected());
+    }
+
+    TEST_F(WsExecutionClientTest, ReconnectsAndAuthenticatesAgain) {
+        client.start();
+        ASSERT_TRUE(waitFor([&] { return server.handshakes().size() == 1; }));
+        server.dropConnections();
+        ASSERT_TRUE(waitFor([&] { return server.handshakes().size() == 2; }));
+        const auto handshakes = server.handshakes();
+        // A fresh nonce for every connection.
+        ASSERT_NE(header(handshakes[1], "X-GEMINI-PAYLOAD"), header(handshakes[0], "X-GEMINI-PAYLOAD"));
+
+        // The sequence starts over on the new connection.
+        server.send(R"([{"type":"accepted","order_id":"20","client_order_id":"4294967300","symbol":"btcgusdperp",)"
+                    R"("side":"buy","original_amount":"1","socket_sequence":0}])");
+        ResMsg msg;
+        ASSERT_TRUE(nextEvent(msg));
+        ASSERT_EQ(msg.status, ResMsg::OrdStatus::NEW);
+        ASSERT_EQ(msg.order_id, 20u);
+    }
+}
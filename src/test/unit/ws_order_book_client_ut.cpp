@@ -0,0 +1,106 @@
+#include <chrono>
+#include <string>
+#include <thread>
+
+#include "gtest/gtest.h"
+#include "../mock/mock_ws_server.h"
+#include "../../client/ws_order_book_client.h"
+
+namespace client {
+    using namespace util::literals;
+
+    namespace {
+        template<typename Predicate>
+        bool waitFor(Predicate &&predicate) {
+            const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+            while (!predicate()) {
+                if (std::chrono::steady_clock::now() > deadline) {
+                    return false;
+                }
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+            return true;
+        }
+
+        WsOrderBookClientConfig testConfig(bool busy_poll) {
+            WsOrderBookClientConfig config;
+            config.busy_poll = busy_poll;
+            config.reconnect_backoff = std::chrono::milliseconds(10);
+            config.ca_certificate_pem = std::string(mock::LocalhostCertificatePem);
+            return config;
+        }
+    }
+
+    class WsOrderBookClientTest : public ::testing::TestWithParam<bool> {
+    protected:
+        // Waits for the next top of book of symbol 0.
+        bool nextBook(WsBestBidBestAskMsg &msg) {
+            return waitFor([&] { return updates.consume([&](size_t, const WsBestBidBestAskMsg &m) { msg = m; }) != 0; });
+        }
+
+        mock::MockWsServer server;
+        const util::SymbolTable symbols{"BTCGUSDPERP"};
+        util::LatestValueSlots<WsBestBidBestAskMsg> updates{1};
+        WsOrderBookClient client{"wss://localhost:" + std::to_string(server.port()) + "/v2/marketdata", symbols,
+                                 updates, nullptr, testConfig(GetParam())};
+    };
+
+    TEST_P(WsOrderBookClientTest, SubscribesAndBuildsTheBook) {
+        client.start();
+        ASSERT_TRUE(waitFor([&] { return server.subscriptions().size() == 1; }));
+        ASSERT_NE(server.subscriptions()[0].find(R"("symbols":["BTCGUSDPERP"])"), std::string::npos);
+        ASSERT_TRUE(client.is_connected());
+
+        const auto sent = replay::wallClockNanos();
+        server.send(R"({"type":"l2_updates","symbol":"BTCGUSDPERP","changes":[["buy","60000","1"],["sell","60001","2"]]})");
+        WsBestBidBestAskMsg msg;
+        ASSERT_TRUE(nextBook(msg));
+        ASSERT_EQ(msg.best_bid, 60000_px);
+        ASSERT_EQ(msg.best_ask, 60001_px);
+        ASSERT_EQ(msg.best_ask_quantity, 2_qty);
+        // When the kernel got the frame.
+        ASSERT_GE(msg.receive_time_ns, sent);
+        ASSERT_LE(msg.receive_time_ns, replay::wallClockNanos());
+
+        // The read buffer is reused, a big frame followed by small ones all come out whole.
+        std::string snapshot = R"({"type":"l2_updates","symbol":"BTCGUSDPERP","changes":[)";
+        for (int level = 1; level <= 2000; ++level) {
+            snapshot += R"(["buy",")" + std::to_string(50000 + level) + R"(","1"],)";
+        }
+        snapshot += R"(["buy","60000.5","3"]]})";
+        server.send({snapshot, R"({"type":"heartbeat","timestamp":1})",
+                     R"({"type":"l2_updates","symbol":"BTCGUSDPERP","changes":[["sell","60001","0"]]})"});
+        ASSERT_TRUE(waitFor([&] {
+            return updates.consume([&](size_t, const WsBestBidBestAskMsg &m) { msg = m; }) != 0 && msg.best_ask.isZero();
+        }));
+        ASSERT_EQ(msg.best_bid, 60000.5_px);
+        client.stop();
+        ASSERT_FALSE(client.is_connected());
+    }
+
+    TEST_P(WsOrderBookClientTest, ReconnectsResubscribesAndResyncsTheBook) {
+        client.start();
+        ASSERT_TRUE(waitFor([&] { return server.subscriptions().size() == 1; }));
+        server.send(R"({"type":"l2_updates","symbol":"BTCGUSDPERP","changes":[["buy","60000","1"],["buy","59999","1"]]})");
+        WsBestBidBestAskMsg msg;
+        ASSERT_TRUE(nextBook(msg));
+        ASSERT_EQ(msg.best_bid, 60000_px);
+
+        // Whatever happened while disconnected is unknown: the book is emptied right away.
+        server.dropConnections();
+        ASSERT_TRUE(nextBook(msg));
+        ASSERT_TRUE(msg.best_bid.isZero());
+        ASSERT_TRUE(waitFor([&] { return server.subscriptions().size() == 2; }));
+        ASSERT_EQ(server.subscriptions()[1], server.subscriptions()[0]);
+        ASSERT_EQ(server.connectionsAccepted(), 2u);
+
+        // The snapshot after the new subscription is the whole book, 60000 went away in the meantime.
+        server.send(R"({"type":"l2_updates","symbol":"BTCGUSDPERP","changes":[["buy","59999","1"],["sell","60002","1"]]})");
+        ASSERT_TRUE(nextBook(msg));
+        ASSERT_EQ(msg.best_bid, 59999_px);
+        ASSERT_EQ(msg.best_ask, 60002_px);
+    }
+
+    INSTANTIATE_TEST_SUITE_P(RunLoops, WsOrderBookClientTest, ::testing::Values(false, true),
+                             [](const auto &info) { return info.param ? "BusyPoll" : "Blocking"; });
+}
@@ -0,0 +1,117 @@
+// cmm_metrics: prints the metrics a running crypto_mm publishes in shared memory.
+//
+//   cmm_metrics [--segment=/crypto_mm.metrics] [--interval=<seconds>] [--prometheus]
+//
+// Attaches read only, so it can be started, stopped and pointed at a live process at any time without the
+// trading threads noticing. With --interval it keeps printing, counters then also show their rate.
+
+#include <chrono>
+#include <cstdio>
+#include <exception>
+#include <string>
+#include <thread>
+#include <unordered_map>
+
+#include "../util/metrics.h"
+
+namespace {
+  std::string formatValue(const util::MetricValue &metric) {
+    if (metric.type == util::MetricType::DECIMAL_GAUGE) {
+      char buffer[util::MaxDecimalChars];
+      return std::string(buffer, util::formatDecimal(metric.value, buffer));
+    }
+    return std::to_string(metric.value);
+  }
+
+  // Prometheus names allow neither dots nor dashes.
+  std::string prometheusName(const std::string &name) {
+    std::string out = "cmm_";
+    for (const auto c: name) {
+      out += (c == '.' || c == '-') ? '_' : c;
+    }
+    return out;
+  }
+
+  void printText(const util::MetricsReader &reader, std::unordered_map<std::string, int64_t> &previous,
+                 double interval) {
+    std::printf("pid %ld\n", static_cast<long>(reader.pid()));
+    for (const auto &metric: reader.metrics()) {
+      std::printf("  %-40s %20s", metric.name.c_str(), formatValue(metric).c_str());
+      if (metric.type == util::MetricType::COUNTER && interval > 0) {
+        const auto it = previous.find(metric.name);
+        if (it != previous.end()) {
+          std::printf("  %12.1f/s", static_cast<double>(metric.value - it->second) / interval);
+        }
+        previous[metric.name] = metric.value;
+      }
+      std::printf("\n");
+    }
+    for (const auto &histogram: reader.histograms()) {
+      std::printf("  %-40s n=%lu mean=%lu p50<=%lu p99<=%lu\n", histogram.name.c_str(), histogram.count,
+                  histogram.count ? histogram.sum / histogram.count : 0, histogram.percentile(0.5),
+                  histogram.percentile(0.99));
+    }
+    std::fflush(stdout);
+  }
+
+  void printPrometheus(const util::MetricsReader &reader) {
+    for (const auto &metric: reader.metrics()) {
+      const auto name = prometheusName(metric.name);
+      std::printf("# TYPE %s %s\n%s %s\n", name.c_str(), metric.type == util::MetricType::COUNTER ? "counter" : "gauge",
+                  name.c_str(), formatValue(metric).c_str());
+    }
+    for (const auto &histogram: reader.histograms()) {
+      const auto name = prometheusName(histogram.name);
+      std::printf("# TYPE %s histogram\n", name.c_str());
+      uint64_t cumulative = 0;
+      for (size_t i = 0; i + 1 < histogram.buckets.size(); ++i) {
+        cumulative += histogram.buckets[i];
+        if (histogram.buckets[i] != 0) {
+          std::printf("%s_bucket{le=\"%lu\"} %lu\n", name.c_str(), i == 0 ? 0 : (uint64_t{1} << i) - 1, cumulative);
+        }
+      }
+      std::printf("%s_bucket{le=\"+Inf\"} %lu\n%s_sum %lu\n%s_count %lu\n", name.c_str(), histogram.count,
+                  name.c_str(), histogram.sum, name.c_str(), histogram.count);
+    }
+    std::fflush(stdout);
+  }
+}
+
+int main(int argc, char *argv[]) {
+  std::string segment = "/crypto_mm.metrics";
+  double interval = 0;
+  bool prometheus = false;
+  for (int i = 1; i < argc; ++i) {
+    const std::string arg = argv[i];
+    if (arg.find("--segment=") == 0) {
+      segment = arg.substr(std::string("--segment=").size());
+    } else if (arg.find("--interval=") == 0) {
+      interval = std::stod(arg.substr(std::string("--interval=").size()));
+    } else if (arg == "--prometheus") {
+      prometheus = true;
+    } else {
+      std::fprintf(stderr, "usage: %s [--segment=/crypto_mm.metrics] [--interval=<seconds>] [--prometheus]\n",
+                   argv[0]);
+      return 2;
+    }
+  }
+
+  try {
+    const util::MetricsReader reader(segment);
+    std::unordered_map<std::string, int64_t> previous;
+    while (true) {
+      if (prometheus) {
+        printPrometheus(reader);
+      } else {
+        printText(reader, previous, interval);
+      }
+      if (interval <= 0) {
+        return 0;
+      }
+      std::this_thread::sleep_for(std::chrono::duration<double>(interval));
+    }
+  } catch (const std::exception &e) {
+    std::fprintf(stderr, "%s\n", e.what());
+    return 1;
+  }
+}
@@ -1,9 +1,32 @@
 #pragma once
 
+#include <span>
+
+#include "features.h"
+#include "top_of_book_batch.h"
+#include "../util/logger.h"
+#include "../util/symbol_table.h"
+
 namespace trading {
+  // The features of every symbol, indexed by SymbolId, updated by book updates and trades. The strategy quotes
+  // around the weighted mid, the other features are there for it to lean on.
   class FeatureEngine {
   public:
-    explicit FeatureEngine() {
+    using Features = features::FeaturePipeline<
+      features::WeightedMid,
+      features::Microprice,
+      features::BookImbalance<1>,
+      features::BookImbalance<client::BookDepthLevels>,
+      features::EwmaVolatility<16>,
+      features::EwmaVolatility<256>,
+      features::EwmaVolatility<4096>,
+      features::SpreadStats<256>,
+      features::TradeFlowImbalance<32>>;
+
+    // `simd_level` is for tests and benchmarks, by default the widest the machine has.
+    explicit FeatureEngine(size_t num_symbols = 1, util::SimdLevel simd_level = util::simdLevel())
+      : features_(num_symbols)
+        , simd_level_(simd_level) {
     }
 
     FeatureEngine(const FeatureEngine &) = delete;
@@ -14,26 +37,46 @@ namespace trading {
 
     FeatureEngine &operator=(const FeatureEngine &&) = delete;
 
-    void onBestBidBestAskUpdate(double best_bid, double best_bid_quantity, double best_ask, double best_ask_quantity) {
-      std::cout << "best_bid: " << best_bid << std::endl;
-      std::cout << "best_bid_quantity: " << best_bid_quantity << std::endl;
-      std::cout << "best_ask: " << best_ask << std::endl;
-      std::cout << "best_ask_quantity: " << best_ask_quantity << std::endl;
-      if (best_bid != 0.0 && best_bid_quantity != 0.0 && best_ask != 0.0 && best_ask_quantity != 0.0) {
-        [[likely]]
-            m_fair_price = (best_bid * best_bid_quantity + best_ask * best_ask_quantity) / (
-                             best_bid_quantity + best_ask_quantity);
-      } else {
-        m_fair_price = 0.0;
+    // bid_depth and ask_depth are the quantities behind the best levels, nearest first, if the caller has them.
+    void onBestBidBestAskUpdate(util::SymbolId symbol_id, util::Price best_bid, util::Qty best_bid_quantity,
+                                util::Price best_ask, util::Qty best_ask_quantity,
+                                std::span<const util::Qty> bid_depth = {}, std::span<const util::Qty> ask_depth = {}) {
+      LOG_DEBUG("symbol_id: {}, best_bid: {}, best_bid_quantity: {}, best_ask: {}, best_ask_quantity: {}",
+                symbol_id, best_bid, best_bid_quantity, best_ask, best_ask_quantity);
+      features_.onBook(symbol_id, features::BookTick::make(best_bid, best_bid_quantity, best_ask, best_ask_quantity,
+                                                           bid_depth, ask_depth));
+      LOG_DEBUG("fair_price: {}", getFairPrice(symbol_id));
+    }
+
+    // The same as onBestBidBestAskUpdate() for every row of `batch`, in order. What the kernels share is
+    // evaluated for all rows at once with the widest SIMD the machine has, only the stateful kernels run per row.
+    void onBestBidBestAskBatch(features::TopOfBookBatch &batch) {
+      features::evaluateTopOfBook(batch, simd_level_);
+      for (size_t row = 0; row < batch.size; ++row) {
+        features_.onBook(batch.symbol_ids[row], batch.tick(row));
       }
-      std::cout << "m_fair_price: " << m_fair_price << std::endl;
     }
 
-    double getFairPrice() const {
-      return m_fair_price;
+    void onTrade(util::SymbolId symbol_id, client::Side aggressor_side, util::Price price, util::Qty quantity) {
+      features_.onTrade(symbol_id, features::TradeTick{aggressor_side, price, quantity});
+    }
+
+    util::Price getFairPrice(util::SymbolId symbol_id = 0) const {
+      return features_.get<features::WeightedMid>(symbol_id).price();
+    }
+
+    // feature<features::Microprice>(id).value() and the like.
+    template<typename Feature>
+    const Feature &feature(util::SymbolId symbol_id = 0) const noexcept {
+      return features_.get<Feature>(symbol_id);
+    }
+
+    size_t numSymbols() const noexcept {
+      return features_.numSymbols();
     }
 
   private:
-    double m_fair_price{0.0};
+    Features features_;
+    const util::SimdLevel simd_level_;
   };
 }
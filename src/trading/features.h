@@ -0,0 +1,315 @@
+#pragma once
+
+#include <cmath>
+#include <concepts>
+#include <cstddef>
+#include <span>
+#include <tuple>
+#include <vector>
+
+#include "../client/types.h"
+#include "../util/decimal.h"
+#include "../util/symbol_table.h"
+
+// Streaming microstructure features. A feature is a kernel: a small default constructible struct holding its
+// own state, updated in O(1) by onBook() and/or onTrade(). FeaturePipeline composes kernels at compile time into
+// one tuple per symbol, so a tick runs through every kernel of its symbol without a virtual call and touching
+// only that symbol's few cache lines.
+namespace trading::features {
+  // Keeps the compiler from fusing a product into the sum it feeds, so the scalar path and every SIMD width
+  // round the same way whatever the target.
+  template<typename T>
+  inline T unfused(T value) noexcept {
+    asm("" : "+v"(value));
+    return value;
+  }
+
+  // What every kernel may need from a top of book, derived once per update. All zero unless both sides have a
+  // price and a quantity. evaluateTopOfBook() computes the same for a batch of symbols, bit for bit.
+  struct TopOfBookValues {
+    bool two_sided{false};
+    double bid_quantity{};
+    double ask_quantity{};
+    double mid{};
+    double spread{};
+    // (bid * ask quantity + ask * bid quantity) / (bid quantity + ask quantity).
+    double microprice{};
+    // (bid * bid quantity + ask * ask quantity) / (bid quantity + ask quantity) on the fixed-point values, taken
+    // in double because the products overflow 64 bit, rounded half up.
+    util::Price weighted_mid{};
+
+    static TopOfBookValues derive(int64_t best_bid, int64_t best_bid_quantity, int64_t best_ask,
+                                  int64_t best_ask_quantity) noexcept {
+      TopOfBookValues values;
+      values.two_sided = best_bid != 0 && best_bid_quantity != 0 && best_ask != 0 && best_ask_quantity != 0;
+      if (!values.two_sided) [[unlikely]] {
+        return values;
+      }
+      const auto bid = util::fixedToDouble(best_bid);
+      const auto ask = util::fixedToDouble(best_ask);
+      values.bid_quantity = util::fixedToDouble(best_bid_quantity);
+      values.ask_quantity = util::fixedToDouble(best_ask_quantity);
+      values.mid = (bid + ask) * 0.5;
+      values.spread = ask - bid;
+      values.microprice = (unfused(bid * values.ask_quantity) + unfused(ask * values.bid_quantity)) /
+                          (values.bid_quantity + values.ask_quantity);
+      const auto bid_fixed = static_cast<double>(best_bid);
+      const auto ask_fixed = static_cast<double>(best_ask);
+      const auto bid_quantity_fixed = static_cast<double>(best_bid_quantity);
+      const auto ask_quantity_fixed = static_cast<double>(best_ask_quantity);
+      values.weighted_mid = util::Price::fromFixed(static_cast<int64_t>(
+        (unfused(bid_fixed * bid_quantity_fixed) + unfused(ask_fixed * ask_quantity_fixed)) /
+        (bid_quantity_fixed + ask_quantity_fixed) + 0.5));
+      return values;
+    }
+  };
+
+  // A top of book update as every kernel sees it.
+  struct BookTick : TopOfBookValues {
+    util::Price best_bid{};
+    util::Qty best_bid_quantity{};
+    util::Price best_ask{};
+    util::Qty best_ask_quantity{};
+    // Quantities of the levels behind the best ones, nearest first. Empty if the producer has no depth.
+    std::span<const util::Qty> bid_depth{};
+    std::span<const util::Qty> ask_depth{};
+
+    static BookTick make(util::Price best_bid, util::Qty best_bid_quantity, util::Price best_ask,
+                         util::Qty best_ask_quantity, std::span<const util::Qty> bid_depth = {},
+                         std::span<const util::Qty> ask_depth = {}) noexcept {
+      return BookTick{TopOfBookValues::derive(best_bid.fixed(), best_bid_quantity.fixed(), best_ask.fixed(),
+                                              best_ask_quantity.fixed()),
+                      best_bid, best_bid_quantity, best_ask, best_ask_quantity, bid_depth, ask_depth};
+    }
+  };
+
+  struct TradeTick {
+    client::Side aggressor_side{};
+    util::Price price{};
+    util::Qty quantity{};
+  };
+
+  template<typename Kernel>
+  concept BookKernel = requires(Kernel &kernel, const BookTick &tick) { kernel.onBook(tick); };
+
+  template<typename Kernel>
+  concept TradeKernel = requires(Kernel &kernel, const TradeTick &trade) { kernel.onTrade(trade); };
+
+  template<typename Kernel>
+  concept FeatureKernel = std::default_initializable<Kernel> && (BookKernel<Kernel> || TradeKernel<Kernel>);
+
+  // Per event decay of an EWMA with a half-life of `half_life` events, 2^(-1/half_life). std::exp is not
+  // constexpr, the series converges within a few terms for exponents down to -ln 2.
+  consteval double decayForHalfLife(size_t half_life) {
+    const double x = -0.6931471805599453 / static_cast<double>(half_life);
+    double term = 1.0;
+    double sum = 1.0;
+    for (int i = 1; i < 20; ++i) {
+      term *= x / i;
+      sum += term;
+    }
+    return sum;
+  }
+
+  // Quantity weighted mid, what the strategy quotes around. Zero without a two sided book.
+  class WeightedMid {
+  public:
+    void onBook(const BookTick &tick) noexcept {
+      price_ = tick.weighted_mid;
+    }
+
+    util::Price price() const noexcept {
+      return price_;
+    }
+
+  private:
+    util::Price price_{};
+  };
+
+  // Mid leaning towards the side with less quantity, where the price is more likely to go. Zero without a two
+  // sided book.
+  class Microprice {
+  public:
+    void onBook(const BookTick &tick) noexcept {
+      value_ = tick.microprice;
+    }
+
+    double value() const noexcept {
+      return value_;
+    }
+
+  private:
+    double value_{};
+  };
+
+  // (bid - ask) / (bid + ask) of the quantities on the first `Levels` levels of each side, in [-1, 1].
+  template<size_t Levels>
+  class BookImbalance {
+    static_assert(Levels >= 1);
+
+  public:
+    void onBook(const BookTick &tick) noexcept {
+      auto bid = tick.best_bid_quantity.toDouble();
+      auto ask = tick.best_ask_quantity.toDouble();
+      for (size_t i = 0; i < Levels - 1 && i < tick.bid_depth.size(); ++i) {
+        bid += tick.bid_depth[i].toDouble();
+      }
+      for (size_t i = 0; i < Levels - 1 && i < tick.ask_depth.size(); ++i) {
+        ask += tick.ask_depth[i].toDouble();
+      }
+      value_ = bid + ask > 0.0 ? (bid - ask) / (bid + ask) : 0.0;
+    }
+
+    double value() const noexcept {
+      return value_;
+    }
+
+  private:
+    double value_{};
+  };
+
+  // Volatility of the mid per book update, as an EWMA of squared relative mid changes with a half-life of
+  // `HalfLife` updates. A one sided book breaks the series, the change across it is not counted.
+  template<size_t HalfLife>
+  class EwmaVolatility {
+  public:
+    static constexpr double Decay = decayForHalfLife(HalfLife);
+
+    void onBook(const BookTick &tick) noexcept {
+      if (!tick.two_sided) [[unlikely]] {
+        last_mid_ = 0.0;
+        return;
+      }
+      if (last_mid_ != 0.0) [[likely]] {
+        const auto change = (tick.mid - last_mid_) / last_mid_;
+        variance_ = Decay * variance_ + (1.0 - Decay) * change * change;
+      }
+      last_mid_ = tick.mid;
+    }
+
+    // Standard deviation of the relative mid change per update, the square root is only taken here.
+    double value() const noexcept {
+      return std::sqrt(variance_);
+    }
+
+  private:
+    double variance_{};
+    double last_mid_{};
+  };
+
+  // Latest spread with its EWMA mean and standard deviation over a half-life of `HalfLife` two sided updates.
+  template<size_t HalfLife>
+  class SpreadStats {
+  public:
+    static constexpr double Decay = decayForHalfLife(HalfLife);
+
+    void onBook(const BookTick &tick) noexcept {
+      if (!tick.two_sided) [[unlikely]] {
+        return;
+      }
+      last_ = tick.spread;
+      if (!seeded_) [[unlikely]] {
+        mean_ = tick.spread;
+        seeded_ = true;
+      }
+      const auto deviation = tick.spread - mean_;
+      mean_ += (1.0 - Decay) * deviation;
+      variance_ = Decay * (variance_ + (1.0 - Decay) * deviation * deviation);
+    }
+
+    double last() const noexcept {
+      return last_;
+    }
+
+    double mean() const noexcept {
+      return mean_;
+    }
+
+    double stddev() const noexcept {
+      return std::sqrt(variance_);
+    }
+
+  private:
+    double last_{};
+    double mean_{};
+    double variance_{};
+    bool seeded_{false};
+  };
+
+  // (bought - sold) / (bought + sold) of aggressor quantities, as EWMAs with a half-life of `HalfLife` trades. A
+  // trade with a BID aggressor was bought.
+  template<size_t HalfLife>
+  class TradeFlowImbalance {
+  public:
+    static constexpr double Decay = decayForHalfLife(HalfLife);
+
+    void onTrade(const TradeTick &trade) noexcept {
+      const auto quantity = trade.quantity.toDouble();
+      bought_ = Decay * bought_ + (trade.aggressor_side == client::Side::BID ? quantity : 0.0);
+      sold_ = Decay * sold_ + (trade.aggressor_side == client::Side::ASK ? quantity : 0.0);
+    }
+
+    double value() const noexcept {
+      return bought_ + sold_ > 0.0 ? (bought_ - sold_) / (bought_ + sold_) : 0.0;
+    }
+
+  private:
+    double bought_{};
+    double sold_{};
+  };
+
+  // The kernels of every symbol, composed at compile time. Each symbol gets its own cache line aligned tuple, a
+  // tick updates all of its features in one pass over it.
+  template<FeatureKernel... Kernels>
+  class FeaturePipeline {
+  public:
+    explicit FeaturePipeline(size_t num_symbols) : symbols_(num_symbols) {
+    }
+
+    void onBook(util::SymbolId symbol_id, const BookTick &tick) noexcept {
+      std::apply([&tick](auto &...kernels) {
+        (update(kernels, tick), ...);
+      }, symbols_[symbol_id].kernels);
+    }
+
+    void onTrade(util::SymbolId symbol_id, const TradeTick &trade) noexcept {
+      std::apply([&trade](auto &...kernels) {
+        (update(kernels, trade), ...);
+      }, symbols_[symbol_id].kernels);
+    }
+
+    template<typename Kernel>
+    const Kernel &get(util::SymbolId symbol_id) const noexcept {
+      return std::get<Kernel>(symbols_[symbol_id].kernels);
+    }
+
+    size_t numSymbols() const noexcept {
+      return symbols_.size();
+    }
+
+    static constexpr size_t numKernels() noexcept {
+      return sizeof...(Kernels);
+    }
+
+  private:
+    struct alignas(64) SymbolFeatures {
+      std::tuple<Kernels...> kernels;
+    };
+
+    template<typename Kernel>
+    static void update(Kernel &kernel, const BookTick &tick) noexcept {
+      if constexpr (BookKernel<Kernel>) {
+        kernel.onBook(tick);
+      }
+    }
+
+    template<typename Kernel>
+    static void update(Kernel &kernel, const TradeTick &trade) noexcept {
+      if constexpr (TradeKernel<Kernel>) {
+        kernel.onTrade(trade);
+      }
+    }
+
+    std::vector<SymbolFeatures> symbols_;
+  };
+}
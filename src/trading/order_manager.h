@@ -1,15 +1,83 @@
 #pragma once
 
+#include <algorithm>
+#include <array>
+#include <limits>
+#include <vector>
+
+#include "order_pool.h"
 #include "../client/ws_order_entry_client.h"
+#include "../util/latency_probe.h"
+#include "../util/logger.h"
+#include "../util/metrics.h"
+#include "../util/symbol_table.h"
 
 namespace trading {
+  // How an open order gets to a new price. Gemini has no amend or replace, both modes cancel and send a new
+  // order. CANCEL_THEN_NEW sends the new one once the cancel is confirmed, a level never has two orders but is
+  // empty for a round trip. CANCEL_REPLACE sends both in the same batch: the level is re-quoted a round trip
+  // earlier, the old order stays live next to the new one until the cancel lands.
+  enum class RequoteMode : uint8_t {
+    CANCEL_THEN_NEW,
+    CANCEL_REPLACE
+  };
+
+  constexpr std::array<const char *, 2> RequoteModeNames{"cancel_then_new", "cancel_replace"};
+
+  struct OrderManagerConfig {
+    // Quantity of every ladder level, the first one is quoted at the price the market maker asks for and
+    // each further one level_spacing away from the touch. The ladder has as many levels per side.
+    std::vector<util::Qty> level_quantities{util::Qty::fromFixed(util::FixedPointScale / 10)};
+    util::Price level_spacing{util::Price::fromFixed(util::FixedPointScale)};
+    // Orders of all symbols and levels live in one pool of this many slots.
+    size_t max_orders{4096};
+    RequoteMode requote_mode{RequoteMode::CANCEL_THEN_NEW};
+    // A request without a response for this long is taken as lost, see onTimer(). 0 never times out.
+    int64_t ack_timeout_ns{2'000'000'000};
+    // Registry of the om.* metrics, nullptr for the process wide one.
+    util::MetricsRegistry *metrics{nullptr};
+  };
+
+  struct OrderManagerStats {
+    // Target price changes of quoted levels, pulling or first quoting a level is not a move.
+    uint64_t price_moves{0};
+    // New orders sent for a moved level and the time from the move to the new order, summed and the worst.
+    uint64_t requotes{0};
+    int64_t requote_ns{0};
+    int64_t max_requote_ns{0};
+    uint64_t ack_timeouts{0};
+  };
+
+  // Quotes a ladder of orders per symbol and side. Orders live in a fixed capacity pool and the client
+  // order id is their pool handle, so responses find their order in O(1). A re-quote only touches the levels
+  // whose price changed: an open order is cancelled and its level re-quoted per RequoteMode. A level with a
+  // request in flight waits for its response and is then moved to the latest target price, the moves in
+  // between never reach the wire. All requests of one re-quote go onto the queue in a single batch.
   class OrderManager {
   public:
-    static constexpr double clip = 0.1;
+    using Config = OrderManagerConfig;
+    using Stats = OrderManagerStats;
 
     explicit OrderManager(
       util::SpscQueue<client::WsOrderEntryClient::WsOrderEntryReqMsg> &
-      outgoing_order_entry_req_queue) : outgoing_order_entry_req_queue_(outgoing_order_entry_req_queue) {
+      outgoing_order_entry_req_queue, size_t num_symbols = 1, const Config &config = Config{})
+      : outgoing_order_entry_req_queue_(outgoing_order_entry_req_queue)
+        , level_quantities_(config.level_quantities)
+        , level_spacing_(config.level_spacing)
+        , orders_(config.max_orders)
+        , ladder_(num_symbols * 2 * config.level_quantities.size(), OrderPool<OMOrder>::InvalidSlot)
+        , target_prices_(ladder_.size())
+        , moved_at_ns_(ladder_.size(), NotMoved)
+        , specs_(num_symbols)
+        , requote_mode_(config.requote_mode)
+        , ack_timeout_ns_(config.ack_timeout_ns)
+        , requests_not_sent_(util::metricsRegistry(config.metrics).counter("om.requests_not_sent"))
+        , unknown_updates_(util::metricsRegistry(config.metrics).counter("om.unknown_updates"))
+        , ack_timeouts_(util::metricsRegistry(config.metrics).counter("om.ack_timeouts"))
+        , requote_latency_(util::metricsRegistry(config.metrics).histogram("om.requote_ns")) {
+      // A cancel and a new per level at most.
+      batch_.reserve(4 * level_quantities_.size());
+      in_flight_.reserve(config.max_orders);
     }
 
     struct OMOrder {
@@ -24,103 +92,393 @@ namespace trading {
       [[nodiscard]] std::string toString() const {
         std::ostringstream oss;
         oss << "OMOrder { "
-            << "price: " << price << ", "
-            << "quantity: " << quantity << ", "
-            << "side: " << side << ", "
+            << "symbol_id: " << symbol_id << ", "
+            << "level: " << level << ", "
+            << "price: " << price.toString() << ", "
+            << "quantity: " << quantity.toString() << ", "
+            << "side: " << client::to_string(side) << ", "
             << "order_id: " << order_id << ", "
             << "client_order_id: " << client_order_id << ", "
+            << "sent_ns: " << sent_ns << ", "
             << "state: " << state
             << " }";
         return oss.str();
       }
 
       State state{NONE};
-      double price{};
-      double quantity{};
-      std::string side{};
-      std::string order_id{};
-      std::string client_order_id{};
+      util::SymbolId symbol_id{};
+      uint32_t level{};
+      util::Price price{};
+      util::Qty quantity{};
+      client::Side side{client::Side::NONE};
+      uint64_t order_id{};
+      uint64_t client_order_id{};
+      // When the last request for the order went out, and whether it is in in_flight_.
+      int64_t sent_ns{};
+      bool in_flight{false};
     };
 
-    void moveOrders(double bid_price, double ask_price) {
-      std::cout << "OrderManager::moveOrders(bid_price=" << bid_price << ", ask_price=" << ask_price << ")" <<
-          std::endl;
-      moveOrder(bid_order_, bid_price, "bid", clip);
-      moveOrder(ask_order_, ask_price, "ask", clip);
+    // Tick and lot size the symbol's orders are rounded to. Bids round down and asks up, so a quote never
+    // ends up more aggressive than asked for.
+    void setSymbolSpec(util::SymbolId symbol_id, const util::SymbolSpec &spec) {
+      specs_[symbol_id] = spec;
     }
 
-    void moveOrder(OMOrder &order, double price, const std::string& side, double quantity) {
-      switch (order.state) {
-        case OMOrder::OPEN: {
-          if (order.price != price) {
-            cancelOrder(order);
+    // Moves the ladders of a symbol so their first levels sit at bid_price / ask_price, a zero price pulls
+    // the side.
+    void moveOrders(util::SymbolId symbol_id, util::Price bid_price, util::Price ask_price) {
+      LOG_DEBUG("OrderManager::moveOrders(symbol_id={}, bid_price={}, ask_price={})", symbol_id, bid_price, ask_price);
+      const auto &spec = specs_[symbol_id];
+      for (size_t level = 0; level < levels(); ++level) {
+        const auto offset = level_spacing_ * static_cast<int64_t>(level);
+        moveOrder(ladderIndex(symbol_id, client::Side::BID, level),
+                  bid_price.isZero() ? util::Price{} : spec.roundToTick(bid_price - offset));
+        moveOrder(ladderIndex(symbol_id, client::Side::ASK, level),
+                  ask_price.isZero() ? util::Price{} : spec.roundUpToTick(ask_price + offset));
+      }
+      flush();
+    }
+
+    void onOrderUpdate(const client::WsOrderEntryClient::WsOrderEntryResMsg &msg) {
+      const auto slot = orders_.find(msg.client_order_id);
+      if (slot == OrderPool<OMOrder>::InvalidSlot) [[unlikely]] {
+        // Usually the second report of something already final, the order events and the order entry
+        // responses both report acks, cancels and rejects.
+        unknown_updates_.add();
+        LOG_DEBUG("onOrderUpdate: unknown client_order_id={}", msg.client_order_id);
+        return;
+      }
+      auto &order = orders_[slot];
+      const auto index = ladderIndex(order.symbol_id, order.side, order.level);
+      switch (msg.status) {
+        case client::WsOrderEntryClient::WsOrderEntryResMsg::OrdStatus::NEW: {
+          if (order.order_id == 0) {
+            order.order_id = msg.order_id;
+          }
+          // Only the first ack opens the order, the second one may come after a cancel was already sent.
+          if (order.state == OMOrder::PENDING_OPEN) {
+            order.state = OMOrder::OPEN;
+            if (ladder_[index] != slot) [[unlikely]] {
+              // Given up on after its ack timed out, the level has moved on without it.
+              cancelOrder(order);
+            } else {
+              // The ladder may have moved while the order was in flight.
+              moveOrder(index, target_prices_[index]);
+            }
           }
         }
         break;
-        case OMOrder::NONE:
-        case OMOrder::CLOSED: {
-          if (price != 0.0) [[likely]] {
-            // TODO: Check pre-trade risk.
-            newOrder(order, price, side, quantity);
+        case client::WsOrderEntryClient::WsOrderEntryResMsg::OrdStatus::CANCELED: {
+          releaseOrder(index, slot);
+          moveOrder(index, target_prices_[index]);
+        }
+        break;
+        case client::WsOrderEntryClient::WsOrderEntryResMsg::OrdStatus::PARTIALLY_FILLED:
+        case client::WsOrderEntryClient::WsOrderEntryResMsg::OrdStatus::FILLED: {
+          order.quantity = msg.leaves_qty;
+          if (order.quantity.isZero()) {
+            releaseOrder(index, slot);
+            moveOrder(index, target_prices_[index]);
+          }
+        }
+        break;
+        case client::WsOrderEntryClient::WsOrderEntryResMsg::OrdStatus::REJECTED: {
+          // A rejected new frees the level for the next re-quote, a rejected cancel leaves the order open. An
+          // open order is past both, that is the second report of a rejected cancel. An order replaced on its
+          // level stays open too and onTimer() cancels it again, unless a fill or cancel closes it first.
+          if (order.state == OMOrder::PENDING_CLOSE) {
+            order.state = OMOrder::OPEN;
+          } else if (order.state == OMOrder::PENDING_OPEN) {
+            releaseOrder(index, slot);
+          }
+        }
+        break;
+        case client::WsOrderEntryClient::WsOrderEntryResMsg::OrdStatus::NONE: {
+        }
+        break;
+      };
+      flush();
+    }
+
+    size_t levels() const noexcept {
+      return level_quantities_.size();
+    }
+
+    // Order quoted at a level, nullptr if the level is empty.
+    const OMOrder *order(util::SymbolId symbol_id, client::Side side, size_t level) const noexcept {
+      const auto slot = ladder_[ladderIndex(symbol_id, side, level)];
+      return slot != OrderPool<OMOrder>::InvalidSlot ? &orders_[slot] : nullptr;
+    }
+
+    const OMOrder *bidOrder(util::SymbolId symbol_id) const noexcept {
+      return order(symbol_id, client::Side::BID, 0);
+    }
+
+    const OMOrder *askOrder(util::SymbolId symbol_id) const noexcept {
+      return order(symbol_id, client::Side::ASK, 0);
+    }
+
+    // Current time, stamped on requests and the moves of target prices. Every so often checks the requests in
+    // flight for lost responses:
+    // - a cancel is sent again,
+    // - a new frees its level to be re-quoted and is cancelled if its ack still comes, after a second timeout
+    //   it is forgotten,
+    // - an order replaced on its level but still open is cancelled again.
+    void onTimer(int64_t now_ns) {
+      now_ns_ = now_ns;
+      if (ack_timeout_ns_ == 0 || in_flight_.empty() || now_ns < next_timeout_check_ns_) [[likely]] {
+        return;
+      }
+      sweepInFlight(true);
+      flush();
+    }
+
+    const Stats &stats() const noexcept {
+      return stats_;
+    }
+
+  private:
+    static constexpr int64_t NotMoved = std::numeric_limits<int64_t>::min();
+
+    // Ladders are laid out symbol by symbol, bids then asks, level by level.
+    size_t ladderIndex(util::SymbolId symbol_id, client::Side side, size_t level) const noexcept {
+      return (static_cast<size_t>(symbol_id) * 2 + (side == client::Side::ASK ? 1 : 0)) * levels() + level;
+    }
+
+    void moveOrder(size_t index, util::Price price) {
+      if (target_prices_[index] != price) {
+        if (price.isZero()) {
+          moved_at_ns_[index] = NotMoved;
+        } else if (!target_prices_[index].isZero()) {
+          ++stats_.price_moves;
+          // A level moving again before its re-quote went out is timed from the first move.
+          if (moved_at_ns_[index] == NotMoved) {
+            moved_at_ns_[index] = now_ns_;
+          }
+        }
+        target_prices_[index] = price;
+      }
+      const auto slot = ladder_[index];
+      if (slot == OrderPool<OMOrder>::InvalidSlot) {
+        if (!price.isZero()) [[likely]] {
+          // TODO: Check pre-trade risk.
+          newOrder(index, price);
+        }
+        return;
+      }
+      auto &order = orders_[slot];
+      switch (order.state) {
+        case OMOrder::OPEN: {
+          if (order.price == price) {
+            // Moved and back before the order could be touched.
+            moved_at_ns_[index] = NotMoved;
+          } else {
+            cancelOrder(order);
+            if (requote_mode_ == RequoteMode::CANCEL_REPLACE && !price.isZero()) {
+              // The cancelled order leaves the ladder, its responses only release it.
+              ladder_[index] = OrderPool<OMOrder>::InvalidSlot;
+              newOrder(index, price);
+            }
           }
         }
         break;
         case OMOrder::PENDING_OPEN:
         case OMOrder::PENDING_CLOSE: {
-          std::cout << order.toString() << " already pending new/cancel..." << std::endl;
+          LOG_DEBUG("{} order client_order_id={} already pending new/cancel...", client::to_string(order.side),
+                    order.client_order_id);
         }
         break;
+        case OMOrder::NONE:
+        case OMOrder::CLOSED:
+          break;
       }
     }
 
-    void newOrder(OMOrder &order, double price, const std::string& side, double quantity) {
+    void newOrder(size_t index, util::Price price) {
+      const auto slot = orders_.acquire();
+      if (slot == OrderPool<OMOrder>::InvalidSlot) [[unlikely]] {
+        LOG_ERROR("newOrder: order pool of {} orders exhausted", orders_.capacity());
+        return;
+      }
+      const auto level = index % levels();
+      auto &order = orders_[slot];
+      order.state = OMOrder::PENDING_OPEN;
+      order.symbol_id = static_cast<util::SymbolId>(index / (2 * levels()));
+      order.level = static_cast<uint32_t>(level);
+      order.side = (index / levels()) % 2 == 0 ? client::Side::BID : client::Side::ASK;
+      order.price = price;
+      order.quantity = specs_[order.symbol_id].roundToLot(level_quantities_[level]);
+      order.client_order_id = orders_.clientOrderId(slot);
+      ladder_[index] = slot;
+
       client::WsOrderEntryClient::WsOrderEntryReqMsg msg;
       msg.type = client::WsOrderEntryClient::WsOrderEntryReqMsg::RequestType::NEW_ORDER;
-      msg.price = price;
-      msg.quantity = quantity;
-      msg.side = side;
+      msg.price = order.price;
+      msg.quantity = order.quantity;
+      msg.side = order.side;
+      msg.symbol_id = order.symbol_id;
       msg.client_order_id = order.client_order_id;
-      outgoing_order_entry_req_queue_.push(msg);
-      order.state = OMOrder::PENDING_OPEN;
-      order.price = price;
-      order.side = side;
-      order.quantity = quantity;
-      std::cout << "newOrder: " << order.toString() << std::endl;
+      batch_.push_back(msg);
+      LOG_INFO("newOrder: symbol_id={} side={} level={} price={} quantity={} client_order_id={}", order.symbol_id,
+               client::to_string(order.side), order.level, order.price, order.quantity, order.client_order_id);
     }
 
     void cancelOrder(OMOrder &order) {
-      std::cout << "cancelOrder: " << order.toString() << std::endl;
+      order.state = OMOrder::PENDING_CLOSE;
+      client::WsOrderEntryClient::WsOrderEntryReqMsg msg;
+      msg.type = client::WsOrderEntryClient::WsOrderEntryReqMsg::RequestType::CANCEL_ORDER;
+      msg.side = order.side;
+      msg.symbol_id = order.symbol_id;
+      msg.order_id = order.order_id;
+      msg.client_order_id = order.client_order_id;
+      batch_.push_back(msg);
+      LOG_INFO("cancelOrder: symbol_id={} side={} level={} price={} order_id={} client_order_id={}", order.symbol_id,
+               client::to_string(order.side), order.level, order.price, order.order_id, order.client_order_id);
     }
 
-    void onOrderUpdate(const client::WsOrderEntryClient::WsOrderEntryResMsg& msg) {
-      auto order = msg.side == "bid" ? bid_order_ : ask_order_;
-      switch (msg.status) {
-        case client::WsOrderEntryClient::WsOrderEntryResMsg::OrdStatus::NEW: {
-          order.state = OMOrder::OPEN;
+    void releaseOrder(size_t index, uint32_t slot) noexcept {
+      if (ladder_[index] == slot) {
+        ladder_[index] = OrderPool<OMOrder>::InvalidSlot;
+      }
+      orders_.release(slot);
+    }
+
+    // Sends the requests of this re-quote in one go. Whatever does not fit the queue is rolled back so the
+    // next re-quote tries again.
+    void flush() {
+      if (batch_.empty()) {
+        return;
+      }
+      CMM_PROBE(ORDER_QUEUE_PUSH);
+      for (auto &msg: batch_) {
+        msg.tsc = CMM_PROBE_STAMP();
+      }
+      const auto pushed = outgoing_order_entry_req_queue_.push_n(batch_.data(), batch_.size());
+      for (size_t i = 0; i < pushed; ++i) {
+        onSent(batch_[i]);
+      }
+      if (pushed != batch_.size()) [[unlikely]] {
+        requests_not_sent_.add(static_cast<int64_t>(batch_.size() - pushed));
+        LOG_ERROR("OrderManager: order entry queue full, {} of {} requests not sent", batch_.size() - pushed,
+                  batch_.size());
+        // Backwards, so the new order replacing a cancelled one is gone before the cancel is undone.
+        for (size_t i = batch_.size(); i > pushed; --i) {
+          const auto slot = orders_.find(batch_[i - 1].client_order_id);
+          if (slot == OrderPool<OMOrder>::InvalidSlot) {
+            continue;
+          }
+          auto &order = orders_[slot];
+          const auto index = ladderIndex(order.symbol_id, order.side, order.level);
+          if (order.state == OMOrder::PENDING_CLOSE) {
+            order.state = OMOrder::OPEN;
+            if (ladder_[index] == OrderPool<OMOrder>::InvalidSlot) {
+              ladder_[index] = slot;
+            }
+          } else {
+            releaseOrder(index, slot);
+          }
         }
-        break;
-        case client::WsOrderEntryClient::WsOrderEntryResMsg::OrdStatus::CANCELED: {
-          order.state = OMOrder::CLOSED;
+      }
+      batch_.clear();
+    }
+
+    // Stamps a request that made it onto the queue, starts tracking its order and times the re-quote of a
+    // moved level.
+    void onSent(const client::WsOrderEntryClient::WsOrderEntryReqMsg &msg) {
+      const auto slot = orders_.find(msg.client_order_id);
+      if (slot == OrderPool<OMOrder>::InvalidSlot) [[unlikely]] {
+        return;
+      }
+      auto &order = orders_[slot];
+      order.sent_ns = now_ns_;
+      if (msg.type == client::WsOrderEntryClient::WsOrderEntryReqMsg::RequestType::NEW_ORDER) {
+        auto &moved_at_ns = moved_at_ns_[ladderIndex(order.symbol_id, order.side, order.level)];
+        if (moved_at_ns != NotMoved) {
+          const auto latency = now_ns_ - moved_at_ns;
+          moved_at_ns = NotMoved;
+          ++stats_.requotes;
+          stats_.requote_ns += latency;
+          stats_.max_requote_ns = std::max(stats_.max_requote_ns, latency);
+          requote_latency_.record(static_cast<uint64_t>(std::max<int64_t>(latency, 0)));
         }
-        break;
-        case client::WsOrderEntryClient::WsOrderEntryResMsg::OrdStatus::PARTIALLY_FILLED:
-        case client::WsOrderEntryClient::WsOrderEntryResMsg::OrdStatus::FILLED: {
-          order.quantity = msg.leaves_qty;
-          if(order.quantity == 0.0)
-            order.state = OMOrder::CLOSED;
+      }
+      if (order.in_flight) {
+        return;
+      }
+      if (in_flight_.size() == in_flight_.capacity()) [[unlikely]] {
+        // Entries of orders that got their response are only dropped here and by onTimer().
+        sweepInFlight(false);
+      }
+      order.in_flight = true;
+      in_flight_.push_back(msg.client_order_id);
+      next_timeout_check_ns_ = std::min(next_timeout_check_ns_, order.sent_ns + ack_timeout_ns_);
+    }
+
+    // Drops the orders of in_flight_ that no longer wait for anything, with `expire` handles the ones that
+    // waited longer than the ack timeout.
+    void sweepInFlight(bool expire) {
+      size_t kept = 0;
+      int64_t next_timeout_ns = std::numeric_limits<int64_t>::max();
+      for (const auto client_order_id: in_flight_) {
+        const auto slot = orders_.find(client_order_id);
+        if (slot == OrderPool<OMOrder>::InvalidSlot) {
+          continue;
         }
-        break;
-        case client::WsOrderEntryClient::WsOrderEntryResMsg::OrdStatus::REJECTED:
-        case client::WsOrderEntryClient::WsOrderEntryResMsg::OrdStatus::NONE: {
+        auto &order = orders_[slot];
+        const auto index = ladderIndex(order.symbol_id, order.side, order.level);
+        const bool replaced = ladder_[index] != slot;
+        if (order.state != OMOrder::PENDING_OPEN && order.state != OMOrder::PENDING_CLOSE && !replaced) {
+          order.in_flight = false;
+          continue;
         }
-        break;
-      };
+        if (expire && now_ns_ - order.sent_ns >= ack_timeout_ns_) {
+          ack_timeouts_.add();
+          ++stats_.ack_timeouts;
+          LOG_WARN("OrderManager: no response to {}", order.toString());
+          if (order.state != OMOrder::PENDING_OPEN) {
+            cancelOrder(order);
+          } else if (replaced) {
+            orders_.release(slot);
+            continue;
+          } else {
+            ladder_[index] = OrderPool<OMOrder>::InvalidSlot;
+            moveOrder(index, target_prices_[index]);
+          }
+          order.sent_ns = now_ns_;
+        }
+        next_timeout_ns = std::min(next_timeout_ns, order.sent_ns + ack_timeout_ns_);
+        in_flight_[kept++] = client_order_id;
+      }
+      in_flight_.resize(kept);
+      if (expire) {
+        next_timeout_check_ns_ = next_timeout_ns;
+      }
     }
 
-  private:
     util::SpscQueue<client::WsOrderEntryClient::WsOrderEntryReqMsg> &outgoing_order_entry_req_queue_;
 
-    OMOrder ask_order_{};
-    OMOrder bid_order_{};
+    const std::vector<util::Qty> level_quantities_;
+    const util::Price level_spacing_;
+    OrderPool<OMOrder> orders_;
+    // Pool slot of the order quoted at each ladder level, see ladderIndex().
+    std::vector<uint32_t> ladder_;
+    // Price each ladder level should be quoted at, zero for none.
+    std::vector<util::Price> target_prices_;
+    // When each level's target price moved away from the quoted one, NotMoved once re-quoted.
+    std::vector<int64_t> moved_at_ns_;
+    std::vector<util::SymbolSpec> specs_;
+    std::vector<client::WsOrderEntryClient::WsOrderEntryReqMsg> batch_;
+    // Client order ids of orders waiting for a response, and replaced ones not yet closed.
+    std::vector<uint64_t> in_flight_;
+    const RequoteMode requote_mode_;
+    const int64_t ack_timeout_ns_;
+    int64_t now_ns_{0};
+    // Earliest a request in flight can time out.
+    int64_t next_timeout_check_ns_{std::numeric_limits<int64_t>::max()};
+    Stats stats_;
+    util::Counter requests_not_sent_;
+    util::Counter unknown_updates_;
+    util::Counter ack_timeouts_;
+    util::Histogram requote_latency_;
   };
 }
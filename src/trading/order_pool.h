@@ -0,0 +1,89 @@
+#pragma once
+
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
+#include <vector>
+
+namespace trading {
+  // Fixed capacity pool of orders addressed by client order id. An id is the slot index in the low 32 bits
+  // and the slot's generation in the high 32 bits, so lookup is one index plus a compare and a stale id of
+  // a recycled slot never matches the order now living there. Nothing allocates after construction.
+  template<typename Order>
+  class OrderPool {
+  public:
+    static constexpr uint32_t InvalidSlot = std::numeric_limits<uint32_t>::max();
+
+    explicit OrderPool(size_t capacity) : slots_(capacity) {
+      if (capacity == 0 || capacity >= InvalidSlot) {
+        throw std::invalid_argument("OrderPool: invalid capacity");
+      }
+      free_.reserve(capacity);
+      for (size_t i = capacity; i > 0; --i) {
+        free_.push_back(static_cast<uint32_t>(i - 1));
+      }
+    }
+
+    // Takes a free slot, InvalidSlot if the pool is exhausted. The order is value initialised.
+    uint32_t acquire() noexcept {
+      if (free_.empty()) [[unlikely]] {
+        return InvalidSlot;
+      }
+      const auto slot = free_.back();
+      free_.pop_back();
+      auto &entry = slots_[slot];
+      entry.order = Order{};
+      entry.in_use = true;
+      return slot;
+    }
+
+    void release(uint32_t slot) noexcept {
+      auto &entry = slots_[slot];
+      if (entry.in_use) {
+        entry.in_use = false;
+        ++entry.generation;
+        free_.push_back(slot);
+      }
+    }
+
+    uint64_t clientOrderId(uint32_t slot) const noexcept {
+      // Generation starts at 1 so no live order has client order id 0.
+      return (static_cast<uint64_t>(slots_[slot].generation + 1) << 32) | slot;
+    }
+
+    // Slot of a live order, InvalidSlot for unknown or stale ids.
+    uint32_t find(uint64_t client_order_id) const noexcept {
+      const auto slot = static_cast<uint32_t>(client_order_id);
+      if (slot >= slots_.size() || !slots_[slot].in_use || clientOrderId(slot) != client_order_id) {
+        return InvalidSlot;
+      }
+      return slot;
+    }
+
+    Order &operator[](uint32_t slot) noexcept {
+      return slots_[slot].order;
+    }
+
+    const Order &operator[](uint32_t slot) const noexcept {
+      return slots_[slot].order;
+    }
+
+    size_t capacity() const noexcept {
+      return slots_.size();
+    }
+
+    size_t available() const noexcept {
+      return free_.size();
+    }
+
+  private:
+    struct Entry {
+      Order order{};
+      uint32_t generation{0};
+      bool in_use{false};
+    };
+
+    std::vector<Entry> slots_;
+    std::vector<uint32_t> free_;
+  };
+}
@@ -0,0 +1,284 @@
+#pragma once
+
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+#include "features.h"
+#include "../util/simd.h"
+
+namespace trading::features {
+  // Top of book updates of many symbols as columns, for evaluating what BookTick derives for all of them in one
+  // pass. Fill with push(), evaluateTopOfBook() fills the output columns, tick() hands row by row to the
+  // stateful kernels.
+  struct TopOfBookBatch {
+    explicit TopOfBookBatch(size_t capacity)
+      : symbol_ids(capacity)
+        , best_bids(capacity)
+        , best_bid_quantities(capacity)
+        , best_asks(capacity)
+        , best_ask_quantities(capacity)
+        , bid_depths(capacity)
+        , ask_depths(capacity)
+        , two_sided(capacity)
+        , bid_quantities(capacity)
+        , ask_quantities(capacity)
+        , mids(capacity)
+        , spreads(capacity)
+        , microprices(capacity)
+        , weighted_mids(capacity) {
+    }
+
+    // The depth spans are not copied, they have to outlive the batch's use. Returns false once full.
+    bool push(util::SymbolId symbol_id, util::Price best_bid, util::Qty best_bid_quantity, util::Price best_ask,
+              util::Qty best_ask_quantity, std::span<const util::Qty> bid_depth = {},
+              std::span<const util::Qty> ask_depth = {}) noexcept {
+      if (size == capacity()) [[unlikely]] {
+        return false;
+      }
+      symbol_ids[size] = symbol_id;
+      best_bids[size] = best_bid.fixed();
+      best_bid_quantities[size] = best_bid_quantity.fixed();
+      best_asks[size] = best_ask.fixed();
+      best_ask_quantities[size] = best_ask_quantity.fixed();
+      bid_depths[size] = bid_depth;
+      ask_depths[size] = ask_depth;
+      ++size;
+      return true;
+    }
+
+    void clear() noexcept {
+      size = 0;
+    }
+
+    size_t capacity() const noexcept {
+      return symbol_ids.size();
+    }
+
+    // What BookTick::make() returns for the row, once evaluated.
+    BookTick tick(size_t row) const noexcept {
+      BookTick tick;
+      tick.two_sided = two_sided[row] != 0;
+      tick.bid_quantity = bid_quantities[row];
+      tick.ask_quantity = ask_quantities[row];
+      tick.mid = mids[row];
+      tick.spread = spreads[row];
+      tick.microprice = microprices[row];
+      tick.weighted_mid = util::Price::fromFixed(weighted_mids[row]);
+      tick.best_bid = util::Price::fromFixed(best_bids[row]);
+      tick.best_bid_quantity = util::Qty::fromFixed(best_bid_quantities[row]);
+      tick.best_ask = util::Price::fromFixed(best_asks[row]);
+      tick.best_ask_quantity = util::Qty::fromFixed(best_ask_quantities[row]);
+      tick.bid_depth = bid_depths[row];
+      tick.ask_depth = ask_depths[row];
+      return tick;
+    }
+
+    size_t size{0};
+    // Inputs, fixed-point.
+    std::vector<util::SymbolId> symbol_ids;
+    std::vector<int64_t> best_bids;
+    std::vector<int64_t> best_bid_quantities;
+    std::vector<int64_t> best_asks;
+    std::vector<int64_t> best_ask_quantities;
+    std::vector<std::span<const util::Qty> > bid_depths;
+    std::vector<std::span<const util::Qty> > ask_depths;
+    // Outputs, the fields of TopOfBookValues.
+    std::vector<uint8_t> two_sided;
+    std::vector<double> bid_quantities;
+    std::vector<double> ask_quantities;
+    std::vector<double> mids;
+    std::vector<double> spreads;
+    std::vector<double> microprices;
+    std::vector<int64_t> weighted_mids;
+  };
+
+  namespace detail {
+    inline void evaluateTopOfBookRow(TopOfBookBatch &batch, size_t row) noexcept {
+      const auto values = TopOfBookValues::derive(batch.best_bids[row], batch.best_bid_quantities[row],
+                                                  batch.best_asks[row], batch.best_ask_quantities[row]);
+      batch.two_sided[row] = values.two_sided;
+      batch.bid_quantities[row] = values.bid_quantity;
+      batch.ask_quantities[row] = values.ask_quantity;
+      batch.mids[row] = values.mid;
+      batch.spreads[row] = values.spread;
+      batch.microprices[row] = values.microprice;
+      batch.weighted_mids[row] = values.weighted_mid.fixed();
+    }
+
+    inline void evaluateTopOfBookScalar(TopOfBookBatch &batch, size_t begin) noexcept {
+      for (size_t row = begin; row < batch.size; ++row) {
+        evaluateTopOfBookRow(batch, row);
+      }
+    }
+
+#if defined(__x86_64__) || defined(__i386__)
+    __attribute__((target("avx2"))) inline __m256d unfused(__m256d value) noexcept {
+      asm("" : "+v"(value));
+      return value;
+    }
+
+    __attribute__((target("avx2"))) inline __m256i loadRows(const std::vector<int64_t> &column, size_t row) noexcept {
+      return _mm256_loadu_si256(reinterpret_cast<const __m256i *>(column.data() + row));
+    }
+
+    // Exact for values in [0, 2^52).
+    __attribute__((target("avx2"))) inline __m256d toDouble(__m256i value) noexcept {
+      const auto magic = _mm256_set1_pd(0x1p52);
+      return _mm256_sub_pd(_mm256_castsi256_pd(_mm256_or_si256(value, _mm256_castpd_si256(magic))), magic);
+    }
+
+    // Truncates like static_cast, exact for results in [0, 2^52).
+    __attribute__((target("avx2"))) inline __m256i toFixed(__m256d value) noexcept {
+      const auto magic = _mm256_set1_pd(0x1p52);
+      return _mm256_sub_epi64(_mm256_castpd_si256(_mm256_add_pd(
+        _mm256_round_pd(value, _MM_FROUND_TO_ZERO | _MM_FROUND_NO_EXC), magic)), _mm256_castpd_si256(magic));
+    }
+
+    // 4 rows at a time. AVX2 has no int64 to double conversion: values in [0, 2^52) are converted exactly by
+    // placing them in the mantissa of 2^52, a block with anything outside goes through the scalar path. Lanes
+    // without a two sided book are computed anyway, on garbage, and zeroed by their mask.
+    __attribute__((target("avx2"))) inline void evaluateTopOfBookAvx2(TopOfBookBatch &batch) noexcept {
+      const auto out_of_range = _mm256_set1_epi64x(~((int64_t{1} << 52) - 1));
+      const auto zero = _mm256_setzero_si256();
+      const auto scale = _mm256_set1_pd(static_cast<double>(util::FixedPointScale));
+      const auto half = _mm256_set1_pd(0.5);
+
+      size_t row = 0;
+      for (; row + 4 <= batch.size; row += 4) {
+        const auto bid_fixed = loadRows(batch.best_bids, row);
+        const auto bid_quantity_fixed = loadRows(batch.best_bid_quantities, row);
+        const auto ask_fixed = loadRows(batch.best_asks, row);
+        const auto ask_quantity_fixed = loadRows(batch.best_ask_quantities, row);
+        const auto any = _mm256_or_si256(_mm256_or_si256(bid_fixed, bid_quantity_fixed),
+                                         _mm256_or_si256(ask_fixed, ask_quantity_fixed));
+        if (!_mm256_testz_si256(any, out_of_range)) [[unlikely]] {
+          for (size_t i = row; i < row + 4; ++i) {
+            evaluateTopOfBookRow(batch, i);
+          }
+          continue;
+        }
+        // All ones in the lanes with a zero anywhere.
+        const auto one_sided = _mm256_castsi256_pd(_mm256_or_si256(
+          _mm256_or_si256(_mm256_cmpeq_epi64(bid_fixed, zero), _mm256_cmpeq_epi64(bid_quantity_fixed, zero)),
+          _mm256_or_si256(_mm256_cmpeq_epi64(ask_fixed, zero), _mm256_cmpeq_epi64(ask_quantity_fixed, zero))));
+
+        const auto bid_fixed_d = toDouble(bid_fixed);
+        const auto bid_quantity_fixed_d = toDouble(bid_quantity_fixed);
+        const auto ask_fixed_d = toDouble(ask_fixed);
+        const auto ask_quantity_fixed_d = toDouble(ask_quantity_fixed);
+        const auto bid = _mm256_div_pd(bid_fixed_d, scale);
+        const auto ask = _mm256_div_pd(ask_fixed_d, scale);
+        const auto bid_quantity = _mm256_div_pd(bid_quantity_fixed_d, scale);
+        const auto ask_quantity = _mm256_div_pd(ask_quantity_fixed_d, scale);
+        const auto mid = _mm256_mul_pd(_mm256_add_pd(bid, ask), half);
+        const auto spread = _mm256_sub_pd(ask, bid);
+        const auto microprice = _mm256_div_pd(
+          _mm256_add_pd(unfused(_mm256_mul_pd(bid, ask_quantity)), unfused(_mm256_mul_pd(ask, bid_quantity))),
+          _mm256_add_pd(bid_quantity, ask_quantity));
+        const auto weighted_mid = _mm256_add_pd(_mm256_div_pd(
+          _mm256_add_pd(unfused(_mm256_mul_pd(bid_fixed_d, bid_quantity_fixed_d)),
+                        unfused(_mm256_mul_pd(ask_fixed_d, ask_quantity_fixed_d))),
+          _mm256_add_pd(bid_quantity_fixed_d, ask_quantity_fixed_d)), half);
+        // Between the bid and the ask, below 2^52 as well.
+        const auto weighted_mid_fixed = toFixed(weighted_mid);
+
+        _mm256_storeu_pd(batch.bid_quantities.data() + row, _mm256_andnot_pd(one_sided, bid_quantity));
+        _mm256_storeu_pd(batch.ask_quantities.data() + row, _mm256_andnot_pd(one_sided, ask_quantity));
+        _mm256_storeu_pd(batch.mids.data() + row, _mm256_andnot_pd(one_sided, mid));
+        _mm256_storeu_pd(batch.spreads.data() + row, _mm256_andnot_pd(one_sided, spread));
+        _mm256_storeu_pd(batch.microprices.data() + row, _mm256_andnot_pd(one_sided, microprice));
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(batch.weighted_mids.data() + row),
+                            _mm256_andnot_si256(_mm256_castpd_si256(one_sided), weighted_mid_fixed));
+        const auto one_sided_bits = _mm256_movemask_pd(one_sided);
+        for (size_t i = 0; i < 4; ++i) {
+          batch.two_sided[row + i] = ((one_sided_bits >> i) & 1) == 0;
+        }
+      }
+      evaluateTopOfBookScalar(batch, row);
+    }
+
+    __attribute__((target("avx512f"))) inline __m512d unfused(__m512d value) noexcept {
+      asm("" : "+v"(value));
+      return value;
+    }
+
+    __attribute__((target("avx512f"))) inline __m512i loadRows(__mmask8 rows, const std::vector<int64_t> &column,
+                                                               size_t row) noexcept {
+      return _mm512_maskz_loadu_epi64(rows, column.data() + row);
+    }
+
+    // 8 rows at a time, the last block with masked loads and stores instead of a scalar tail. Every output is
+    // computed under the two sided mask, zero in the other lanes.
+    __attribute__((target("avx512f,avx512dq"))) inline void evaluateTopOfBookAvx512(TopOfBookBatch &batch) noexcept {
+      const auto scale = _mm512_set1_pd(static_cast<double>(util::FixedPointScale));
+      const auto half = _mm512_set1_pd(0.5);
+      const auto one = _mm512_set1_epi64(1);
+
+      for (size_t row = 0; row < batch.size; row += 8) {
+        const auto rows = batch.size - row < 8 ? static_cast<__mmask8>((1u << (batch.size - row)) - 1) : __mmask8{0xff};
+        const auto bid_fixed = loadRows(rows, batch.best_bids, row);
+        const auto bid_quantity_fixed = loadRows(rows, batch.best_bid_quantities, row);
+        const auto ask_fixed = loadRows(rows, batch.best_asks, row);
+        const auto ask_quantity_fixed = loadRows(rows, batch.best_ask_quantities, row);
+        // Rows past the end load as zero and drop out here.
+        const auto two_sided = static_cast<__mmask8>(_mm512_test_epi64_mask(bid_fixed, bid_fixed) &
+                                                     _mm512_test_epi64_mask(bid_quantity_fixed, bid_quantity_fixed) &
+                                                     _mm512_test_epi64_mask(ask_fixed, ask_fixed) &
+                                                     _mm512_test_epi64_mask(ask_quantity_fixed, ask_quantity_fixed));
+
+        const auto bid_fixed_d = _mm512_cvtepi64_pd(bid_fixed);
+        const auto bid_quantity_fixed_d = _mm512_cvtepi64_pd(bid_quantity_fixed);
+        const auto ask_fixed_d = _mm512_cvtepi64_pd(ask_fixed);
+        const auto ask_quantity_fixed_d = _mm512_cvtepi64_pd(ask_quantity_fixed);
+        const auto bid = _mm512_maskz_div_pd(two_sided, bid_fixed_d, scale);
+        const auto ask = _mm512_maskz_div_pd(two_sided, ask_fixed_d, scale);
+        const auto bid_quantity = _mm512_maskz_div_pd(two_sided, bid_quantity_fixed_d, scale);
+        const auto ask_quantity = _mm512_maskz_div_pd(two_sided, ask_quantity_fixed_d, scale);
+        const auto mid = _mm512_maskz_mul_pd(two_sided, _mm512_add_pd(bid, ask), half);
+        const auto spread = _mm512_maskz_sub_pd(two_sided, ask, bid);
+        const auto microprice = _mm512_maskz_div_pd(
+          two_sided,
+          _mm512_add_pd(unfused(_mm512_mul_pd(bid, ask_quantity)), unfused(_mm512_mul_pd(ask, bid_quantity))),
+          _mm512_add_pd(bid_quantity, ask_quantity));
+        const auto weighted_mid = _mm512_maskz_cvttpd_epi64(two_sided, _mm512_add_pd(_mm512_maskz_div_pd(
+          two_sided,
+          _mm512_add_pd(unfused(_mm512_mul_pd(bid_fixed_d, bid_quantity_fixed_d)),
+                        unfused(_mm512_mul_pd(ask_fixed_d, ask_quantity_fixed_d))),
+          _mm512_add_pd(bid_quantity_fixed_d, ask_quantity_fixed_d)), half));
+
+        _mm512_mask_storeu_pd(batch.bid_quantities.data() + row, rows, bid_quantity);
+        _mm512_mask_storeu_pd(batch.ask_quantities.data() + row, rows, ask_quantity);
+        _mm512_mask_storeu_pd(batch.mids.data() + row, rows, mid);
+        _mm512_mask_storeu_pd(batch.spreads.data() + row, rows, spread);
+        _mm512_mask_storeu_pd(batch.microprices.data() + row, rows, microprice);
+        _mm512_mask_storeu_epi64(batch.weighted_mids.data() + row, rows, weighted_mid);
+        _mm512_mask_cvtepi64_storeu_epi8(batch.two_sided.data() + row, rows,
+                                         _mm512_maskz_mov_epi64(two_sided, one));
+      }
+    }
+#endif
+  }
+
+  // Fills the output columns of the first batch.size rows, exactly as TopOfBookValues::derive() would row by
+  // row. `level` defaults to the widest the machine has, a narrower one is for tests and benchmarks.
+  inline void evaluateTopOfBook(TopOfBookBatch &batch, util::SimdLevel level = util::simdLevel()) noexcept {
+#if defined(__x86_64__) || defined(__i386__)
+    switch (level) {
+      case util::SimdLevel::AVX512:
+        detail::evaluateTopOfBookAvx512(batch);
+        return;
+      case util::SimdLevel::AVX2:
+        detail::evaluateTopOfBookAvx2(batch);
+        return;
+      default:
+        break;
+    }
+#endif
+    detail::evaluateTopOfBookScalar(batch, 0);
+  }
+}
@@ -1,26 +1,80 @@
 #pragma once
 
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <vector>
+
 #include "feature_engine.h"
 #include "market_maker.h"
 #include "order_manager.h"
 #include "../client/ws_execution_client.h"
 #include "../client/ws_order_book_client.h"
-#include "../client/ws_order_client.h"
 #include "../client/ws_order_entry_client.h"
 #include "../client/ws_trades_client.h"
+#include "../util/latency_probe.h"
+#include "../util/latest_value.h"
+#include "../util/logger.h"
+#include "../util/metrics.h"
 #include "../util/spsc_queue.h"
+#include "../util/thread_utils.h"
+#include "../util/wait_strategy.h"
 
 namespace trading {
+  struct TradingEngineConfig {
+    util::WaitStrategyType wait_strategy{util::WaitStrategyType::SPIN_YIELD};
+    // Upper bound of order responses, and of trades, drained per pass so a burst of them cannot hold up top of
+    // book updates.
+    size_t max_batch{64};
+    // CPU to pin the processing thread to, negative means no pinning.
+    int cpu_id{-1};
+    // Record engine.wire_to_decision_ns, from the receive time of a book update to the market maker being done
+    // with it. Only meaningful live, replayed updates carry their capture time.
+    bool measure_wire_to_decision{false};
+    // Registry of the engine.* metrics, nullptr for the process wide one.
+    util::MetricsRegistry *metrics{nullptr};
+  };
+
   class TradingEngine {
   public:
+    using Config = TradingEngineConfig;
+
     TradingEngine(FeatureEngine &feature_engine, OrderManager &order_manager, MarketMaker &market_maker,
-                  util::SpscQueue<client::WsOrderBookClient::WsBestBidBestAskMsg> &incoming_order_book_updates_queue,
-                  util::SpscQueue<client::WsOrderEntryClient::WsOrderEntryResMsg> &incoming_order_entry_res_queue)
-      : feature_engine_(feature_engine)
+                  util::LatestValueSlots<client::WsOrderBookClient::WsBestBidBestAskMsg> &incoming_order_book_updates,
+                  util::SpscQueue<client::WsOrderEntryClient::WsOrderEntryResMsg> &incoming_order_entry_res_queue,
+                  const Config &config = Config{})
+      : config_(config)
+        , wait_strategy_(config.wait_strategy)
+        , feature_engine_(feature_engine)
         , order_manager_(order_manager)
         , market_maker_(market_maker)
-        , incoming_order_book_updates_queue_(incoming_order_book_updates_queue)
-        , incoming_order_entry_res_queue_(incoming_order_entry_res_queue) {
+        , incoming_order_book_updates_(incoming_order_book_updates)
+        , incoming_order_entry_res_queue_(incoming_order_entry_res_queue)
+        , book_updates_(util::metricsRegistry(config.metrics).counter("engine.book_updates"))
+        , trades_(util::metricsRegistry(config.metrics).counter("engine.trades"))
+        , order_responses_(util::metricsRegistry(config.metrics).counter("engine.order_responses"))
+        , order_events_(util::metricsRegistry(config.metrics).counter("engine.order_events"))
+        , response_queue_depth_(util::metricsRegistry(config.metrics).gauge("engine.response_queue_depth"))
+        , wire_to_decision_(util::metricsRegistry(config.metrics).histogram("engine.wire_to_decision_ns"))
+        , book_batch_(incoming_order_book_updates.keys()) {
+      pending_books_.reserve(incoming_order_book_updates.keys());
+      fair_prices_.reserve(feature_engine.numSymbols());
+      for (size_t i = 0; i < feature_engine.numSymbols(); ++i) {
+        fair_prices_.push_back(util::metricsRegistry(config.metrics).decimalGauge("engine.fair_price." +
+                                                                            std::to_string(i)));
+      }
+    }
+
+    // Trades of the public feed for the trade features, see client::TradePublisher. Set before start().
+    void setIncomingTrades(util::SpscQueue<client::WsTradesMsg> *incoming_trades) noexcept {
+      incoming_trades_ = incoming_trades;
+    }
+
+    // Order events streamed by client::WsExecutionClient, the same messages as the order entry responses on a
+    // queue of their own. Set before start().
+    void setIncomingOrderEvents(
+      util::SpscQueue<client::WsOrderEntryClient::WsOrderEntryResMsg> *incoming_order_events) noexcept {
+      incoming_order_events_ = incoming_order_events;
     }
 
     void start() {
@@ -30,38 +84,167 @@ namespace trading {
 
     void stop() {
       run_ = false;
+      wait_strategy_.wake();
       if (processing_thread_.joinable()) {
         processing_thread_.join();
       }
     }
 
+    // Producers feeding our queues call this after a push so a parked engine wakes up.
+    void notify() noexcept {
+      wait_strategy_.notify();
+    }
+
+    util::WaitStrategy &waitStrategy() noexcept {
+      return wait_strategy_;
+    }
+
     void process() {
-      while (run_) {
-        client::WsOrderBookClient::WsBestBidBestAskMsg best_bid_best_ask_msg;
-        if (incoming_order_book_updates_queue_.pop(best_bid_best_ask_msg)) {
-          feature_engine_.onBestBidBestAskUpdate(best_bid_best_ask_msg.best_bid,
-                                                 best_bid_best_ask_msg.best_bid_quantity,
-                                                 best_bid_best_ask_msg.best_ask,
-                                                 best_bid_best_ask_msg.best_ask_quantity);
-          market_maker_.onBestBidBestAskUpdate(best_bid_best_ask_msg.best_bid, best_bid_best_ask_msg.best_bid_quantity,
-                                               best_bid_best_ask_msg.best_ask,
-                                               best_bid_best_ask_msg.best_ask_quantity);
-        }
-        client::WsOrderEntryClient::WsOrderEntryResMsg order_entry_res_msg;
-        if (incoming_order_entry_res_queue_.pop(order_entry_res_msg)) {
-          market_maker_.onOrderUpdate(order_entry_res_msg);
+      if (config_.cpu_id >= 0 && !util::pinCurrentThreadToCpu(config_.cpu_id)) {
+        LOG_WARN("TradingEngine: failed to pin to cpu {}", config_.cpu_id);
+      }
+      while (run_.load(std::memory_order::relaxed)) {
+        order_manager_.onTimer(std::chrono::duration_cast<std::chrono::nanoseconds>(
+          std::chrono::steady_clock::now().time_since_epoch()).count());
+        const auto processed = processPending();
+        if (processed == 0) {
+          wait_strategy_.idle([this] { return hasPendingWork(); });
+        } else {
+          wait_strategy_.reset();
         }
-        std::this_thread::sleep_for(std::chrono::milliseconds(1));
       }
     }
 
+    // One pass over the top of book slots, the trade queue and the order update queues on the calling thread,
+    // returns the number of messages processed. process()
+    // loops over this, replay and tests call it directly instead of start() to stay single threaded, and give
+    // the OrderManager their own time.
+    size_t processPending() {
+      // Order updates go first so the quoting below sees up to date order states, trades before the books so
+      // it sees the flow that came with them.
+      return processOrderEntryResponses() + processOrderEvents() + processTrades() + processOrderBookUpdates();
+    }
+
   private:
-    bool run_{false};
+    // Only the latest top of book of every symbol that changed since the last pass, however many updates the
+    // book client made in between. They are collected first so the features of all of them are evaluated as
+    // one batch, then quoted in slot order. FEATURE_UPDATE of an update includes the quoting of the ones before
+    // it in the pass, it waited for them.
+    size_t processOrderBookUpdates() {
+      pending_books_.clear();
+      book_batch_.clear();
+      const auto processed = incoming_order_book_updates_.consume([this](size_t, const auto &best_bid_best_ask_msg) {
+        CMM_PROBE_FROM(ENGINE_POP, best_bid_best_ask_msg.tsc);
+        pending_books_.push_back(PendingBook{best_bid_best_ask_msg, CMM_PROBE_STAMP()});
+        CMM_PROBE_END();
+      });
+      if (!processed) {
+        return 0;
+      }
+      // pending_books_ has the capacity of every slot, the depth spans stay valid.
+      for (const auto &pending: pending_books_) {
+        const auto &msg = pending.msg;
+        book_batch_.push(msg.symbol_id, msg.best_bid, msg.best_bid_quantity, msg.best_ask, msg.best_ask_quantity,
+                         msg.bid_depth, msg.ask_depth);
+      }
+      feature_engine_.onBestBidBestAskBatch(book_batch_);
+
+      for (const auto &pending: pending_books_) {
+        const auto &msg = pending.msg;
+        CMM_PROBE_FROM(FEATURE_UPDATE, pending.engine_pop_stamp);
+        fair_prices_[msg.symbol_id].set(feature_engine_.getFairPrice(msg.symbol_id));
+        market_maker_.onBestBidBestAskUpdate(msg.symbol_id, msg.best_bid, msg.best_bid_quantity, msg.best_ask,
+                                             msg.best_ask_quantity);
+        CMM_PROBE_END();
+        if (config_.measure_wire_to_decision && msg.receive_time_ns != 0) {
+          // Both ends are CLOCK_REALTIME, a step of the clock in between could make it negative.
+          wire_to_decision_.record(static_cast<uint64_t>(
+            std::max<int64_t>(0, replay::wallClockNanos() - msg.receive_time_ns)));
+        }
+      }
+      book_updates_.add(static_cast<int64_t>(processed));
+      return processed;
+    }
+
+    // Unlike top of book every trade counts, none is skipped.
+    size_t processTrades() {
+      if (!incoming_trades_) {
+        return 0;
+      }
+      size_t processed = 0;
+      client::WsTradesMsg trade;
+      while (processed < config_.max_batch && incoming_trades_->pop(trade)) {
+        feature_engine_.onTrade(trade.symbol_id, trade.aggressor_side, trade.price, trade.quantity);
+        ++processed;
+      }
+      if (processed) {
+        trades_.add(static_cast<int64_t>(processed));
+      }
+      return processed;
+    }
+
+    size_t processOrderEntryResponses() {
+      size_t processed = 0;
+      client::WsOrderEntryClient::WsOrderEntryResMsg order_entry_res_msg;
+      while (processed < config_.max_batch && incoming_order_entry_res_queue_.pop(order_entry_res_msg)) {
+        market_maker_.onOrderUpdate(order_entry_res_msg);
+        ++processed;
+      }
+      if (processed) {
+        order_responses_.add(static_cast<int64_t>(processed));
+        response_queue_depth_.set(static_cast<int64_t>(incoming_order_entry_res_queue_.size()));
+      }
+      return processed;
+    }
+
+    // Whichever of an order event and the order entry response reporting the same comes second is a no-op in the
+    // order manager, the order between the two queues doesn't matter.
+    size_t processOrderEvents() {
+      if (!incoming_order_events_) {
+        return 0;
+      }
+      size_t processed = 0;
+      client::WsOrderEntryClient::WsOrderEntryResMsg order_event;
+      while (processed < config_.max_batch && incoming_order_events_->pop(order_event)) {
+        market_maker_.onOrderUpdate(order_event);
+        ++processed;
+      }
+      if (processed) {
+        order_events_.add(static_cast<int64_t>(processed));
+      }
+      return processed;
+    }
+
+    bool hasPendingWork() const noexcept {
+      return !run_.load(std::memory_order::relaxed) || incoming_order_book_updates_.hasDirty() ||
+             !incoming_order_entry_res_queue_.empty() || (incoming_trades_ && !incoming_trades_->empty()) ||
+             (incoming_order_events_ && !incoming_order_events_->empty());
+    }
+
+    struct PendingBook {
+      client::WsOrderBookClient::WsBestBidBestAskMsg msg;
+      uint64_t engine_pop_stamp;
+    };
+
+    const Config config_;
+    util::WaitStrategy wait_strategy_;
+    std::atomic<bool> run_{false};
     std::thread processing_thread_;
     trading::FeatureEngine &feature_engine_;
     trading::OrderManager &order_manager_;
     trading::MarketMaker &market_maker_;
-    util::SpscQueue<client::WsOrderBookClient::WsBestBidBestAskMsg> &incoming_order_book_updates_queue_;
+    util::LatestValueSlots<client::WsOrderBookClient::WsBestBidBestAskMsg> &incoming_order_book_updates_;
     util::SpscQueue<client::WsOrderEntryClient::WsOrderEntryResMsg> &incoming_order_entry_res_queue_;
+    util::SpscQueue<client::WsTradesMsg> *incoming_trades_{nullptr};
+    util::SpscQueue<client::WsOrderEntryClient::WsOrderEntryResMsg> *incoming_order_events_{nullptr};
+    util::Counter book_updates_;
+    util::Counter trades_;
+    util::Counter order_responses_;
+    util::Counter order_events_;
+    util::Gauge response_queue_depth_;
+    util::Histogram wire_to_decision_;
+    std::vector<util::Gauge> fair_prices_;
+    std::vector<PendingBook> pending_books_;
+    features::TopOfBookBatch book_batch_;
   };
 }
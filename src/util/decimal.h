@@ -0,0 +1,264 @@
+#pragma once
+
+#include <compare>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <type_traits>
+
+namespace util {
+  // Decimal strings from the exchange are decoded into int64 fixed-point with 8 decimal places,
+  // enough for every price and quantity Gemini sends.
+  constexpr int FixedPointDecimals = 8;
+  constexpr int64_t FixedPointScale = 100'000'000;
+
+  // Parses "[-]digits[.digits]" into fixed-point without allocating. Fractional digits past the
+  // eighth are truncated. Returns false on anything else, including an empty string and values beyond
+  // the fixed-point range of about +-9.2e10.
+  constexpr bool parseDecimal(std::string_view str, int64_t &out) noexcept {
+    const char *p = str.data();
+    const char *const end = p + str.size();
+    bool negative = false;
+    if (p != end && *p == '-') {
+      negative = true;
+      ++p;
+    }
+    if (p == end) {
+      return false;
+    }
+    constexpr auto MaxFixed = static_cast<uint64_t>(std::numeric_limits<int64_t>::max());
+    uint64_t integer = 0;
+    const char *const integer_begin = p;
+    while (p != end && static_cast<unsigned>(*p - '0') < 10) {
+      integer = integer * 10 + static_cast<unsigned>(*p - '0');
+      if (integer > MaxFixed / FixedPointScale) {
+        return false;
+      }
+      ++p;
+    }
+    const bool has_integer = p != integer_begin;
+    uint64_t fraction = 0;
+    int decimals = 0;
+    if (p != end && *p == '.') {
+      ++p;
+      const char *const fraction_begin = p;
+      while (p != end && static_cast<unsigned>(*p - '0') < 10) {
+        if (decimals < FixedPointDecimals) {
+          fraction = fraction * 10 + static_cast<unsigned>(*p - '0');
+          ++decimals;
+        }
+        ++p;
+      }
+      if (p == fraction_begin && !has_integer) {
+        return false;
+      }
+    } else if (!has_integer) {
+      return false;
+    }
+    if (p != end) {
+      return false;
+    }
+    for (; decimals < FixedPointDecimals; ++decimals) {
+      fraction *= 10;
+    }
+    if (integer > (MaxFixed - fraction) / FixedPointScale) {
+      return false;
+    }
+    const auto value = static_cast<int64_t>(integer * FixedPointScale + fraction);
+    out = negative ? -value : value;
+    return true;
+  }
+
+  constexpr double fixedToDouble(int64_t value) noexcept {
+    return static_cast<double>(value) / static_cast<double>(FixedPointScale);
+  }
+
+  constexpr int64_t doubleToFixed(double value) noexcept {
+    const auto scaled = value * static_cast<double>(FixedPointScale);
+    return static_cast<int64_t>(scaled < 0 ? scaled - 0.5 : scaled + 0.5);
+  }
+
+  // Longest formatDecimal() output: sign, 11 integer digits, point, 8 decimals.
+  constexpr size_t MaxDecimalChars = 21;
+
+  // Writes a fixed-point value as the shortest plain decimal, "60000.5", "0.1", "-3", without a locale or an
+  // allocation. Returns the end of what was written, at most MaxDecimalChars.
+  constexpr char *formatDecimal(int64_t value, char *out) noexcept {
+    uint64_t magnitude = value < 0 ? 0 - static_cast<uint64_t>(value) : static_cast<uint64_t>(value);
+    if (value < 0) {
+      *out++ = '-';
+    }
+    auto integer = magnitude / FixedPointScale;
+    auto fraction = magnitude % FixedPointScale;
+    char digits[20];
+    int count = 0;
+    do {
+      digits[count++] = static_cast<char>('0' + integer % 10);
+      integer /= 10;
+    } while (integer != 0);
+    while (count > 0) {
+      *out++ = digits[--count];
+    }
+    if (fraction != 0) {
+      int decimals = FixedPointDecimals;
+      while (fraction % 10 == 0) {
+        fraction /= 10;
+        --decimals;
+      }
+      *out++ = '.';
+      for (int i = decimals - 1; i >= 0; --i) {
+        out[i] = static_cast<char>('0' + fraction % 10);
+        fraction /= 10;
+      }
+      out += decimals;
+    }
+    return out;
+  }
+
+  // A util::FixedPointScale fixed-point decimal. The tag keeps prices and quantities from being mixed up, the
+  // integer representation makes them exact to compare, hash and use as keys. Tick and lot sizes are values
+  // of the same types, see util::SymbolSpec.
+  template<typename Tag>
+  class Decimal {
+  public:
+    constexpr Decimal() noexcept = default;
+
+    static constexpr Decimal fromFixed(int64_t fixed) noexcept {
+      Decimal decimal;
+      decimal.fixed_ = fixed;
+      return decimal;
+    }
+
+    // For configuration and tests, rounds to the nearest representable value.
+    static constexpr Decimal fromDouble(double value) noexcept {
+      return fromFixed(doubleToFixed(value));
+    }
+
+    // Same grammar as parseDecimal(), `out` is left alone on failure.
+    static constexpr bool parse(std::string_view str, Decimal &out) noexcept {
+      return parseDecimal(str, out.fixed_);
+    }
+
+    constexpr int64_t fixed() const noexcept {
+      return fixed_;
+    }
+
+    constexpr double toDouble() const noexcept {
+      return fixedToDouble(fixed_);
+    }
+
+    constexpr bool isZero() const noexcept {
+      return fixed_ == 0;
+    }
+
+    char *format(char *out) const noexcept {
+      return formatDecimal(fixed_, out);
+    }
+
+    std::string toString() const {
+      char buffer[MaxDecimalChars];
+      return std::string(buffer, format(buffer));
+    }
+
+    // Number of whole `step`s (a tick or lot size) in this value, rounding towards zero.
+    constexpr int64_t steps(Decimal step) const noexcept {
+      return fixed_ / step.fixed_;
+    }
+
+    // Largest multiple of `step` not further from zero than this value.
+    constexpr Decimal roundDown(Decimal step) const noexcept {
+      return fromFixed(fixed_ / step.fixed_ * step.fixed_);
+    }
+
+    // Smallest multiple of `step` not closer to zero than this value.
+    constexpr Decimal roundUp(Decimal step) const noexcept {
+      const auto rest = fixed_ % step.fixed_;
+      return fromFixed(fixed_ - rest + (rest > 0 ? step.fixed_ : rest < 0 ? -step.fixed_ : 0));
+    }
+
+    constexpr auto operator<=>(const Decimal &) const noexcept = default;
+
+    constexpr Decimal operator-() const noexcept {
+      return fromFixed(-fixed_);
+    }
+
+    constexpr Decimal &operator+=(Decimal other) noexcept {
+      fixed_ += other.fixed_;
+      return *this;
+    }
+
+    constexpr Decimal &operator-=(Decimal other) noexcept {
+      fixed_ -= other.fixed_;
+      return *this;
+    }
+
+    friend constexpr Decimal operator+(Decimal lhs, Decimal rhs) noexcept {
+      return fromFixed(lhs.fixed_ + rhs.fixed_);
+    }
+
+    friend constexpr Decimal operator-(Decimal lhs, Decimal rhs) noexcept {
+      return fromFixed(lhs.fixed_ - rhs.fixed_);
+    }
+
+    friend constexpr Decimal operator*(Decimal lhs, int64_t rhs) noexcept {
+      return fromFixed(lhs.fixed_ * rhs);
+    }
+
+    friend constexpr Decimal operator*(int64_t lhs, Decimal rhs) noexcept {
+      return fromFixed(lhs * rhs.fixed_);
+    }
+
+    friend constexpr Decimal operator/(Decimal lhs, int64_t rhs) noexcept {
+      return fromFixed(lhs.fixed_ / rhs);
+    }
+
+    friend std::ostream &operator<<(std::ostream &os, Decimal decimal) {
+      char buffer[MaxDecimalChars];
+      return os.write(buffer, decimal.format(buffer) - buffer);
+    }
+
+  private:
+    int64_t fixed_{0};
+  };
+
+  struct PriceTag {
+  };
+
+  struct QtyTag {
+  };
+
+  using Price = Decimal<PriceTag>;
+  using Qty = Decimal<QtyTag>;
+
+  static_assert(sizeof(Price) == sizeof(int64_t) && std::is_trivially_copyable_v<Price>);
+
+  // 60000.5_px, 0.1_qty: exact decimal constants for configuration and tests, parsed at compile time.
+  namespace literals {
+    consteval Price operator""_px(const char *digits) {
+      Price price;
+      if (!Price::parse(digits, price)) {
+        throw "not a decimal price";
+      }
+      return price;
+    }
+
+    consteval Qty operator""_qty(const char *digits) {
+      Qty quantity;
+      if (!Qty::parse(digits, quantity)) {
+        throw "not a decimal quantity";
+      }
+      return quantity;
+    }
+  }
+}
+
+template<typename Tag>
+struct std::hash<util::Decimal<Tag> > {
+  size_t operator()(const util::Decimal<Tag> &decimal) const noexcept {
+    return std::hash<int64_t>{}(decimal.fixed());
+  }
+};
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <string_view>
+
+namespace util {
+  // Trivially copyable, fixed capacity string for messages crossing our queues. Longer input is
+  // truncated; sizeof(FixedString<N>) == N (N - 1 characters plus a length byte).
+  template<size_t N>
+  struct FixedString {
+    static_assert(N >= 2 && N <= 256, "length has to fit in one byte");
+
+    FixedString() = default;
+
+    FixedString(std::string_view str) noexcept {
+      assign(str);
+    }
+
+    void assign(std::string_view str) noexcept {
+      size_ = static_cast<uint8_t>(std::min(str.size(), N - 1));
+      std::copy_n(str.data(), size_, data_);
+    }
+
+    std::string_view view() const noexcept {
+      return {data_, size_};
+    }
+
+    bool empty() const noexcept {
+      return size_ == 0;
+    }
+
+    bool operator==(std::string_view other) const noexcept {
+      return view() == other;
+    }
+
+  private:
+    char data_[N - 1]{};
+    uint8_t size_{0};
+  };
+}
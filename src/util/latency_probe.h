@@ -0,0 +1,296 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#include "logger.h"
+
+// Set to 0 to compile the probes out: the CMM_PROBE* call sites disappear and the stamps carried in messages
+// stay 0.
+#ifndef CMM_LATENCY_PROBES
+#define CMM_LATENCY_PROBES 1
+#endif
+
+namespace util {
+  // Time stamp counter. It ticks at a constant rate on every core of the machines we run on (invariant TSC),
+  // so stamps taken on different threads can be subtracted. Steady clock nanoseconds elsewhere.
+  inline uint64_t readTsc() noexcept {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return static_cast<uint64_t>(std::chrono::steady_clock::now().time_since_epoch().count());
+#endif
+  }
+
+  // TSC ticks per nanosecond, measured against the steady clock on first use (which takes 20 ms).
+  inline double tscTicksPerNano() {
+    static const double ticks_per_nano = [] {
+#if defined(__x86_64__) || defined(__i386__)
+      const auto clock_start = std::chrono::steady_clock::now();
+      const auto tsc_start = readTsc();
+      std::this_thread::sleep_for(std::chrono::milliseconds(20));
+      const auto tsc_end = readTsc();
+      const auto nanos = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - clock_start).count();
+      return static_cast<double>(tsc_end - tsc_start) / static_cast<double>(nanos);
+#else
+      return 1.0;
+#endif
+    }();
+    return ticks_per_nano;
+  }
+
+  // Where a market data event is on its way to an order on the wire, in order. The histogram of a stage holds
+  // the time since the previous stage of the same event.
+  enum class ProbeStage : uint8_t {
+    SOCKET_READ, // the read that returned the frame, waiting for it included
+    PARSED, // frame parsed and applied to the book
+    QUEUE_PUSH, // top of book built, about to go to the trading engine
+    ENGINE_POP, // popped by the trading engine, the queue hop between threads
+    FEATURE_UPDATE,
+    QUOTE_DECISION,
+    ORDER_QUEUE_PUSH, // order requests built, about to go to order entry
+    SIGNED, // popped by order entry and signed, the queue hop included
+    WIRE_WRITE, // written to the exchange session
+    COUNT
+  };
+
+  constexpr size_t ProbeStageCount = static_cast<size_t>(ProbeStage::COUNT);
+
+  constexpr std::array<const char *, ProbeStageCount> ProbeStageNames{
+    "socket_read", "parsed", "queue_push", "engine_pop", "feature_update", "quote_decision", "order_queue_push",
+    "signed", "wire_write"
+  };
+
+  // HDR style histogram of tick counts. Values below 64 get a bucket each, above that every power of two is
+  // split into 32 linear buckets, so a value and its bucket differ by less than 1/32. Values are capped at
+  // 2^36 ticks, about 20 s at 3 GHz.
+  //
+  // One thread records, any other may read at the same time. Counts are relaxed atomics the recording thread
+  // updates with a plain load and store, so a reader never slows it down but may see a record in the max and
+  // not yet in its bucket.
+  class LatencyHistogram {
+  public:
+    static constexpr unsigned SubBucketBits = 5;
+    static constexpr uint64_t SubBuckets = uint64_t{1} << SubBucketBits;
+    static constexpr unsigned MaxValueBits = 36;
+    static constexpr uint64_t MaxValue = (uint64_t{1} << MaxValueBits) - 1;
+    static constexpr size_t Buckets = (MaxValueBits - SubBucketBits + 1) * SubBuckets;
+
+    static constexpr size_t bucketOf(uint64_t value) noexcept {
+      if (value < 2 * SubBuckets) {
+        return static_cast<size_t>(value);
+      }
+      const auto shift = static_cast<unsigned>(63 - std::countl_zero(value)) - SubBucketBits;
+      return static_cast<size_t>(shift * SubBuckets + (value >> shift));
+    }
+
+    // Smallest and largest value that land in `bucket`.
+    static constexpr uint64_t lowestValue(size_t bucket) noexcept {
+      if (bucket < 2 * SubBuckets) {
+        return bucket;
+      }
+      const auto shift = bucket / SubBuckets - 1;
+      return (bucket - shift * SubBuckets) << shift;
+    }
+
+    static constexpr uint64_t highestValue(size_t bucket) noexcept {
+      return bucket + 1 < Buckets ? lowestValue(bucket + 1) - 1 : MaxValue;
+    }
+
+    void record(uint64_t value) noexcept {
+      value = std::min(value, MaxValue);
+      auto &count = counts_[bucketOf(value)];
+      count.store(count.load(std::memory_order::relaxed) + 1, std::memory_order::relaxed);
+      if (value > max_.load(std::memory_order::relaxed)) {
+        max_.store(value, std::memory_order::relaxed);
+      }
+    }
+
+    uint64_t count(size_t bucket) const noexcept {
+      return counts_[bucket].load(std::memory_order::relaxed);
+    }
+
+    uint64_t max() const noexcept {
+      return max_.load(std::memory_order::relaxed);
+    }
+
+  private:
+    std::array<std::atomic<uint64_t>, Buckets> counts_{};
+    std::atomic<uint64_t> max_{0};
+  };
+
+  // A copy of one or more histograms, made off the hot threads.
+  struct LatencySnapshot {
+    std::array<uint64_t, LatencyHistogram::Buckets> counts{};
+    uint64_t total{0};
+    uint64_t max{0};
+
+    void add(const LatencyHistogram &histogram) noexcept {
+      for (size_t i = 0; i < counts.size(); ++i) {
+        const auto count = histogram.count(i);
+        counts[i] += count;
+        total += count;
+      }
+      max = std::max(max, histogram.max());
+    }
+
+    // Value at or below which the fraction `p` of the records are, as the largest value of its bucket.
+    uint64_t percentile(double p) const noexcept {
+      if (total == 0) {
+        return 0;
+      }
+      const auto rank = std::max<uint64_t>(1, static_cast<uint64_t>(p * static_cast<double>(total) + 0.5));
+      uint64_t seen = 0;
+      for (size_t i = 0; i < counts.size(); ++i) {
+        seen += counts[i];
+        if (seen >= rank) {
+          return std::min(LatencyHistogram::highestValue(i), max);
+        }
+      }
+      return max;
+    }
+  };
+
+  // Per thread latency histograms of every ProbeStage. A thread follows one event at a time: begin() stamps
+  // its start, every probe() records the ticks since the previous stamp and stamps again. An event crossing a
+  // queue carries its last stamp() along and the consuming thread continues it with probeFrom(). Outside an
+  // event probes record nothing, so code paths shared with replays, backtests and order responses stay out of
+  // the histograms.
+  //
+  // A probe is a TSC read, a thread local lookup and a few stores into the thread's own histogram, no locks
+  // and no syscalls (after the thread's first probe, which registers it).
+  class LatencyProbes {
+  public:
+    static constexpr size_t MaxThreads = 64;
+
+    static LatencyProbes &instance() {
+      static LatencyProbes probes;
+      return probes;
+    }
+
+    LatencyProbes(const LatencyProbes &) = delete;
+
+    LatencyProbes(const LatencyProbes &&) = delete;
+
+    LatencyProbes &operator=(const LatencyProbes &) = delete;
+
+    LatencyProbes &operator=(const LatencyProbes &&) = delete;
+
+    static void begin() noexcept {
+      if (auto *thread = threadProbes()) [[likely]] {
+        thread->stamp = readTsc();
+      }
+    }
+
+    static void end() noexcept {
+      if (auto *thread = threadProbes()) [[likely]] {
+        thread->stamp = 0;
+      }
+    }
+
+    static void probe(ProbeStage stage) noexcept {
+      auto *thread = threadProbes();
+      if (!thread || thread->stamp == 0) {
+        return;
+      }
+      const auto now = readTsc();
+      thread->histograms[static_cast<size_t>(stage)].record(now - thread->stamp);
+      thread->stamp = now;
+    }
+
+    // Continues an event stamped `since` on another thread, 0 if there is none.
+    static void probeFrom(ProbeStage stage, uint64_t since) noexcept {
+      if (auto *thread = threadProbes()) [[likely]] {
+        thread->stamp = since;
+        probe(stage);
+      }
+    }
+
+    // Last stamp of the calling thread's event, 0 outside an event.
+    static uint64_t stamp() noexcept {
+      const auto *thread = threadProbes();
+      return thread ? thread->stamp : 0;
+    }
+
+    // Histogram of `stage` over all threads so far, in ticks.
+    LatencySnapshot snapshot(ProbeStage stage) const {
+      LatencySnapshot snapshot;
+      const auto count = thread_count_.load(std::memory_order::acquire);
+      for (size_t i = 0; i < count; ++i) {
+        snapshot.add(threads_[i]->histograms[static_cast<size_t>(stage)]);
+      }
+      return snapshot;
+    }
+
+    // Logs percentiles of every stage seen so far, in nanoseconds.
+    void report() const {
+      const auto ticks_per_nano = tscTicksPerNano();
+      const auto nanos = [&](uint64_t ticks) {
+        return static_cast<uint64_t>(static_cast<double>(ticks) / ticks_per_nano);
+      };
+      for (size_t i = 0; i < ProbeStageCount; ++i) {
+        const auto stage = snapshot(static_cast<ProbeStage>(i));
+        if (stage.total == 0) {
+          continue;
+        }
+        LOG_INFO("latency {}: n={} p50={}ns p99={}ns p99.9={}ns max={}ns", ProbeStageNames[i], stage.total,
+                 nanos(stage.percentile(0.5)), nanos(stage.percentile(0.99)), nanos(stage.percentile(0.999)),
+                 nanos(stage.max));
+      }
+    }
+
+  private:
+    struct alignas(64) ThreadProbes {
+      uint64_t stamp{0};
+      std::array<LatencyHistogram, ProbeStageCount> histograms{};
+    };
+
+    LatencyProbes() = default;
+
+    static ThreadProbes *threadProbes() noexcept {
+      thread_local ThreadProbes *probes = instance().registerThread();
+      return probes;
+    }
+
+    ThreadProbes *registerThread() noexcept {
+      std::lock_guard<std::mutex> lock(mutex_);
+      const auto count = thread_count_.load(std::memory_order::relaxed);
+      if (count == MaxThreads) {
+        return nullptr;
+      }
+      threads_[count] = std::make_unique<ThreadProbes>();
+      thread_count_.store(count + 1, std::memory_order::release);
+      return threads_[count].get();
+    }
+
+    std::mutex mutex_;
+    std::array<std::unique_ptr<ThreadProbes>, MaxThreads> threads_{};
+    std::atomic<size_t> thread_count_{0};
+  };
+}
+
+#if CMM_LATENCY_PROBES
+#define CMM_PROBE_BEGIN() ::util::LatencyProbes::begin()
+#define CMM_PROBE_END() ::util::LatencyProbes::end()
+#define CMM_PROBE(stage) ::util::LatencyProbes::probe(::util::ProbeStage::stage)
+#define CMM_PROBE_FROM(stage, since) ::util::LatencyProbes::probeFrom(::util::ProbeStage::stage, since)
+#define CMM_PROBE_STAMP() ::util::LatencyProbes::stamp()
+#else
+#define CMM_PROBE_BEGIN() static_cast<void>(0)
+#define CMM_PROBE_END() static_cast<void>(0)
+#define CMM_PROBE(stage) static_cast<void>(0)
+#define CMM_PROBE_FROM(stage, since) static_cast<void>(0)
+#define CMM_PROBE_STAMP() uint64_t{0}
+#endif
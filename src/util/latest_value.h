@@ -0,0 +1,168 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <type_traits>
+
+#include "thread_utils.h"
+
+namespace util {
+  // Single writer seqlock around a trivially copyable value. The writer never waits. A reader retries when the
+  // writer was in the middle of a store, so it always gets a whole value and never slows the writer down.
+  //
+  // The value is kept in relaxed atomic words rather than a plain T so that a reader racing a store is not a
+  // data race, the sequence number tells it to throw the torn copy away.
+  template<typename T>
+  class SeqLock {
+    static_assert(std::is_trivially_copyable_v<T>);
+
+  public:
+    static constexpr size_t Words = (sizeof(T) + sizeof(uint64_t) - 1) / sizeof(uint64_t);
+
+    // Writer side.
+    void store(const T &value) noexcept {
+      std::array<uint64_t, Words> words{};
+      std::memcpy(words.data(), &value, sizeof(T));
+      const auto seq = seq_.load(std::memory_order::relaxed);
+      seq_.store(seq + 1, std::memory_order::relaxed);
+      std::atomic_thread_fence(std::memory_order::release);
+      for (size_t i = 0; i < Words; ++i) {
+        words_[i].store(words[i], std::memory_order::relaxed);
+      }
+      seq_.store(seq + 2, std::memory_order::release);
+    }
+
+    // Reader side. Copies the latest value into `value` and returns its version: 0 before the first store,
+    // then counting up by 2 with every store.
+    uint64_t load(T &value) const noexcept {
+      std::array<uint64_t, Words> words;
+      while (true) {
+        const auto before = seq_.load(std::memory_order::acquire);
+        if (before & 1) [[unlikely]] {
+          cpuRelax();
+          continue;
+        }
+        for (size_t i = 0; i < Words; ++i) {
+          words[i] = words_[i].load(std::memory_order::relaxed);
+        }
+        std::atomic_thread_fence(std::memory_order::acquire);
+        if (seq_.load(std::memory_order::relaxed) == before) [[likely]] {
+          std::memcpy(static_cast<void *>(&value), words.data(), sizeof(T));
+          return before;
+        }
+      }
+    }
+
+    uint64_t version() const noexcept {
+      return seq_.load(std::memory_order::acquire);
+    }
+
+  private:
+    std::atomic<uint64_t> seq_{0};
+    std::array<std::atomic<uint64_t>, Words> words_{};
+  };
+
+  // The latest value per key, handed from one writer thread to one reader thread. The writer overwrites the
+  // key's slot and marks it in a dirty bitmap; the reader scans the bitmap and reads each marked slot once. How
+  // far the reader is behind doesn't matter: it reads each key at most once per pass, always the newest value,
+  // and values it never got to are simply replaced.
+  //
+  // This is for state where only the latest value matters, top of book for instance. Anything where every
+  // message counts belongs on an SpscQueue.
+  template<typename T>
+  class LatestValueSlots {
+  public:
+    explicit LatestValueSlots(size_t keys)
+      : keys_(keys), slots_(std::make_unique<Slot[]>(keys)), dirty_(std::make_unique<DirtyWord[]>(dirtyWords())),
+        versions_(std::make_unique<uint64_t[]>(keys)) {
+    }
+
+    LatestValueSlots(const LatestValueSlots &) = delete;
+
+    LatestValueSlots(const LatestValueSlots &&) = delete;
+
+    LatestValueSlots &operator=(const LatestValueSlots &) = delete;
+
+    LatestValueSlots &operator=(const LatestValueSlots &&) = delete;
+
+    // Writer side. Returns true if the previous value of `key` was replaced before the reader got to it.
+    bool store(size_t key, const T &value) noexcept {
+      slots_[key].value.store(value);
+      const auto bit = uint64_t{1} << (key % 64);
+      return dirty_[key / 64].bits.fetch_or(bit, std::memory_order::release) & bit;
+    }
+
+    // Reader side. Calls `on_value(key, value)` for every key stored since the last call, in key order, and
+    // returns how many there were.
+    template<typename OnValue>
+    size_t consume(OnValue &&on_value) {
+      size_t consumed = 0;
+      T value;
+      for (size_t word = 0; word < dirtyWords(); ++word) {
+        if (dirty_[word].bits.load(std::memory_order::relaxed) == 0) [[likely]] {
+          continue;
+        }
+        for (auto bits = dirty_[word].bits.exchange(0, std::memory_order::acquire); bits != 0; bits &= bits - 1) {
+          const auto key = word * 64 + static_cast<size_t>(std::countr_zero(bits));
+          // A store racing the exchange above marks the key again although we read its value right now, the
+          // version tells the next pass it has seen that one already.
+          const auto version = slots_[key].value.load(value);
+          if (version == versions_[key]) {
+            continue;
+          }
+          versions_[key] = version;
+          on_value(key, value);
+          ++consumed;
+        }
+      }
+      return consumed;
+    }
+
+    // Either side.
+
+    bool hasDirty() const noexcept {
+      for (size_t word = 0; word < dirtyWords(); ++word) {
+        if (dirty_[word].bits.load(std::memory_order::relaxed) != 0) {
+          return true;
+        }
+      }
+      return false;
+    }
+
+    // Latest value of `key` regardless of the dirty bits, all zero bytes before the first store.
+    T latest(size_t key) const noexcept {
+      T value{};
+      slots_[key].value.load(value);
+      return value;
+    }
+
+    size_t keys() const noexcept {
+      return keys_;
+    }
+
+  private:
+    // Keys on separate cache lines so the writer updating one never invalidates the line the reader is copying
+    // another from.
+    struct alignas(64) Slot {
+      SeqLock<T> value;
+    };
+
+    struct alignas(64) DirtyWord {
+      std::atomic<uint64_t> bits{0};
+    };
+
+    size_t dirtyWords() const noexcept {
+      return (keys_ + 63) / 64;
+    }
+
+    const size_t keys_;
+    std::unique_ptr<Slot[]> slots_;
+    std::unique_ptr<DirtyWord[]> dirty_;
+    // Reader only: version of the value last handed out per key.
+    std::unique_ptr<uint64_t[]> versions_;
+  };
+}
@@ -0,0 +1,423 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <charconv>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <memory>
+#include <mutex>
+#include <string_view>
+#include <thread>
+#include <type_traits>
+#include <utility>
+
+#include "decimal.h"
+#include "fixed_string.h"
+#include "spsc_queue.h"
+#include "thread_utils.h"
+
+// Levels below this are compiled out: the call site, its arguments and the format string disappear.
+#ifndef CMM_LOG_LEVEL
+#define CMM_LOG_LEVEL 1 // INFO
+#endif
+
+namespace util {
+  enum class LogLevel : uint8_t {
+    DEBUG = 0,
+    INFO = 1,
+    WARN = 2,
+    ERROR = 3
+  };
+
+  // One per call site with static storage, its address identifies the format string in a record.
+  struct LogSite {
+    LogLevel level;
+    const char *format; // "{}" placeholders, one per argument
+    const char *file;
+    int line;
+  };
+
+  enum class LogArgType : uint8_t {
+    INT,
+    UINT,
+    DOUBLE,
+    BOOL,
+    CHAR,
+    DECIMAL, // util::Price, util::Qty
+    STRING // copied into the record, truncated to what the arguments after it leave
+  };
+
+  // What a hot thread writes per log call: the site plus the raw argument bytes, formatting happens
+  // on the logger thread.
+  struct alignas(64) LogRecord {
+    static constexpr size_t MaxArgs = 8;
+    static constexpr size_t PayloadSize = 96;
+
+    const LogSite *site;
+    int64_t timestamp_ns;
+    uint8_t num_args;
+    uint8_t payload_size;
+    // An argument did not fit the payload and was left out.
+    bool truncated;
+    LogArgType types[MaxArgs];
+    char payload[PayloadSize];
+  };
+
+  static_assert(sizeof(LogRecord) == 128);
+  static_assert(std::is_trivially_copyable_v<LogRecord>);
+
+  struct LoggerConfig {
+    FILE *file{stdout};
+    // Keep the logger thread on a non-isolated CPU, see the README. Negative means no pinning.
+    int cpu_id{-1};
+    // Records buffered per producing thread, a full ring drops (and counts) new records.
+    size_t ring_size{4096};
+  };
+
+  // Asynchronous logger. Every thread that logs gets its own SPSC ring of LogRecords, a background
+  // thread drains the rings, formats and writes. A log call on a hot thread is a handful of stores
+  // into a ring slot, no locks, no syscalls, no allocation (after the thread's first call).
+  class Logger {
+  public:
+    static constexpr size_t MaxThreads = 64;
+
+    static Logger &instance() {
+      static Logger logger;
+      return logger;
+    }
+
+    Logger(const Logger &) = delete;
+
+    Logger(const Logger &&) = delete;
+
+    Logger &operator=(const Logger &) = delete;
+
+    Logger &operator=(const Logger &&) = delete;
+
+    ~Logger() {
+      stop();
+    }
+
+    // Until started records pile up in the rings and get dropped once those are full.
+    void start(const LoggerConfig &config = LoggerConfig{}) {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (running_) {
+        return;
+      }
+      config_ = config;
+      running_ = true;
+      thread_ = std::thread(&Logger::run, this);
+    }
+
+    void stop() {
+      {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!running_) {
+          return;
+        }
+        running_ = false;
+      }
+      if (thread_.joinable()) {
+        thread_.join();
+      }
+    }
+
+    template<typename... Args>
+    void log(const LogSite *site, const Args &... args) noexcept {
+      static_assert(sizeof...(Args) <= LogRecord::MaxArgs, "too many log arguments");
+      auto *ring = threadRing();
+      if (!ring) [[unlikely]] {
+        return;
+      }
+      auto *record = ring->queue.try_claim();
+      if (!record) [[unlikely]] {
+        ring->dropped.fetch_add(1, std::memory_order::relaxed);
+        return;
+      }
+      record->site = site;
+      record->timestamp_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+      record->num_args = 0;
+      record->payload_size = 0;
+      record->truncated = false;
+      encodeAll(*record, std::index_sequence_for<Args...>{}, args...);
+      ring->queue.commit();
+    }
+
+    uint64_t dropped() const noexcept {
+      uint64_t total = 0;
+      const auto count = ring_count_.load(std::memory_order::acquire);
+      for (size_t i = 0; i < count; ++i) {
+        total += rings_[i]->dropped.load(std::memory_order::relaxed);
+      }
+      return total;
+    }
+
+  private:
+    struct Ring {
+      explicit Ring(size_t size) : queue(size) {
+      }
+
+      SpscQueue<LogRecord> queue;
+      std::atomic<uint64_t> dropped{0};
+    };
+
+    Logger() = default;
+
+    Ring *threadRing() noexcept {
+      thread_local Ring *ring = registerThread();
+      return ring;
+    }
+
+    Ring *registerThread() noexcept {
+      std::lock_guard<std::mutex> lock(mutex_);
+      const auto count = ring_count_.load(std::memory_order::relaxed);
+      if (count == MaxThreads) {
+        return nullptr;
+      }
+      rings_[count] = std::make_unique<Ring>(config_.ring_size);
+      ring_count_.store(count + 1, std::memory_order::release);
+      return rings_[count].get();
+    }
+
+    // Bytes an argument takes at least, a string can shrink to its length byte.
+    template<typename T>
+    static constexpr size_t minEncodedSize() noexcept {
+      using U = std::decay_t<T>;
+      if constexpr (std::is_same_v<U, bool> || std::is_same_v<U, char>) {
+        return 1;
+      } else if constexpr (std::is_enum_v<U> || std::is_arithmetic_v<U> || requires(const U &arg) { arg.fixed(); }) {
+        return 8;
+      } else {
+        return 1;
+      }
+    }
+
+    // Element i is what arguments i.. need at least.
+    template<typename... Args>
+    static constexpr std::array<size_t, sizeof...(Args) + 1> minEncodedSizes() noexcept {
+      std::array<size_t, sizeof...(Args) + 1> sizes{minEncodedSize<Args>()..., 0};
+      for (size_t i = sizeof...(Args); i > 0; --i) {
+        sizes[i - 1] += sizes[i];
+      }
+      return sizes;
+    }
+
+    // Strings are truncated to leave room for the arguments after them.
+    template<size_t... I, typename... Args>
+    static void encodeAll(LogRecord &record, std::index_sequence<I...>, const Args &... args) noexcept {
+      static constexpr auto reserved = minEncodedSizes<Args...>();
+      static_assert(reserved[0] <= LogRecord::PayloadSize, "log arguments do not fit a record");
+      (encode(record, args, reserved[I + 1]), ...);
+    }
+
+    template<typename T>
+    static void encode(LogRecord &record, const T &arg, size_t reserved) noexcept {
+      using U = std::decay_t<T>;
+      auto &type = record.types[record.num_args++];
+      if constexpr (std::is_same_v<U, bool>) {
+        type = LogArgType::BOOL;
+        put(record, static_cast<char>(arg));
+      } else if constexpr (std::is_same_v<U, char>) {
+        type = LogArgType::CHAR;
+        put(record, arg);
+      } else if constexpr (std::is_enum_v<U>) {
+        type = LogArgType::INT;
+        put(record, static_cast<int64_t>(arg));
+      } else if constexpr (std::is_integral_v<U> && std::is_signed_v<U>) {
+        type = LogArgType::INT;
+        put(record, static_cast<int64_t>(arg));
+      } else if constexpr (std::is_integral_v<U>) {
+        type = LogArgType::UINT;
+        put(record, static_cast<uint64_t>(arg));
+      } else if constexpr (std::is_floating_point_v<U>) {
+        type = LogArgType::DOUBLE;
+        put(record, static_cast<double>(arg));
+      } else if constexpr (requires { arg.fixed(); }) {
+        type = LogArgType::DECIMAL;
+        put(record, static_cast<int64_t>(arg.fixed()));
+      } else if constexpr (requires { arg.view(); }) {
+        type = LogArgType::STRING;
+        putString(record, arg.view(), reserved);
+      } else {
+        static_assert(std::is_convertible_v<const T &, std::string_view>, "unsupported log argument type");
+        type = LogArgType::STRING;
+        putString(record, std::string_view(arg), reserved);
+      }
+    }
+
+    // Takes back the argument being encoded, the last one counted.
+    static void dropArg(LogRecord &record) noexcept {
+      --record.num_args;
+      record.truncated = true;
+    }
+
+    template<typename T>
+    static void put(LogRecord &record, T value) noexcept {
+      if (record.payload_size + sizeof(T) > LogRecord::PayloadSize) [[unlikely]] {
+        dropArg(record);
+        return;
+      }
+      std::memcpy(record.payload + record.payload_size, &value, sizeof(T));
+      record.payload_size += sizeof(T);
+    }
+
+    static void putString(LogRecord &record, std::string_view str, size_t reserved) noexcept {
+      const size_t used = record.payload_size + 1 + reserved;
+      if (used > LogRecord::PayloadSize) [[unlikely]] {
+        dropArg(record);
+        return;
+      }
+      const auto size = static_cast<uint8_t>(std::min(str.size(), LogRecord::PayloadSize - used));
+      record.payload[record.payload_size++] = static_cast<char>(size);
+      std::memcpy(record.payload + record.payload_size, str.data(), size);
+      record.payload_size += size;
+    }
+
+    void run() {
+      if (config_.cpu_id >= 0) {
+        pinCurrentThreadToCpu(config_.cpu_id);
+      }
+      for (;;) {
+        const bool running = isRunning();
+        const auto written = drain();
+        if (written) {
+          std::fflush(config_.file);
+        } else if (!running) {
+          break;
+        } else {
+          std::this_thread::sleep_for(std::chrono::microseconds(500));
+        }
+      }
+      if (const auto lost = dropped()) {
+        std::fprintf(config_.file, "Logger: dropped %lu records\n", static_cast<unsigned long>(lost));
+        std::fflush(config_.file);
+      }
+    }
+
+    bool isRunning() {
+      std::lock_guard<std::mutex> lock(mutex_);
+      return running_;
+    }
+
+    size_t drain() {
+      size_t written = 0;
+      const auto count = ring_count_.load(std::memory_order::acquire);
+      for (size_t i = 0; i < count; ++i) {
+        auto &queue = rings_[i]->queue;
+        while (const auto *record = queue.front()) {
+          write(*record);
+          queue.pop();
+          ++written;
+        }
+      }
+      return written;
+    }
+
+    void write(const LogRecord &record) {
+      static constexpr std::array<const char *, 4> LevelNames{"DEBUG", "INFO ", "WARN ", "ERROR"};
+      char line[1024];
+      char *out = line;
+      char *const end = line + sizeof(line) - 1;
+
+      const auto secs = static_cast<time_t>(record.timestamp_ns / 1'000'000'000);
+      tm utc{};
+      gmtime_r(&secs, &utc);
+      out += std::strftime(out, static_cast<size_t>(end - out), "%Y-%m-%dT%H:%M:%S", &utc);
+      out += std::snprintf(out, static_cast<size_t>(end - out), ".%09ld %s ",
+                           static_cast<long>(record.timestamp_ns % 1'000'000'000),
+                           LevelNames[static_cast<size_t>(record.site->level)]);
+
+      size_t offset = 0;
+      uint8_t arg = 0;
+      for (const char *f = record.site->format; *f && out < end; ++f) {
+        if (f[0] == '{' && f[1] == '}' && arg < record.num_args) {
+          out = formatArg(out, end, record, record.types[arg++], offset);
+          ++f;
+        } else {
+          *out++ = *f;
+        }
+      }
+      if (record.truncated) {
+        static constexpr std::string_view Marker = " [truncated]";
+        out = std::copy_n(Marker.data(), std::min(Marker.size(), static_cast<size_t>(end - out)), out);
+      }
+      *out++ = '\n';
+      std::fwrite(line, 1, static_cast<size_t>(out - line), config_.file);
+    }
+
+    static char *formatArg(char *out, char *end, const LogRecord &record, LogArgType type, size_t &offset) {
+      const auto *payload = record.payload + offset;
+      switch (type) {
+        case LogArgType::INT: {
+          int64_t value;
+          std::memcpy(&value, payload, sizeof(value));
+          offset += sizeof(value);
+          return std::to_chars(out, end, value).ptr;
+        }
+        case LogArgType::UINT: {
+          uint64_t value;
+          std::memcpy(&value, payload, sizeof(value));
+          offset += sizeof(value);
+          return std::to_chars(out, end, value).ptr;
+        }
+        case LogArgType::DOUBLE: {
+          double value;
+          std::memcpy(&value, payload, sizeof(value));
+          offset += sizeof(value);
+          const auto result = std::to_chars(out, end, value);
+          return result.ec == std::errc() ? result.ptr : out;
+        }
+        case LogArgType::BOOL: {
+          offset += 1;
+          const std::string_view str = *payload ? "true" : "false";
+          const auto size = std::min(str.size(), static_cast<size_t>(end - out));
+          return std::copy_n(str.data(), size, out);
+        }
+        case LogArgType::CHAR: {
+          offset += 1;
+          *out = *payload;
+          return out + 1;
+        }
+        case LogArgType::DECIMAL: {
+          int64_t value;
+          std::memcpy(&value, payload, sizeof(value));
+          offset += sizeof(value);
+          return end - out >= static_cast<std::ptrdiff_t>(MaxDecimalChars) ? formatDecimal(value, out) : out;
+        }
+        case LogArgType::STRING: {
+          const auto size = std::min(static_cast<size_t>(static_cast<uint8_t>(*payload)),
+                                     static_cast<size_t>(end - out));
+          offset += 1 + static_cast<uint8_t>(*payload);
+          return std::copy_n(payload + 1, size, out);
+        }
+      }
+      return out;
+    }
+
+    std::mutex mutex_;
+    bool running_{false};
+    LoggerConfig config_{};
+    std::thread thread_;
+    std::array<std::unique_ptr<Ring>, MaxThreads> rings_{};
+    std::atomic<size_t> ring_count_{0};
+  };
+}
+
+#define CMM_LOG(level, format, ...) \
+  do { \
+    if constexpr (static_cast<int>(level) >= CMM_LOG_LEVEL) { \
+      static constexpr ::util::LogSite cmm_log_site{level, format, __FILE__, __LINE__}; \
+      ::util::Logger::instance().log(&cmm_log_site __VA_OPT__(,) __VA_ARGS__); \
+    } \
+  } while (0)
+
+#define LOG_DEBUG(format, ...) CMM_LOG(::util::LogLevel::DEBUG, format __VA_OPT__(,) __VA_ARGS__)
+#define LOG_INFO(format, ...) CMM_LOG(::util::LogLevel::INFO, format __VA_OPT__(,) __VA_ARGS__)
+#define LOG_WARN(format, ...) CMM_LOG(::util::LogLevel::WARN, format __VA_OPT__(,) __VA_ARGS__)
+#define LOG_ERROR(format, ...) CMM_LOG(::util::LogLevel::ERROR, format __VA_OPT__(,) __VA_ARGS__)
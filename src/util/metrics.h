@@ -0,0 +1,428 @@
+#pragma once
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "decimal.h"
+
+namespace util {
+  enum class MetricType : uint8_t {
+    COUNTER,
+    GAUGE,
+    DECIMAL_GAUGE // a util::Decimal, stored fixed-point
+  };
+
+  // A metrics segment is a MetricsHeader, max_metrics MetricSlots and max_histograms HistogramSlots. Slots are
+  // filled in order and only counted in the header once complete, a reader never looks at a slot past the
+  // count. Any change to these structs needs a new CurrentVersion.
+  struct MetricsHeader {
+    static constexpr char Magic[8] = {'C', 'M', 'M', 'M', 'E', 'T', 'R', 'C'};
+    static constexpr uint32_t CurrentVersion = 1;
+
+    char magic[8];
+    uint32_t version;
+    uint32_t max_metrics;
+    uint32_t max_histograms;
+    uint32_t reserved0;
+    std::atomic<uint32_t> metrics;
+    std::atomic<uint32_t> histograms;
+    int64_t pid;
+    char reserved[24];
+  };
+
+  struct alignas(64) MetricSlot {
+    char name[48];
+    MetricType type;
+    std::atomic<int64_t> value;
+  };
+
+  // Bucket i counts the values of bit width i, [2^(i-1), 2^i), the last one everything above.
+  struct alignas(64) HistogramSlot {
+    static constexpr size_t Buckets = 64;
+
+    char name[48];
+    std::atomic<uint64_t> count;
+    std::atomic<uint64_t> sum;
+    std::array<std::atomic<uint64_t>, Buckets> buckets;
+  };
+
+  static_assert(sizeof(MetricsHeader) == 64);
+  static_assert(sizeof(MetricSlot) == 64);
+  static_assert(sizeof(HistogramSlot) == 576);
+  static_assert(std::atomic<uint64_t>::is_always_lock_free);
+
+  // Handles hot threads update metrics through. Every metric has a single writing thread, so an update is a
+  // relaxed load and store on memory nobody else writes: no lock prefix, no syscall, nothing to wait for.
+  class Counter {
+  public:
+    explicit Counter(std::atomic<int64_t> &value) noexcept : value_(&value) {
+    }
+
+    void add(int64_t count = 1) noexcept {
+      value_->store(value_->load(std::memory_order::relaxed) + count, std::memory_order::relaxed);
+    }
+
+    int64_t value() const noexcept {
+      return value_->load(std::memory_order::relaxed);
+    }
+
+  private:
+    std::atomic<int64_t> *value_;
+  };
+
+  class Gauge {
+  public:
+    explicit Gauge(std::atomic<int64_t> &value) noexcept : value_(&value) {
+    }
+
+    void set(int64_t value) noexcept {
+      value_->store(value, std::memory_order::relaxed);
+    }
+
+    template<typename Tag>
+    void set(Decimal<Tag> value) noexcept {
+      set(value.fixed());
+    }
+
+    int64_t value() const noexcept {
+      return value_->load(std::memory_order::relaxed);
+    }
+
+  private:
+    std::atomic<int64_t> *value_;
+  };
+
+  class Histogram {
+  public:
+    explicit Histogram(HistogramSlot &slot) noexcept : slot_(&slot) {
+    }
+
+    void record(uint64_t value) noexcept {
+      bump(slot_->buckets[std::min<size_t>(std::bit_width(value), HistogramSlot::Buckets - 1)], 1);
+      bump(slot_->count, 1);
+      bump(slot_->sum, value);
+    }
+
+  private:
+    static void bump(std::atomic<uint64_t> &value, uint64_t by) noexcept {
+      value.store(value.load(std::memory_order::relaxed) + by, std::memory_order::relaxed);
+    }
+
+    HistogramSlot *slot_;
+  };
+
+  namespace detail {
+    inline std::runtime_error metricsError(const std::string &what, const std::string &name) {
+      return std::runtime_error("metrics " + name + ": " + what + (errno ? std::string(": ") + std::strerror(errno)
+                                                                         : std::string()));
+    }
+
+    inline size_t metricsSegmentSize(uint32_t max_metrics, uint32_t max_histograms) noexcept {
+      return sizeof(MetricsHeader) + max_metrics * sizeof(MetricSlot) + max_histograms * sizeof(HistogramSlot);
+    }
+  }
+
+  struct MetricsConfig {
+    // POSIX shared memory segment to publish into, e.g. "/crypto_mm.metrics". Empty keeps the metrics in
+    // private memory.
+    std::string shm_name{};
+    uint32_t max_metrics{256};
+    uint32_t max_histograms{32};
+  };
+
+  // Counters, gauges and histograms of the process, laid out in a shared memory segment that an external
+  // monitor (cmm_metrics) maps read only. Registering takes a lock and is meant for constructors, the handles
+  // it returns are what hot paths use. Registering a name again returns the same metric. Once the segment is
+  // full further metrics are still handed out but not published.
+  class MetricsRegistry {
+  public:
+    using Config = MetricsConfig;
+
+    // The process wide registry, set up from the configuration given to configure() before its first use.
+    static MetricsRegistry &instance() {
+      static MetricsRegistry registry([] {
+        instantiated() = true;
+        return processConfig();
+      }());
+      return registry;
+    }
+
+    static void configure(const Config &config) {
+      if (instantiated()) {
+        throw std::logic_error("MetricsRegistry: configure() after the registry was first used");
+      }
+      processConfig() = config;
+    }
+
+    explicit MetricsRegistry(const Config &config = Config{}) : config_(config) {
+      size_ = detail::metricsSegmentSize(config.max_metrics, config.max_histograms);
+      errno = 0;
+      void *data;
+      if (config.shm_name.empty()) {
+        data = ::mmap(nullptr, size_, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+      } else {
+        // A segment left behind by an earlier run is replaced, monitors still attached to it keep the old one.
+        ::shm_unlink(config.shm_name.c_str());
+        const int fd = ::shm_open(config.shm_name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0644);
+        if (fd < 0) {
+          throw detail::metricsError("cannot create", config.shm_name);
+        }
+        if (::ftruncate(fd, static_cast<off_t>(size_)) != 0) {
+          ::close(fd);
+          throw detail::metricsError("cannot size", config.shm_name);
+        }
+        data = ::mmap(nullptr, size_, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        ::close(fd);
+      }
+      if (data == MAP_FAILED) {
+        throw detail::metricsError("cannot map", config.shm_name);
+      }
+      header_ = static_cast<MetricsHeader *>(data);
+      metrics_ = reinterpret_cast<MetricSlot *>(header_ + 1);
+      histograms_ = reinterpret_cast<HistogramSlot *>(metrics_ + config.max_metrics);
+      header_->version = MetricsHeader::CurrentVersion;
+      header_->max_metrics = config.max_metrics;
+      header_->max_histograms = config.max_histograms;
+      header_->pid = ::getpid();
+      std::memcpy(header_->magic, MetricsHeader::Magic, sizeof(header_->magic));
+      std::atomic_thread_fence(std::memory_order::release);
+    }
+
+    ~MetricsRegistry() {
+      ::munmap(header_, size_);
+      if (!config_.shm_name.empty()) {
+        ::shm_unlink(config_.shm_name.c_str());
+      }
+    }
+
+    MetricsRegistry(const MetricsRegistry &) = delete;
+
+    MetricsRegistry(const MetricsRegistry &&) = delete;
+
+    MetricsRegistry &operator=(const MetricsRegistry &) = delete;
+
+    MetricsRegistry &operator=(const MetricsRegistry &&) = delete;
+
+    Counter counter(std::string_view name) {
+      return Counter(slot(name, MetricType::COUNTER).value);
+    }
+
+    Gauge gauge(std::string_view name) {
+      return Gauge(slot(name, MetricType::GAUGE).value);
+    }
+
+    Gauge decimalGauge(std::string_view name) {
+      return Gauge(slot(name, MetricType::DECIMAL_GAUGE).value);
+    }
+
+    Histogram histogram(std::string_view name) {
+      std::lock_guard<std::mutex> lock(mutex_);
+      const auto count = header_->histograms.load(std::memory_order::relaxed);
+      for (uint32_t i = 0; i < count; ++i) {
+        if (histograms_[i].name == name) {
+          return Histogram(histograms_[i]);
+        }
+      }
+      if (count == config_.max_histograms) [[unlikely]] {
+        return Histogram(unpublished_histogram_);
+      }
+      auto &slot = histograms_[count];
+      copyName(slot.name, name);
+      header_->histograms.store(count + 1, std::memory_order::release);
+      return Histogram(slot);
+    }
+
+    const std::string &shmName() const noexcept {
+      return config_.shm_name;
+    }
+
+  private:
+    static bool &instantiated() {
+      static bool flag = false;
+      return flag;
+    }
+
+    static Config &processConfig() {
+      static Config config;
+      return config;
+    }
+
+    template<size_t N>
+    static void copyName(char (&to)[N], std::string_view name) noexcept {
+      const auto size = std::min(name.size(), N - 1);
+      std::memcpy(to, name.data(), size);
+      to[size] = '\0';
+    }
+
+    MetricSlot &slot(std::string_view name, MetricType type) {
+      std::lock_guard<std::mutex> lock(mutex_);
+      const auto count = header_->metrics.load(std::memory_order::relaxed);
+      for (uint32_t i = 0; i < count; ++i) {
+        if (metrics_[i].name == name) {
+          return metrics_[i];
+        }
+      }
+      if (count == config_.max_metrics) [[unlikely]] {
+        return unpublished_metric_;
+      }
+      auto &slot = metrics_[count];
+      copyName(slot.name, name);
+      slot.type = type;
+      header_->metrics.store(count + 1, std::memory_order::release);
+      return slot;
+    }
+
+    const Config config_;
+    size_t size_;
+    MetricsHeader *header_;
+    MetricSlot *metrics_;
+    HistogramSlot *histograms_;
+    std::mutex mutex_;
+    MetricSlot unpublished_metric_{};
+    HistogramSlot unpublished_histogram_{};
+  };
+
+  // `registry` if given, the process wide one otherwise. Components that can run several times in a process,
+  // like the engines of parallel backtests, take their registry in their config so each instance writes its
+  // own metrics.
+  inline MetricsRegistry &metricsRegistry(MetricsRegistry *registry) {
+    return registry ? *registry : MetricsRegistry::instance();
+  }
+
+  struct MetricValue {
+    std::string name;
+    MetricType type;
+    int64_t value;
+  };
+
+  struct HistogramValue {
+    std::string name;
+    uint64_t count;
+    uint64_t sum;
+    std::array<uint64_t, HistogramSlot::Buckets> buckets;
+
+    // Upper bound of the bucket the fraction `p` of the values are in or below.
+    uint64_t percentile(double p) const noexcept {
+      uint64_t total = 0;
+      for (const auto bucket: buckets) {
+        total += bucket;
+      }
+      const auto rank = std::max<uint64_t>(1, static_cast<uint64_t>(p * static_cast<double>(total) + 0.5));
+      uint64_t seen = 0;
+      for (size_t i = 0; i < buckets.size(); ++i) {
+        seen += buckets[i];
+        if (seen >= rank) {
+          return i == 0 ? 0 : i + 1 == buckets.size() ? UINT64_MAX : (uint64_t{1} << i) - 1;
+        }
+      }
+      return 0;
+    }
+  };
+
+  // Read only mapping of a segment a MetricsRegistry publishes, usually from another process. Nothing is
+  // ever written to it, so attaching a monitor costs the writers at most a few shared cache lines.
+  class MetricsReader {
+  public:
+    explicit MetricsReader(const std::string &shm_name) : shm_name_(shm_name) {
+      errno = 0;
+      const int fd = ::shm_open(shm_name.c_str(), O_RDONLY, 0);
+      if (fd < 0) {
+        throw detail::metricsError("cannot open", shm_name);
+      }
+      struct stat st{};
+      ::fstat(fd, &st);
+      size_ = static_cast<size_t>(st.st_size);
+      if (size_ < sizeof(MetricsHeader)) {
+        ::close(fd);
+        throw detail::metricsError("truncated header", shm_name);
+      }
+      void *data = ::mmap(nullptr, size_, PROT_READ, MAP_SHARED, fd, 0);
+      ::close(fd);
+      if (data == MAP_FAILED) {
+        throw detail::metricsError("cannot map", shm_name);
+      }
+      header_ = static_cast<const MetricsHeader *>(data);
+      std::atomic_thread_fence(std::memory_order::acquire);
+      if (std::memcmp(header_->magic, MetricsHeader::Magic, sizeof(header_->magic)) != 0 ||
+          header_->version != MetricsHeader::CurrentVersion ||
+          size_ < detail::metricsSegmentSize(header_->max_metrics, header_->max_histograms)) {
+        ::munmap(const_cast<MetricsHeader *>(header_), size_);
+        errno = 0;
+        throw detail::metricsError("not a metrics segment of version " +
+                                   std::to_string(MetricsHeader::CurrentVersion), shm_name);
+      }
+      metrics_ = reinterpret_cast<const MetricSlot *>(header_ + 1);
+      histograms_ = reinterpret_cast<const HistogramSlot *>(metrics_ + header_->max_metrics);
+    }
+
+    ~MetricsReader() {
+      ::munmap(const_cast<MetricsHeader *>(header_), size_);
+    }
+
+    MetricsReader(const MetricsReader &) = delete;
+
+    MetricsReader(const MetricsReader &&) = delete;
+
+    MetricsReader &operator=(const MetricsReader &) = delete;
+
+    MetricsReader &operator=(const MetricsReader &&) = delete;
+
+    int64_t pid() const noexcept {
+      return header_->pid;
+    }
+
+    std::vector<MetricValue> metrics() const {
+      const auto count = std::min(header_->metrics.load(std::memory_order::acquire), header_->max_metrics);
+      std::vector<MetricValue> values;
+      values.reserve(count);
+      for (uint32_t i = 0; i < count; ++i) {
+        const auto &slot = metrics_[i];
+        values.push_back(MetricValue{name(slot.name), slot.type, slot.value.load(std::memory_order::relaxed)});
+      }
+      return values;
+    }
+
+    std::vector<HistogramValue> histograms() const {
+      const auto count = std::min(header_->histograms.load(std::memory_order::acquire), header_->max_histograms);
+      std::vector<HistogramValue> values;
+      values.reserve(count);
+      for (uint32_t i = 0; i < count; ++i) {
+        const auto &slot = histograms_[i];
+        HistogramValue value{name(slot.name), slot.count.load(std::memory_order::relaxed),
+                             slot.sum.load(std::memory_order::relaxed), {}};
+        for (size_t j = 0; j < value.buckets.size(); ++j) {
+          value.buckets[j] = slot.buckets[j].load(std::memory_order::relaxed);
+        }
+        values.push_back(std::move(value));
+      }
+      return values;
+    }
+
+  private:
+    template<size_t N>
+    static std::string name(const char (&name)[N]) {
+      return std::string(name, ::strnlen(name, N));
+    }
+
+    std::string shm_name_;
+    size_t size_;
+    const MetricsHeader *header_;
+    const MetricSlot *metrics_;
+    const HistogramSlot *histograms_;
+  };
+}
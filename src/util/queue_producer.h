@@ -0,0 +1,170 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "metrics.h"
+#include "spsc_queue.h"
+#include "thread_utils.h"
+#include "wait_strategy.h"
+
+namespace util {
+  // What a producer does when its SpscQueue is full.
+  enum class OverflowPolicy : uint8_t {
+    DROP, // lose the message, for what a later message makes obsolete anyway
+    BLOCK, // spin until the consumer makes room, for messages that must not be lost
+    CONFLATE // keep the latest message per key aside and send it once there is room
+  };
+
+  struct QueueProducerConfig {
+    OverflowPolicy policy{OverflowPolicy::DROP};
+    // Prefix of the metrics of the queue, e.g. "md.bbo_queue" publishes md.bbo_queue.pushed, .dropped,
+    // .conflated, .blocked and .high_water.
+    std::string metrics_name{};
+    // Number of distinct keys push() is given, CONFLATE only.
+    size_t keys{1};
+  };
+
+  // Producer side of an SpscQueue with an overflow policy and metrics. Whatever the policy, a full queue is
+  // never silent: a message that had to wait, was replaced or was lost is counted.
+  //
+  // CONFLATE keeps one message per key aside while the queue is full (a newer one replaces it) and sends the
+  // kept ones before anything else on the next push() or flush(), so per key the consumer still sees messages
+  // in order, the latest one last, and never more than it can take.
+  //
+  // The high water mark is the queue size seen every SampleInterval pushes, or the capacity once it was full.
+  // Reading the size touches the consumer's index, so it isn't done on every push.
+  template<typename T>
+  class QueueProducer {
+  public:
+    using Config = QueueProducerConfig;
+
+    static constexpr uint32_t SampleInterval = 64;
+
+    QueueProducer(SpscQueue<T> &queue, const Config &config = Config{},
+                  WaitStrategy *consumer_wait_strategy = nullptr)
+      : queue_(queue)
+        , policy_(config.policy)
+        , consumer_wait_strategy_(consumer_wait_strategy)
+        , pushed_(MetricsRegistry::instance().counter(config.metrics_name + ".pushed"))
+        , dropped_(MetricsRegistry::instance().counter(config.metrics_name + ".dropped"))
+        , conflated_(MetricsRegistry::instance().counter(config.metrics_name + ".conflated"))
+        , blocked_(MetricsRegistry::instance().counter(config.metrics_name + ".blocked"))
+        , high_water_(MetricsRegistry::instance().gauge(config.metrics_name + ".high_water")) {
+      if (policy_ == OverflowPolicy::CONFLATE) {
+        pending_.resize(config.keys);
+        is_pending_.resize(config.keys, false);
+        pending_keys_.reserve(config.keys);
+      }
+    }
+
+    QueueProducer(const QueueProducer &) = delete;
+
+    QueueProducer(const QueueProducer &&) = delete;
+
+    QueueProducer &operator=(const QueueProducer &) = delete;
+
+    QueueProducer &operator=(const QueueProducer &&) = delete;
+
+    // Returns false if the message was dropped, or BLOCK gave up because `cancelled` became true. `key` is
+    // below Config::keys and only used by CONFLATE.
+    bool push(const T &msg, size_t key = 0, const std::atomic<bool> *cancelled = nullptr) noexcept {
+      if (!pending_keys_.empty()) [[unlikely]] {
+        flush();
+      }
+      if (pending_keys_.empty() && queue_.push(msg)) [[likely]] {
+        pushed_.add();
+        sampleHighWater();
+        return true;
+      }
+      high_water_.set(static_cast<int64_t>(queue_.capacity()));
+      switch (policy_) {
+        case OverflowPolicy::DROP:
+          dropped_.add();
+          return false;
+        case OverflowPolicy::BLOCK:
+          return pushBlocking(msg, cancelled);
+        case OverflowPolicy::CONFLATE:
+          if (is_pending_[key]) {
+            conflated_.add();
+          } else {
+            is_pending_[key] = true;
+            pending_keys_.push_back(static_cast<uint32_t>(key));
+          }
+          pending_[key] = msg;
+          return true;
+      }
+      return false;
+    }
+
+    // Sends as many of the messages CONFLATE kept aside as fit, returns whether any are left.
+    bool flush() noexcept {
+      size_t sent = 0;
+      while (sent < pending_keys_.size() && queue_.push(pending_[pending_keys_[sent]])) {
+        is_pending_[pending_keys_[sent]] = false;
+        ++sent;
+      }
+      if (sent) {
+        pushed_.add(static_cast<int64_t>(sent));
+        pending_keys_.erase(pending_keys_.begin(), pending_keys_.begin() + static_cast<std::ptrdiff_t>(sent));
+        if (consumer_wait_strategy_) {
+          consumer_wait_strategy_->notify();
+        }
+      }
+      return !pending_keys_.empty();
+    }
+
+    size_t pending() const noexcept {
+      return pending_keys_.size();
+    }
+
+    OverflowPolicy policy() const noexcept {
+      return policy_;
+    }
+
+  private:
+    bool pushBlocking(const T &msg, const std::atomic<bool> *cancelled) noexcept {
+      blocked_.add();
+      if (consumer_wait_strategy_) {
+        consumer_wait_strategy_->notify();
+      }
+      while (!queue_.push(msg)) {
+        if (cancelled && cancelled->load(std::memory_order::relaxed)) [[unlikely]] {
+          dropped_.add();
+          return false;
+        }
+        cpuRelax();
+      }
+      pushed_.add();
+      return true;
+    }
+
+    void sampleHighWater() noexcept {
+      if (++since_sample_ < SampleInterval) [[likely]] {
+        return;
+      }
+      since_sample_ = 0;
+      const auto size = static_cast<int64_t>(queue_.size());
+      if (size > high_water_.value()) {
+        high_water_.set(size);
+      }
+    }
+
+    SpscQueue<T> &queue_;
+    const OverflowPolicy policy_;
+    WaitStrategy *consumer_wait_strategy_;
+    // CONFLATE: latest message per key not sent yet, and those keys in the order they were first kept.
+    std::vector<T> pending_;
+    std::vector<bool> is_pending_;
+    std::vector<uint32_t> pending_keys_;
+    uint32_t since_sample_{0};
+    Counter pushed_;
+    Counter dropped_;
+    Counter conflated_;
+    Counter blocked_;
+    Gauge high_water_;
+  };
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+
+namespace util {
+  // Widest vector instruction set the batch kernels may use on this machine. The binary is built for the
+  // baseline x86-64, the AVX2 and AVX-512 kernels are compiled per function and picked at run time.
+  enum class SimdLevel : uint8_t {
+    SCALAR,
+    AVX2,
+    AVX512, // F and DQ, for the 64 bit integer conversions
+  };
+
+  inline SimdLevel detectSimdLevel() noexcept {
+#if defined(__x86_64__) || defined(__i386__)
+    // Also checks that the OS saves the wider registers.
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512dq")) {
+      return SimdLevel::AVX512;
+    }
+    if (__builtin_cpu_supports("avx2")) {
+      return SimdLevel::AVX2;
+    }
+#endif
+    return SimdLevel::SCALAR;
+  }
+
+  // detectSimdLevel() of the first call.
+  inline SimdLevel simdLevel() noexcept {
+    static const SimdLevel level = detectSimdLevel();
+    return level;
+  }
+
+  // Whether the machine runs `level`, SCALAR always.
+  inline bool simdLevelSupported(SimdLevel level) noexcept {
+    return static_cast<uint8_t>(level) <= static_cast<uint8_t>(simdLevel());
+  }
+
+  constexpr std::array<const char *, 3> SimdLevelNames{"scalar", "avx2", "avx512"};
+}
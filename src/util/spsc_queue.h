@@ -1,14 +1,30 @@
 #pragma once
 
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <memory>
+#include <utility>
 #include <vector>
 
 #include "padded_value.h"
 
 namespace util {
+  // Bounded single producer single consumer ring.
+  //
+  // Capacity is rounded up to a power of two so indices wrap with a mask. Indices only ever grow,
+  // which lets every slot be used (no "one empty slot" rule). Each side keeps a private copy of
+  // the other side's index and only reloads the shared atomic when the copy says full/empty.
+  //
+  // Slots always hold live objects: besides copying push()/pop() there is an in-place API,
+  // try_claim()/commit() and emplace() for the producer and front()/pop() for the consumer, so
+  // messages holding buffers can reuse the slot's memory instead of allocating per message.
   template<typename T>
   class SpscQueue final {
   public:
-    explicit SpscQueue(std::size_t maxElems) : store_(maxElems, T()) {
+    explicit SpscQueue(std::size_t maxElems)
+      : capacity_(std::bit_ceil(std::max<std::size_t>(maxElems, 1))), mask_(capacity_ - 1),
+        store_(capacity_, T()) {
     }
 
     SpscQueue() = delete;
@@ -17,38 +33,136 @@ namespace util {
     SpscQueue &operator=(const SpscQueue &) = delete;
     SpscQueue &operator=(const SpscQueue &&) = delete;
 
-    auto push(const T &elem) noexcept {
-      const auto idx = nextWriteIdx_.value.load(std::memory_order::relaxed);
-      const auto next_idx = increment(idx);
-      if (next_idx != nextReadIdx_.value.load(std::memory_order::acquire)) {
-        store_[idx] = elem;
-        nextWriteIdx_.value.store(next_idx, std::memory_order::release);
-        return true;
+    // Producer side.
+
+    // Returns the next free slot to be overwritten in place, or nullptr if the queue is full.
+    // Nothing is visible to the consumer until commit().
+    T *try_claim() noexcept {
+      const auto idx = writeIdx_.value.load(std::memory_order::relaxed);
+      if (idx - cachedReadIdx_.value == capacity_) {
+        cachedReadIdx_.value = readIdx_.value.load(std::memory_order::acquire);
+        if (idx - cachedReadIdx_.value == capacity_) [[unlikely]] {
+          return nullptr;
+        }
       }
-      return false;
+      return &store_[idx & mask_];
+    }
+
+    void commit() noexcept {
+      writeIdx_.value.store(writeIdx_.value.load(std::memory_order::relaxed) + 1, std::memory_order::release);
     }
 
-    auto pop(T &elem) noexcept {
-      const auto idx = nextReadIdx_.value.load(std::memory_order::relaxed);
-      if (idx == nextWriteIdx_.value.load(std::memory_order::acquire)) {
+    template<typename... Args>
+    bool emplace(Args &&... args) noexcept(std::is_nothrow_constructible_v<T, Args...>) {
+      auto *slot = try_claim();
+      if (!slot) [[unlikely]] {
         return false;
       }
-      elem = store_[idx];
-      const auto next_idx = increment(idx);
-      nextReadIdx_.value.store(next_idx, std::memory_order::release);
+      std::destroy_at(slot);
+      std::construct_at(slot, std::forward<Args>(args)...);
+      commit();
       return true;
     }
 
-  private:
-    size_t increment(size_t idx) const {
-      if (idx == store_.capacity() - 1) { [[unlikely]]
-        return 0;
+    bool push(const T &elem) noexcept {
+      auto *slot = try_claim();
+      if (!slot) [[unlikely]] {
+        return false;
+      }
+      *slot = elem;
+      commit();
+      return true;
+    }
+
+    // Pushes as many of the n elements as fit, publishing them with a single index store.
+    std::size_t push_n(const T *elems, std::size_t n) noexcept {
+      const auto idx = writeIdx_.value.load(std::memory_order::relaxed);
+      auto free = capacity_ - (idx - cachedReadIdx_.value);
+      if (free < n) {
+        cachedReadIdx_.value = readIdx_.value.load(std::memory_order::acquire);
+        free = capacity_ - (idx - cachedReadIdx_.value);
       }
-      return idx + 1;
+      const auto count = std::min(free, n);
+      for (std::size_t i = 0; i < count; ++i) {
+        store_[(idx + i) & mask_] = elems[i];
+      }
+      if (count) {
+        writeIdx_.value.store(idx + count, std::memory_order::release);
+      }
+      return count;
     }
 
+    // Consumer side.
+
+    // Returns the oldest element for in-place reading, or nullptr if the queue is empty.
+    // The slot stays valid until pop().
+    T *front() noexcept {
+      const auto idx = readIdx_.value.load(std::memory_order::relaxed);
+      if (idx == cachedWriteIdx_.value) {
+        cachedWriteIdx_.value = writeIdx_.value.load(std::memory_order::acquire);
+        if (idx == cachedWriteIdx_.value) {
+          return nullptr;
+        }
+      }
+      return &store_[idx & mask_];
+    }
+
+    // Releases the slot returned by front().
+    void pop() noexcept {
+      readIdx_.value.store(readIdx_.value.load(std::memory_order::relaxed) + 1, std::memory_order::release);
+    }
+
+    bool pop(T &elem) noexcept {
+      auto *slot = front();
+      if (!slot) {
+        return false;
+      }
+      elem = std::move(*slot);
+      pop();
+      return true;
+    }
+
+    // Pops up to max_n elements, releasing them with a single index store.
+    std::size_t pop_n(T *elems, std::size_t max_n) noexcept {
+      const auto idx = readIdx_.value.load(std::memory_order::relaxed);
+      auto available = cachedWriteIdx_.value - idx;
+      if (available < max_n) {
+        cachedWriteIdx_.value = writeIdx_.value.load(std::memory_order::acquire);
+        available = cachedWriteIdx_.value - idx;
+      }
+      const auto count = std::min(available, max_n);
+      for (std::size_t i = 0; i < count; ++i) {
+        elems[i] = std::move(store_[(idx + i) & mask_]);
+      }
+      if (count) {
+        readIdx_.value.store(idx + count, std::memory_order::release);
+      }
+      return count;
+    }
+
+    // Either side.
+
+    bool empty() const noexcept {
+      return readIdx_.value.load(std::memory_order::acquire) == writeIdx_.value.load(std::memory_order::acquire);
+    }
+
+    std::size_t size() const noexcept {
+      const auto read_idx = readIdx_.value.load(std::memory_order::acquire);
+      return writeIdx_.value.load(std::memory_order::acquire) - read_idx;
+    }
+
+    std::size_t capacity() const noexcept {
+      return capacity_;
+    }
+
+  private:
+    const std::size_t capacity_;
+    const std::size_t mask_;
     std::vector<T> store_;
-    PaddedValue<std::atomic<size_t> > nextWriteIdx_{0};
-    PaddedValue<std::atomic<size_t> > nextReadIdx_{0};
+    // Shared indices and each side's private cache of the other one, all on separate cache lines.
+    PaddedValue<std::atomic<std::size_t> > writeIdx_{0};
+    PaddedValue<std::size_t> cachedReadIdx_{0};
+    PaddedValue<std::atomic<std::size_t> > readIdx_{0};
+    PaddedValue<std::size_t> cachedWriteIdx_{0};
   };
-}
\ No newline at end of file
+}
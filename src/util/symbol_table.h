@@ -0,0 +1,120 @@
+#pragma once
+
+#include <bit>
+#include <cstdint>
+#include <initializer_list>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "decimal.h"
+
+namespace util {
+  // Dense index of an instrument, everything per-symbol lives in arrays indexed by it.
+  using SymbolId = uint16_t;
+
+  constexpr SymbolId InvalidSymbolId = std::numeric_limits<SymbolId>::max();
+
+  // Exchange rules of an instrument: prices are multiples of tick_size, quantities multiples of lot_size.
+  struct SymbolSpec {
+    Price tick_size{Price::fromFixed(FixedPointScale / 100)};
+    Qty lot_size{Qty::fromFixed(1)};
+
+    constexpr Price roundToTick(Price price) const noexcept {
+      return price.roundDown(tick_size);
+    }
+
+    constexpr Price roundUpToTick(Price price) const noexcept {
+      return price.roundUp(tick_size);
+    }
+
+    constexpr Qty roundToLot(Qty quantity) const noexcept {
+      return quantity.roundDown(lot_size);
+    }
+  };
+
+  // Symbols are interned once at startup, after that names only get resolved where they come in from the
+  // exchange (market data frames) and every other component works with SymbolIds. find() is an open
+  // addressing hash lookup that never allocates.
+  class SymbolTable {
+  public:
+    SymbolTable() = default;
+
+    SymbolTable(std::initializer_list<std::string_view> names) {
+      for (const auto name: names) {
+        add(name);
+      }
+    }
+
+    // Returns the id of the symbol, adding it with `spec` if it is new.
+    SymbolId add(std::string_view name, const SymbolSpec &spec = SymbolSpec{}) {
+      if (const auto id = find(name); id != InvalidSymbolId) {
+        return id;
+      }
+      if (names_.size() == InvalidSymbolId) {
+        throw std::length_error("SymbolTable: too many symbols");
+      }
+      names_.emplace_back(name);
+      specs_.push_back(spec);
+      rehash(std::bit_ceil(std::max<size_t>(2 * names_.size(), 16)));
+      return static_cast<SymbolId>(names_.size() - 1);
+    }
+
+    SymbolId find(std::string_view name) const noexcept {
+      if (slots_.empty()) {
+        return InvalidSymbolId;
+      }
+      for (auto slot = hash(name) & mask_;; slot = (slot + 1) & mask_) {
+        const auto id = slots_[slot];
+        if (id == InvalidSymbolId || names_[id] == name) {
+          return id;
+        }
+      }
+    }
+
+    std::string_view name(SymbolId id) const noexcept {
+      return names_[id];
+    }
+
+    const SymbolSpec &spec(SymbolId id) const noexcept {
+      return specs_[id];
+    }
+
+    size_t size() const noexcept {
+      return names_.size();
+    }
+
+    const std::vector<std::string> &names() const noexcept {
+      return names_;
+    }
+
+  private:
+    // FNV-1a, symbols are short.
+    static uint64_t hash(std::string_view name) noexcept {
+      uint64_t h = 14695981039346656037ull;
+      for (const auto c: name) {
+        h = (h ^ static_cast<unsigned char>(c)) * 1099511628211ull;
+      }
+      return h;
+    }
+
+    void rehash(size_t capacity) {
+      slots_.assign(capacity, InvalidSymbolId);
+      mask_ = capacity - 1;
+      for (size_t id = 0; id < names_.size(); ++id) {
+        auto slot = hash(names_[id]) & mask_;
+        while (slots_[slot] != InvalidSymbolId) {
+          slot = (slot + 1) & mask_;
+        }
+        slots_[slot] = static_cast<SymbolId>(id);
+      }
+    }
+
+    std::vector<std::string> names_;
+    std::vector<SymbolSpec> specs_;
+    std::vector<SymbolId> slots_;
+    uint64_t mask_{0};
+  };
+}
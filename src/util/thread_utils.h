@@ -0,0 +1,31 @@
+#pragma once
+
+#include <pthread.h>
+#include <sched.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+namespace util {
+  // Hint to the CPU that we are in a spin-wait loop (PAUSE on x86, YIELD on ARM).
+  inline void cpuRelax() noexcept {
+#if defined(__x86_64__) || defined(__i386__)
+    _mm_pause();
+#elif defined(__aarch64__)
+    asm volatile("yield" ::: "memory");
+#endif
+  }
+
+  // Pins the calling thread to a single CPU, see the CPU allocation layout in the README.
+  // Returns false if the CPU does not exist or is not in our allowed set.
+  inline bool pinCurrentThreadToCpu(int cpu_id) noexcept {
+    if (cpu_id < 0 || cpu_id >= CPU_SETSIZE) {
+      return false;
+    }
+    cpu_set_t cpu_set;
+    CPU_ZERO(&cpu_set);
+    CPU_SET(cpu_id, &cpu_set);
+    return pthread_setaffinity_np(pthread_self(), sizeof(cpu_set), &cpu_set) == 0;
+  }
+}
@@ -0,0 +1,115 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <thread>
+
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "padded_value.h"
+#include "thread_utils.h"
+
+namespace util {
+  enum class WaitStrategyType {
+    BUSY_SPIN, // Never gives up the CPU, lowest latency, for threads pinned to isolated CPUs.
+    SPIN_YIELD, // Spins for a while, then yields to the scheduler on every idle pass.
+    SPIN_PARK // Spins for a while, then sleeps on a futex until a producer calls notify().
+  };
+
+  // Decides what a consumer loop does when a pass over its queues found nothing to do.
+  // The consumer calls idle() after an empty pass and reset() after a pass that did work,
+  // producers call notify() after publishing work (only SPIN_PARK actually needs it).
+  class WaitStrategy {
+  public:
+    explicit WaitStrategy(WaitStrategyType type, uint32_t spin_limit = 10000,
+                          std::chrono::microseconds park_timeout = std::chrono::milliseconds(1))
+      : type_(type), spin_limit_(spin_limit), park_timeout_(park_timeout) {
+    }
+
+    WaitStrategy(const WaitStrategy &) = delete;
+
+    WaitStrategy(const WaitStrategy &&) = delete;
+
+    WaitStrategy &operator=(const WaitStrategy &) = delete;
+
+    WaitStrategy &operator=(const WaitStrategy &&) = delete;
+
+    WaitStrategyType type() const noexcept {
+      return type_;
+    }
+
+    // has_work is re-checked after announcing that we are about to park so a notify() racing
+    // with us going to sleep is never lost.
+    template<typename HasWork>
+    void idle(HasWork &&has_work) noexcept {
+      if (type_ == WaitStrategyType::BUSY_SPIN) [[likely]] {
+        cpuRelax();
+        return;
+      }
+      if (idle_spins_ < spin_limit_) {
+        ++idle_spins_;
+        cpuRelax();
+        return;
+      }
+      if (type_ == WaitStrategyType::SPIN_YIELD) {
+        std::this_thread::yield();
+      } else {
+        park(has_work);
+      }
+    }
+
+    void reset() noexcept {
+      idle_spins_ = 0;
+    }
+
+    void notify() noexcept {
+      if (type_ != WaitStrategyType::SPIN_PARK) {
+        return;
+      }
+      // Pairs with the fence in park(): either we see the waiter or the waiter sees our work.
+      std::atomic_thread_fence(std::memory_order::seq_cst);
+      if (parked_.value.load(std::memory_order::relaxed)) [[unlikely]] {
+        wake();
+      }
+    }
+
+    // Unconditionally wakes a parked consumer, e.g. on shutdown.
+    void wake() noexcept {
+      epoch_.value.fetch_add(1, std::memory_order::release);
+      syscall(SYS_futex, reinterpret_cast<uint32_t *>(&epoch_.value), FUTEX_WAKE_PRIVATE, 1, nullptr, nullptr, 0);
+    }
+
+  private:
+    template<typename HasWork>
+    void park(HasWork &&has_work) noexcept {
+      const auto epoch = epoch_.value.load(std::memory_order::acquire);
+      parked_.value.store(true, std::memory_order::relaxed);
+      std::atomic_thread_fence(std::memory_order::seq_cst);
+      if (!has_work()) {
+        // The timeout only bounds the damage of a producer that forgets to notify.
+        const auto secs = std::chrono::duration_cast<std::chrono::seconds>(park_timeout_);
+        timespec timeout{
+          .tv_sec = static_cast<time_t>(secs.count()),
+          .tv_nsec = static_cast<long>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            park_timeout_ - secs).count())
+        };
+        syscall(SYS_futex, reinterpret_cast<uint32_t *>(&epoch_.value), FUTEX_WAIT_PRIVATE, epoch, &timeout,
+                nullptr, 0);
+      }
+      parked_.value.store(false, std::memory_order::relaxed);
+    }
+
+    static_assert(sizeof(std::atomic<uint32_t>) == sizeof(uint32_t), "futex word must be 32 bits");
+
+    const WaitStrategyType type_;
+    const uint32_t spin_limit_;
+    const std::chrono::microseconds park_timeout_;
+    uint32_t idle_spins_{0};
+    PaddedValue<std::atomic<uint32_t> > epoch_{0};
+    PaddedValue<std::atomic<bool> > parked_{false};
+  };
+}